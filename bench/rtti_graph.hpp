@@ -0,0 +1,166 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+// a synthetic rtti graph laid out like the game's. most classes derive from the class before them, so the graph is
+// as deep as it is wide, and the factory only lists every 64th class so the rest has to be found by walking.
+
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "rtti.hpp"
+
+namespace stormbird_bench {
+	using namespace stormbird_hook;
+
+	class rtti_graph {
+	public:
+		rtti_graph(size_t class_count, uint64_t seed) : rng(seed) {
+			uint16_t type_id = 1;
+			for (size_t index = 0; index < 16; ++index) {
+				auto &primitive = primitives.emplace_back();
+				primitive.base = { type_id++, 1, RTTIType::Primitive };
+				primitive.name = text("primitive" + std::to_string(index));
+				primitive.size = static_cast<uint8_t>(1 << (index % 4));
+				primitive.total_size = primitive.size;
+				primitive.count = 1;
+				primitive.parent = index % 4 == 0 ? &primitive.base : &primitives[index - index % 4].base;
+				leaves.push_back(&primitive.base);
+			}
+
+			for (size_t index = 0; index < class_count / 8 + 1; ++index) {
+				auto &enum_rtti = enums.emplace_back();
+				enum_rtti.base = { type_id++, 2, index % 2 == 0 ? RTTIType::Enum : RTTIType::Bitset };
+				enum_rtti.name = text("Enum" + std::to_string(index));
+				enum_rtti.size = 4;
+				enum_rtti.member_count = static_cast<uint16_t>(below(8));
+				auto &values = enum_values.emplace_back(enum_rtti.member_count);
+				for (auto &value : values) {
+					value.value = rng();
+					value.name = text("value" + std::to_string(&value - values.data()));
+				}
+				enum_rtti.values = values.data();
+				leaves.push_back(&enum_rtti.base);
+			}
+
+			for (size_t index = 0; index < class_count; ++index) {
+				auto &class_rtti = classes.emplace_back();
+				class_rtti.base = { type_id++, 3, RTTIType::Class };
+				class_rtti.name = text("Class" + std::to_string(index));
+				class_rtti.hash = static_cast<uint32_t>(rng());
+				class_rtti.size = static_cast<uint32_t>(8 + below(512));
+				class_rtti.alignment = 8;
+			}
+
+			auto &reference_data = reference_kinds.emplace_back();
+			reference_data.name = text("Ref");
+			auto &container_data = reference_kinds.emplace_back();
+			container_data.name = text("Array");
+			for (size_t index = 0; index < class_count / 2 + 1; ++index) {
+				auto *type = any_type(); // picked first, a reference only ever points at types made before it
+				auto &reference = references.emplace_back();
+				auto container = index % 2 == 1;
+				reference.base = { type_id++, 4, container ? RTTIType::Container : RTTIType::Reference };
+				reference.data = container ? &container_data : &reference_data;
+				reference.type = type;
+			}
+
+			for (size_t index = 0; index < class_count; ++index) {
+				link_class(index);
+			}
+
+			for (size_t index = 0; index < class_count; index += 64) {
+				records.push_back({ index, &classes[index].base });
+			}
+
+			factory.rtti = { records.data(), static_cast<uint32_t>(records.size()), static_cast<uint32_t>(records.size()) };
+		}
+
+		rtti_graph(const rtti_graph &) = delete;
+		auto
+		operator=(const rtti_graph &) -> rtti_graph & = delete;
+
+		[[nodiscard]] auto
+		type_count() const -> size_t {
+			return primitives.size() + enums.size() + classes.size() + references.size();
+		}
+
+		// a game patch, changes the schema hash of every nth class
+		void
+		patch(size_t every) {
+			for (size_t index = 0; index < classes.size(); index += every) {
+				classes[index].hash = static_cast<uint32_t>(rng());
+			}
+		}
+
+		RTTIFactory factory {};
+
+	private:
+		auto
+		below(size_t limit) -> size_t {
+			return static_cast<size_t>(rng() % limit);
+		}
+
+		auto
+		text(std::string value) -> const char * {
+			return strings.emplace_back(std::move(value)).c_str();
+		}
+
+		auto
+		any_type() -> RTTIBase * {
+			switch (below(4)) {
+				case 0: return &classes[below(classes.size())].base;
+				case 1: return references.empty() ? leaves[below(leaves.size())] : &references[below(references.size())].base;
+				default: return leaves[below(leaves.size())];
+			}
+		}
+
+		void
+		link_class(size_t index) {
+			auto &class_rtti = classes[index];
+			if (index > 0) {
+				auto &parent = below(8) == 0 ? classes[below(index)] : classes[index - 1];
+				auto &bases = class_bases.emplace_back(1);
+				bases[0].type = &parent;
+				class_rtti.bases = bases.data();
+				class_rtti.base_count = 1;
+				class_rtti.next_sibling = parent.first_child;
+				parent.first_child = &class_rtti;
+			}
+
+			auto &members = class_members.emplace_back(below(12));
+			for (auto &member : members) {
+				member.type = any_type();
+				member.name = text("member" + std::to_string(&member - members.data()));
+				member.offset = static_cast<uint16_t>(8 * (&member - members.data()));
+			}
+			class_rtti.members = members.data();
+			class_rtti.member_count = static_cast<uint8_t>(members.size());
+
+			if (below(4) == 0) {
+				auto &events = class_events.emplace_back(1);
+				events[0].type = any_type();
+				class_rtti.events = events.data();
+				class_rtti.event_count = 1;
+			}
+		}
+
+		std::mt19937_64 rng;
+		std::deque<std::string> strings;
+		std::deque<RTTIPrimitive> primitives;
+		std::deque<RTTIEnum> enums;
+		std::deque<std::vector<RTTIEnumValue>> enum_values;
+		std::deque<RTTIClass> classes;
+		std::deque<std::vector<RTTIBaseClass>> class_bases;
+		std::deque<std::vector<RTTIClassMember>> class_members;
+		std::deque<std::vector<RTTIClassEvent>> class_events;
+		std::deque<RTTIReferenceBaseData> reference_kinds;
+		std::deque<RTTIReference> references;
+		std::vector<RTTIBase *> leaves; // primitives and enums
+		std::vector<RTTIRecord> records;
+	};
+} // namespace stormbird_bench
@@ -0,0 +1,299 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// rtti graph walks on synthetic graphs, one csv row per case.
+// node_set walks the graph with std::unordered_set for the visited types and a fresh one per sibling chain, the way the
+// dump used to, flat_set is the same walk on rtti_work_queue. name_rebuild and name_cache add the name of every type the
+// walk passes, json and binary are the full dumps into a null stream, the _parallel rows on 1 to max threads.
+// capture copies the graph into an rtti_snapshot, json_snapshot writes rtti.json from that copy.
+// record captures through a memory_recorder and saves what it read as a memory snapshot, offline captures from that file.
+// index writes rtti.idx from the snapshot, lookup finds every class by name in it and resolves one member of each.
+// manifest hashes every type for an incremental dump, json_delta writes one after a patch to 1% of the classes.
+// usage: rtti_walk_bench [max classes] [max threads]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "memory_snapshot.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_delta.hpp"
+#include "rtti_dump.hpp"
+#include "rtti_graph.hpp"
+#include "rtti_index.hpp"
+#include "rtti_names.hpp"
+#include "rtti_snapshot.hpp"
+#include "rtti_walk.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	class null_buffer : public std::streambuf {
+	protected:
+		auto
+		overflow(int_type value) -> int_type override {
+			written++;
+			return value;
+		}
+
+		auto
+		xsputn(const char_type *, std::streamsize count) -> std::streamsize override {
+			written += static_cast<size_t>(count);
+			return count;
+		}
+
+	public:
+		size_t written { 0 };
+	};
+
+	// every type the dump follows from rtti
+	template<typename Descendants, typename Fn>
+	void
+	for_each_edge(const RTTIBase *rtti, Descendants &&descendants, Fn &&fn) {
+		switch (rtti->rtti_type) {
+			case RTTIType::Primitive:
+				{
+					const auto *primitive = reinterpret_cast<const RTTIPrimitive *>(rtti);
+					if (primitive->parent != rtti) {
+						fn(primitive->parent);
+					}
+					break;
+				}
+			case RTTIType::Reference:
+			case RTTIType::Container: fn(reinterpret_cast<const RTTIReference *>(rtti)->type); break;
+			case RTTIType::Class:
+				{
+					const auto *class_rtti = reinterpret_cast<const RTTIClass *>(rtti);
+					descendants(class_rtti, [&](const RTTIClass *descendant) { fn(reinterpret_cast<const RTTIBase *>(descendant)); });
+					for (auto i = 0; class_rtti->bases != nullptr && i < class_rtti->base_count; i++) {
+						fn(reinterpret_cast<const RTTIBase *>(class_rtti->bases[i].type));
+					}
+					for (auto i = 0; class_rtti->members != nullptr && i < class_rtti->member_count; i++) {
+						fn(class_rtti->members[i].type);
+					}
+					for (auto i = 0; class_rtti->events != nullptr && i < class_rtti->event_count; i++) {
+						fn(class_rtti->events[i].type);
+					}
+					break;
+				}
+			default: break;
+		}
+	}
+
+	auto
+	walk_node_set(const RTTIFactory &factory) -> size_t {
+		std::unordered_set<uint64_t> visited;
+		std::vector<const RTTIBase *> pending;
+		auto push = [&](const RTTIBase *rtti) {
+			if (rtti != nullptr && visited.emplace(reinterpret_cast<uint64_t>(rtti)).second) {
+				pending.push_back(rtti);
+			}
+		};
+
+		auto descendants = [](const RTTIClass *class_rtti, auto &&fn) {
+			std::unordered_set<uint64_t> siblings {};
+			for (const auto *descendant = class_rtti->first_child; descendant != nullptr && siblings.emplace(reinterpret_cast<uint64_t>(descendant)).second; descendant = descendant->next_sibling) {
+				fn(descendant);
+			}
+		};
+
+		for_each_rtti_root(factory, [&](const RTTIBase *root) {
+			push(root);
+			while (!pending.empty()) {
+				const auto *rtti = pending.back();
+				pending.pop_back();
+				for_each_edge(rtti, descendants, push);
+			}
+		});
+
+		return visited.size();
+	}
+
+	template<typename Fn>
+	auto
+	walk_flat_set(const RTTIFactory &factory, Fn &&edge) -> size_t {
+		rtti_work_queue queue;
+		rtti_address_set siblings;
+		auto descendants = [&](const RTTIClass *class_rtti, auto &&fn) {
+			for_each_rtti_descendant(class_rtti, siblings, fn);
+		};
+
+		for_each_rtti_root(factory, [&](const RTTIBase *root) {
+			queue.push(root);
+			while (const auto *rtti = queue.pop()) {
+				for_each_edge(rtti, descendants, [&](const RTTIBase *next) {
+					edge(next);
+					queue.push(next);
+				});
+			}
+		});
+
+		return queue.visited_count();
+	}
+
+	template<typename Fn>
+	auto
+	time_best(Fn &&fn) -> double {
+		double best = 1e300;
+		for (int run = 0; run < 5; ++run) {
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+
+		return best;
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	size_t max_classes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+	uint32_t max_threads = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : std::max(1u, std::thread::hardware_concurrency());
+
+	std::printf("case,threads,classes,types,visited,seconds,mtypes_per_s,bytes\n");
+	for (size_t classes = 10000; classes <= max_classes; classes *= 10) {
+		stormbird_bench::rtti_graph graph(classes, 0x5708B1D);
+		auto types = graph.type_count();
+		auto report = [&](const char *name, uint32_t threads, size_t visited, double seconds, size_t bytes) {
+			std::printf("%s,%u,%zu,%zu,%zu,%.6f,%.3f,%zu\n", name, threads, classes, types, visited, seconds, static_cast<double>(types) / seconds / 1e6, bytes);
+		};
+
+		size_t visited = 0;
+		auto seconds = time_best([&]() { visited = walk_node_set(graph.factory); });
+		report("node_set", 1, visited, seconds, 0);
+
+		seconds = time_best([&]() { visited = walk_flat_set(graph.factory, [](const RTTIBase *) { }); });
+		report("flat_set", 1, visited, seconds, 0);
+
+		// the dump spells the name of every type it refers to, bytes is the length of all of them
+		size_t length = 0;
+		seconds = time_best([&]() {
+			length = 0;
+			walk_flat_set(graph.factory, [&](const RTTIBase *rtti) { length += get_rtti_name(rtti).size(); });
+		});
+		report("name_rebuild", 1, visited, seconds, length);
+
+		seconds = time_best([&]() {
+			rtti_name_cache names;
+			length = 0;
+			walk_flat_set(graph.factory, [&](const RTTIBase *rtti) { length += names.name_of(rtti).size(); });
+		});
+		report("name_cache", 1, visited, seconds, length);
+
+		null_buffer json;
+		seconds = time_best([&]() {
+			std::ostream output(&json);
+			write_rtti_json(graph.factory, output);
+		});
+		report("json", 1, visited, seconds, json.written / 5);
+
+		null_buffer binary;
+		seconds = time_best([&]() {
+			std::ostream output(&binary);
+			write_rtti_binary(graph.factory, output);
+		});
+		report("binary", 1, visited, seconds, binary.written / 5);
+
+		// how long the game's memory is read for when the dump copies it first, and what writing from the copy costs
+		size_t snapshot_bytes = 0;
+		seconds = time_best([&]() { snapshot_bytes = rtti_snapshot::capture(graph.factory).size(); });
+		report("capture", 1, visited, seconds, snapshot_bytes);
+
+		auto snapshot = rtti_snapshot::capture(graph.factory);
+		null_buffer snapshot_json;
+		seconds = time_best([&]() {
+			std::ostream output(&snapshot_json);
+			write_rtti_json(snapshot, output);
+		});
+		report("json_snapshot", 1, visited, seconds, snapshot_json.written / 5);
+
+		std::string memory;
+		seconds = time_best([&]() {
+			memory_recorder recorder([](uint64_t address, void *out, size_t size) {
+				std::memcpy(out, reinterpret_cast<const void *>(address), size);
+				return true;
+			});
+
+			auto recorded = rtti_snapshot::capture(reinterpret_cast<uint64_t>(&graph.factory), recorder.reader());
+			std::ostringstream file;
+			recorder.write(file, reinterpret_cast<uint64_t>(&graph.factory));
+			memory = std::move(file).str();
+		});
+		report("record", 1, visited, seconds, memory.size());
+
+		// the view wants 8 byte alignment, which a string does not promise
+		std::vector<uint64_t> memory_file((memory.size() + 7) / 8);
+		std::memcpy(memory_file.data(), memory.data(), memory.size());
+		auto memory_view = memory_snapshot_view::open({ reinterpret_cast<const uint8_t *>(memory_file.data()), memory.size() });
+		seconds = time_best([&]() { snapshot_bytes = rtti_snapshot::capture(memory_view->entry(), memory_view->reader())->size(); });
+		report("offline", 1, visited, seconds, snapshot_bytes);
+
+		std::string index;
+		seconds = time_best([&]() {
+			std::ostringstream file;
+			write_rtti_index(snapshot, file);
+			index = std::move(file).str();
+		});
+		report("index", 1, visited, seconds, index.size());
+
+		std::vector<uint64_t> index_file((index.size() + 7) / 8);
+		std::memcpy(index_file.data(), index.data(), index.size());
+		auto index_view = rtti_index_view::open({ reinterpret_cast<const uint8_t *>(index_file.data()), index.size() });
+		size_t found = 0;
+		seconds = time_best([&]() {
+			found = 0;
+			for (const auto &type : index_view->types()) {
+				const auto *class_index = type.kind == RTTIType::Class ? index_view->find_class(index_view->string(type.name)) : nullptr;
+				if (class_index == nullptr) {
+					continue;
+				}
+
+				auto members = index_view->members(*class_index);
+				found += members.empty() || index_view->resolve_member(*class_index, index_view->string(members.front().name)) ? 1 : 0;
+			}
+		});
+		report("lookup", 1, visited, seconds, found);
+
+		rtti_manifest manifest;
+		seconds = time_best([&]() { manifest = build_rtti_manifest(graph.factory); });
+		report("manifest", 1, visited, seconds, manifest.entries().size());
+
+		graph.patch(100);
+		null_buffer delta_json;
+		seconds = time_best([&]() {
+			std::ostream output(&delta_json);
+			write_rtti_json(diff_rtti(graph.factory, manifest), output);
+		});
+		report("json_delta", 1, visited, seconds, delta_json.written / 5);
+
+		for (uint32_t threads = 1; threads <= max_threads; threads = threads == max_threads ? threads + 1 : std::min(threads * 2, max_threads)) {
+			rtti_dump_options options { rtti_dump_mode::parallel, threads };
+			null_buffer parallel_json;
+			seconds = time_best([&]() {
+				std::ostream output(&parallel_json);
+				write_rtti_json(graph.factory, output, options);
+			});
+			report("json_parallel", threads, visited, seconds, parallel_json.written / 5);
+
+			null_buffer parallel_binary;
+			seconds = time_best([&]() {
+				std::ostream output(&parallel_binary);
+				write_rtti_binary(graph.factory, output, options);
+			});
+			report("binary_parallel", threads, visited, seconds, parallel_binary.written / 5);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// thread scaling of the chunked signature scan on a synthetic image.
+// usage: scan_scaling [image size in MiB] [max threads]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "signature.hpp"
+#include "signature_parallel.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	auto
+	make_image(size_t size) -> std::vector<uint8_t> {
+		std::vector<uint8_t> image(size);
+		std::mt19937_64 rng(0x5708B1D);
+		for (auto &byte : image) {
+			byte = static_cast<uint8_t>(rng());
+		}
+
+		// plant a few copies of the pattern, one of them straddling every chunk size we are likely to pick
+		hex_signature signature = RTTI_FACTORY_CTOR_SIGNATURE;
+		for (size_t offset = (1024 * 1024) - 7; offset + signature.size < size; offset += size / 5) {
+			for (uint32_t index = 0; index < signature.size; ++index) {
+				image[offset + index] = static_cast<uint8_t>((0xAA & ~signature.masks[index]) | signature.values[index]);
+			}
+		}
+
+		return image;
+	}
+
+	template<typename Fn>
+	auto
+	time_best(Fn &&fn) -> double {
+		double best = 1e300;
+		for (int run = 0; run < 5; ++run) {
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+
+		return best;
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256) * 1024 * 1024;
+	uint32_t max_threads = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : std::max(1u, std::thread::hardware_concurrency());
+
+	auto image = make_image(size);
+	const auto *begin = image.data();
+	const auto *end = begin + image.size();
+
+	std::printf("mode,threads,bytes,seconds,gb_per_s,matches\n");
+
+	std::vector<const uint8_t *> results;
+	auto report = [&](const char *mode, uint32_t threads, double seconds) {
+		std::printf("%s,%u,%zu,%.6f,%.3f,%zu\n", mode, threads, size, seconds, static_cast<double>(size) / seconds / 1e9, results.size());
+	};
+
+	auto serial = time_best([&]() {
+		results.clear();
+		find_signature(begin, end, RTTI_FACTORY_CTOR_SIGNATURE, results);
+	});
+	report("serial", 1, serial);
+
+	for (uint32_t threads = 1; threads <= max_threads; threads = threads == max_threads ? threads + 1 : std::min(threads * 2, max_threads)) {
+		scan_options options { scan_mode::parallel, threads };
+		auto parallel = time_best([&]() {
+			results.clear();
+			find_signature(begin, end, RTTI_FACTORY_CTOR_SIGNATURE, results, options);
+		});
+		report("parallel", threads, parallel);
+	}
+
+	return 0;
+}
@@ -0,0 +1,210 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// scan hot path throughput and per-signature latency on synthetic images, one csv row per case.
+// approximate rows allow two mismatched bytes.
+// usage: signature_bench [image size in MiB]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "signature_approximate.hpp"
+#include "signature_batch.hpp"
+#include "signature_engine.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	constexpr uint32_t batch_size = 32;
+	constexpr uint32_t approximate_mismatches = 2;
+
+	// bytes roughly as common as they are in x64 code, so anchors are picked like they would be for real signatures
+	class code_bytes {
+	public:
+		explicit code_bytes(uint64_t seed) : rng(seed) {
+			for (uint32_t value = 0; value < 256; ++value) {
+				if (byte_commonness(static_cast<uint8_t>(value)) > 0) {
+					common.push_back(static_cast<uint8_t>(value));
+				}
+			}
+		}
+
+		auto
+		next() -> uint8_t {
+			auto value = rng();
+			if ((value & 1) != 0) {
+				return common[(value >> 1) % common.size()];
+			}
+
+			return static_cast<uint8_t>(value >> 8);
+		}
+
+		auto
+		chance(double probability) -> bool {
+			return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < probability;
+		}
+
+		auto
+		below(size_t limit) -> size_t {
+			return static_cast<size_t>(rng() % limit);
+		}
+
+	private:
+		std::mt19937_64 rng;
+		std::vector<uint8_t> common;
+	};
+
+	// a random pattern of size bytes where each byte is a wildcard with the given probability, never all wildcards
+	auto
+	make_pattern(code_bytes &bytes, uint32_t size, double wildcards) -> dynamic_signature {
+		std::string pattern;
+		auto literal = false;
+		for (uint32_t index = 0; index < size; ++index) {
+			if ((index + 1 < size || literal) && bytes.chance(wildcards)) {
+				pattern += "?? ";
+				continue;
+			}
+
+			constexpr std::string_view digits = "0123456789abcdef";
+			auto value = bytes.next();
+			pattern += digits[value >> 4];
+			pattern += digits[value & 0xF];
+			pattern += ' ';
+			literal = true;
+		}
+
+		return *dynamic_signature::parse(pattern);
+	}
+
+	// copies the signature into the image matches_per_mib times per MiB on average, wildcards get random bytes
+	void
+	plant(code_bytes &bytes, std::vector<uint8_t> &image, const hex_signature &signature, double matches_per_mib) {
+		auto count = static_cast<size_t>(matches_per_mib * static_cast<double>(image.size()) / (1024.0 * 1024.0));
+		for (size_t copy = 0; copy < count; ++copy) {
+			auto offset = bytes.below(image.size() - signature.size);
+			for (uint32_t index = 0; index < signature.size; ++index) {
+				image[offset + index] = static_cast<uint8_t>((bytes.next() & ~signature.masks[index]) | signature.values[index]);
+			}
+		}
+	}
+
+	template<typename Fn>
+	auto
+	time_best(Fn &&fn) -> double {
+		double best = 1e300;
+		for (int run = 0; run < 3; ++run) {
+			auto start = std::chrono::steady_clock::now();
+			fn();
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+
+		return best;
+	}
+
+	auto
+	isa_name(signature_isa isa) -> const char * {
+		switch (isa) {
+			case signature_isa::scalar: return "scalar";
+			case signature_isa::sse2: return "sse2";
+			case signature_isa::avx2: return "avx2";
+			case signature_isa::avx512: return "avx512";
+		}
+
+		return "unknown";
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 64) * 1024 * 1024;
+
+	code_bytes bytes(0x5708B1D);
+	std::vector<uint8_t> background(size);
+	for (auto &byte : background) {
+		byte = bytes.next();
+	}
+
+	std::vector<signature_isa> isas = { signature_isa::scalar };
+	for (auto isa : { signature_isa::sse2, signature_isa::avx2, signature_isa::avx512 }) {
+		if (detect_signature_isa() >= isa) {
+			isas.push_back(isa);
+		}
+	}
+
+	std::printf("kind,isa,signatures,signature_size,wildcards,matches_per_mib,bytes,seconds,gb_per_s,us_per_signature,matches\n");
+	auto report = [&](const char *kind, const char *isa, uint32_t count, uint32_t signature_size, double wildcards, double matches_per_mib, double seconds, size_t matches) {
+		std::printf("%s,%s,%u,%u,%.2f,%.1f,%zu,%.6f,%.3f,%.3f,%zu\n", kind, isa, count, signature_size, wildcards, matches_per_mib, size, seconds, static_cast<double>(size) / seconds / 1e9, seconds * 1e6 / count, matches);
+	};
+
+	for (uint32_t signature_size : { 16u, 48u }) {
+		for (auto wildcards : { 0.0, 0.25, 0.5 }) {
+			for (auto matches_per_mib : { 0.0, 16.0 }) {
+				std::vector<dynamic_signature> patterns;
+				for (uint32_t index = 0; index < batch_size; ++index) {
+					patterns.push_back(make_pattern(bytes, signature_size, wildcards));
+				}
+
+				auto image = background;
+				for (const auto &pattern : patterns) {
+					plant(bytes, image, pattern.view(), matches_per_mib);
+				}
+
+				const auto *begin = image.data();
+				const auto *end = begin + image.size();
+				auto signature = patterns.front().view();
+
+				std::vector<const uint8_t *> results;
+				for (auto isa : isas) {
+					auto seconds = time_best([&]() {
+						results.clear();
+						find_signature(begin, end, signature, results, isa);
+					});
+					report("single", isa_name(isa), 1, signature_size, wildcards, matches_per_mib, seconds, results.size());
+				}
+
+				std::vector<approximate_match> near;
+				for (auto isa : isas) {
+					if (isa == signature_isa::avx512) { // shares the avx2 kernel
+						continue;
+					}
+
+					auto seconds = time_best([&]() {
+						near.clear();
+						find_signature_approximate(begin, end, signature, approximate_mismatches, near, isa);
+					});
+					report("approximate", isa_name(isa), 1, signature_size, wildcards, matches_per_mib, seconds, near.size());
+				}
+
+				// the whole batch, and a batch of the single signature against the single rows above
+				for (auto count : { batch_size, 1u }) {
+					signature_batch batch;
+					for (uint32_t index = 0; index < count; ++index) {
+						batch.add(patterns[index].view());
+					}
+
+					std::vector<std::vector<const uint8_t *>> batch_results;
+					auto seconds = time_best([&]() {
+						batch_results.clear();
+						batch.find(begin, end, batch_results);
+					});
+
+					size_t matches = 0;
+					for (const auto &found : batch_results) {
+						matches += found.size();
+					}
+
+					report("batch", isa_name(detect_signature_isa()), count, signature_size, wildcards, matches_per_mib, seconds, matches);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
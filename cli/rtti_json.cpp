@@ -0,0 +1,49 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// converts rtti.bin into the rtti.json the hook writes when dump_rtti_binary is off.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "mapped_file.hpp"
+#include "rtti_binary.hpp"
+
+using namespace stormbird_hook;
+
+auto
+main(int argc, char **argv) -> int {
+	if (argc < 2 || argc > 3) {
+		std::cerr << "usage: stormbird_rtti_json <rtti.bin> [rtti.json]\n"
+				  << "  writes to stdout without an output path\n";
+		return 1;
+	}
+
+	mapped_file file(std::filesystem::path { argv[1] });
+	if (!file.is_open()) {
+		std::cerr << "[rtti_json] could not map " << argv[1] << "\n";
+		return 1;
+	}
+
+	auto view = rtti_file_view::open(file.data());
+	if (!view) {
+		std::cerr << "[rtti_json] " << argv[1] << " is not an rtti dump of version " << rtti_file_version << "\n";
+		return 1;
+	}
+
+	if (argc == 2) {
+		write_rtti_json(*view, std::cout);
+		return 0;
+	}
+
+	std::ofstream output(argv[2], std::ios::binary);
+	if (!output) {
+		std::cerr << "[rtti_json] could not open " << argv[2] << "\n";
+		return 1;
+	}
+
+	write_rtti_json(*view, output);
+	return output ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// writes a c++ header with the layout of every class and enum in rtti.bin, for hook code that reads game objects.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+#include "mapped_file.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_layout.hpp"
+
+using namespace stormbird_hook;
+
+auto
+main(int argc, char **argv) -> int {
+	rtti_layout_options options;
+	auto first = 1;
+	if (argc > 2 && std::string_view { argv[1] } == "--namespace") {
+		options.name_space = argv[2];
+		first = 3;
+	}
+
+	if (argc - first < 1 || argc - first > 2) {
+		std::cerr << "usage: stormbird_rtti_layout [--namespace name] <rtti.bin> [rtti.hpp]\n"
+				  << "  writes to stdout without an output path, the namespace is game by default\n";
+		return 1;
+	}
+
+	mapped_file file(std::filesystem::path { argv[first] });
+	if (!file.is_open()) {
+		std::cerr << "[rtti_layout] could not map " << argv[first] << "\n";
+		return 1;
+	}
+
+	auto view = rtti_file_view::open(file.data());
+	if (!view) {
+		std::cerr << "[rtti_layout] " << argv[first] << " is not an rtti dump of version " << rtti_file_version << "\n";
+		return 1;
+	}
+
+	if (argc - first == 1) {
+		write_rtti_layout(*view, std::cout, options);
+		return std::cout ? 0 : 1;
+	}
+
+	std::ofstream output(argv[first + 1], std::ios::binary);
+	if (!output) {
+		std::cerr << "[rtti_layout] could not open " << argv[first + 1] << "\n";
+		return 1;
+	}
+
+	write_rtti_layout(*view, output, options);
+	return output ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// applies incremental rtti dumps to a full one and prints the result, see rtti_merge.hpp.
+
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+
+#include "rtti_merge.hpp"
+
+namespace {
+	auto
+	read_json(const char *path) -> std::optional<nlohmann::json> {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			std::cerr << "[rtti_merge] could not open " << path << "\n";
+			return std::nullopt;
+		}
+
+		auto json = nlohmann::json::parse(file, nullptr, false);
+		if (json.is_discarded()) {
+			std::cerr << "[rtti_merge] " << path << " is not json\n";
+			return std::nullopt;
+		}
+
+		return json;
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	if (argc < 3) {
+		std::cerr << "usage: stormbird_rtti_merge <rtti.json> <delta.json>...\n"
+				  << "  applies the deltas in the order they were written and prints the full rtti.json\n";
+		return 1;
+	}
+
+	auto base = read_json(argv[1]);
+	if (!base) {
+		return 1;
+	}
+
+	if (!base->is_array()) {
+		std::cerr << "[rtti_merge] " << argv[1] << " is not a full rtti dump\n";
+		return 1;
+	}
+
+	stormbird_cli::rtti_merger merger(std::move(*base));
+	for (auto index = 2; index < argc; ++index) {
+		auto delta = read_json(argv[index]);
+		if (!delta) {
+			return 1;
+		}
+
+		if (!stormbird_cli::is_rtti_delta(*delta)) {
+			std::cerr << "[rtti_merge] " << argv[index] << " is not an incremental rtti dump\n";
+			return 1;
+		}
+
+		if (!merger.apply(std::move(*delta))) {
+			std::cerr << "[rtti_merge] " << argv[index] << " was not taken against the delta before it\n";
+			return 1;
+		}
+	}
+
+	std::cout << merger.result().dump();
+	return std::cout ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// rebuilds a full rtti.json from the rtti.json of a full dump and the incremental dumps written after it.
+// every delta replaces all types of the keys it lists and drops the keys it removed, a key being the type's kind and
+// name. the result keeps the order of the base, keys that are new go at the end.
+// a delta does not carry addresses and type ids, they move with every build, so they are dropped from the base as well.
+
+namespace stormbird_cli {
+	using rtti_key = std::pair<uint8_t, std::string>;
+
+	inline auto
+	rtti_key_of(const nlohmann::json &type) -> rtti_key {
+		return { type.value("type", uint8_t { 0 }), type.value("name", std::string {}) };
+	}
+
+	inline auto
+	is_rtti_delta(const nlohmann::json &json) -> bool {
+		return json.is_object() && json.contains("base") && json.contains("schema") && json.value("removed", nlohmann::json {}).is_array() && json.value("types", nlohmann::json {}).is_array();
+	}
+
+	// a type object of rtti.json without the fields a delta leaves out
+	inline void
+	strip_rtti_locations(nlohmann::json &type) {
+		for (const auto *name : { "type_id", "category_type_id", "addr", "parent_addr", "type_addr" }) {
+			type.erase(name);
+		}
+
+		for (auto &[name, value] : type.items()) {
+			if (!value.is_array()) {
+				continue;
+			}
+
+			for (auto &element : value) {
+				if (element.is_object()) {
+					element.erase("addr");
+					element.erase("type_addr");
+				}
+			}
+		}
+	}
+
+	class rtti_merger {
+	public:
+		// base is the array of a full dump
+		explicit rtti_merger(nlohmann::json base) {
+			for (auto &type : base) {
+				strip_rtti_locations(type);
+				auto [it, inserted] = types.try_emplace(rtti_key_of(type));
+				if (inserted) {
+					order.push_back(it->first);
+				}
+
+				it->second.push_back(std::move(type));
+			}
+		}
+
+		// false if the delta was not taken against the delta applied before it
+		auto
+		apply(nlohmann::json delta) -> bool {
+			if (schema && delta["base"].get<uint64_t>() != *schema) {
+				return false;
+			}
+
+			schema = delta["schema"].get<uint64_t>();
+
+			for (const auto &removed : delta["removed"]) {
+				types.erase(rtti_key_of(removed));
+			}
+
+			std::set<rtti_key> replaced;
+			for (auto &type : delta["types"]) {
+				auto key = rtti_key_of(type);
+				auto [it, inserted] = types.try_emplace(key);
+				if (inserted) {
+					order.push_back(key);
+				}
+
+				// the first type of a key in this delta drops what the key held before
+				if (replaced.insert(key).second) {
+					it->second.clear();
+				}
+
+				it->second.push_back(std::move(type));
+			}
+
+			return true;
+		}
+
+		// the merged array, the merger is spent afterwards
+		auto
+		result() -> nlohmann::json {
+			// a key removed and added again is in order twice, it is written at the first
+			auto merged = nlohmann::json::array();
+			for (const auto &key : order) {
+				auto it = types.find(key);
+				if (it == types.end()) {
+					continue;
+				}
+
+				for (auto &type : it->second) {
+					merged.push_back(std::move(type));
+				}
+
+				types.erase(it);
+			}
+
+			return merged;
+		}
+
+	private:
+		std::vector<rtti_key> order;
+		std::map<rtti_key, std::vector<nlohmann::json>> types;
+		std::optional<uint64_t> schema; // of the last delta, the next one has to be taken against it
+	};
+} // namespace stormbird_cli
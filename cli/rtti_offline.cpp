@@ -0,0 +1,77 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// dumps rtti from the rtti.memory the hook saves when dump_rtti_memory is on, without the game.
+// writes the same rtti.json, or rtti.bin with --binary, the hook would have written from that memory.
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+#include "mapped_file.hpp"
+#include "memory_snapshot.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_dump.hpp"
+#include "rtti_snapshot.hpp"
+
+using namespace stormbird_hook;
+
+auto
+main(int argc, char **argv) -> int {
+	auto binary = argc > 1 && std::string_view { argv[1] } == "--binary";
+	auto first = binary ? 2 : 1;
+	if (argc - first < 1 || argc - first > 2) {
+		std::cerr << "usage: stormbird_rtti_offline [--binary] <rtti.memory> [output]\n"
+				  << "  writes rtti.json, or rtti.bin with --binary, to stdout without an output path\n";
+		return 1;
+	}
+
+	mapped_file file(std::filesystem::path { argv[first] });
+	if (!file.is_open()) {
+		std::cerr << "[rtti_offline] could not map " << argv[first] << "\n";
+		return 1;
+	}
+
+	auto view = memory_snapshot_view::open(file.data());
+	if (!view) {
+		std::cerr << "[rtti_offline] " << argv[first] << " is not a memory snapshot of version " << memory_file_version << "\n";
+		return 1;
+	}
+
+	auto snapshot = rtti_snapshot::capture(view->entry(), view->reader());
+	if (!snapshot) {
+		std::cerr << "[rtti_offline] the rtti factory at " << std::hex << view->entry() << std::dec << " is not in the snapshot\n";
+		return 1;
+	}
+
+	std::cerr << "[rtti_offline] copied " << snapshot->type_count() << " types from " << view->regions().size() << " regions";
+	if (snapshot->unreadable_count() > 0) {
+		std::cerr << ", " << snapshot->unreadable_count() << " pointers lead outside the snapshot and are written as null";
+	}
+
+	std::cerr << "\n";
+
+	auto write = [&](std::ostream &output) {
+		if (binary) {
+			write_rtti_binary(*snapshot, output);
+		} else {
+			write_rtti_json(*snapshot, output);
+		}
+	};
+
+	if (argc - first == 1) {
+		write(std::cout);
+		return std::cout ? 0 : 1;
+	}
+
+	std::ofstream output(argv[first + 1], std::ios::binary);
+	if (!output) {
+		std::cerr << "[rtti_offline] could not open " << argv[first + 1] << "\n";
+		return 1;
+	}
+
+	write(output);
+	return output ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// answers lookups from rtti.idx, the index the hook writes when dump_rtti_index is on, or builds one from rtti.bin.
+// the index is mapped and read in place, nothing is parsed.
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_index.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	auto
+	usage() -> int {
+		std::cerr << "usage: stormbird_rtti_query index <rtti.bin> <rtti.idx>\n"
+				  << "       stormbird_rtti_query <rtti.idx> type <name>\n"
+				  << "       stormbird_rtti_query <rtti.idx> members <class>\n"
+				  << "       stormbird_rtti_query <rtti.idx> member <class> <member>\n"
+				  << "       stormbird_rtti_query <rtti.idx> bases <class>\n"
+				  << "       stormbird_rtti_query <rtti.idx> derived <class>\n"
+				  << "  member also finds inherited members, derived lists every class deriving from the class\n";
+		return 1;
+	}
+
+	auto
+	kind_name(RTTIType kind) -> std::string_view {
+		constexpr std::array<std::string_view, 7> names = { "primitive", "reference", "container", "enum", "class", "bitset", "struct" };
+		auto index = static_cast<size_t>(kind);
+		return index < names.size() ? names[index] : "unknown";
+	}
+
+	auto
+	build_index(const char *input, const char *output) -> int {
+		mapped_file file(std::filesystem::path { input });
+		if (!file.is_open()) {
+			std::cerr << "[rtti_query] could not map " << input << "\n";
+			return 1;
+		}
+
+		auto view = rtti_file_view::open(file.data());
+		if (!view) {
+			std::cerr << "[rtti_query] " << input << " is not an rtti dump of version " << rtti_file_version << "\n";
+			return 1;
+		}
+
+		std::ofstream index(output, std::ios::binary);
+		if (!index) {
+			std::cerr << "[rtti_query] could not open " << output << "\n";
+			return 1;
+		}
+
+		write_rtti_index(*view, index);
+		return index ? 0 : 1;
+	}
+
+	auto
+	find_class(const rtti_index_view &index, std::string_view name) -> const rtti_index_class * {
+		const auto *class_index = index.find_class(name);
+		if (class_index == nullptr) {
+			std::cerr << "[rtti_query] no class named " << name << "\n";
+		}
+
+		return class_index;
+	}
+
+	auto
+	query_type(const rtti_index_view &index, std::string_view name) -> int {
+		auto found = index.find(name);
+		if (found.empty()) {
+			std::cerr << "[rtti_query] no type named " << name << "\n";
+			return 1;
+		}
+
+		for (auto type : found) {
+			const auto &record = index.types()[type];
+			std::cout << kind_name(record.kind) << " " << name << " at 0x" << std::hex << record.address << std::dec;
+			if (const auto *class_index = index.class_of(type); class_index != nullptr) {
+				std::cout << ", size " << class_index->size << ", alignment " << class_index->alignment << ", " << class_index->members.count << " members, " << class_index->bases.count << " bases, " << class_index->derived.count << " derived";
+			}
+
+			std::cout << "\n";
+		}
+
+		return 0;
+	}
+
+	// in the order the class declares them
+	auto
+	query_members(const rtti_index_view &index, const rtti_index_class &class_index) -> int {
+		auto sorted = index.members(class_index);
+		std::vector<const rtti_index_member *> members;
+		members.reserve(sorted.size());
+		for (const auto &member : sorted) {
+			members.push_back(&member);
+		}
+
+		std::sort(members.begin(), members.end(), [](const rtti_index_member *left, const rtti_index_member *right) { return left->position < right->position; });
+		for (const auto *member : members) {
+			std::cout << "0x" << std::hex << member->offset << std::dec << " " << index.string(member->name) << " " << index.name_of(member->type) << "\n";
+		}
+
+		return 0;
+	}
+
+	auto
+	query_member(const rtti_index_view &index, const rtti_index_class &class_index, std::string_view name) -> int {
+		auto field = index.resolve_member(class_index, name);
+		if (!field) {
+			std::cerr << "[rtti_query] " << index.name_of(class_index.type) << " has no member named " << name << "\n";
+			return 1;
+		}
+
+		std::cout << "0x" << std::hex << field->offset << std::dec << " " << name << " " << index.name_of(field->member->type);
+		if (field->owner != class_index.type) {
+			std::cout << ", inherited from " << index.name_of(field->owner);
+		}
+
+		std::cout << "\n";
+		return 0;
+	}
+
+	auto
+	query_bases(const rtti_index_view &index, const rtti_index_class &class_index) -> int {
+		for (const auto &base : index.bases(class_index)) {
+			std::cout << "0x" << std::hex << base.offset << std::dec << " " << index.name_of(base.type) << "\n";
+		}
+
+		return 0;
+	}
+
+	auto
+	query_derived(const rtti_index_view &index, const rtti_index_class &class_index) -> int {
+		index.for_each_subclass(class_index, [&index](const rtti_index_class &subclass) { std::cout << index.name_of(subclass.type) << "\n"; });
+		return 0;
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	if (argc < 4) {
+		return usage();
+	}
+
+	std::string_view command { argv[2] };
+	if (std::string_view { argv[1] } == "index") {
+		return argc == 4 ? build_index(argv[2], argv[3]) : usage();
+	}
+
+	mapped_file file(std::filesystem::path { argv[1] });
+	if (!file.is_open()) {
+		std::cerr << "[rtti_query] could not map " << argv[1] << "\n";
+		return 1;
+	}
+
+	auto index = rtti_index_view::open(file.data());
+	if (!index) {
+		std::cerr << "[rtti_query] " << argv[1] << " is not an rtti index of version " << rtti_index_version << "\n";
+		return 1;
+	}
+
+	if (command == "type" && argc == 4) {
+		return query_type(*index, argv[3]);
+	}
+
+	if ((command == "members" || command == "bases" || command == "derived") && argc == 4) {
+		const auto *class_index = find_class(*index, argv[3]);
+		if (class_index == nullptr) {
+			return 1;
+		}
+
+		if (command == "members") {
+			return query_members(*index, *class_index);
+		}
+
+		return command == "bases" ? query_bases(*index, *class_index) : query_derived(*index, *class_index);
+	}
+
+	if (command == "member" && argc == 5) {
+		const auto *class_index = find_class(*index, argv[3]);
+		return class_index == nullptr ? 1 : query_member(*index, *class_index, argv[4]);
+	}
+
+	return usage();
+}
@@ -0,0 +1,145 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// checks every signature against game builds on disk, without launching the game.
+// a signature is good for a build when it matches exactly once, like create_hook() expects.
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "pe_image.hpp"
+#include "signature.hpp"
+#include "signature_file.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	void
+	print_usage() {
+		std::cerr << "usage: stormbird_sigcheck [--all | --section <name>] [--fuzzy <n>] <exe, dll or directory>...\n"
+				  << "  --all             scan the whole image instead of only the code sections\n"
+				  << "  --section <name>  scan only the named section, e.g. .text\n"
+				  << "  --fuzzy <n>       list near matches within n differing bytes for missing signatures, default 2, 0 disables\n";
+	}
+
+	auto
+	is_image(const std::filesystem::path &path) -> bool {
+		auto ext = path.extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+		return ext == ".exe" || ext == ".dll";
+	}
+
+	// returns false if any signature did not match exactly once
+	auto
+	check_image(const std::filesystem::path &path, const scan_options &options, uint32_t fuzzy) -> bool {
+		mapped_file file(path);
+		if (!file.is_open()) {
+			std::cerr << "[sigcheck] could not map " << path.string() << "\n";
+			return false;
+		}
+
+		auto image = parse_pe_image(file.data());
+		if (!image) {
+			std::cerr << "[sigcheck] " << path.string() << " is not a pe image\n";
+			return false;
+		}
+
+		signature_batch batch;
+		for (const auto &named : signatures) {
+			batch.add(named.target.signature);
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		auto results = scan_file(file.data(), *image, batch, options);
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << path.string() << " (timestamp " << std::hex << image->timestamp << std::dec << ", " << elapsed.count() << " ms)\n";
+
+		auto good = true;
+		for (size_t index = 0; index < signatures.size(); ++index) {
+			// targets are checked on the matches, then reported at the address they resolve to
+			auto rvas = resolve_file_matches(file.data(), *image, signatures[index].target, results[index]);
+			std::string_view status = results[index].size() == 1 ? (rvas.size() == 1 ? "ok" : "unresolved") : (results[index].empty() ? "missing" : "ambiguous");
+			good &= results[index].size() == 1 && rvas.size() == 1;
+
+			std::cout << "\t" << signatures[index].name << "\t" << status;
+			for (auto rva : rvas) {
+				std::cout << "\t" << std::hex << image->image_base + rva << std::dec;
+			}
+			std::cout << "\n";
+
+			if (results[index].empty() && fuzzy > 0) {
+				constexpr size_t max_listed = 4;
+				auto near = scan_file_approximate(file.data(), *image, signatures[index].target.signature, fuzzy, options);
+				for (size_t candidate = 0; candidate < near.size() && candidate < max_listed; ++candidate) {
+					std::cout << "\t\tnear\t" << std::hex << image->image_base + near[candidate].rva << std::dec << "\t" << near[candidate].distance << " bytes differ\n";
+				}
+			}
+		}
+
+		return good;
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	scan_options options { .scope = scan_scope::executable };
+	std::string section;
+	uint32_t fuzzy = 2;
+	std::vector<std::filesystem::path> inputs;
+
+	for (auto index = 1; index < argc; ++index) {
+		std::string_view arg = argv[index];
+		if (arg == "--all") {
+			options.scope = scan_scope::module;
+		} else if (arg == "--section" && index + 1 < argc) {
+			section = argv[++index];
+			options.scope = scan_scope::named;
+		} else if (arg == "--fuzzy" && index + 1 < argc) {
+			fuzzy = static_cast<uint32_t>(std::strtoul(argv[++index], nullptr, 10));
+		} else if (arg == "-h" || arg == "--help") {
+			print_usage();
+			return 0;
+		} else {
+			inputs.emplace_back(arg);
+		}
+	}
+
+	options.section = section;
+
+	if (inputs.empty()) {
+		print_usage();
+		return 1;
+	}
+
+	auto good = true;
+	for (const auto &input : inputs) {
+		if (!std::filesystem::is_directory(input)) {
+			good &= check_image(input, options, fuzzy);
+			continue;
+		}
+
+		std::vector<std::filesystem::path> images;
+		for (const auto &entry : std::filesystem::recursive_directory_iterator(input, std::filesystem::directory_options::skip_permission_denied)) {
+			if (entry.is_regular_file() && is_image(entry.path())) {
+				images.push_back(entry.path());
+			}
+		}
+
+		std::sort(images.begin(), images.end());
+		for (const auto &image : images) {
+			good &= check_image(image, options, fuzzy);
+		}
+	}
+
+	return good ? 0 : 2;
+}
@@ -0,0 +1,144 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// builds the shortest signature that matches a given address exactly once in a game build on disk.
+// relocated pointers, branch targets and rip-relative displacements change between builds, so they are wildcarded.
+// of the unique candidates the one with the rarest anchors wins, it scans the fastest.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "pe_image.hpp"
+#include "signature_minimize.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	// how many instruction boundaries past the shortest unique one are considered for better anchors
+	constexpr size_t extra_boundaries = 4;
+
+	void
+	print_usage() {
+		std::cerr << "usage: stormbird_sigmin [options] <exe or dll> <address>\n"
+				  << "  <address>         virtual address or rva of the first instruction, in hex\n"
+				  << "  --name <name>     codename for the MAKE_SIGNATURE line, default TARGET\n"
+				  << "  --max-size <n>    give up past n bytes, default 96\n"
+				  << "  --offsets         also wildcard memory displacements, e.g. struct field offsets\n"
+				  << "  --all             must be unique in the whole image instead of only the code sections\n"
+				  << "  --section <name>  must be unique in the named section, e.g. .text\n";
+	}
+
+	auto
+	parse_address(std::string_view text) -> std::optional<uint64_t> {
+		std::string value(text);
+		char *end = nullptr;
+		auto address = std::strtoull(value.c_str(), &end, 16);
+		if (value.empty() || end != value.c_str() + value.size()) {
+			return std::nullopt;
+		}
+
+		return address;
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	scan_options options { .scope = scan_scope::executable };
+	std::string section;
+	std::string name = "TARGET";
+	size_t max_size = 96;
+	auto offsets = false;
+	std::vector<std::string_view> inputs;
+
+	for (auto index = 1; index < argc; ++index) {
+		std::string_view arg = argv[index];
+		if (arg == "--all") {
+			options.scope = scan_scope::module;
+		} else if (arg == "--section" && index + 1 < argc) {
+			section = argv[++index];
+			options.scope = scan_scope::named;
+		} else if (arg == "--name" && index + 1 < argc) {
+			name = argv[++index];
+		} else if (arg == "--max-size" && index + 1 < argc) {
+			max_size = std::strtoull(argv[++index], nullptr, 10);
+		} else if (arg == "--offsets") {
+			offsets = true;
+		} else if (arg == "-h" || arg == "--help") {
+			print_usage();
+			return 0;
+		} else {
+			inputs.push_back(arg);
+		}
+	}
+
+	options.section = section;
+
+	auto address = inputs.size() == 2 ? parse_address(inputs[1]) : std::nullopt;
+	if (!address || max_size == 0) {
+		print_usage();
+		return 1;
+	}
+
+	std::filesystem::path path(inputs[0]);
+	mapped_file file(path);
+	if (!file.is_open()) {
+		std::cerr << "[sigmin] could not map " << path.string() << "\n";
+		return 1;
+	}
+
+	auto image = parse_pe_image(file.data());
+	if (!image || !image->is_64) {
+		std::cerr << "[sigmin] " << path.string() << " is not a 64-bit pe image\n";
+		return 1;
+	}
+
+	// anything past the image base is a virtual address, anything below it an rva
+	auto rva = static_cast<uint32_t>(*address >= image->image_base ? *address - image->image_base : *address);
+	const auto *target_section = image->section_for_rva(rva);
+	auto offset = image->rva_to_offset(rva);
+	if (target_section == nullptr || !offset) {
+		std::cerr << "[sigmin] " << std::hex << *address << std::dec << " is not backed by the file\n";
+		return 1;
+	}
+
+	auto available = std::min<size_t>({ max_size, target_section->raw_size - (rva - target_section->virtual_address), file.data().size() - *offset });
+	auto bytes = collect_signature_candidate(file.data().subspan(*offset, available), rva, parse_relocations(file.data(), *image), offsets);
+	if (bytes.boundaries.empty()) {
+		std::cerr << "[sigmin] no valid instruction at " << std::hex << *address << std::dec << "\n";
+		return 1;
+	}
+
+	auto low = shortest_unique_boundary(file.data(), *image, bytes, rva, options);
+	if (low == bytes.boundaries.size()) {
+		std::cerr << "[sigmin] no unique signature within " << bytes.values.size() << " bytes, try a larger --max-size or --all\n";
+		return 2;
+	}
+
+	auto best = low;
+	size_t best_candidates = SIZE_MAX;
+	for (auto boundary = low; boundary < bytes.boundaries.size() && boundary <= low + extra_boundaries; ++boundary) {
+		auto signature = dynamic_signature::parse(format_signature_candidate(bytes, bytes.boundaries[boundary]));
+		if (!signature) {
+			continue;
+		}
+
+		auto candidates = anchor_candidates(file.data(), *image, signature->view(), options);
+		std::cerr << "[sigmin] " << signature->view().size << " bytes, " << candidates << " anchor candidates\n";
+		if (candidates < best_candidates) {
+			best = boundary;
+			best_candidates = candidates;
+		}
+	}
+
+	std::cout << "MAKE_SIGNATURE(" << name << ", \"" << format_signature_candidate(bytes, bytes.boundaries[best]) << "\")\n";
+	return 0;
+}
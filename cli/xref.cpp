@@ -0,0 +1,128 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// answers cross reference queries against a game build on disk: who points at a string, who points at an address,
+// and which rtti class records carry a name.
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "pe_image.hpp"
+#include "rtti_locate.hpp"
+#include "signature_file.hpp"
+#include "xref_index.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	enum class query_kind {
+		string,
+		pointer,
+		rtti_class
+	};
+
+	void
+	print_usage() {
+		std::cerr << "usage: stormbird_xref <exe or dll> [queries...]\n"
+				  << "  --string <text>   pointers to every string equal to text\n"
+				  << "  --pointer <addr>  pointers to a virtual address or rva, in hex\n"
+				  << "  --class <name>    rtti class records named name\n";
+	}
+} // namespace
+
+auto
+main(int argc, char **argv) -> int {
+	std::vector<std::pair<query_kind, std::string_view>> queries;
+	std::string_view input;
+
+	for (auto index = 1; index < argc; ++index) {
+		std::string_view arg = argv[index];
+		if (arg == "--string" && index + 1 < argc) {
+			queries.emplace_back(query_kind::string, argv[++index]);
+		} else if (arg == "--pointer" && index + 1 < argc) {
+			queries.emplace_back(query_kind::pointer, argv[++index]);
+		} else if (arg == "--class" && index + 1 < argc) {
+			queries.emplace_back(query_kind::rtti_class, argv[++index]);
+		} else if (arg == "-h" || arg == "--help") {
+			print_usage();
+			return 0;
+		} else if (input.empty()) {
+			input = arg;
+		} else {
+			print_usage();
+			return 1;
+		}
+	}
+
+	if (input.empty()) {
+		print_usage();
+		return 1;
+	}
+
+	std::filesystem::path path(input);
+	mapped_file file(path);
+	if (!file.is_open()) {
+		std::cerr << "[xref] could not map " << path.string() << "\n";
+		return 1;
+	}
+
+	auto image = parse_pe_image(file.data());
+	if (!image) {
+		std::cerr << "[xref] " << path.string() << " is not a pe image\n";
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto index = build_xref_index(file.data(), *image);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	std::cerr << "[xref] indexed " << index.all_pointers().size() << " pointers and " << index.string_count() << " strings in " << elapsed.count() << " ms\n";
+
+	auto print_rva = [&](uint32_t rva) {
+		std::cout << "\t" << std::hex << image->image_base + rva << std::dec << "\n";
+	};
+
+	for (const auto &[kind, text] : queries) {
+		switch (kind) {
+			case query_kind::string:
+				{
+					std::cout << "string \"" << text << "\"\n";
+					for (auto rva : index.pointers_to_string(text)) {
+						print_rva(rva);
+					}
+					break;
+				}
+			case query_kind::pointer:
+				{
+					// anything past the image base is a virtual address, anything below it an rva
+					auto address = std::strtoull(std::string(text).c_str(), nullptr, 16);
+					if (address < image->image_base) {
+						address += image->image_base;
+					}
+
+					std::cout << "pointer " << std::hex << address << std::dec << "\n";
+					for (const auto &pointer : index.pointers_to(address)) {
+						print_rva(pointer.rva);
+					}
+					break;
+				}
+			case query_kind::rtti_class:
+				{
+					std::cout << "class " << text << "\n";
+					for (auto address : find_rtti_classes(index, text, file_reader { file.data(), &*image })) {
+						print_rva(static_cast<uint32_t>(address - image->image_base));
+					}
+					break;
+				}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace stormbird_hook {
+	// bump pointer allocator, memory is handed out from large blocks and only given back all at once.
+	// nothing is ever moved, so pointers into the arena stay valid until it is cleared or destroyed, moves included.
+	class bump_arena {
+	public:
+		explicit bump_arena(size_t block_size = 1024 * 1024) : block_size(block_size) { }
+
+		// size bytes aligned to alignment, a power of two. the bytes are not cleared.
+		auto
+		allocate(size_t size, size_t alignment = alignof(std::max_align_t)) -> void * {
+			auto offset = aligned_offset(alignment);
+			if (blocks.empty() || offset + size > capacity) {
+				capacity = std::max(block_size, size + alignment);
+				blocks.push_back(std::make_unique_for_overwrite<uint8_t[]>(capacity));
+				used = 0;
+				offset = aligned_offset(alignment);
+			}
+
+			used = offset + size;
+			total += size;
+			return &blocks.back()[offset];
+		}
+
+		auto
+		copy(const void *data, size_t size, size_t alignment = 1) -> void * {
+			auto *result = allocate(size, alignment);
+			if (size > 0) {
+				std::memcpy(result, data, size);
+			}
+
+			return result;
+		}
+
+		// a nul terminated copy, null stays null
+		auto
+		copy_string(const char *text) -> const char * {
+			return text == nullptr ? nullptr : copy_string(std::string_view { text });
+		}
+
+		auto
+		copy_string(std::string_view text) -> const char * {
+			auto *result = static_cast<char *>(allocate(text.size() + 1, 1));
+			text.copy(result, text.size());
+			result[text.size()] = '\0';
+			return result;
+		}
+
+		// bytes handed out, not counting alignment or the unused tail of each block
+		[[nodiscard]] auto
+		size() const -> size_t {
+			return total;
+		}
+
+		void
+		clear() {
+			blocks.clear();
+			used = 0;
+			capacity = 0;
+			total = 0;
+		}
+
+	private:
+		// where the next allocation with this alignment would start in the last block
+		[[nodiscard]] auto
+		aligned_offset(size_t alignment) const -> size_t {
+			if (blocks.empty()) {
+				return 0;
+			}
+
+			auto start = reinterpret_cast<uintptr_t>(blocks.back().get());
+			return ((start + used + alignment - 1) & ~(alignment - 1)) - start;
+		}
+
+		size_t block_size;
+		std::vector<std::unique_ptr<uint8_t[]>> blocks;
+		size_t used { 0 }; // of the last block
+		size_t capacity { 0 }; // of the last block
+		size_t total { 0 };
+	};
+} // namespace stormbird_hook
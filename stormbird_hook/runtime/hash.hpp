@@ -0,0 +1,62 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+namespace stormbird_hook {
+	// fast non-cryptographic 64-bit hash, four independent lanes over 32 byte stripes so it runs near memory speed.
+	// only meant for telling apart builds and cache entries, never for anything adversarial.
+	inline auto
+	hash_bytes(std::span<const uint8_t> data, uint64_t seed = 0) -> uint64_t {
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+		constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+		constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+
+		auto round = [&](uint64_t acc, uint64_t value) -> uint64_t {
+			acc += value * prime2;
+			acc = std::rotl(acc, 31);
+			return acc * prime1;
+		};
+
+		auto read64 = [](const uint8_t *ptr) -> uint64_t {
+			uint64_t value = 0;
+			std::memcpy(&value, ptr, sizeof(value));
+			return value;
+		};
+
+		std::array<uint64_t, 4> lanes = { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 };
+		size_t offset = 0;
+		for (; data.size() - offset >= 32; offset += 32) {
+			for (size_t lane = 0; lane < lanes.size(); ++lane) {
+				lanes[lane] = round(lanes[lane], read64(data.data() + offset + lane * 8));
+			}
+		}
+
+		uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+		hash += data.size();
+
+		for (; data.size() - offset >= 8; offset += 8) {
+			hash ^= round(0, read64(data.data() + offset));
+			hash = std::rotl(hash, 27) * prime1 + prime3;
+		}
+
+		for (; offset < data.size(); ++offset) {
+			hash ^= data[offset] * prime3;
+			hash = std::rotl(hash, 11) * prime1;
+		}
+
+		hash ^= hash >> 33;
+		hash *= prime2;
+		hash ^= hash >> 29;
+		hash *= prime3;
+		hash ^= hash >> 32;
+		return hash;
+	}
+} // namespace stormbird_hook
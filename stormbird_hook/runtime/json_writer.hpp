@@ -0,0 +1,198 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// streaming json writer, values go straight into a fixed buffer that is flushed to the stream when it fills up.
+// the output is compact and formatted the same way as nlohmann::json::dump(), so nothing downstream can tell.
+
+namespace stormbird_hook {
+	class json_writer {
+	public:
+		static constexpr size_t buffer_size = 64 * 1024;
+
+		explicit json_writer(std::ostream &output) : output(output) { }
+
+		json_writer(const json_writer &) = delete;
+		auto
+		operator=(const json_writer &) -> json_writer & = delete;
+
+		~json_writer() {
+			flush();
+		}
+
+		void
+		begin_object() {
+			separate();
+			put('{');
+			first.push_back(true);
+		}
+
+		void
+		end_object() {
+			first.pop_back();
+			put('}');
+		}
+
+		void
+		begin_array() {
+			separate();
+			put('[');
+			first.push_back(true);
+		}
+
+		void
+		end_array() {
+			first.pop_back();
+			put(']');
+		}
+
+		// the next value belongs to this key
+		void
+		key(std::string_view name) {
+			separate();
+			put_string(name);
+			put(':');
+			after_key = true;
+		}
+
+		void
+		value(std::string_view text) {
+			separate();
+			put_string(text);
+		}
+
+		// a null c string is written as an empty string
+		void
+		value(const char *text) {
+			value(text == nullptr ? std::string_view {} : std::string_view { text });
+		}
+
+		void
+		value(uint64_t number) {
+			separate();
+			std::array<char, 24> digits {};
+			auto [end, error] = std::to_chars(digits.data(), digits.data() + digits.size(), number);
+			put({ digits.data(), static_cast<size_t>(end - digits.data()) });
+		}
+
+		template<typename T>
+		void
+		field(std::string_view name, T value) {
+			key(name);
+			if constexpr (std::is_integral_v<T>) {
+				this->value(static_cast<uint64_t>(value));
+			} else {
+				this->value(value);
+			}
+		}
+
+		void
+		flush() {
+			if (used > 0) {
+				output.write(buffer.data(), static_cast<std::streamsize>(used));
+				used = 0;
+			}
+
+			output.flush();
+		}
+
+	private:
+		// commas between the elements of arrays and objects, a value right after its key needs none
+		void
+		separate() {
+			if (after_key) {
+				after_key = false;
+				return;
+			}
+
+			if (!first.empty()) {
+				if (!first.back()) {
+					put(',');
+				}
+
+				first.back() = false;
+			}
+		}
+
+		void
+		put(char value) {
+			if (used == buffer.size()) {
+				drain();
+			}
+
+			buffer[used++] = value;
+		}
+
+		void
+		put(std::string_view text) {
+			while (!text.empty()) {
+				if (used == buffer.size()) {
+					drain();
+				}
+
+				auto count = std::min(text.size(), buffer.size() - used);
+				text.copy(buffer.data() + used, count);
+				used += count;
+				text.remove_prefix(count);
+			}
+		}
+
+		// same escapes as nlohmann::json, everything past ascii is passed through as is
+		void
+		put_string(std::string_view text) {
+			constexpr std::string_view digits = "0123456789abcdef";
+
+			put('"');
+			auto start = text.begin();
+			for (auto it = text.begin(); it != text.end(); ++it) {
+				auto value = static_cast<uint8_t>(*it);
+				if (value >= 0x20 && value != '"' && value != '\\') {
+					continue;
+				}
+
+				put(std::string_view(start, it));
+				start = it + 1;
+				switch (value) {
+					case '"': put("\\\""); break;
+					case '\\': put("\\\\"); break;
+					case '\b': put("\\b"); break;
+					case '\f': put("\\f"); break;
+					case '\n': put("\\n"); break;
+					case '\r': put("\\r"); break;
+					case '\t': put("\\t"); break;
+					default:
+						put("\\u00");
+						put(digits[value >> 4]);
+						put(digits[value & 0xF]);
+						break;
+				}
+			}
+
+			put(std::string_view(start, text.end()));
+			put('"');
+		}
+
+		void
+		drain() {
+			output.write(buffer.data(), static_cast<std::streamsize>(used));
+			used = 0;
+		}
+
+		std::ostream &output;
+		std::vector<char> buffer = std::vector<char>(buffer_size);
+		size_t used { 0 };
+		std::vector<bool> first; // one entry per open array or object, true until it has an element
+		bool after_key { false };
+	};
+} // namespace stormbird_hook
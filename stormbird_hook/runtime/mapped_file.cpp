@@ -0,0 +1,127 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace stormbird_hook {
+#ifdef _WIN32
+	mapped_file::mapped_file(const std::filesystem::path &path) {
+		auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return;
+		}
+
+		file_handle = file;
+
+		LARGE_INTEGER file_size;
+		if (GetFileSizeEx(file, &file_size) == 0 || file_size.QuadPart == 0) {
+			close();
+			return;
+		}
+
+		mapping_handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_handle == nullptr) {
+			close();
+			return;
+		}
+
+		view = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (view == nullptr) {
+			close();
+			return;
+		}
+
+		size = static_cast<size_t>(file_size.QuadPart);
+	}
+
+	void
+	mapped_file::close() {
+		if (view != nullptr) {
+			UnmapViewOfFile(view);
+		}
+
+		if (mapping_handle != nullptr) {
+			CloseHandle(mapping_handle);
+		}
+
+		if (file_handle != nullptr) {
+			CloseHandle(file_handle);
+		}
+
+		view = nullptr;
+		size = 0;
+		mapping_handle = nullptr;
+		file_handle = nullptr;
+	}
+#else
+	mapped_file::mapped_file(const std::filesystem::path &path) {
+		auto file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0) {
+			return;
+		}
+
+		struct stat info {};
+		if (fstat(file, &info) != 0 || info.st_size == 0) {
+			::close(file);
+			return;
+		}
+
+		// the mapping keeps its own reference to the file
+		auto *mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		::close(file);
+		if (mapping == MAP_FAILED) {
+			return;
+		}
+
+		view = static_cast<const uint8_t *>(mapping);
+		size = static_cast<size_t>(info.st_size);
+	}
+
+	void
+	mapped_file::close() {
+		if (view != nullptr) {
+			munmap(const_cast<uint8_t *>(view), size);
+		}
+
+		view = nullptr;
+		size = 0;
+	}
+#endif
+
+	mapped_file::~mapped_file() {
+		close();
+	}
+
+	mapped_file::mapped_file(mapped_file &&other) noexcept {
+		*this = std::move(other);
+	}
+
+	auto
+	mapped_file::operator=(mapped_file &&other) noexcept -> mapped_file & {
+		if (this != &other) {
+			close();
+			std::swap(view, other.view);
+			std::swap(size, other.size);
+#ifdef _WIN32
+			std::swap(file_handle, other.file_handle);
+			std::swap(mapping_handle, other.mapping_handle);
+#endif
+		}
+
+		return *this;
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,52 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+
+namespace stormbird_hook {
+	// read-only memory map of a whole file, empty if the file could not be mapped.
+	class mapped_file {
+	public:
+		mapped_file() = default;
+
+		explicit mapped_file(const std::filesystem::path &path);
+
+		~mapped_file();
+
+		mapped_file(const mapped_file &) = delete;
+
+		auto
+		operator=(const mapped_file &) -> mapped_file & = delete;
+
+		mapped_file(mapped_file &&other) noexcept;
+
+		auto
+		operator=(mapped_file &&other) noexcept -> mapped_file &;
+
+		[[nodiscard]] auto
+		data() const -> std::span<const uint8_t> {
+			return { view, size };
+		}
+
+		[[nodiscard]] auto
+		is_open() const -> bool {
+			return view != nullptr;
+		}
+
+	private:
+		void
+		close();
+
+		const uint8_t *view { nullptr };
+		size_t size { 0 };
+#ifdef _WIN32
+		void *file_handle { nullptr };
+		void *mapping_handle { nullptr };
+#endif
+	};
+} // namespace stormbird_hook
@@ -0,0 +1,160 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "memory_snapshot.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	using namespace stormbird_hook;
+
+	constexpr size_t region_alignment = 8;
+
+	auto
+	aligned(uint64_t offset) -> uint64_t {
+		return (offset + region_alignment - 1) & ~(region_alignment - 1);
+	}
+} // namespace
+
+namespace stormbird_hook {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	void
+	write_memory_snapshot(std::ostream &output, uint64_t entry, std::span<const memory_region> regions) {
+		std::vector<memory_region> sorted(regions.begin(), regions.end());
+		std::sort(sorted.begin(), sorted.end(), [](const memory_region &left, const memory_region &right) { return left.address < right.address; });
+
+		memory_file_header header { .region_count = static_cast<uint32_t>(sorted.size()), .entry = entry };
+		std::vector<memory_file_region> table;
+		table.reserve(sorted.size());
+		uint64_t offset = aligned(sizeof(header) + sorted.size() * sizeof(memory_file_region));
+		for (const auto &region : sorted) {
+			table.push_back({ region.address, region.bytes.size(), offset });
+			offset = aligned(offset + region.bytes.size());
+		}
+
+		output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char *>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(memory_file_region)));
+		uint64_t written = sizeof(header) + table.size() * sizeof(memory_file_region);
+		for (size_t index = 0; index < sorted.size(); ++index) {
+			constexpr std::array<char, region_alignment> zeros {};
+			output.write(zeros.data(), static_cast<std::streamsize>(table[index].offset - written));
+			output.write(reinterpret_cast<const char *>(sorted[index].bytes.data()), static_cast<std::streamsize>(sorted[index].bytes.size()));
+			written = table[index].offset + table[index].size;
+		}
+
+		output.flush();
+	}
+
+	auto
+	memory_snapshot_view::open(std::span<const uint8_t> data) -> std::optional<memory_snapshot_view> {
+		if (data.size() < sizeof(memory_file_header) || reinterpret_cast<uintptr_t>(data.data()) % region_alignment != 0) {
+			return std::nullopt;
+		}
+
+		memory_snapshot_view view;
+		view.data = data;
+		view.header = reinterpret_cast<const memory_file_header *>(data.data());
+		if (view.header->magic != memory_file_magic || view.header->version != memory_file_version) {
+			return std::nullopt;
+		}
+
+		if ((data.size() - sizeof(memory_file_header)) / sizeof(memory_file_region) < view.header->region_count) {
+			return std::nullopt;
+		}
+
+		view.table = { reinterpret_cast<const memory_file_region *>(data.data() + sizeof(memory_file_header)), view.header->region_count };
+		uint64_t end = 0;
+		for (const auto &region : view.table) {
+			if (region.offset > data.size() || data.size() - region.offset < region.size || region.address < end || region.address + region.size < region.address) {
+				return std::nullopt;
+			}
+
+			end = region.address + region.size;
+		}
+
+		return view;
+	}
+
+	auto
+	memory_snapshot_view::read(uint64_t address, void *out, size_t size) const -> bool {
+		// the last region starting at or before the address
+		auto region = std::upper_bound(table.begin(), table.end(), address, [](uint64_t value, const memory_file_region &entry) { return value < entry.address; });
+		if (region == table.begin()) {
+			return false;
+		}
+
+		--region;
+		auto *target = static_cast<uint8_t *>(out);
+		while (size > 0) {
+			if (region == table.end() || address < region->address || address - region->address >= region->size) {
+				return false;
+			}
+
+			auto start = address - region->address;
+			auto count = std::min<uint64_t>(size, region->size - start);
+			std::memcpy(target, data.data() + region->offset + start, count);
+			target += count;
+			address += count;
+			size -= count;
+			++region;
+		}
+
+		return true;
+	}
+
+	auto
+	memory_recorder::operator()(uint64_t address, void *out, size_t size) -> bool {
+		if (!read(address, out, size)) {
+			return false;
+		}
+
+		if (size == 0) {
+			return true;
+		}
+
+		const auto *source = static_cast<const uint8_t *>(out);
+		reads.push_back({ address, bytes.size(), size });
+		bytes.insert(bytes.end(), source, source + size);
+		return true;
+	}
+
+	void
+	memory_recorder::write(std::ostream &output, uint64_t entry) const {
+		auto sorted = reads;
+		std::sort(sorted.begin(), sorted.end(), [](const recorded_read &left, const recorded_read &right) { return left.address < right.address; });
+
+		// merged bytes first, the regions point into them once nothing is appended anymore
+		std::vector<uint8_t> merged;
+		std::vector<std::pair<uint64_t, size_t>> starts; // address and offset into merged of every region
+		uint64_t end = 0;
+		for (const auto &recorded : sorted) {
+			if (starts.empty() || recorded.address > end) {
+				starts.emplace_back(recorded.address, merged.size());
+				end = recorded.address;
+			}
+
+			// only the part past what the regions already hold is new
+			auto recorded_end = recorded.address + recorded.size;
+			if (recorded_end > end) {
+				auto skip = end - recorded.address;
+				merged.insert(merged.end(), bytes.begin() + static_cast<std::ptrdiff_t>(recorded.offset + skip), bytes.begin() + static_cast<std::ptrdiff_t>(recorded.offset + recorded.size));
+				end = recorded_end;
+			}
+		}
+
+		std::vector<memory_region> regions;
+		regions.reserve(starts.size());
+		for (size_t index = 0; index < starts.size(); ++index) {
+			auto last = index + 1 < starts.size() ? starts[index + 1].second : merged.size();
+			regions.push_back({ starts[index].first, std::span(merged).subspan(starts[index].second, last - starts[index].second) });
+		}
+
+		write_memory_snapshot(output, entry, regions);
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
@@ -0,0 +1,123 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <utility>
+#include <vector>
+
+// memory of a process saved to a file, so whatever read it live can read it again somewhere else.
+// the file is a header, a table of regions sorted by address, and the bytes of every region. every table and region
+// is 8 byte aligned so a mapped file is read in place. all values are little endian.
+
+namespace stormbird_hook {
+	// copies size bytes at a virtual address to out, false if any of them cannot be read. the readers of
+	// resolve_target() and find_rtti_factories() have the same shape.
+	using memory_reader = std::function<bool(uint64_t address, void *out, size_t size)>;
+
+	constexpr std::array<char, 8> memory_file_magic = { 'S', 'B', 'M', 'E', 'M', '\0', '\0', '\0' };
+	constexpr uint32_t memory_file_version = 1;
+
+	struct memory_file_header {
+		std::array<char, 8> magic = memory_file_magic;
+		uint32_t version { memory_file_version };
+		uint32_t region_count { 0 };
+		uint64_t entry { 0 }; // where the reader should start, the rtti factory for rtti.memory
+	};
+
+	struct memory_file_region {
+		uint64_t address { 0 };
+		uint64_t size { 0 };
+		uint64_t offset { 0 }; // of the bytes, from the start of the file
+	};
+
+	static_assert(sizeof(memory_file_header) == 24);
+	static_assert(sizeof(memory_file_region) == 24);
+
+	struct memory_region {
+		uint64_t address { 0 };
+		std::span<const uint8_t> bytes;
+	};
+
+	// the regions must not overlap, they are written sorted
+	void
+	write_memory_snapshot(std::ostream &output, uint64_t entry, std::span<const memory_region> regions);
+
+	// reads a memory snapshot in place. the bytes have to be 8 byte aligned and outlive the view.
+	class memory_snapshot_view {
+	public:
+		// nothing if the magic or the version are off, or the regions are out of bounds, unsorted or overlapping
+		[[nodiscard]] static auto
+		open(std::span<const uint8_t> data) -> std::optional<memory_snapshot_view>;
+
+		// a read may run across regions that follow each other without a gap
+		auto
+		read(uint64_t address, void *out, size_t size) const -> bool;
+
+		[[nodiscard]] auto
+		entry() const -> uint64_t {
+			return header->entry;
+		}
+
+		[[nodiscard]] auto
+		regions() const -> std::span<const memory_file_region> {
+			return table;
+		}
+
+		// read bound to this view, the view has to outlive it
+		[[nodiscard]] auto
+		reader() const -> memory_reader {
+			return [this](uint64_t address, void *out, size_t size) { return read(address, out, size); };
+		}
+
+	private:
+		std::span<const uint8_t> data;
+		const memory_file_header *header { nullptr };
+		std::span<const memory_file_region> table;
+	};
+
+	// reads through another reader and keeps a copy of everything that could be read, to save as a memory snapshot of
+	// just the memory some walk needed
+	class memory_recorder {
+	public:
+		explicit memory_recorder(memory_reader read) : read(std::move(read)) { }
+
+		auto
+		operator()(uint64_t address, void *out, size_t size) -> bool;
+
+		// records into this recorder, it has to outlive the reader. a memory_reader made from the recorder itself
+		// would record into a copy.
+		[[nodiscard]] auto
+		reader() -> memory_reader {
+			return [this](uint64_t address, void *out, size_t size) { return (*this)(address, out, size); };
+		}
+
+		// every read merged into regions, overlapping and touching reads become one
+		void
+		write(std::ostream &output, uint64_t entry) const;
+
+		// bytes read, counting reads of the same memory again
+		[[nodiscard]] auto
+		size() const -> size_t {
+			return bytes.size();
+		}
+
+	private:
+		struct recorded_read {
+			uint64_t address;
+			size_t offset; // into bytes
+			size_t size;
+		};
+
+		memory_reader read;
+		std::vector<recorded_read> reads;
+		std::vector<uint8_t> bytes;
+	};
+} // namespace stormbird_hook
@@ -0,0 +1,149 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "pe_image.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	constexpr uint16_t dos_magic = 0x5A4D; // MZ
+	constexpr uint32_t nt_magic = 0x00004550; // PE\0\0
+	constexpr uint16_t optional_magic_32 = 0x10B;
+	constexpr uint16_t optional_magic_64 = 0x20B;
+
+	constexpr size_t file_header_size = 20;
+	constexpr size_t section_header_size = 40;
+	constexpr size_t relocation_block_header_size = 8;
+
+	// relocation types, same values as IMAGE_REL_BASED_*
+	constexpr uint16_t relocation_highlow = 3;
+	constexpr uint16_t relocation_dir64 = 10;
+
+	template<typename T>
+	auto
+	read(std::span<const uint8_t> data, size_t offset, T &value) -> bool {
+		if (offset > data.size() || data.size() - offset < sizeof(T)) {
+			return false;
+		}
+
+		std::memcpy(&value, data.data() + offset, sizeof(T));
+		return true;
+	}
+} // namespace
+
+namespace stormbird_hook {
+	auto
+	parse_pe_image(std::span<const uint8_t> data) -> std::optional<pe_image> {
+		uint16_t magic = 0;
+		if (!read(data, 0, magic) || magic != dos_magic) {
+			return std::nullopt;
+		}
+
+		uint32_t nt_offset = 0;
+		uint32_t signature = 0;
+		if (!read(data, 0x3C, nt_offset) || !read(data, nt_offset, signature) || signature != nt_magic) {
+			return std::nullopt;
+		}
+
+		pe_image image;
+		uint16_t section_count = 0;
+		uint16_t optional_size = 0;
+		size_t file_header = nt_offset + 4;
+		if (!read(data, file_header, image.machine) || !read(data, file_header + 2, section_count) || !read(data, file_header + 4, image.timestamp) || !read(data, file_header + 16, optional_size)) {
+			return std::nullopt;
+		}
+
+		size_t optional_header = file_header + file_header_size;
+		uint16_t optional_magic = 0;
+		if (!read(data, optional_header, optional_magic) || (optional_magic != optional_magic_32 && optional_magic != optional_magic_64)) {
+			return std::nullopt;
+		}
+
+		image.is_64 = optional_magic == optional_magic_64;
+		if (image.is_64) {
+			if (!read(data, optional_header + 24, image.image_base)) {
+				return std::nullopt;
+			}
+		} else {
+			uint32_t image_base = 0;
+			if (!read(data, optional_header + 28, image_base)) {
+				return std::nullopt;
+			}
+
+			image.image_base = image_base;
+		}
+
+		if (!read(data, optional_header + 16, image.entry_point) || !read(data, optional_header + 56, image.size_of_image) || !read(data, optional_header + 60, image.size_of_headers)) {
+			return std::nullopt;
+		}
+
+		// the directory table sits at the end of the optional header and may be shorter than 16 entries
+		size_t directory_count_offset = optional_header + (image.is_64 ? 108 : 92);
+		uint32_t directory_count = 0;
+		if (read(data, directory_count_offset, directory_count)) {
+			auto directory_table = directory_count_offset + 4;
+			auto fits = (optional_header + optional_size - std::min(directory_table, optional_header + optional_size)) / sizeof(pe_data_directory);
+			directory_count = static_cast<uint32_t>(std::min<size_t>({ directory_count, image.directories.size(), fits }));
+			for (size_t index = 0; index < directory_count; ++index) {
+				read(data, directory_table + index * sizeof(pe_data_directory), image.directories[index]);
+			}
+		}
+
+		size_t section_table = optional_header + optional_size;
+		if (section_table + static_cast<size_t>(section_count) * section_header_size > data.size()) {
+			return std::nullopt;
+		}
+
+		image.sections.resize(section_count);
+		for (size_t index = 0; index < section_count; ++index) {
+			auto &section = image.sections[index];
+			auto offset = section_table + index * section_header_size;
+			std::memcpy(section.raw_name.data(), data.data() + offset, section.raw_name.size());
+			read(data, offset + 8, section.virtual_size);
+			read(data, offset + 12, section.virtual_address);
+			read(data, offset + 16, section.raw_size);
+			read(data, offset + 20, section.raw_offset);
+			read(data, offset + 36, section.characteristics);
+		}
+
+		return image;
+	}
+
+	auto
+	parse_relocations(std::span<const uint8_t> file, const pe_image &image) -> std::vector<pe_relocation> {
+		std::vector<pe_relocation> relocations;
+		const auto &directory = image.directories[pe_directory_base_relocation];
+
+		// blocks of a page rva, a block size and then 16-bit entries of a 4-bit type and a 12-bit page offset
+		// a block larger than what is left of the directory is corrupt, stepping over it could wrap the cursor
+		uint32_t cursor = 0;
+		while (directory.size - cursor >= relocation_block_header_size) {
+			auto offset = image.rva_to_offset(directory.virtual_address + cursor);
+			uint32_t page = 0;
+			uint32_t block_size = 0;
+			if (!offset || !read(file, *offset, page) || !read(file, *offset + 4, block_size) || block_size < relocation_block_header_size || block_size > directory.size - cursor) {
+				break;
+			}
+
+			for (uint32_t entry_offset = relocation_block_header_size; entry_offset + 2 <= block_size; entry_offset += 2) {
+				uint16_t entry = 0;
+				if (!read(file, *offset + entry_offset, entry)) {
+					break;
+				}
+
+				// absolute entries are padding, the other types do not show up in x86 images
+				auto type = static_cast<uint16_t>(entry >> 12);
+				if (type == relocation_dir64 || type == relocation_highlow) {
+					relocations.push_back({ page + (entry & 0xFFFu), static_cast<uint8_t>(type == relocation_dir64 ? 8 : 4) });
+				}
+			}
+
+			cursor += block_size;
+		}
+
+		std::sort(relocations.begin(), relocations.end(), [](const pe_relocation &lhs, const pe_relocation &rhs) { return lhs.rva < rhs.rva; });
+		return relocations;
+	}
+} // namespace stormbird_hook
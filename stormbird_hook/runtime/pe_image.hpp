@@ -0,0 +1,124 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace stormbird_hook {
+	// section characteristics, same values as IMAGE_SCN_*
+	constexpr uint32_t pe_section_code = 0x00000020;
+	constexpr uint32_t pe_section_initialized_data = 0x00000040;
+	constexpr uint32_t pe_section_uninitialized_data = 0x00000080;
+	constexpr uint32_t pe_section_execute = 0x20000000;
+	constexpr uint32_t pe_section_read = 0x40000000;
+	constexpr uint32_t pe_section_write = 0x80000000;
+
+	// data directory indices, same values as IMAGE_DIRECTORY_ENTRY_*
+	constexpr size_t pe_directory_export = 0;
+	constexpr size_t pe_directory_import = 1;
+	constexpr size_t pe_directory_exception = 3;
+	constexpr size_t pe_directory_base_relocation = 5;
+
+	struct pe_data_directory {
+		uint32_t virtual_address { 0 }; // rva
+		uint32_t size { 0 };
+	};
+
+	// a field the loader rewrites when the image is not loaded at its preferred base
+	struct pe_relocation {
+		uint32_t rva { 0 };
+		uint8_t size { 0 }; // 4 or 8
+	};
+
+	struct pe_section {
+		std::array<char, 8> raw_name {}; // not null terminated if the name is 8 characters long
+		uint32_t virtual_size { 0 };
+		uint32_t virtual_address { 0 }; // rva
+		uint32_t raw_size { 0 };
+		uint32_t raw_offset { 0 }; // file offset
+		uint32_t characteristics { 0 };
+
+		[[nodiscard]] auto
+		name() const -> std::string_view {
+			auto length = std::string_view(raw_name.data(), raw_name.size()).find('\0');
+			return { raw_name.data(), length == std::string_view::npos ? raw_name.size() : length };
+		}
+
+		[[nodiscard]] auto
+		executable() const -> bool {
+			return (characteristics & (pe_section_code | pe_section_execute)) != 0;
+		}
+
+		// size of the section once loaded, sections with no virtual size use their raw size
+		[[nodiscard]] auto
+		mapped_size() const -> uint32_t {
+			return virtual_size == 0 ? raw_size : virtual_size;
+		}
+	};
+
+	// the parts of the pe headers we care about. works on raw file bytes as well as on a loaded image,
+	// the headers are at the start of both.
+	struct pe_image {
+		uint16_t machine { 0 };
+		uint32_t timestamp { 0 };
+		bool is_64 { false };
+		uint64_t image_base { 0 };
+		uint32_t entry_point { 0 }; // rva
+		uint32_t size_of_image { 0 };
+		uint32_t size_of_headers { 0 };
+		std::array<pe_data_directory, 16> directories {};
+		std::vector<pe_section> sections;
+
+		[[nodiscard]] auto
+		find_section(std::string_view name) const -> const pe_section * {
+			for (const auto &section : sections) {
+				if (section.name() == name) {
+					return &section;
+				}
+			}
+
+			return nullptr;
+		}
+
+		[[nodiscard]] auto
+		section_for_rva(uint32_t rva) const -> const pe_section * {
+			for (const auto &section : sections) {
+				if (rva >= section.virtual_address && rva - section.virtual_address < section.mapped_size()) {
+					return &section;
+				}
+			}
+
+			return nullptr;
+		}
+
+		// where the byte at rva lives in the file, nothing if it is zero fill or outside the image
+		[[nodiscard]] auto
+		rva_to_offset(uint32_t rva) const -> std::optional<uint32_t> {
+			if (rva < size_of_headers) {
+				return rva;
+			}
+
+			const auto *section = section_for_rva(rva);
+			if (section == nullptr || rva - section->virtual_address >= section->raw_size) {
+				return std::nullopt;
+			}
+
+			return section->raw_offset + (rva - section->virtual_address);
+		}
+	};
+
+	// returns nothing if the headers are truncated or not a pe file
+	auto
+	parse_pe_image(std::span<const uint8_t> data) -> std::optional<pe_image>;
+
+	// every field in the base relocation directory of a pe file on disk, sorted by rva
+	auto
+	parse_relocations(std::span<const uint8_t> file, const pe_image &image) -> std::vector<pe_relocation>;
+} // namespace stormbird_hook
@@ -0,0 +1,660 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "rtti_binary.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "json_writer.hpp"
+#include "rtti_names.hpp"
+#include "rtti_snapshot.hpp"
+#include "rtti_walk.hpp"
+
+namespace {
+	using namespace stormbird_hook;
+
+	constexpr size_t table_alignment = 8;
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// every type gets its index the first time it is referred to, and is filled in once everything before it is
+	class rtti_binary_builder {
+	public:
+		explicit rtti_binary_builder(rtti_source source) : source(source) {
+			strings.push_back('\0');
+		}
+
+		void
+		build(const RTTIFactory &factory) {
+			for_each_rtti_root(factory, [this](const RTTIBase *rtti) { index_of(rtti); });
+			fill_all();
+		}
+
+		// the types take their indices in this order
+		void
+		build(std::span<const RTTIBase *const> order) {
+			for (const auto *rtti : order) {
+				index_of(rtti);
+			}
+
+			fill_all();
+		}
+
+		void
+		write(std::ostream &output) const {
+			emit([&output](const void *data, size_t size) { output.write(static_cast<const char *>(data), static_cast<std::streamsize>(size)); });
+			output.flush();
+		}
+
+		void
+		write(rtti_binary_buffer &buffer) const {
+			size_t size = 0;
+			emit([&size](const void *, size_t bytes) { size += bytes; });
+
+			buffer.words.assign((size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+			buffer.size = size;
+			auto *cursor = reinterpret_cast<uint8_t *>(buffer.words.data());
+			emit([&cursor](const void *data, size_t bytes) {
+				if (bytes > 0) {
+					std::memcpy(cursor, data, bytes);
+					cursor += bytes;
+				}
+			});
+		}
+
+	private:
+		// hands the file to put piece by piece: the header, then every table after the padding that aligns it
+		template<typename Fn>
+		void
+		emit(Fn &&put) const {
+			rtti_file_header header;
+			std::vector<std::span<const uint8_t>> tables(static_cast<size_t>(rtti_file_table::count));
+			tables[static_cast<size_t>(rtti_file_table::strings)] = table_bytes(strings);
+			tables[static_cast<size_t>(rtti_file_table::types)] = table_bytes(types);
+			tables[static_cast<size_t>(rtti_file_table::primitives)] = table_bytes(primitives);
+			tables[static_cast<size_t>(rtti_file_table::references)] = table_bytes(references);
+			tables[static_cast<size_t>(rtti_file_table::enums)] = table_bytes(enums);
+			tables[static_cast<size_t>(rtti_file_table::enum_values)] = table_bytes(enum_values);
+			tables[static_cast<size_t>(rtti_file_table::classes)] = table_bytes(classes);
+			tables[static_cast<size_t>(rtti_file_table::descendants)] = table_bytes(descendants);
+			tables[static_cast<size_t>(rtti_file_table::bases)] = table_bytes(bases);
+			tables[static_cast<size_t>(rtti_file_table::members)] = table_bytes(members);
+			tables[static_cast<size_t>(rtti_file_table::functions)] = table_bytes(functions);
+			tables[static_cast<size_t>(rtti_file_table::events)] = table_bytes(events);
+			tables[static_cast<size_t>(rtti_file_table::base_events)] = table_bytes(base_events);
+
+			uint64_t offset = sizeof(header);
+			for (size_t id = 0; id < tables.size(); ++id) {
+				offset = (offset + table_alignment - 1) & ~(table_alignment - 1);
+				header.tables[id] = { offset, tables[id].size() };
+				offset += tables[id].size();
+			}
+
+			put(&header, sizeof(header));
+			uint64_t written = sizeof(header);
+			for (size_t id = 0; id < tables.size(); ++id) {
+				constexpr std::array<char, table_alignment> zeros {};
+				put(zeros.data(), static_cast<size_t>(header.tables[id].offset - written));
+				put(tables[id].data(), tables[id].size());
+				written = header.tables[id].offset + tables[id].size();
+			}
+		}
+
+		[[nodiscard]] auto
+		address_of(const void *type) const -> uint64_t {
+			return rtti_address(type, source);
+		}
+
+		template<typename T>
+		static auto
+		table_bytes(const std::vector<T> &table) -> std::span<const uint8_t> {
+			return { reinterpret_cast<const uint8_t *>(table.data()), table.size() * sizeof(T) };
+		}
+
+		auto
+		intern(std::string_view text) -> uint32_t {
+			if (text.empty()) {
+				return 0;
+			}
+
+			auto [it, inserted] = pooled.try_emplace(text, static_cast<uint32_t>(strings.size()));
+			if (inserted) {
+				strings.insert(strings.end(), text.begin(), text.end());
+				strings.push_back('\0');
+			}
+
+			return it->second;
+		}
+
+		auto
+		intern(const char *text) -> uint32_t {
+			return text == nullptr ? 0 : intern(std::string_view { text });
+		}
+
+		auto
+		index_of(const RTTIBase *rtti) -> uint32_t {
+			if (rtti == nullptr) {
+				return rtti_file_null;
+			}
+
+			auto [it, inserted] = indices.try_emplace(address_of(rtti), static_cast<uint32_t>(types.size()));
+			if (inserted) {
+				types.push_back({ .address = address_of(rtti) });
+				sources.push_back(rtti);
+			}
+
+			return it->second;
+		}
+
+		// the type table is the work queue, filling a type can only append types after it
+		void
+		fill_all() {
+			for (uint32_t index = 0; index < types.size(); ++index) {
+				fill(index);
+			}
+		}
+
+		auto
+		range_from(size_t first, size_t last) -> rtti_file_range {
+			return { static_cast<uint32_t>(first), static_cast<uint32_t>(last - first) };
+		}
+
+		void
+		fill(uint32_t index) {
+			const auto *rtti = sources[index];
+			rtti_file_type type {
+				.address = address_of(rtti),
+				.name = intern(names.name_of(rtti)),
+				.type_id = rtti->type_id,
+				.category_type_id = rtti->category_type_id,
+				.kind = rtti->rtti_type,
+			};
+
+			switch (rtti->rtti_type) {
+				case RTTIType::Primitive:
+					{
+						const auto *primitive = reinterpret_cast<const RTTIPrimitive *>(rtti);
+						type.detail = static_cast<uint32_t>(primitives.size());
+						primitives.push_back({
+							.parent = primitive->parent == rtti ? rtti_file_self : index_of(primitive->parent),
+							.unknown2 = primitive->unknown2,
+							.total_size = primitive->total_size,
+							.size = primitive->size,
+							.count = primitive->count,
+						});
+						break;
+					}
+				case RTTIType::Reference:
+				case RTTIType::Container:
+					{
+						const auto *reference = reinterpret_cast<const RTTIReference *>(rtti);
+						type.detail = static_cast<uint32_t>(references.size());
+						references.push_back({
+							.container_name = intern(reference->data->name),
+							.type = index_of(reference->type),
+							.unknown1 = reference->data->unknown1,
+							.unknown2 = reference->data->unknown2,
+							.unknown3 = reference->data->unknown3,
+						});
+						break;
+					}
+				case RTTIType::Enum:
+				case RTTIType::Bitset:
+					{
+						const auto *enum_rtti = reinterpret_cast<const RTTIEnum *>(rtti);
+						auto first = enum_values.size();
+						for (auto i = 0; enum_rtti->values != nullptr && i < enum_rtti->member_count; i++) {
+							enum_values.push_back({ .value = enum_rtti->values[i].value, .name = intern(enum_rtti->values[i].name) });
+						}
+
+						type.detail = static_cast<uint32_t>(enums.size());
+						enums.push_back({
+							.values = range_from(first, enum_values.size()),
+							.unknown1 = enum_rtti->unknown1,
+							.unknown2 = enum_rtti->unknown2,
+							.member_count = enum_rtti->member_count,
+							.size = enum_rtti->size,
+						});
+						break;
+					}
+				case RTTIType::Class:
+					{
+						type.detail = static_cast<uint32_t>(classes.size());
+						classes.push_back(fill_class(reinterpret_cast<const RTTIClass *>(rtti)));
+						break;
+					}
+				case RTTIType::Struct: break;
+			}
+
+			types[index] = type;
+		}
+
+		auto
+		fill_class(const RTTIClass *class_rtti) -> rtti_file_class {
+			rtti_file_class result {
+				.hash = class_rtti->hash,
+				.unknown5 = class_rtti->unknown5,
+				.size = class_rtti->size,
+				.unknown3 = class_rtti->unknown3,
+				.unknown4 = class_rtti->unknown4,
+				.alignment = class_rtti->alignment,
+				.flags = class_rtti->flags,
+				.base_count = class_rtti->base_count,
+				.member_count = class_rtti->member_count,
+				.function_count = class_rtti->function_count,
+				.event_count = class_rtti->event_count,
+				.base_event_count = class_rtti->base_event_count,
+				.unknown1 = class_rtti->unknown1,
+				.unknown2 = class_rtti->unknown2,
+			};
+
+			auto first = descendants.size();
+			for_each_rtti_descendant(class_rtti, siblings, [this](const RTTIClass *descendant_rtti) {
+				descendants.push_back(index_of(reinterpret_cast<const RTTIBase *>(descendant_rtti)));
+			});
+			result.descendants = range_from(first, descendants.size());
+
+			first = bases.size();
+			for (auto i = 0; class_rtti->bases != nullptr && i < class_rtti->base_count; i++) {
+				bases.push_back({ index_of(reinterpret_cast<const RTTIBase *>(class_rtti->bases[i].type)), class_rtti->bases[i].offset });
+			}
+			result.bases = range_from(first, bases.size());
+
+			first = members.size();
+			for (auto i = 0; class_rtti->members != nullptr && i < class_rtti->member_count; i++) {
+				const auto &member = class_rtti->members[i];
+				members.push_back({ index_of(member.type), intern(member.name), member.offset, member.flags, member.unknown });
+			}
+			result.members = range_from(first, members.size());
+
+			first = functions.size();
+			for (auto i = 0; class_rtti->functions != nullptr && i < class_rtti->function_count; i++) {
+				const auto &function = class_rtti->functions[i];
+				functions.push_back({ function.return_type, intern(function.name), intern(function.args) });
+			}
+			result.functions = range_from(first, functions.size());
+
+			first = events.size();
+			for (auto i = 0; class_rtti->events != nullptr && i < class_rtti->event_count; i++) {
+				events.push_back(index_of(class_rtti->events[i].type));
+			}
+			result.events = range_from(first, events.size());
+
+			first = base_events.size();
+			for (auto i = 0; class_rtti->base_events != nullptr && i < class_rtti->base_event_count; i++) {
+				const auto &base_event = class_rtti->base_events[i];
+				base_events.push_back({ base_event.unknown1, index_of(base_event.type), index_of(base_event.base_class) });
+			}
+			result.base_events = range_from(first, base_events.size());
+
+			return result;
+		}
+
+		rtti_source source;
+		ankerl::unordered_dense::map<uint64_t, uint32_t> indices;
+		std::vector<const RTTIBase *> sources; // the type behind each index
+		rtti_address_set siblings; // scratch for for_each_rtti_descendant()
+		rtti_name_cache names;
+		ankerl::unordered_dense::map<std::string_view, uint32_t> pooled; // views into the game or into names
+
+		std::vector<char> strings;
+		std::vector<rtti_file_type> types;
+		std::vector<rtti_file_primitive> primitives;
+		std::vector<rtti_file_reference> references;
+		std::vector<rtti_file_enum> enums;
+		std::vector<rtti_file_enum_value> enum_values;
+		std::vector<rtti_file_class> classes;
+		std::vector<rtti_file_type_ref> descendants;
+		std::vector<rtti_file_base> bases;
+		std::vector<rtti_file_member> members;
+		std::vector<rtti_file_function> functions;
+		std::vector<rtti_file_type_ref> events;
+		std::vector<rtti_file_base_event> base_events;
+	};
+
+	// size of one record of every table, for the bounds checks
+	constexpr std::array<size_t, static_cast<size_t>(rtti_file_table::count)> record_sizes = {
+		sizeof(char),
+		sizeof(rtti_file_type),
+		sizeof(rtti_file_primitive),
+		sizeof(rtti_file_reference),
+		sizeof(rtti_file_enum),
+		sizeof(rtti_file_enum_value),
+		sizeof(rtti_file_class),
+		sizeof(rtti_file_type_ref),
+		sizeof(rtti_file_base),
+		sizeof(rtti_file_member),
+		sizeof(rtti_file_function),
+		sizeof(rtti_file_type_ref),
+		sizeof(rtti_file_base_event),
+	};
+
+	// writes one record of the file the way rtti_json_dumper writes the live type
+	class rtti_file_json_writer {
+	public:
+		rtti_file_json_writer(const rtti_file_view &file, std::ostream &output) : file(file), writer(output) { }
+
+		void
+		write() {
+			writer.begin_array();
+			for (const auto &type : file.types()) {
+				write_type(type);
+			}
+			writer.end_array();
+			writer.flush();
+		}
+
+	private:
+		template<typename T>
+		auto
+		records(rtti_file_table id, rtti_file_range range) const -> std::span<const T> {
+			auto table = file.table<T>(id);
+			if (range.first > table.size() || table.size() - range.first < range.count) {
+				return {};
+			}
+
+			return table.subspan(range.first, range.count);
+		}
+
+		template<typename T>
+		auto
+		record(rtti_file_table id, uint32_t index) const -> const T * {
+			auto table = file.table<T>(id);
+			return index < table.size() ? &table[index] : nullptr;
+		}
+
+		void
+		write_type(const rtti_file_type &type) {
+			writer.begin_object();
+			writer.field("type_id", type.type_id);
+			writer.field("category_type_id", type.category_type_id);
+			writer.field("type", static_cast<uint8_t>(type.kind));
+			writer.field("addr", type.address);
+
+			switch (type.kind) {
+				case RTTIType::Primitive:
+					{
+						const auto *primitive = record<rtti_file_primitive>(rtti_file_table::primitives, type.detail);
+						if (primitive == nullptr) {
+							break;
+						}
+
+						writer.field("total_size", primitive->total_size);
+						writer.field("size", primitive->size);
+						writer.field("count", primitive->count);
+						writer.field("unknown2", primitive->unknown2);
+						writer.field("name", file.string(type.name));
+						if (primitive->parent != rtti_file_self) {
+							writer.field("parent_addr", file.address_of(primitive->parent));
+							writer.field("parent", file.name_of(primitive->parent));
+						}
+						break;
+					}
+				case RTTIType::Reference:
+				case RTTIType::Container:
+					{
+						const auto *reference = record<rtti_file_reference>(rtti_file_table::references, type.detail);
+						if (reference == nullptr) {
+							break;
+						}
+
+						writer.field("name", file.string(type.name));
+						writer.field("container_name", file.string(reference->container_name));
+						writer.field("type_name", file.name_of(reference->type));
+						writer.field("type_addr", file.address_of(reference->type));
+						writer.field("unknown1", reference->unknown1);
+						writer.field("unknown2", reference->unknown2);
+						writer.field("unknown3", reference->unknown3);
+						break;
+					}
+				case RTTIType::Enum:
+				case RTTIType::Bitset:
+					{
+						const auto *enum_rtti = record<rtti_file_enum>(rtti_file_table::enums, type.detail);
+						if (enum_rtti == nullptr) {
+							break;
+						}
+
+						writer.field("name", file.string(type.name));
+						writer.field("size", enum_rtti->size);
+						writer.field("member_count", enum_rtti->member_count);
+						writer.field("unknown1", enum_rtti->unknown1);
+						writer.field("unknown2", enum_rtti->unknown2);
+						writer.key("values");
+						writer.begin_array();
+						for (const auto &value : records<rtti_file_enum_value>(rtti_file_table::enum_values, enum_rtti->values)) {
+							writer.begin_object();
+							writer.field("value", value.value);
+							writer.field("name", file.string(value.name));
+							writer.end_object();
+						}
+						writer.end_array();
+						break;
+					}
+				case RTTIType::Class:
+					{
+						const auto *class_rtti = record<rtti_file_class>(rtti_file_table::classes, type.detail);
+						if (class_rtti != nullptr) {
+							writer.field("name", file.string(type.name));
+							write_class(*class_rtti);
+						}
+						break;
+					}
+				case RTTIType::Struct: break;
+			}
+
+			writer.end_object();
+		}
+
+		void
+		write_class(const rtti_file_class &class_rtti) {
+			writer.field("base_count", class_rtti.base_count);
+			writer.field("member_count", class_rtti.member_count);
+			writer.field("function_count", class_rtti.function_count);
+			writer.field("event_count", class_rtti.event_count);
+			writer.field("base_event_count", class_rtti.base_event_count);
+			writer.field("unknown1", class_rtti.unknown1);
+			writer.field("unknown2", class_rtti.unknown2);
+			writer.field("unknown3", class_rtti.unknown3);
+			writer.field("unknown4", class_rtti.unknown4);
+			writer.field("hash", class_rtti.hash);
+			writer.field("unknown5", class_rtti.unknown5);
+			writer.field("size", class_rtti.size);
+			writer.field("alignment", class_rtti.alignment);
+			writer.field("flags", class_rtti.flags);
+
+			// the live dump only writes these arrays when they have elements
+			if (class_rtti.descendants.count > 0) {
+				writer.key("descendants");
+				writer.begin_array();
+				for (auto descendant : records<rtti_file_type_ref>(rtti_file_table::descendants, class_rtti.descendants)) {
+					writer.begin_object();
+					writer.field("name", file.name_of(descendant));
+					writer.field("addr", file.address_of(descendant));
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti.bases.count > 0) {
+				writer.key("bases");
+				writer.begin_array();
+				for (const auto &base : records<rtti_file_base>(rtti_file_table::bases, class_rtti.bases)) {
+					writer.begin_object();
+					writer.field("name", file.name_of(base.type));
+					writer.field("addr", file.address_of(base.type));
+					writer.field("offset", base.offset);
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti.members.count > 0) {
+				writer.key("members");
+				writer.begin_array();
+				for (const auto &member : records<rtti_file_member>(rtti_file_table::members, class_rtti.members)) {
+					writer.begin_object();
+					writer.field("type_name", file.name_of(member.type));
+					writer.field("type_addr", file.address_of(member.type));
+					writer.field("name", file.string(member.name));
+					writer.field("offset", member.offset);
+					writer.field("flags", member.flags);
+					writer.field("unknown", member.unknown);
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti.functions.count > 0) {
+				writer.key("functions");
+				writer.begin_array();
+				for (const auto &function : records<rtti_file_function>(rtti_file_table::functions, class_rtti.functions)) {
+					writer.begin_object();
+					writer.field("type", function.return_type);
+					writer.field("name", file.string(function.name));
+					writer.field("args", file.string(function.args));
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti.events.count > 0) {
+				writer.key("events");
+				writer.begin_array();
+				for (auto event : records<rtti_file_type_ref>(rtti_file_table::events, class_rtti.events)) {
+					writer.begin_object();
+					writer.field("name", file.name_of(event));
+					writer.field("addr", file.address_of(event));
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti.base_events.count > 0) {
+				writer.key("base_events");
+				writer.begin_array();
+				for (const auto &base_event : records<rtti_file_base_event>(rtti_file_table::base_events, class_rtti.base_events)) {
+					writer.begin_object();
+					writer.field("unknown1", base_event.unknown1);
+					writer.field("name", file.name_of(base_event.type));
+					writer.field("addr", file.address_of(base_event.type));
+					writer.field("type_name", file.name_of(base_event.base_class));
+					writer.field("type_addr", file.address_of(base_event.base_class));
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+		}
+
+		const rtti_file_view &file;
+		json_writer writer;
+	};
+
+	// output is a stream or an rtti_binary_buffer
+	template<typename Output>
+	void
+	write_binary(const RTTIFactory &factory, rtti_source source, Output &output, const rtti_dump_options &options) {
+		rtti_binary_builder builder(source);
+		if (options.mode == rtti_dump_mode::serial) {
+			builder.build(factory);
+		} else {
+			builder.build(collect_rtti_types(factory, options, source));
+		}
+
+		builder.write(output);
+	}
+
+#pragma clang diagnostic pop
+} // namespace
+
+namespace stormbird_hook {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	auto
+	rtti_file_view::open(std::span<const uint8_t> data) -> std::optional<rtti_file_view> {
+		if (data.size() < sizeof(rtti_file_header) || reinterpret_cast<uintptr_t>(data.data()) % table_alignment != 0) {
+			return std::nullopt;
+		}
+
+		rtti_file_view view;
+		view.data = data;
+		view.header = reinterpret_cast<const rtti_file_header *>(data.data());
+		if (view.header->magic != rtti_file_magic || view.header->version != rtti_file_version || view.header->table_count != static_cast<uint32_t>(rtti_file_table::count)) {
+			return std::nullopt;
+		}
+
+		for (size_t id = 0; id < record_sizes.size(); ++id) {
+			const auto &entry = view.header->tables[id];
+			if (entry.offset % table_alignment != 0 || entry.offset > data.size() || data.size() - entry.offset < entry.size || entry.size % record_sizes[id] != 0) {
+				return std::nullopt;
+			}
+		}
+
+		// every string has to be terminated, so the last byte of the pool is a nul
+		auto strings = view.table<char>(rtti_file_table::strings);
+		if (strings.empty() || strings.back() != '\0') {
+			return std::nullopt;
+		}
+
+		view.strings = { strings.data(), strings.size() };
+		return view;
+	}
+
+	auto
+	rtti_file_view::string(uint32_t offset) const -> std::string_view {
+		if (offset >= strings.size()) {
+			return {};
+		}
+
+		return { strings.data() + offset };
+	}
+
+	auto
+	rtti_file_view::address_of(uint32_t type) const -> uint64_t {
+		auto all = types();
+		return type < all.size() ? all[type].address : 0;
+	}
+
+	auto
+	rtti_file_view::name_of(uint32_t type) const -> std::string_view {
+		auto all = types();
+		return type < all.size() ? string(all[type].name) : "<null>";
+	}
+
+	void
+	write_rtti_binary(const RTTIFactory &factory, std::ostream &output, const rtti_dump_options &options) {
+		write_binary(factory, rtti_source::game, output, options);
+	}
+
+	void
+	write_rtti_binary(const rtti_snapshot &snapshot, std::ostream &output, const rtti_dump_options &options) {
+		write_binary(snapshot.factory(), rtti_source::snapshot, output, options);
+	}
+
+	auto
+	build_rtti_binary(const RTTIFactory &factory, const rtti_dump_options &options) -> rtti_binary_buffer {
+		rtti_binary_buffer buffer;
+		write_binary(factory, rtti_source::game, buffer, options);
+		return buffer;
+	}
+
+	auto
+	build_rtti_binary(const rtti_snapshot &snapshot, const rtti_dump_options &options) -> rtti_binary_buffer {
+		rtti_binary_buffer buffer;
+		write_binary(snapshot.factory(), rtti_source::snapshot, buffer, options);
+		return buffer;
+	}
+
+	void
+	write_rtti_json(const rtti_file_view &file, std::ostream &output) {
+		rtti_file_json_writer writer(file, output);
+		writer.write();
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
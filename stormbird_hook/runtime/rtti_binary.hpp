@@ -0,0 +1,247 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "rtti.hpp"
+#include "rtti_walk.hpp"
+
+// rtti.bin, the compact form of rtti.json: fixed-width record tables, one pool of deduplicated strings, and types
+// referring to each other by their index in the type table. every table is 8 byte aligned so a mapped file is read
+// in place. all values are little endian.
+
+namespace stormbird_hook {
+	class rtti_snapshot;
+
+	constexpr std::array<char, 8> rtti_file_magic = { 'S', 'B', 'R', 'T', 'T', 'I', '\0', '\0' };
+	constexpr uint32_t rtti_file_version = 1;
+
+	// type indices that do not name a type
+	constexpr uint32_t rtti_file_null = 0xFFFFFFFF; // a null pointer
+	constexpr uint32_t rtti_file_self = 0xFFFFFFFE; // primitive parent only, the primitive is its own parent
+
+	enum class rtti_file_table : uint32_t {
+		strings, // nul terminated, a string is referred to by its offset. offset 0 is the empty string
+		types,
+		primitives,
+		references,
+		enums,
+		enum_values,
+		classes,
+		descendants,
+		bases,
+		members,
+		functions,
+		events,
+		base_events,
+		count
+	};
+
+	struct rtti_file_range {
+		uint32_t first { 0 };
+		uint32_t count { 0 };
+	};
+
+	struct rtti_file_table_entry {
+		uint64_t offset { 0 }; // from the start of the file
+		uint64_t size { 0 }; // in bytes
+	};
+
+	struct rtti_file_header {
+		std::array<char, 8> magic = rtti_file_magic;
+		uint32_t version { rtti_file_version };
+		uint32_t table_count { static_cast<uint32_t>(rtti_file_table::count) };
+		std::array<rtti_file_table_entry, static_cast<size_t>(rtti_file_table::count)> tables {};
+	};
+
+	struct rtti_file_type {
+		uint64_t address { 0 }; // where the type lived in the game, only kept for the addr fields of the json
+		uint32_t name { 0 }; // get_rtti_name()
+		uint32_t detail { rtti_file_null }; // index into the table of the kind, nothing for structs
+		uint16_t type_id { 0 };
+		uint16_t category_type_id { 0 };
+		RTTIType kind { RTTIType::Primitive };
+		std::array<uint8_t, 3> padding {};
+	};
+
+	struct rtti_file_primitive {
+		uint32_t parent { rtti_file_self };
+		uint32_t unknown2 { 0 };
+		uint16_t total_size { 0 };
+		uint8_t size { 0 };
+		uint8_t count { 0 };
+		uint32_t padding { 0 };
+	};
+
+	struct rtti_file_reference {
+		uint32_t container_name { 0 };
+		uint32_t type { rtti_file_null };
+		uint16_t unknown1 { 0 };
+		uint8_t unknown2 { 0 };
+		uint8_t unknown3 { 0 };
+		uint32_t padding { 0 };
+	};
+
+	struct rtti_file_enum {
+		rtti_file_range values {};
+		uint32_t unknown1 { 0 };
+		uint32_t unknown2 { 0 };
+		uint16_t member_count { 0 };
+		uint8_t size { 0 };
+		std::array<uint8_t, 5> padding {};
+	};
+
+	struct rtti_file_enum_value {
+		uint64_t value { 0 };
+		uint32_t name { 0 };
+		uint32_t padding { 0 };
+	};
+
+	struct rtti_file_class {
+		uint32_t hash { 0 };
+		uint32_t unknown5 { 0 };
+		uint32_t size { 0 };
+		uint16_t unknown3 { 0 };
+		uint16_t unknown4 { 0 };
+		uint16_t alignment { 0 };
+		uint16_t flags { 0 };
+		uint8_t base_count { 0 };
+		uint8_t member_count { 0 };
+		uint8_t function_count { 0 };
+		uint8_t event_count { 0 };
+		uint8_t base_event_count { 0 };
+		uint8_t unknown1 { 0 };
+		uint8_t unknown2 { 0 };
+		uint8_t padding { 0 };
+		rtti_file_range descendants {}; // indices into descendants, the other ranges likewise
+		rtti_file_range bases {};
+		rtti_file_range members {};
+		rtti_file_range functions {};
+		rtti_file_range events {};
+		rtti_file_range base_events {};
+	};
+
+	struct rtti_file_base {
+		uint32_t type { rtti_file_null };
+		uint32_t offset { 0 };
+	};
+
+	struct rtti_file_member {
+		uint32_t type { rtti_file_null };
+		uint32_t name { 0 };
+		uint16_t offset { 0 };
+		uint16_t flags { 0 };
+		uint32_t unknown { 0 };
+	};
+
+	struct rtti_file_function {
+		uint64_t return_type { 0 };
+		uint32_t name { 0 };
+		uint32_t args { 0 };
+	};
+
+	struct rtti_file_base_event {
+		uint64_t unknown1 { 0 };
+		uint32_t type { rtti_file_null };
+		uint32_t base_class { rtti_file_null };
+	};
+
+	// descendants and events are plain type indices
+	using rtti_file_type_ref = uint32_t;
+
+	// the records are the file layout, they must not change size without a version bump
+	static_assert(sizeof(rtti_file_header) == 224);
+	static_assert(sizeof(rtti_file_type) == 24);
+	static_assert(sizeof(rtti_file_primitive) == 16);
+	static_assert(sizeof(rtti_file_reference) == 16);
+	static_assert(sizeof(rtti_file_enum) == 24);
+	static_assert(sizeof(rtti_file_enum_value) == 16);
+	static_assert(sizeof(rtti_file_class) == 76);
+	static_assert(sizeof(rtti_file_base) == 8);
+	static_assert(sizeof(rtti_file_member) == 16);
+	static_assert(sizeof(rtti_file_function) == 16);
+	static_assert(sizeof(rtti_file_base_event) == 16);
+
+	// reads an rtti.bin in place. the bytes have to be 8 byte aligned and outlive the view.
+	class rtti_file_view {
+	public:
+		// nothing if the magic, the version or any table bounds are off
+		[[nodiscard]] static auto
+		open(std::span<const uint8_t> data) -> std::optional<rtti_file_view>;
+
+		[[nodiscard]] auto
+		string(uint32_t offset) const -> std::string_view;
+
+		// the type address of an index, 0 for rtti_file_null
+		[[nodiscard]] auto
+		address_of(uint32_t type) const -> uint64_t;
+
+		// the type name of an index, "<null>" for rtti_file_null
+		[[nodiscard]] auto
+		name_of(uint32_t type) const -> std::string_view;
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+		template<typename T>
+		[[nodiscard]] auto
+		table(rtti_file_table id) const -> std::span<const T> {
+			const auto &entry = header->tables[static_cast<size_t>(id)];
+			return { reinterpret_cast<const T *>(data.data() + entry.offset), static_cast<size_t>(entry.size / sizeof(T)) };
+		}
+
+#pragma clang diagnostic pop
+
+		[[nodiscard]] auto
+		types() const -> std::span<const rtti_file_type> {
+			return table<rtti_file_type>(rtti_file_table::types);
+		}
+
+	private:
+		std::span<const uint8_t> data;
+		const rtti_file_header *header { nullptr };
+		std::string_view strings;
+	};
+
+	// walks the factory and writes the types as rtti.bin. a serial dump numbers the types breadth-first: the roots, then
+	// every other type where it is first referred to. a parallel dump numbers them by game address. neither is the
+	// depth-first order of write_rtti_json().
+	// a parallel dump only walks on several threads, the tables are filled on the calling thread.
+	void
+	write_rtti_binary(const RTTIFactory &factory, std::ostream &output, const rtti_dump_options &options = {});
+
+	// the same file written from a snapshot, addresses are the ones the types had in the game
+	void
+	write_rtti_binary(const rtti_snapshot &snapshot, std::ostream &output, const rtti_dump_options &options = {});
+
+	// rtti.bin in memory, in 8 byte words so a view can read it in place
+	struct rtti_binary_buffer {
+		std::vector<uint64_t> words;
+		size_t size { 0 }; // in bytes, the last word is padded with zeros
+
+		[[nodiscard]] auto
+		bytes() const -> std::span<const uint8_t> {
+			return { reinterpret_cast<const uint8_t *>(words.data()), size };
+		}
+	};
+
+	// the file write_rtti_binary() writes, for when it is read back right away, e.g. to index it
+	[[nodiscard]] auto
+	build_rtti_binary(const RTTIFactory &factory, const rtti_dump_options &options = {}) -> rtti_binary_buffer;
+
+	[[nodiscard]] auto
+	build_rtti_binary(const rtti_snapshot &snapshot, const rtti_dump_options &options = {}) -> rtti_binary_buffer;
+
+	// turns rtti.bin back into rtti.json, same objects as write_rtti_json() wrote for the same factory in type table order
+	void
+	write_rtti_json(const rtti_file_view &file, std::ostream &output);
+} // namespace stormbird_hook
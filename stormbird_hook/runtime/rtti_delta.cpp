@@ -0,0 +1,347 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "rtti_delta.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "hash.hpp"
+#include "rtti_names.hpp"
+#include "rtti_snapshot.hpp"
+
+namespace {
+	using namespace stormbird_hook;
+
+	auto
+	key_less(RTTIType left_kind, std::string_view left_name, RTTIType right_kind, std::string_view right_name) -> bool {
+		return left_kind != right_kind ? left_kind < right_kind : left_name < right_name;
+	}
+
+	// a name has to stay on its line in the manifest, so line breaks and the backslash are escaped
+	auto
+	escape_name(std::string_view name) -> std::string {
+		std::string text;
+		text.reserve(name.size());
+		for (auto character : name) {
+			switch (character) {
+				case '\\': text += "\\\\"; break;
+				case '\n': text += "\\n"; break;
+				case '\r': text += "\\r"; break;
+				default: text += character; break;
+			}
+		}
+
+		return text;
+	}
+
+	auto
+	unescape_name(std::string_view text) -> std::string {
+		std::string name;
+		name.reserve(text.size());
+		for (size_t index = 0; index < text.size(); ++index) {
+			if (text[index] != '\\' || index + 1 == text.size()) {
+				name += text[index];
+				continue;
+			}
+
+			switch (text[++index]) {
+				case 'n': name += '\n'; break;
+				case 'r': name += '\r'; break;
+				default: name += text[index]; break;
+			}
+		}
+
+		return name;
+	}
+
+	// a type with its key and schema, the types of one key end up next to each other once sorted
+	struct keyed_type {
+		RTTIType kind;
+		std::string_view name;
+		uint64_t schema;
+		const RTTIBase *rtti;
+	};
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// the bytes of everything a dump writes about a type except where it is, hashed in one go
+	class rtti_schema_hasher {
+	public:
+		auto
+		schema_of(const RTTIBase *rtti) -> uint64_t {
+			bytes.clear();
+			add(rtti->rtti_type);
+
+			switch (rtti->rtti_type) {
+				case RTTIType::Primitive:
+					{
+						const auto *primitive = reinterpret_cast<const RTTIPrimitive *>(rtti);
+						add(primitive->total_size);
+						add(primitive->size);
+						add(primitive->count);
+						add(primitive->unknown2);
+						add(names.name_of(rtti));
+						add(primitive->parent == rtti ? std::string_view {} : names.name_of(primitive->parent));
+						break;
+					}
+				case RTTIType::Reference:
+				case RTTIType::Container:
+					{
+						const auto *reference = reinterpret_cast<const RTTIReference *>(rtti);
+						add(names.name_of(rtti));
+						add(reference->data->unknown1);
+						add(reference->data->unknown2);
+						add(reference->data->unknown3);
+						break;
+					}
+				case RTTIType::Enum:
+				case RTTIType::Bitset:
+					{
+						const auto *enum_rtti = reinterpret_cast<const RTTIEnum *>(rtti);
+						add(enum_rtti->size);
+						add(enum_rtti->member_count);
+						add(enum_rtti->unknown1);
+						add(enum_rtti->unknown2);
+						for (auto i = 0; enum_rtti->values != nullptr && i < enum_rtti->member_count; i++) {
+							add(enum_rtti->values[i].value);
+							add(text_of(enum_rtti->values[i].name));
+						}
+						break;
+					}
+				case RTTIType::Class:
+					{
+						// the game hashes the class itself. the descendants are written with it but are not part of
+						// it, a new subclass would otherwise leave a stale list in a rebuilt dump.
+						const auto *class_rtti = reinterpret_cast<const RTTIClass *>(rtti);
+						add(class_rtti->hash);
+						add(class_rtti->size);
+						add(class_rtti->alignment);
+						add(class_rtti->flags);
+						for_each_rtti_descendant(class_rtti, siblings, [this](const RTTIClass *descendant_rtti) { add(names.name_of(reinterpret_cast<const RTTIBase *>(descendant_rtti))); });
+						break;
+					}
+				case RTTIType::Struct: break;
+			}
+
+			return hash_bytes(bytes);
+		}
+
+		auto
+		name_of(const RTTIBase *rtti) -> std::string_view {
+			return names.name_of(rtti);
+		}
+
+	private:
+		static auto
+		text_of(const char *text) -> std::string_view {
+			return text == nullptr ? std::string_view {} : std::string_view { text };
+		}
+
+		template<typename T>
+		void
+		add(T value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			const auto *data = reinterpret_cast<const uint8_t *>(&value);
+			bytes.insert(bytes.end(), data, data + sizeof(T));
+		}
+
+		// the length first, so moving a character from one string to the next changes the hash
+		void
+		add(std::string_view text) {
+			add(static_cast<uint64_t>(text.size()));
+			bytes.insert(bytes.end(), text.begin(), text.end());
+		}
+
+		rtti_name_cache names;
+		rtti_address_set siblings; // scratch for for_each_rtti_descendant()
+		std::vector<uint8_t> bytes;
+	};
+
+#pragma clang diagnostic pop
+
+	// a serial dump walks on one thread, collecting the types should too
+	auto
+	collect_types(const RTTIFactory &factory, const rtti_dump_options &options, rtti_source source) -> std::vector<const RTTIBase *> {
+		auto walk = options;
+		if (walk.mode == rtti_dump_mode::serial) {
+			walk.thread_count = 1;
+		}
+
+		return collect_rtti_types(factory, walk, source);
+	}
+
+	// every type keyed and sorted by key. the names are views into hasher, which has to outlive the result.
+	auto
+	key_types(std::span<const RTTIBase *const> types, rtti_schema_hasher &hasher) -> std::vector<keyed_type> {
+		std::vector<keyed_type> keyed;
+		keyed.reserve(types.size());
+		for (const auto *rtti : types) {
+			auto name = rtti->rtti_type == RTTIType::Struct ? std::string_view {} : hasher.name_of(rtti);
+			keyed.push_back({ rtti->rtti_type, name, hasher.schema_of(rtti), rtti });
+		}
+
+		std::stable_sort(keyed.begin(), keyed.end(), [](const keyed_type &left, const keyed_type &right) { return key_less(left.kind, left.name, right.kind, right.name); });
+		return keyed;
+	}
+
+	// calls fn with every run of types sharing a key and the schema of the run. the schemas of a run are summed, so
+	// the order the walk found them in does not matter.
+	template<typename Fn>
+	void
+	for_each_key(std::span<const keyed_type> keyed, Fn &&fn) {
+		for (size_t first = 0; first < keyed.size();) {
+			auto last = first;
+			uint64_t schema = 0;
+			for (; last < keyed.size() && keyed[last].kind == keyed[first].kind && keyed[last].name == keyed[first].name; ++last) {
+				schema += keyed[last].schema;
+			}
+
+			fn(keyed.subspan(first, last - first), schema);
+			first = last;
+		}
+	}
+
+	auto
+	build_manifest(const RTTIFactory &factory, const rtti_dump_options &options, rtti_source source) -> rtti_manifest {
+		rtti_schema_hasher hasher;
+		auto keyed = key_types(collect_types(factory, options, source), hasher);
+		std::vector<rtti_manifest_entry> entries;
+		for_each_key(keyed, [&entries](std::span<const keyed_type> run, uint64_t schema) { entries.push_back({ run.front().kind, std::string(run.front().name), schema }); });
+		return rtti_manifest(std::move(entries));
+	}
+
+	// both sides are sorted by key, so they are walked side by side in one pass
+	auto
+	diff(const RTTIFactory &factory, const rtti_manifest &base, const rtti_dump_options &options, rtti_source source) -> rtti_delta {
+		rtti_delta delta;
+		delta.source = source;
+		delta.base = base.hash();
+		rtti_schema_hasher hasher;
+		auto keyed = key_types(collect_types(factory, options, source), hasher);
+		auto base_entries = base.entries();
+		size_t next_base = 0;
+		std::vector<rtti_manifest_entry> entries;
+		for_each_key(keyed, [&](std::span<const keyed_type> run, uint64_t schema) {
+			const auto &key = run.front();
+			for (; next_base < base_entries.size() && key_less(base_entries[next_base].kind, base_entries[next_base].name, key.kind, key.name); ++next_base) {
+				delta.removed.push_back(base_entries[next_base]);
+			}
+
+			auto known = next_base < base_entries.size() && base_entries[next_base].kind == key.kind && base_entries[next_base].name == key.name;
+			if (!known || base_entries[next_base].schema != schema) {
+				for (const auto &type : run) {
+					delta.types.push_back(type.rtti);
+				}
+
+				if (known) {
+					delta.changed++;
+				} else {
+					delta.added++;
+				}
+			}
+
+			if (known) {
+				++next_base;
+			}
+
+			entries.push_back({ key.kind, std::string(key.name), schema });
+		});
+
+		delta.removed.insert(delta.removed.end(), base_entries.begin() + static_cast<std::ptrdiff_t>(next_base), base_entries.end());
+		std::sort(delta.types.begin(), delta.types.end(), [source](const RTTIBase *left, const RTTIBase *right) { return rtti_address(left, source) < rtti_address(right, source); });
+		delta.manifest = rtti_manifest(std::move(entries));
+		return delta;
+	}
+} // namespace
+
+namespace stormbird_hook {
+	rtti_manifest::rtti_manifest(std::vector<rtti_manifest_entry> entries) : sorted(std::move(entries)) {
+		std::stable_sort(sorted.begin(), sorted.end(), [](const rtti_manifest_entry &left, const rtti_manifest_entry &right) { return key_less(left.kind, left.name, right.kind, right.name); });
+	}
+
+	// format:
+	//   <kind> <schema> <name>
+	// kind is decimal, schema hex, and the name runs to the end of the line since it may be empty or hold spaces.
+	auto
+	rtti_manifest::load(const std::filesystem::path &path) -> std::optional<rtti_manifest> {
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) {
+			return std::nullopt;
+		}
+
+		std::vector<rtti_manifest_entry> entries;
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.empty() || line[0] == '#') {
+				continue;
+			}
+
+			std::istringstream stream(line);
+			uint32_t kind = 0;
+			uint64_t schema = 0;
+			stream >> kind >> std::hex >> schema;
+			if (stream.fail() || kind > static_cast<uint32_t>(RTTIType::Struct) || stream.get() != ' ') {
+				return std::nullopt;
+			}
+
+			std::string name;
+			std::getline(stream, name);
+			entries.push_back({ static_cast<RTTIType>(kind), unescape_name(name), schema });
+		}
+
+		return rtti_manifest(std::move(entries));
+	}
+
+	auto
+	rtti_manifest::save(const std::filesystem::path &path) const -> bool {
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+
+		file << "# stormbird rtti manifest, the base of the next incremental dump\n";
+		for (const auto &entry : sorted) {
+			file << std::dec << static_cast<uint32_t>(entry.kind) << " " << std::hex << entry.schema << " " << escape_name(entry.name) << "\n";
+		}
+
+		return static_cast<bool>(file);
+	}
+
+	auto
+	rtti_manifest::hash() const -> uint64_t {
+		uint64_t hash = sorted.size();
+		for (const auto &entry : sorted) {
+			auto name = std::span(reinterpret_cast<const uint8_t *>(entry.name.data()), entry.name.size());
+			hash = hash_bytes(name, hash ^ (entry.schema + static_cast<uint64_t>(entry.kind)));
+		}
+
+		return hash;
+	}
+
+	auto
+	build_rtti_manifest(const RTTIFactory &factory, const rtti_dump_options &options) -> rtti_manifest {
+		return build_manifest(factory, options, rtti_source::game);
+	}
+
+	auto
+	build_rtti_manifest(const rtti_snapshot &snapshot, const rtti_dump_options &options) -> rtti_manifest {
+		return build_manifest(snapshot.factory(), options, rtti_source::snapshot);
+	}
+
+	auto
+	diff_rtti(const RTTIFactory &factory, const rtti_manifest &base, const rtti_dump_options &options) -> rtti_delta {
+		return diff(factory, base, options, rtti_source::game);
+	}
+
+	auto
+	diff_rtti(const rtti_snapshot &snapshot, const rtti_manifest &base, const rtti_dump_options &options) -> rtti_delta {
+		return diff(snapshot.factory(), base, options, rtti_source::snapshot);
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,87 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "rtti.hpp"
+#include "rtti_walk.hpp"
+
+// incremental dumps. a manifest lists every type of a dump by kind and name, the key, with a hash of its schema. a
+// delta against a manifest holds only the types whose key is new or whose schema changed, and the keys that are gone,
+// so writing one costs a hash per type and serializing just the difference. types sharing a key travel together.
+// the schema leaves out where a type is, its addresses and type ids. those move with every build, so a delta does not
+// write them and a dump rebuilt from deltas drops them. stormbird_rtti_merge does the rebuilding.
+
+namespace stormbird_hook {
+	class rtti_snapshot;
+
+	struct rtti_manifest_entry {
+		RTTIType kind { RTTIType::Primitive };
+		std::string name; // get_rtti_name(), empty for structs
+		uint64_t schema { 0 };
+	};
+
+	class rtti_manifest {
+	public:
+		rtti_manifest() = default;
+
+		explicit rtti_manifest(std::vector<rtti_manifest_entry> entries);
+
+		// nothing if the file is missing or is not a manifest
+		[[nodiscard]] static auto
+		load(const std::filesystem::path &path) -> std::optional<rtti_manifest>;
+
+		auto
+		save(const std::filesystem::path &path) const -> bool;
+
+		// sorted by kind, then by name
+		[[nodiscard]] auto
+		entries() const -> std::span<const rtti_manifest_entry> {
+			return sorted;
+		}
+
+		// of every key and schema, two dumps of the same schema hash the same
+		[[nodiscard]] auto
+		hash() const -> uint64_t;
+
+	private:
+		std::vector<rtti_manifest_entry> sorted;
+	};
+
+	struct rtti_delta {
+		rtti_source source { rtti_source::game };
+		uint64_t base { 0 }; // rtti_manifest::hash() of the manifest it was taken against
+		rtti_manifest manifest; // of everything dumped, the base for the next delta
+		std::vector<const RTTIBase *> types; // every type of an added or changed key, sorted by address
+		std::vector<rtti_manifest_entry> removed; // keys of the base that are gone
+		size_t added { 0 }; // keys
+		size_t changed { 0 }; // keys
+
+		[[nodiscard]] auto
+		empty() const -> bool {
+			return types.empty() && removed.empty();
+		}
+	};
+
+	// the manifest of a full dump of the factory
+	[[nodiscard]] auto
+	build_rtti_manifest(const RTTIFactory &factory, const rtti_dump_options &options = {}) -> rtti_manifest;
+
+	[[nodiscard]] auto
+	build_rtti_manifest(const rtti_snapshot &snapshot, const rtti_dump_options &options = {}) -> rtti_manifest;
+
+	// the types that differ from base. the types point into the factory, write the delta before it goes away.
+	[[nodiscard]] auto
+	diff_rtti(const RTTIFactory &factory, const rtti_manifest &base, const rtti_dump_options &options = {}) -> rtti_delta;
+
+	[[nodiscard]] auto
+	diff_rtti(const rtti_snapshot &snapshot, const rtti_manifest &base, const rtti_dump_options &options = {}) -> rtti_delta;
+} // namespace stormbird_hook
@@ -0,0 +1,395 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "rtti_dump.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "json_writer.hpp"
+#include "rtti_delta.hpp"
+#include "rtti_snapshot.hpp"
+#include "rtti_walk.hpp"
+
+namespace {
+	using namespace stormbird_hook;
+
+	constexpr size_t json_slice_types = 1024; // types in each slice of a parallel dump
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// types are written one at a time, a type after the types it refers to
+	class rtti_json_dumper {
+	public:
+		rtti_json_dumper(std::ostream &output, rtti_source source) : writer(output), source(source) { }
+
+		void
+		dump(const RTTIFactory &factory) {
+			writer.begin_array();
+			for_each_rtti_root(factory, [this](const RTTIBase *rtti) { visit(rtti); });
+			writer.end_array();
+			writer.flush();
+		}
+
+		// just these types, in this order, without following them anywhere
+		void
+		dump(std::span<const RTTIBase *const> types) {
+			writer.begin_array();
+			for (const auto *rtti : types) {
+				write(rtti);
+			}
+			writer.end_array();
+			writer.flush();
+		}
+
+		void
+		dump(const rtti_delta &delta) {
+			locations = false;
+			writer.begin_object();
+			writer.field("base", delta.base);
+			writer.field("schema", delta.manifest.hash());
+
+			writer.key("removed");
+			writer.begin_array();
+			for (const auto &entry : delta.removed) {
+				writer.begin_object();
+				writer.field("type", static_cast<uint8_t>(entry.kind));
+				writer.field("name", std::string_view { entry.name });
+				writer.end_object();
+			}
+			writer.end_array();
+
+			writer.key("types");
+			writer.begin_array();
+			for (const auto *rtti : delta.types) {
+				write(rtti);
+			}
+			writer.end_array();
+
+			writer.end_object();
+			writer.flush();
+		}
+
+	private:
+		// where a type is. a delta leaves it out, it changes with every build
+		void
+		address_field(std::string_view name, const void *type) {
+			if (locations) {
+				writer.field(name, rtti_address(type, source));
+			}
+		}
+
+		// writes rtti and everything it leads to that has not been written yet
+		void
+		visit(const RTTIBase *rtti) {
+			walk.walk(rtti, [this](const RTTIBase *next) { write(next); });
+		}
+
+		void
+		write(const RTTIBase *rtti) {
+			writer.begin_object();
+			if (locations) {
+				writer.field("type_id", rtti->type_id);
+				writer.field("category_type_id", rtti->category_type_id);
+			}
+			writer.field("type", static_cast<uint8_t>(rtti->rtti_type));
+			address_field("addr", rtti);
+
+			switch (rtti->rtti_type) {
+				case RTTIType::Primitive:
+					{
+						write_primitive(reinterpret_cast<const RTTIPrimitive *>(rtti));
+						break;
+					}
+				case RTTIType::Reference:
+				case RTTIType::Container:
+					{
+						write_reference(reinterpret_cast<const RTTIReference *>(rtti));
+						break;
+					}
+				case RTTIType::Enum:
+				case RTTIType::Bitset:
+					{
+						write_enum(reinterpret_cast<const RTTIEnum *>(rtti));
+						break;
+					}
+				case RTTIType::Class:
+					{
+						write_class(reinterpret_cast<const RTTIClass *>(rtti));
+						break;
+					}
+				case RTTIType::Struct: break;
+			}
+
+			writer.end_object();
+		}
+
+		void
+		write_primitive(const RTTIPrimitive *primitive) {
+			writer.field("total_size", primitive->total_size);
+			writer.field("size", primitive->size);
+			writer.field("count", primitive->count);
+			writer.field("unknown2", primitive->unknown2);
+			writer.field("name", primitive->name);
+			if (primitive->parent != reinterpret_cast<const RTTIBase *>(primitive)) {
+				address_field("parent_addr", primitive->parent);
+				writer.field("parent", names.name_of(primitive->parent));
+			}
+		}
+
+		void
+		write_reference(const RTTIReference *reference) {
+			writer.field("name", names.name_of(reinterpret_cast<const RTTIBase *>(reference)));
+			writer.field("container_name", reference->data->name);
+			writer.field("type_name", names.name_of(reference->type));
+			address_field("type_addr", reference->type);
+			writer.field("unknown1", reference->data->unknown1);
+			writer.field("unknown2", reference->data->unknown2);
+			writer.field("unknown3", reference->data->unknown3);
+		}
+
+		void
+		write_enum(const RTTIEnum *enum_rtti) {
+			writer.field("name", enum_rtti->name);
+			writer.field("size", enum_rtti->size);
+			writer.field("member_count", enum_rtti->member_count);
+			writer.field("unknown1", enum_rtti->unknown1);
+			writer.field("unknown2", enum_rtti->unknown2);
+
+			writer.key("values");
+			writer.begin_array();
+			for (auto i = 0; enum_rtti->values != nullptr && i < enum_rtti->member_count; i++) {
+				const auto &enum_value = enum_rtti->values[i];
+				writer.begin_object();
+				writer.field("value", enum_value.value);
+				writer.field("name", enum_value.name);
+				writer.end_object();
+			}
+			writer.end_array();
+		}
+
+		void
+		write_class(const RTTIClass *class_rtti) {
+			writer.field("name", class_rtti->name);
+			writer.field("base_count", class_rtti->base_count);
+			writer.field("member_count", class_rtti->member_count);
+			writer.field("function_count", class_rtti->function_count);
+			writer.field("event_count", class_rtti->event_count);
+			writer.field("base_event_count", class_rtti->base_event_count);
+			writer.field("unknown1", class_rtti->unknown1);
+			writer.field("unknown2", class_rtti->unknown2);
+			writer.field("unknown3", class_rtti->unknown3);
+			writer.field("unknown4", class_rtti->unknown4);
+			writer.field("hash", class_rtti->hash);
+			writer.field("unknown5", class_rtti->unknown5);
+			writer.field("size", class_rtti->size);
+			writer.field("alignment", class_rtti->alignment);
+			writer.field("flags", class_rtti->flags);
+
+			if (class_rtti->first_child != nullptr) {
+				writer.key("descendants");
+				writer.begin_array();
+				for_each_rtti_descendant(class_rtti, siblings, [this](const RTTIClass *descendant_rtti) {
+					writer.begin_object();
+					writer.field("name", names.name_of(reinterpret_cast<const RTTIBase *>(descendant_rtti)));
+					address_field("addr", descendant_rtti);
+					writer.end_object();
+				});
+				writer.end_array();
+			}
+
+			if (class_rtti->bases != nullptr && class_rtti->base_count > 0) {
+				writer.key("bases");
+				writer.begin_array();
+				for (auto i = 0; i < class_rtti->base_count; i++) {
+					const auto &base = class_rtti->bases[i];
+					writer.begin_object();
+					writer.field("name", names.name_of(reinterpret_cast<const RTTIBase *>(base.type)));
+					address_field("addr", base.type);
+					writer.field("offset", base.offset);
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti->members != nullptr && class_rtti->member_count > 0) {
+				writer.key("members");
+				writer.begin_array();
+				for (auto i = 0; i < class_rtti->member_count; i++) {
+					const auto &member = class_rtti->members[i];
+					writer.begin_object();
+					writer.field("type_name", names.name_of(member.type));
+					address_field("type_addr", member.type);
+					writer.field("name", member.name);
+					writer.field("offset", member.offset);
+					writer.field("flags", member.flags);
+					writer.field("unknown", member.unknown);
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti->functions != nullptr && class_rtti->function_count > 0) {
+				writer.key("functions");
+				writer.begin_array();
+				for (auto i = 0; i < class_rtti->function_count; i++) {
+					const auto &function = class_rtti->functions[i];
+					writer.begin_object();
+					writer.field("type", function.return_type);
+					writer.field("name", function.name);
+					writer.field("args", function.args);
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti->events != nullptr && class_rtti->event_count > 0) {
+				writer.key("events");
+				writer.begin_array();
+				for (auto i = 0; i < class_rtti->event_count; i++) {
+					const auto &event = class_rtti->events[i];
+					writer.begin_object();
+					writer.field("name", names.name_of(event.type));
+					address_field("addr", event.type);
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+
+			if (class_rtti->base_events != nullptr && class_rtti->base_event_count > 0) {
+				writer.key("base_events");
+				writer.begin_array();
+				for (auto i = 0; i < class_rtti->base_event_count; i++) {
+					const auto &base_event = class_rtti->base_events[i];
+					writer.begin_object();
+					writer.field("unknown1", base_event.unknown1);
+					writer.field("name", names.name_of(base_event.type));
+					address_field("addr", base_event.type);
+					writer.field("type_name", names.name_of(base_event.base_class));
+					address_field("type_addr", base_event.base_class);
+					writer.end_object();
+				}
+				writer.end_array();
+			}
+		}
+
+		json_writer writer;
+		rtti_source source;
+		bool locations { true }; // addresses and type ids
+		rtti_name_cache names;
+		rtti_post_order_walk walk;
+		rtti_address_set siblings; // scratch for for_each_rtti_descendant()
+	};
+
+#pragma clang diagnostic pop
+
+	void
+	write_json(const RTTIFactory &factory, rtti_source source, std::ostream &output, const rtti_dump_options &options) {
+		if (options.mode == rtti_dump_mode::serial) {
+			rtti_json_dumper dumper(output, source);
+			dumper.dump(factory);
+			return;
+		}
+
+		// the sorted types are cut into slices that the threads write to arrays of their own. a finished slice is spliced
+		// into output as soon as every slice before it is, and a thread only starts a slice while fewer than
+		// max_waiting_slices are ahead of the next one to go out, so only those few are held in memory at once.
+		auto types = collect_rtti_types(factory, options, source);
+		auto thread_count = rtti_thread_count(options);
+		auto slice_count = std::max<size_t>((types.size() + json_slice_types - 1) / json_slice_types, 1);
+		auto max_waiting_slices = static_cast<size_t>(thread_count) * 2;
+		std::vector<std::string> slices(slice_count);
+		std::vector<bool> finished(slice_count);
+		size_t next_slice = 0;
+		size_t written = 0; // slices spliced into output so far
+		auto separate = false;
+		std::mutex lock;
+		std::condition_variable slice_written;
+
+		output.put('[');
+		auto worker = [&]() {
+			std::unique_lock guard(lock);
+			while (true) {
+				slice_written.wait(guard, [&]() { return next_slice >= slice_count || next_slice < written + max_waiting_slices; });
+				if (next_slice >= slice_count) {
+					return;
+				}
+
+				auto index = next_slice++;
+				guard.unlock();
+
+				auto first = index * json_slice_types;
+				auto count = std::min(json_slice_types, types.size() - first);
+				std::ostringstream slice;
+				{
+					rtti_json_dumper dumper(slice, source);
+					dumper.dump(std::span<const RTTIBase *const>(types).subspan(first, count));
+				}
+
+				guard.lock();
+				slices[index] = std::move(slice).str();
+				finished[index] = true;
+				if (index != written) {
+					continue;
+				}
+
+				for (; written < slice_count && finished[written]; ++written) {
+					auto elements = std::string_view(slices[written]).substr(1, slices[written].size() - 2);
+					if (!elements.empty()) {
+						if (separate) {
+							output.put(',');
+						}
+
+						output.write(elements.data(), static_cast<std::streamsize>(elements.size()));
+						separate = true;
+					}
+
+					slices[written] = std::string();
+				}
+
+				slice_written.notify_all();
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (uint32_t index = 1; index < std::min<size_t>(thread_count, slice_count); ++index) {
+			workers.emplace_back(worker);
+		}
+
+		worker();
+
+		for (auto &thread : workers) {
+			thread.join();
+		}
+
+		output.put(']');
+		output.flush();
+	}
+} // namespace
+
+namespace stormbird_hook {
+	void
+	write_rtti_json(const RTTIFactory &factory, std::ostream &output, const rtti_dump_options &options) {
+		write_json(factory, rtti_source::game, output, options);
+	}
+
+	void
+	write_rtti_json(const rtti_snapshot &snapshot, std::ostream &output, const rtti_dump_options &options) {
+		write_json(snapshot.factory(), rtti_source::snapshot, output, options);
+	}
+
+	void
+	write_rtti_json(const rtti_delta &delta, std::ostream &output) {
+		rtti_json_dumper dumper(output, delta.source);
+		dumper.dump(delta);
+	}
+} // namespace stormbird_hook
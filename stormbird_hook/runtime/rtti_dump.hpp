@@ -0,0 +1,34 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <ostream>
+
+#include "rtti.hpp"
+#include "rtti_names.hpp"
+#include "rtti_walk.hpp"
+
+// the rtti.json dump: one flat array with an object for every type reachable from the factory's tables.
+// a serial dump streams types out depth-first, each after the types it refers to, and only holds on to the visited
+// addresses and the type names.
+// a parallel dump writes the same objects sorted by address. it writes them in slices and holds at most a couple of
+// finished slices per thread in memory while an earlier one is still being written.
+
+namespace stormbird_hook {
+	class rtti_snapshot;
+	struct rtti_delta;
+
+	void
+	write_rtti_json(const RTTIFactory &factory, std::ostream &output, const rtti_dump_options &options = {});
+
+	// the same file written from a snapshot, addresses are the ones the types had in the game
+	void
+	write_rtti_json(const rtti_snapshot &snapshot, std::ostream &output, const rtti_dump_options &options = {});
+
+	// an incremental dump, see rtti_delta.hpp. an object with the base and schema manifest hashes, the removed keys
+	// as type and name, and the types written as in rtti.json without their addresses and type ids.
+	void
+	write_rtti_json(const rtti_delta &delta, std::ostream &output);
+} // namespace stormbird_hook
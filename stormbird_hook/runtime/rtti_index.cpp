@@ -0,0 +1,318 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "rtti_index.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+	using namespace stormbird_hook;
+
+	constexpr size_t table_alignment = 8;
+
+	// size of one record of every table, for the bounds checks
+	constexpr std::array<size_t, static_cast<size_t>(rtti_index_table::count)> record_sizes = {
+		sizeof(char),
+		sizeof(rtti_index_type),
+		sizeof(uint32_t),
+		sizeof(rtti_index_class),
+		sizeof(rtti_index_member),
+		sizeof(rtti_index_edge),
+		sizeof(rtti_index_edge),
+	};
+
+	template<typename T>
+	auto
+	file_records(const rtti_file_view &file, rtti_file_table id, rtti_file_range range) -> std::span<const T> {
+		auto table = file.table<T>(id);
+		if (range.first > table.size() || table.size() - range.first < range.count) {
+			return {};
+		}
+
+		return table.subspan(range.first, range.count);
+	}
+
+	auto
+	edge_less(const rtti_index_edge &left, const rtti_index_edge &right) -> bool {
+		return left.type != right.type ? left.type < right.type : left.offset < right.offset;
+	}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	class rtti_index_builder {
+	public:
+		explicit rtti_index_builder(const rtti_file_view &file) : file(file) { }
+
+		void
+		build() {
+			auto file_types = file.types();
+			auto file_classes = file.table<rtti_file_class>(rtti_file_table::classes);
+			types.resize(file_types.size());
+			std::vector<const rtti_file_class *> sources;
+			for (uint32_t index = 0; index < file_types.size(); ++index) {
+				const auto &type = file_types[index];
+				types[index] = { .address = type.address, .name = type.name, .kind = type.kind };
+				if (type.kind == RTTIType::Class && type.detail < file_classes.size()) {
+					types[index].class_index = static_cast<uint32_t>(classes.size());
+					classes.push_back({ .type = index });
+					sources.push_back(&file_classes[type.detail]);
+				}
+
+				if (!file.string(type.name).empty()) {
+					names.push_back(index);
+				}
+			}
+
+			std::stable_sort(names.begin(), names.end(), [this](uint32_t left, uint32_t right) { return file.name_of(left) < file.name_of(right); });
+
+			// the edges of a class come from its own bases and from the descendants the game chains to it
+			std::vector<std::vector<rtti_index_edge>> subclasses(classes.size());
+			for (size_t index = 0; index < classes.size(); ++index) {
+				for (const auto &base : file_records<rtti_file_base>(file, rtti_file_table::bases, sources[index]->bases)) {
+					if (auto base_class = class_index_of(base.type); base_class != rtti_file_null) {
+						subclasses[base_class].push_back({ classes[index].type, base.offset });
+					}
+				}
+
+				for (auto descendant : file_records<rtti_file_type_ref>(file, rtti_file_table::descendants, sources[index]->descendants)) {
+					if (class_index_of(descendant) != rtti_file_null) {
+						subclasses[index].push_back({ descendant, rtti_index_no_offset });
+					}
+				}
+			}
+
+			for (size_t index = 0; index < classes.size(); ++index) {
+				fill_class(classes[index], *sources[index], subclasses[index]);
+			}
+		}
+
+		void
+		write(std::ostream &output) const {
+			rtti_index_header header;
+			std::vector<std::span<const uint8_t>> tables(static_cast<size_t>(rtti_index_table::count));
+			auto pool = file.table<char>(rtti_file_table::strings);
+			tables[static_cast<size_t>(rtti_index_table::strings)] = { reinterpret_cast<const uint8_t *>(pool.data()), pool.size() };
+			tables[static_cast<size_t>(rtti_index_table::types)] = table_bytes(types);
+			tables[static_cast<size_t>(rtti_index_table::names)] = table_bytes(names);
+			tables[static_cast<size_t>(rtti_index_table::classes)] = table_bytes(classes);
+			tables[static_cast<size_t>(rtti_index_table::members)] = table_bytes(members);
+			tables[static_cast<size_t>(rtti_index_table::bases)] = table_bytes(bases);
+			tables[static_cast<size_t>(rtti_index_table::derived)] = table_bytes(derived);
+
+			uint64_t offset = sizeof(header);
+			for (size_t id = 0; id < tables.size(); ++id) {
+				offset = (offset + table_alignment - 1) & ~(table_alignment - 1);
+				header.tables[id] = { offset, tables[id].size() };
+				offset += tables[id].size();
+			}
+
+			output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			uint64_t written = sizeof(header);
+			for (size_t id = 0; id < tables.size(); ++id) {
+				constexpr std::array<char, table_alignment> zeros {};
+				output.write(zeros.data(), static_cast<std::streamsize>(header.tables[id].offset - written));
+				output.write(reinterpret_cast<const char *>(tables[id].data()), static_cast<std::streamsize>(tables[id].size()));
+				written = header.tables[id].offset + tables[id].size();
+			}
+
+			output.flush();
+		}
+
+	private:
+		template<typename T>
+		static auto
+		table_bytes(const std::vector<T> &table) -> std::span<const uint8_t> {
+			return { reinterpret_cast<const uint8_t *>(table.data()), table.size() * sizeof(T) };
+		}
+
+		auto
+		range_from(size_t first, size_t last) -> rtti_file_range {
+			return { static_cast<uint32_t>(first), static_cast<uint32_t>(last - first) };
+		}
+
+		[[nodiscard]] auto
+		class_index_of(uint32_t type) const -> uint32_t {
+			return type < types.size() ? types[type].class_index : rtti_file_null;
+		}
+
+		void
+		fill_class(rtti_index_class &result, const rtti_file_class &source, std::vector<rtti_index_edge> &subclasses) {
+			result.size = source.size;
+			result.hash = source.hash;
+			result.alignment = source.alignment;
+			result.flags = source.flags;
+
+			auto first = members.size();
+			uint16_t position = 0;
+			for (const auto &member : file_records<rtti_file_member>(file, rtti_file_table::members, source.members)) {
+				members.push_back({ .name = member.name, .type = member.type, .offset = member.offset, .flags = member.flags, .position = position++ });
+			}
+			std::stable_sort(members.begin() + static_cast<std::ptrdiff_t>(first), members.end(), [this](const rtti_index_member &left, const rtti_index_member &right) { return file.string(left.name) < file.string(right.name); });
+			result.members = range_from(first, members.size());
+
+			first = bases.size();
+			for (const auto &base : file_records<rtti_file_base>(file, rtti_file_table::bases, source.bases)) {
+				bases.push_back({ base.type, base.offset });
+			}
+			result.bases = range_from(first, bases.size());
+
+			// a subclass both chained and listing this class as a base keeps only the edge with the offset
+			std::sort(subclasses.begin(), subclasses.end(), edge_less);
+			first = derived.size();
+			for (const auto &edge : subclasses) {
+				auto known = derived.size() > first && derived.back().type == edge.type;
+				if (!known || (edge.offset != rtti_index_no_offset && edge.offset != derived.back().offset)) {
+					derived.push_back(edge);
+				}
+			}
+			result.derived = range_from(first, derived.size());
+		}
+
+		const rtti_file_view &file;
+		std::vector<rtti_index_type> types;
+		std::vector<uint32_t> names;
+		std::vector<rtti_index_class> classes;
+		std::vector<rtti_index_member> members;
+		std::vector<rtti_index_edge> bases;
+		std::vector<rtti_index_edge> derived;
+	};
+
+#pragma clang diagnostic pop
+} // namespace
+
+namespace stormbird_hook {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	auto
+	rtti_index_view::open(std::span<const uint8_t> data) -> std::optional<rtti_index_view> {
+		if (data.size() < sizeof(rtti_index_header) || reinterpret_cast<uintptr_t>(data.data()) % table_alignment != 0) {
+			return std::nullopt;
+		}
+
+		rtti_index_view view;
+		view.data = data;
+		view.header = reinterpret_cast<const rtti_index_header *>(data.data());
+		if (view.header->magic != rtti_index_magic || view.header->version != rtti_index_version || view.header->table_count != static_cast<uint32_t>(rtti_index_table::count)) {
+			return std::nullopt;
+		}
+
+		for (size_t id = 0; id < record_sizes.size(); ++id) {
+			const auto &entry = view.header->tables[id];
+			if (entry.offset % table_alignment != 0 || entry.offset > data.size() || data.size() - entry.offset < entry.size || entry.size % record_sizes[id] != 0) {
+				return std::nullopt;
+			}
+		}
+
+		// every string has to be terminated, so the last byte of the pool is a nul
+		auto strings = view.table<char>(rtti_index_table::strings);
+		if (strings.empty() || strings.back() != '\0') {
+			return std::nullopt;
+		}
+
+		view.strings = { strings.data(), strings.size() };
+		return view;
+	}
+
+	auto
+	rtti_index_view::string(uint32_t offset) const -> std::string_view {
+		if (offset >= strings.size()) {
+			return {};
+		}
+
+		return { strings.data() + offset };
+	}
+
+	auto
+	rtti_index_view::name_of(uint32_t type) const -> std::string_view {
+		auto all = types();
+		return type < all.size() ? string(all[type].name) : "<null>";
+	}
+
+	auto
+	rtti_index_view::find(std::string_view name) const -> std::span<const uint32_t> {
+		auto names = table<uint32_t>(rtti_index_table::names);
+		auto first = std::lower_bound(names.begin(), names.end(), name, [this](uint32_t left, std::string_view right) { return name_of(left) < right; });
+		auto last = std::upper_bound(first, names.end(), name, [this](std::string_view left, uint32_t right) { return left < name_of(right); });
+		return { first, last };
+	}
+
+	auto
+	rtti_index_view::find_class(std::string_view name) const -> const rtti_index_class * {
+		for (auto type : find(name)) {
+			if (const auto *class_index = class_of(type); class_index != nullptr) {
+				return class_index;
+			}
+		}
+
+		return nullptr;
+	}
+
+	auto
+	rtti_index_view::class_of(uint32_t type) const -> const rtti_index_class * {
+		auto all = types();
+		auto classes = table<rtti_index_class>(rtti_index_table::classes);
+		if (type >= all.size() || all[type].class_index >= classes.size()) {
+			return nullptr;
+		}
+
+		return &classes[all[type].class_index];
+	}
+
+	auto
+	rtti_index_view::find_member(const rtti_index_class &class_index, std::string_view name) const -> const rtti_index_member * {
+		auto all = members(class_index);
+		auto member = std::lower_bound(all.begin(), all.end(), name, [this](const rtti_index_member &left, std::string_view right) { return string(left.name) < right; });
+		if (member == all.end() || string(member->name) != name) {
+			return nullptr;
+		}
+
+		return &*member;
+	}
+
+	auto
+	rtti_index_view::resolve_member(const rtti_index_class &class_index, std::string_view name) const -> std::optional<rtti_index_field> {
+		// breadth first, so a member hides the ones of the same name further up
+		std::vector<bool> seen(table<rtti_index_class>(rtti_index_table::classes).size());
+		std::vector<std::pair<const rtti_index_class *, uint32_t>> queue { { &class_index, 0 } };
+		seen[position_of(&class_index)] = true;
+		for (size_t next = 0; next < queue.size(); ++next) {
+			auto [current, offset] = queue[next];
+			if (const auto *member = find_member(*current, name); member != nullptr) {
+				return rtti_index_field { member, current->type, offset + member->offset };
+			}
+
+			for (const auto &base : bases(*current)) {
+				const auto *base_class = class_of(base.type);
+				if (base_class == nullptr || base.offset == rtti_index_no_offset || seen[position_of(base_class)]) {
+					continue;
+				}
+
+				seen[position_of(base_class)] = true;
+				queue.emplace_back(base_class, offset + base.offset);
+			}
+		}
+
+		return std::nullopt;
+	}
+
+	void
+	write_rtti_index(const rtti_file_view &file, std::ostream &output) {
+		rtti_index_builder builder(file);
+		builder.build();
+		builder.write(output);
+	}
+
+	void
+	write_rtti_index(const rtti_snapshot &snapshot, std::ostream &output, const rtti_dump_options &options) {
+		auto binary = build_rtti_binary(snapshot, options);
+		if (auto file = rtti_file_view::open(binary.bytes()); file) {
+			write_rtti_index(*file, output);
+		}
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
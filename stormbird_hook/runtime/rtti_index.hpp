@@ -0,0 +1,215 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "rtti_binary.hpp"
+
+// rtti.idx, what tools look up in a dump without parsing it: type names sorted for binary search, the members of
+// every class sorted by name, and the inheritance edges of every class in both directions. laid out like rtti.bin,
+// 8 byte aligned tables read in place, and built from it. type indices and string offsets are the ones of the rtti.bin
+// it was built from, so a lookup can go on in that file for whatever the index leaves out.
+
+namespace stormbird_hook {
+	class rtti_snapshot;
+
+	constexpr std::array<char, 8> rtti_index_magic = { 'S', 'B', 'R', 'I', 'D', 'X', '\0', '\0' };
+	constexpr uint32_t rtti_index_version = 1;
+
+	// an edge to a class that does not list the other class as a base has no offset
+	constexpr uint32_t rtti_index_no_offset = 0xFFFFFFFF;
+
+	enum class rtti_index_table : uint32_t {
+		strings, // the string pool of rtti.bin
+		types,
+		names, // type indices sorted by name, unnamed types are left out
+		classes,
+		members, // sorted by name within every class
+		bases,
+		derived,
+		count
+	};
+
+	struct rtti_index_header {
+		std::array<char, 8> magic = rtti_index_magic;
+		uint32_t version { rtti_index_version };
+		uint32_t table_count { static_cast<uint32_t>(rtti_index_table::count) };
+		std::array<rtti_file_table_entry, static_cast<size_t>(rtti_index_table::count)> tables {};
+	};
+
+	struct rtti_index_type {
+		uint64_t address { 0 };
+		uint32_t name { 0 };
+		uint32_t class_index { rtti_file_null }; // into classes, nothing unless kind is a class
+		RTTIType kind { RTTIType::Primitive };
+		std::array<uint8_t, 7> padding {};
+	};
+
+	struct rtti_index_class {
+		uint32_t type { rtti_file_null };
+		uint32_t size { 0 };
+		uint32_t hash { 0 };
+		uint16_t alignment { 0 };
+		uint16_t flags { 0 };
+		rtti_file_range members {};
+		rtti_file_range bases {};
+		rtti_file_range derived {};
+	};
+
+	struct rtti_index_member {
+		uint32_t name { 0 };
+		uint32_t type { rtti_file_null };
+		uint16_t offset { 0 };
+		uint16_t flags { 0 };
+		uint16_t position { 0 }; // in the class, the members are in offset order before sorting by name
+		uint16_t padding { 0 };
+	};
+
+	// a base: the base class and where it sits in this class. derived: the class and where this class sits in it.
+	struct rtti_index_edge {
+		uint32_t type { rtti_file_null };
+		uint32_t offset { rtti_index_no_offset };
+	};
+
+	// the records are the file layout, they must not change size without a version bump
+	static_assert(sizeof(rtti_index_header) == 128);
+	static_assert(sizeof(rtti_index_type) == 24);
+	static_assert(sizeof(rtti_index_class) == 40);
+	static_assert(sizeof(rtti_index_member) == 16);
+	static_assert(sizeof(rtti_index_edge) == 8);
+
+	// a member found through resolve_member(), with its offset from the start of the class it was looked up in
+	struct rtti_index_field {
+		const rtti_index_member *member { nullptr };
+		uint32_t owner { rtti_file_null }; // the class that declares it
+		uint32_t offset { 0 };
+	};
+
+	// reads an rtti.idx in place. the bytes have to be 8 byte aligned and outlive the view.
+	class rtti_index_view {
+	public:
+		// nothing if the magic, the version or any table bounds are off
+		[[nodiscard]] static auto
+		open(std::span<const uint8_t> data) -> std::optional<rtti_index_view>;
+
+		[[nodiscard]] auto
+		string(uint32_t offset) const -> std::string_view;
+
+		// the type name of an index, "<null>" for rtti_file_null
+		[[nodiscard]] auto
+		name_of(uint32_t type) const -> std::string_view;
+
+		[[nodiscard]] auto
+		types() const -> std::span<const rtti_index_type> {
+			return table<rtti_index_type>(rtti_index_table::types);
+		}
+
+		// every type with this name, in type order. several types may share a name.
+		[[nodiscard]] auto
+		find(std::string_view name) const -> std::span<const uint32_t>;
+
+		// the first class with this name
+		[[nodiscard]] auto
+		find_class(std::string_view name) const -> const rtti_index_class *;
+
+		// the class of a type index, null unless the type is a class
+		[[nodiscard]] auto
+		class_of(uint32_t type) const -> const rtti_index_class *;
+
+		[[nodiscard]] auto
+		members(const rtti_index_class &class_index) const -> std::span<const rtti_index_member> {
+			return records<rtti_index_member>(rtti_index_table::members, class_index.members);
+		}
+
+		[[nodiscard]] auto
+		bases(const rtti_index_class &class_index) const -> std::span<const rtti_index_edge> {
+			return records<rtti_index_edge>(rtti_index_table::bases, class_index.bases);
+		}
+
+		// the classes deriving from this one directly
+		[[nodiscard]] auto
+		derived(const rtti_index_class &class_index) const -> std::span<const rtti_index_edge> {
+			return records<rtti_index_edge>(rtti_index_table::derived, class_index.derived);
+		}
+
+		// a member the class declares itself
+		[[nodiscard]] auto
+		find_member(const rtti_index_class &class_index, std::string_view name) const -> const rtti_index_member *;
+
+		// a member the class declares or inherits, the nearest one first. bases without an offset are skipped.
+		[[nodiscard]] auto
+		resolve_member(const rtti_index_class &class_index, std::string_view name) const -> std::optional<rtti_index_field>;
+
+		// every class deriving from this one, directly or not, once each and parents before children
+		template<typename Fn>
+		void
+		for_each_subclass(const rtti_index_class &class_index, Fn &&fn) const {
+			std::vector<bool> seen(table<rtti_index_class>(rtti_index_table::classes).size());
+			std::vector<const rtti_index_class *> queue { &class_index };
+			for (size_t next = 0; next < queue.size(); ++next) {
+				for (const auto &edge : derived(*queue[next])) {
+					const auto *subclass = class_of(edge.type);
+					if (subclass == nullptr || subclass == &class_index || seen[position_of(subclass)]) {
+						continue;
+					}
+
+					seen[position_of(subclass)] = true;
+					fn(*subclass);
+					queue.push_back(subclass);
+				}
+			}
+		}
+
+	private:
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+		template<typename T>
+		[[nodiscard]] auto
+		table(rtti_index_table id) const -> std::span<const T> {
+			const auto &entry = header->tables[static_cast<size_t>(id)];
+			return { reinterpret_cast<const T *>(data.data() + entry.offset), static_cast<size_t>(entry.size / sizeof(T)) };
+		}
+
+		// where a class of this view is in the class table
+		[[nodiscard]] auto
+		position_of(const rtti_index_class *class_index) const -> size_t {
+			return static_cast<size_t>(class_index - table<rtti_index_class>(rtti_index_table::classes).data());
+		}
+
+#pragma clang diagnostic pop
+
+		template<typename T>
+		[[nodiscard]] auto
+		records(rtti_index_table id, rtti_file_range range) const -> std::span<const T> {
+			auto all = table<T>(id);
+			if (range.first > all.size() || all.size() - range.first < range.count) {
+				return {};
+			}
+
+			return all.subspan(range.first, range.count);
+		}
+
+		std::span<const uint8_t> data;
+		const rtti_index_header *header { nullptr };
+		std::string_view strings;
+	};
+
+	// indexes an rtti.bin
+	void
+	write_rtti_index(const rtti_file_view &file, std::ostream &output);
+
+	// indexes the rtti.bin write_rtti_binary() would write for the snapshot with the same options. to write that file
+	// too, build_rtti_binary() it once and index the buffer.
+	void
+	write_rtti_index(const rtti_snapshot &snapshot, std::ostream &output, const rtti_dump_options &options = {});
+} // namespace stormbird_hook
@@ -0,0 +1,445 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "rtti_layout.hpp"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+	using namespace stormbird_hook;
+
+	// names from the game that would not compile as identifiers, the keywords and what the included headers define
+	constexpr std::array<std::string_view, 100> reserved_words = {
+		"alignas", "alignof", "and", "and_eq", "asm", "assert", "auto", "bitand", "bitor", "bool",
+		"break", "case", "catch", "char", "char16_t", "char32_t", "char8_t", "class", "co_await", "co_return",
+		"co_yield", "compl", "concept", "const", "const_cast", "consteval", "constexpr", "constinit", "continue", "decltype",
+		"default", "delete", "do", "double", "dynamic_cast", "else", "enum", "errno", "explicit", "export",
+		"extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+		"mutable", "namespace", "new", "noexcept", "not", "not_eq", "NULL", "nullptr", "offsetof", "operator",
+		"or", "or_eq", "private", "protected", "public", "register", "reinterpret_cast", "requires", "return", "short",
+		"signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+		"throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual",
+		"void", "volatile", "wchar_t", "while", "xor", "xor_eq", "final", "override", "import", "module",
+	};
+
+	auto
+	is_identifier_character(char character) -> bool {
+		return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') || (character >= '0' && character <= '9') || character == '_';
+	}
+
+	// a c++ identifier for a name from the game. everything else becomes an underscore, without two in a row since
+	// those are reserved, as is a leading underscore before a capital.
+	auto
+	identifier_of(std::string_view name, std::string_view fallback) -> std::string {
+		std::string result;
+		result.reserve(name.size());
+		for (auto character : name) {
+			auto next = is_identifier_character(character) ? character : '_';
+			if (next != '_' || result.empty() || result.back() != '_') {
+				result += next;
+			}
+		}
+
+		if (result.empty() || result == "_") {
+			result = fallback;
+		}
+
+		if ((result[0] >= '0' && result[0] <= '9') || (result[0] == '_' && result.size() > 1 && result[1] >= 'A' && result[1] <= 'Z')) {
+			result.insert(0, "n");
+		}
+
+		if (std::find(reserved_words.begin(), reserved_words.end(), result) != reserved_words.end()) {
+			result += '_';
+		}
+
+		return result;
+	}
+
+	// a number is appended to names that are taken
+	auto
+	unique_in(std::unordered_set<std::string> &taken, std::string name) -> std::string {
+		if (taken.insert(name).second) {
+			return name;
+		}
+
+		for (size_t suffix = 2;; ++suffix) {
+			auto candidate = name + std::to_string(suffix);
+			if (taken.insert(candidate).second) {
+				return candidate;
+			}
+		}
+	}
+
+	// a name from the game inside a // comment, which a line break or a trailing backslash would end or extend
+	auto
+	comment_of(std::string_view name) -> std::string {
+		std::string result(name);
+		for (auto &character : result) {
+			if (character == '\\' || static_cast<unsigned char>(character) < 0x20 || static_cast<unsigned char>(character) >= 0x7F) {
+				character = '?';
+			}
+		}
+
+		return result;
+	}
+
+	auto
+	hex_of(uint64_t value) -> std::string {
+		std::array<char, 16> digits {};
+		auto [end, error] = std::to_chars(digits.data(), digits.data() + digits.size(), value, 16);
+		return "0x" + std::string(digits.data(), end);
+	}
+
+	auto
+	unsigned_of(uint32_t size) -> std::string_view {
+		switch (size) {
+			case 1: return "::std::uint8_t";
+			case 2: return "::std::uint16_t";
+			case 4: return "::std::uint32_t";
+			case 8: return "::std::uint64_t";
+			default: return {};
+		}
+	}
+
+	// total_size is the size of a primitive, its size field is the alignment
+	auto
+	primitive_spelling(std::string_view name, uint32_t size) -> std::string_view {
+		if (name == "float" && size == 4) {
+			return "float";
+		}
+
+		if (name == "double" && size == 8) {
+			return "double";
+		}
+
+		if (!name.starts_with("int")) {
+			return unsigned_of(size);
+		}
+
+		switch (size) {
+			case 1: return "::std::int8_t";
+			case 2: return "::std::int16_t";
+			case 4: return "::std::int32_t";
+			case 8: return "::std::int64_t";
+			default: return {};
+		}
+	}
+
+	class rtti_layout_writer {
+	public:
+		rtti_layout_writer(const rtti_file_view &file, std::ostream &output, const rtti_layout_options &options) :
+			file(file), output(output), name_space(options.name_space), types(file.types()) { }
+
+		void
+		write() {
+			name_types();
+
+			output << "// generated by stormbird_rtti_layout from rtti.bin, generate it again instead of editing it\n"
+				   << "#pragma once\n\n"
+				   << "#include <array>\n"
+				   << "#include <cstddef>\n"
+				   << "#include <cstdint>\n\n"
+				   << "namespace " << name_space << " {\n"
+				   << "#pragma pack(push, 1)\n";
+
+			for (uint32_t type = 0; type < types.size(); ++type) {
+				if (const auto *enum_rtti = enum_of(type); enum_rtti != nullptr && !names[type].empty()) {
+					write_enum(type, *enum_rtti);
+				}
+			}
+
+			for (uint32_t type = 0; type < types.size(); ++type) {
+				if (states[type] == class_state::pending) {
+					write_class_tree(type);
+				}
+			}
+
+			output << "#pragma pack(pop)\n"
+				   << "} // namespace " << name_space << "\n";
+			output.flush();
+		}
+
+	private:
+		enum class class_state : uint8_t {
+			none, // not a class that gets a struct
+			pending,
+			open, // its dependencies are being written, it cannot be embedded yet
+			written,
+		};
+
+		struct layout_field {
+			uint32_t offset;
+			std::string_view name;
+			uint32_t type;
+			bool base;
+		};
+
+		struct class_frame {
+			uint32_t type;
+			std::vector<uint32_t> dependencies;
+			size_t next;
+		};
+
+		template<typename T>
+		auto
+		record(rtti_file_table id, uint32_t index) const -> const T * {
+			auto table = file.table<T>(id);
+			return index < table.size() ? &table[index] : nullptr;
+		}
+
+		template<typename T>
+		auto
+		records(rtti_file_table id, rtti_file_range range) const -> std::span<const T> {
+			auto table = file.table<T>(id);
+			if (range.first > table.size() || table.size() - range.first < range.count) {
+				return {};
+			}
+
+			return table.subspan(range.first, range.count);
+		}
+
+		auto
+		class_of(uint32_t type) const -> const rtti_file_class * {
+			return type < types.size() && types[type].kind == RTTIType::Class ? record<rtti_file_class>(rtti_file_table::classes, types[type].detail) : nullptr;
+		}
+
+		auto
+		enum_of(uint32_t type) const -> const rtti_file_enum * {
+			if (type >= types.size() || (types[type].kind != RTTIType::Enum && types[type].kind != RTTIType::Bitset)) {
+				return nullptr;
+			}
+
+			return record<rtti_file_enum>(rtti_file_table::enums, types[type].detail);
+		}
+
+		// classes with a size become structs, enums of a size an integer has become enums
+		void
+		name_types() {
+			names.resize(types.size());
+			states.resize(types.size(), class_state::none);
+			std::unordered_set<std::string> taken;
+			for (uint32_t type = 0; type < types.size(); ++type) {
+				const auto *class_rtti = class_of(type);
+				const auto *enum_rtti = enum_of(type);
+				if ((class_rtti == nullptr || class_rtti->size == 0) && (enum_rtti == nullptr || unsigned_of(enum_rtti->size).empty())) {
+					continue;
+				}
+
+				names[type] = unique_in(taken, identifier_of(file.string(types[type].name), "type_" + std::to_string(type)));
+				if (class_rtti != nullptr) {
+					states[type] = class_state::pending;
+				}
+			}
+		}
+
+		auto
+		qualified(uint32_t type) const -> std::string {
+			return "::" + std::string(name_space) + "::" + names[type];
+		}
+
+		// the size a member of this type takes, nothing if it is not known or its struct is not written yet
+		auto
+		size_of(uint32_t type) const -> std::optional<uint32_t> {
+			if (type >= types.size()) {
+				return std::nullopt;
+			}
+
+			if (const auto *class_rtti = class_of(type); class_rtti != nullptr) {
+				return states[type] == class_state::written ? std::optional(class_rtti->size) : std::nullopt;
+			}
+
+			if (const auto *enum_rtti = enum_of(type); enum_rtti != nullptr) {
+				return names[type].empty() ? std::nullopt : std::optional<uint32_t>(enum_rtti->size);
+			}
+
+			if (types[type].kind == RTTIType::Primitive) {
+				if (const auto *primitive = record<rtti_file_primitive>(rtti_file_table::primitives, types[type].detail); primitive != nullptr && !primitive_spelling(file.string(types[type].name), primitive->total_size).empty()) {
+					return primitive->total_size;
+				}
+			}
+
+			return std::nullopt;
+		}
+
+		auto
+		spelling(uint32_t type) const -> std::string {
+			if (types[type].kind == RTTIType::Primitive) {
+				const auto *primitive = record<rtti_file_primitive>(rtti_file_table::primitives, types[type].detail);
+				return std::string(primitive_spelling(file.string(types[type].name), primitive->total_size));
+			}
+
+			return qualified(type);
+		}
+
+		void
+		write_original_name(uint32_t type) {
+			auto name = file.string(types[type].name);
+			if (name != names[type]) {
+				output << "\t// " << comment_of(name) << "\n";
+			}
+		}
+
+		void
+		write_enum(uint32_t type, const rtti_file_enum &enum_rtti) {
+			output << "\n";
+			write_original_name(type);
+			output << "\tenum class " << names[type] << " : " << unsigned_of(enum_rtti.size) << " {\n";
+
+			// values are kept as 64 bits, a negative one has every bit above the enum's size set
+			auto mask = enum_rtti.size == 8 ? ~uint64_t { 0 } : (uint64_t { 1 } << (enum_rtti.size * 8)) - 1;
+			std::unordered_set<std::string> taken { names[type] };
+			size_t index = 0;
+			for (const auto &value : records<rtti_file_enum_value>(rtti_file_table::enum_values, enum_rtti.values)) {
+				auto name = unique_in(taken, identifier_of(file.string(value.name), "value_" + std::to_string(index++)));
+				output << "\t\t" << name << " = " << hex_of(value.value & mask) << ",\n";
+			}
+
+			output << "\t};\n";
+		}
+
+		// a struct can only embed structs written before it, so every class is written after the classes it embeds.
+		// the walk keeps its own stack, embedding chains can be as long as the dump.
+		void
+		write_class_tree(uint32_t root) {
+			std::vector<class_frame> stack;
+			stack.push_back(open(root));
+			while (!stack.empty()) {
+				auto &top = stack.back();
+				if (top.next < top.dependencies.size()) {
+					auto dependency = top.dependencies[top.next++];
+					if (states[dependency] == class_state::pending) {
+						stack.push_back(open(dependency));
+					}
+
+					continue;
+				}
+
+				write_class(top.type);
+				states[top.type] = class_state::written;
+				stack.pop_back();
+			}
+		}
+
+		auto
+		open(uint32_t type) -> class_frame {
+			states[type] = class_state::open;
+			class_frame frame { type, {}, 0 };
+			const auto &class_rtti = *class_of(type);
+			for (const auto &base : records<rtti_file_base>(rtti_file_table::bases, class_rtti.bases)) {
+				if (base.type < types.size() && states[base.type] == class_state::pending) {
+					frame.dependencies.push_back(base.type);
+				}
+			}
+
+			for (const auto &member : records<rtti_file_member>(rtti_file_table::members, class_rtti.members)) {
+				if (member.type < types.size() && states[member.type] == class_state::pending) {
+					frame.dependencies.push_back(member.type);
+				}
+			}
+
+			return frame;
+		}
+
+		void
+		write_padding(std::unordered_set<std::string> &taken, uint32_t offset, uint32_t size) {
+			output << "\t\t::std::array<::std::uint8_t, " << size << "> " << unique_in(taken, "pad_" + hex_of(offset).substr(2)) << ";\n";
+		}
+
+		void
+		write_class(uint32_t type) {
+			const auto &class_rtti = *class_of(type);
+			std::vector<layout_field> fields;
+			for (const auto &base : records<rtti_file_base>(rtti_file_table::bases, class_rtti.bases)) {
+				fields.push_back({ base.offset, {}, base.type, true });
+			}
+
+			for (const auto &member : records<rtti_file_member>(rtti_file_table::members, class_rtti.members)) {
+				fields.push_back({ member.offset, file.string(member.name), member.type, false });
+			}
+
+			// bases come first at the same offset, the first field at an offset gets it
+			std::stable_sort(fields.begin(), fields.end(), [](const layout_field &left, const layout_field &right) { return left.offset < right.offset; });
+
+			output << "\n";
+			write_original_name(type);
+			output << "\tstruct " << names[type] << " {\n"
+				   << "\t\tstatic constexpr ::std::size_t alignment = " << class_rtti.alignment << ";\n\n";
+
+			// a member named like its struct would not compile
+			std::unordered_set<std::string> taken { names[type], "alignment" };
+			std::vector<std::pair<std::string, uint32_t>> offsets;
+			uint32_t cursor = 0;
+			for (size_t index = 0; index < fields.size(); ++index) {
+				const auto &field = fields[index];
+				auto label = field.base ? "base " + std::string(file.name_of(field.type)) : std::string(field.name);
+				if (field.offset >= class_rtti.size) {
+					output << "\t\t// " << comment_of(label) << " at " << hex_of(field.offset) << " is past the end of the class\n";
+					continue;
+				}
+
+				if (field.offset < cursor) {
+					output << "\t\t// " << comment_of(label) << " at " << hex_of(field.offset) << " overlaps the member before it\n";
+					continue;
+				}
+
+				// the space up to the next field that starts after this one
+				auto next = class_rtti.size;
+				for (auto later = index + 1; later < fields.size(); ++later) {
+					if (fields[later].offset > field.offset) {
+						next = std::min(next, fields[later].offset);
+						break;
+					}
+				}
+
+				if (field.offset > cursor) {
+					write_padding(taken, cursor, field.offset - cursor);
+				}
+
+				auto fallback = "member_" + hex_of(field.offset).substr(2);
+				auto name = unique_in(taken, field.base ? "base_" + identifier_of(file.name_of(field.type), "class") : identifier_of(field.name, fallback));
+				auto size = size_of(field.type);
+				if (size && *size <= next - field.offset) {
+					output << "\t\t" << spelling(field.type) << " " << name << ";\n";
+					cursor = field.offset + *size;
+				} else {
+					output << "\t\t::std::array<::std::uint8_t, " << next - field.offset << "> " << name << "; // " << comment_of(file.name_of(field.type)) << "\n";
+					cursor = next;
+				}
+
+				offsets.emplace_back(std::move(name), field.offset);
+			}
+
+			if (cursor < class_rtti.size) {
+				write_padding(taken, cursor, class_rtti.size - cursor);
+			}
+
+			output << "\t};\n\n"
+				   << "\tstatic_assert(sizeof(" << qualified(type) << ") == " << class_rtti.size << ");\n";
+			for (const auto &[name, offset] : offsets) {
+				output << "\tstatic_assert(offsetof(" << qualified(type) << ", " << name << ") == " << offset << ");\n";
+			}
+		}
+
+		const rtti_file_view &file;
+		std::ostream &output;
+		std::string_view name_space;
+		std::span<const rtti_file_type> types;
+		std::vector<std::string> names; // the identifier of every type that gets a struct or an enum
+		std::vector<class_state> states;
+	};
+} // namespace
+
+namespace stormbird_hook {
+	void
+	write_rtti_layout(const rtti_file_view &file, std::ostream &output, const rtti_layout_options &options) {
+		rtti_layout_writer writer(file, output, options);
+		writer.write();
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,24 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <ostream>
+#include <string_view>
+
+#include "rtti_binary.hpp"
+
+// a c++ header with the layout of every class and enum in a dump, so hook code reads game objects with plain loads.
+// classes become packed structs with explicit padding, checked against the dump with static_assert. bases are
+// members named base_<class> at their offset, so every struct stays standard layout and offsetof works. a member
+// whose type has no known size, or does not fit before the next member, is a byte array of the space it has.
+
+namespace stormbird_hook {
+	struct rtti_layout_options {
+		std::string_view name_space { "game" };
+	};
+
+	void
+	write_rtti_layout(const rtti_file_view &file, std::ostream &output, const rtti_layout_options &options = {});
+} // namespace stormbird_hook
@@ -0,0 +1,102 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "rtti.hpp"
+#include "xref_index.hpp"
+
+// finds rtti records through the cross reference index instead of a hook.
+// read(address, out, size) copies memory at a virtual address, like the readers of resolve_target().
+
+namespace stormbird_hook {
+	// sanity limits for a record table that is read from memory we do not own
+	constexpr uint32_t max_rtti_records = 1u << 20;
+	constexpr uint32_t sampled_rtti_records = 8;
+
+	template<typename Reader>
+	auto
+	read_rtti_type(uint64_t address, Reader &&read) -> std::optional<RTTIType> {
+		RTTIBase base {};
+		if (!read(address, &base, sizeof(base)) || base.rtti_type > RTTIType::Struct) {
+			return std::nullopt;
+		}
+
+		return base.rtti_type;
+	}
+
+	// addresses of the class records named name, found through whatever points at the name
+	template<typename Reader>
+	auto
+	find_rtti_classes(const xref_index &index, std::string_view name, Reader &&read) -> std::vector<uint64_t> {
+		std::vector<uint64_t> results;
+		for (auto rva : index.pointers_to_string(name)) {
+			auto address = index.image_base() + rva - offsetof(RTTIClass, name);
+			if (read_rtti_type(address, read) == RTTIType::Class) {
+				results.push_back(address);
+			}
+		}
+
+		return results;
+	}
+
+	// addresses of objects that look like a populated RTTIFactory. the factory is a global that starts with a pointer
+	// to its vtable, so every pointer in the index is a candidate. a candidate needs a sane record table whose first
+	// records point at rtti inside the image, and has to list known_class if that is set.
+	// the table is filled at runtime, so this only finds something in a running game.
+	template<typename Reader>
+	auto
+	find_rtti_factories(const xref_index &index, const pe_image &image, Reader &&read, std::optional<uint64_t> known_class = std::nullopt) -> std::vector<uint64_t> {
+		std::vector<uint64_t> results;
+		std::vector<RTTIRecord> records;
+		auto is_writable = [&](uint64_t address) {
+			const auto *section = image.section_for_rva(static_cast<uint32_t>(address - index.image_base()));
+			return section != nullptr && (section->characteristics & pe_section_write) != 0;
+		};
+
+		for (const auto &pointer : index.all_pointers()) {
+			// vtables are read-only, so only pointers from writable data into read-only data are candidates
+			auto address = index.image_base() + pointer.rva;
+			if (!is_writable(address) || is_writable(pointer.target)) {
+				continue;
+			}
+
+			RTTIFactory factory {};
+			if (!read(address, &factory, sizeof(factory))) {
+				continue;
+			}
+
+			const auto &table = factory.rtti;
+			if (table.array == nullptr || table.count == 0 || table.count > table.capacity || table.capacity > max_rtti_records) {
+				continue;
+			}
+
+			auto count = known_class ? table.count : std::min(table.count, sampled_rtti_records);
+			records.resize(count);
+			if (!read(reinterpret_cast<uint64_t>(table.array), records.data(), count * sizeof(RTTIRecord))) {
+				continue;
+			}
+
+			auto sane = std::all_of(records.begin(), records.begin() + std::min(count, sampled_rtti_records), [&](const RTTIRecord &record) {
+				auto rtti = reinterpret_cast<uint64_t>(record.rtti);
+				return index.contains(rtti) && read_rtti_type(rtti, read).has_value();
+			});
+
+			auto lists_known = !known_class || std::any_of(records.begin(), records.end(), [&](const RTTIRecord &record) { return reinterpret_cast<uint64_t>(record.rtti) == *known_class; });
+			if (sane && lists_known) {
+				results.push_back(address);
+			}
+		}
+
+		std::sort(results.begin(), results.end());
+		return results;
+	}
+} // namespace stormbird_hook
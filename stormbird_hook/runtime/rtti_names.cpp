@@ -0,0 +1,134 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "rtti_names.hpp"
+
+namespace {
+	using namespace stormbird_hook;
+
+	auto
+	is_reference(const RTTIBase *rtti) -> bool {
+		return rtti != nullptr && (rtti->rtti_type == RTTIType::Reference || rtti->rtti_type == RTTIType::Container);
+	}
+
+	auto
+	text_of(const char *text) -> std::string_view {
+		return text == nullptr ? std::string_view {} : std::string_view { text };
+	}
+
+	// names that are not built, nothing for references
+	auto
+	plain_name(const RTTIBase *rtti) -> std::string_view {
+		switch (rtti->rtti_type) {
+			case RTTIType::Primitive: return text_of(reinterpret_cast<const RTTIPrimitive *>(rtti)->name);
+			case RTTIType::Enum:
+			case RTTIType::Bitset: return text_of(reinterpret_cast<const RTTIEnum *>(rtti)->name);
+			case RTTIType::Class: return text_of(reinterpret_cast<const RTTIClass *>(rtti)->name);
+			case RTTIType::Reference:
+			case RTTIType::Container:
+			case RTTIType::Struct: break;
+		}
+
+		return {};
+	}
+} // namespace
+
+namespace stormbird_hook {
+	auto
+	get_rtti_name(const RTTIBase *rtti) -> std::string {
+		// references nest, Array<Ref<Foo>> is built outside in. slow trails the chain at half speed and only meets it
+		// again if the chain loops, which would otherwise nest forever.
+		std::string name;
+		size_t depth = 0;
+		const auto *slow = rtti;
+		while (is_reference(rtti)) {
+			name += text_of(reinterpret_cast<const RTTIReference *>(rtti)->data->name);
+			name += '<';
+			depth++;
+			rtti = reinterpret_cast<const RTTIReference *>(rtti)->type;
+			if (depth % 2 == 0) {
+				slow = reinterpret_cast<const RTTIReference *>(slow)->type;
+			}
+
+			if (rtti == slow) {
+				name += "<cycle>";
+				return name.append(depth, '>');
+			}
+		}
+
+		name += rtti == nullptr ? "<null>" : plain_name(rtti);
+		return name.append(depth, '>');
+	}
+
+	auto
+	rtti_name_cache::name_of(const RTTIBase *rtti) -> std::string_view {
+		if (rtti == nullptr) {
+			return "<null>";
+		}
+
+		// the game's string is already there to read, a lookup would cost more than it saves
+		if (!is_reference(rtti)) {
+			return plain_name(rtti);
+		}
+
+		if (auto it = names.find(rtti); it != names.end()) {
+			return it->second;
+		}
+
+		name_chain(rtti);
+		return names.find(rtti)->second;
+	}
+
+	void
+	rtti_name_cache::clear() {
+		names.clear();
+		interned.clear();
+		arena.clear();
+	}
+
+	auto
+	rtti_name_cache::store(std::string_view text) -> std::string_view {
+		if (auto it = interned.find(text); it != interned.end()) {
+			return *it;
+		}
+
+		return *interned.emplace(static_cast<const char *>(arena.copy(text.data(), text.size())), text.size()).first;
+	}
+
+	// names every reference from rtti down to the first type that is not a reference or already has a name, then
+	// builds the names back up from there so each level is one concatenation onto the level below it
+	void
+	rtti_name_cache::name_chain(const RTTIBase *rtti) {
+		chain.clear();
+		const auto *slow = rtti;
+		while (is_reference(rtti) && !names.contains(rtti)) {
+			chain.push_back(rtti);
+			rtti = reinterpret_cast<const RTTIReference *>(rtti)->type;
+			if (chain.size() % 2 == 0) {
+				slow = reinterpret_cast<const RTTIReference *>(slow)->type;
+			}
+
+			// a loop, where the name is cut depends on where the chain is entered, so these are spelled one by one
+			if (rtti == slow) {
+				for (const auto *reference : chain) {
+					names.emplace(reference, store(get_rtti_name(reference)));
+				}
+
+				return;
+			}
+		}
+
+		auto inner = name_of(rtti);
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+			const auto *reference = reinterpret_cast<const RTTIReference *>(*it);
+			scratch.clear();
+			scratch += text_of(reference->data->name);
+			scratch += '<';
+			scratch += inner;
+			scratch += '>';
+			inner = store(scratch);
+			names.emplace(*it, inner);
+		}
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,63 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+#include "arena.hpp"
+#include "rtti.hpp"
+
+// type names as the dump spells them. references and containers include their element, e.g. Array<Ref<Foo>>, which
+// makes their names the only ones that have to be built rather than read from the game.
+
+namespace stormbird_hook {
+	// builds the name from scratch on every call, rtti_name_cache is the one to use for more than a few lookups.
+	// a reference chain that loops back on itself ends in <cycle> instead of nesting forever.
+	auto
+	get_rtti_name(const RTTIBase *rtti) -> std::string;
+
+	// every reference name is built once on top of the name of its element, and equal names share one copy.
+	// not thread safe, use one cache per thread.
+	class rtti_name_cache {
+	public:
+		rtti_name_cache() = default;
+
+		rtti_name_cache(const rtti_name_cache &) = delete;
+		auto
+		operator=(const rtti_name_cache &) -> rtti_name_cache & = delete;
+
+		// same text as get_rtti_name(), valid until the cache is cleared or destroyed. names of primitives, enums and
+		// classes point straight at the game's strings and live as long as those.
+		[[nodiscard]] auto
+		name_of(const RTTIBase *rtti) -> std::string_view;
+
+		// number of references and containers named so far
+		[[nodiscard]] auto
+		size() const -> size_t {
+			return names.size();
+		}
+
+		void
+		clear();
+
+	private:
+		auto
+		store(std::string_view text) -> std::string_view;
+
+		void
+		name_chain(const RTTIBase *rtti);
+
+		ankerl::unordered_dense::map<const RTTIBase *, std::string_view> names; // references only
+		ankerl::unordered_dense::set<std::string_view> interned; // every name in arena
+		bump_arena arena { 64 * 1024 }; // built names
+		std::vector<const RTTIBase *> chain; // scratch for name_chain()
+		std::string scratch;
+	};
+} // namespace stormbird_hook
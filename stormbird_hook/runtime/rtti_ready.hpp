@@ -0,0 +1,128 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "rtti.hpp"
+
+// the game registers its types for a while after the factory is built. instead of guessing how long that takes, the
+// dump watches the counts of the factory's tables and starts once they have stopped changing for a quiet period.
+// rtti_ready_detector only decides, it is handed the counts and the time, so it can be driven without a game or a
+// clock. wait_for_rtti() is the loop that polls and sleeps around it.
+
+namespace stormbird_hook {
+	struct rtti_factory_counts {
+		uint32_t rtti { 0 };
+		uint32_t rtti_refs { 0 };
+		uint32_t core_rtti { 0 };
+
+		auto
+		operator==(const rtti_factory_counts &) const -> bool = default;
+
+		// nothing registered yet
+		[[nodiscard]] auto
+		empty() const -> bool {
+			return rtti == 0 && rtti_refs == 0 && core_rtti == 0;
+		}
+	};
+
+	// the game may be writing the counts while they are read, so every read goes to memory
+	inline auto
+	read_rtti_factory_counts(const RTTIFactory &factory) -> rtti_factory_counts {
+		return {
+			*static_cast<const volatile uint32_t *>(&factory.rtti.count),
+			*static_cast<const volatile uint32_t *>(&factory.rtti_refs.count),
+			*static_cast<const volatile uint32_t *>(&factory.core_rtti.count),
+		};
+	}
+
+	struct rtti_ready_options {
+		std::chrono::milliseconds quiet_period { 1000 }; // the counts have to stay the same for this long
+		std::chrono::milliseconds timeout { 30000 }; // give up waiting after this long, counted from the first poll
+		std::chrono::milliseconds first_poll { 10 }; // the wait after a change, doubled for every poll without one
+		std::chrono::milliseconds max_poll { 250 };
+	};
+
+	enum class rtti_ready_state : uint8_t {
+		waiting,
+		ready, // the counts have been quiet long enough
+		timed_out // still changing, or still empty, when the timeout ran out
+	};
+
+	class rtti_ready_detector {
+	public:
+		using clock = std::chrono::steady_clock;
+
+		rtti_ready_detector(const rtti_ready_options &options, clock::time_point start) : options(options), start(start), last_change(start), interval(options.first_poll) { }
+
+		// feeds the counts seen at now, polls have to come in order
+		auto
+		observe(const rtti_factory_counts &counts, clock::time_point now) -> rtti_ready_state {
+			if (counts != last) {
+				last = counts;
+				last_change = now;
+				interval = options.first_poll;
+			} else {
+				interval = std::min<clock::duration>(interval * 2, options.max_poll);
+			}
+
+			// empty tables are never ready, the game has not started registering yet
+			if (!last.empty() && now - last_change >= options.quiet_period) {
+				return rtti_ready_state::ready;
+			}
+
+			if (now - start >= options.timeout) {
+				return rtti_ready_state::timed_out;
+			}
+
+			return rtti_ready_state::waiting;
+		}
+
+		// how long to wait before the next poll
+		[[nodiscard]] auto
+		next_poll() const -> clock::duration {
+			return interval;
+		}
+
+		[[nodiscard]] auto
+		counts() const -> const rtti_factory_counts & {
+			return last;
+		}
+
+	private:
+		rtti_ready_options options;
+		clock::time_point start;
+		clock::time_point last_change;
+		clock::duration interval;
+		rtti_factory_counts last {};
+	};
+
+	struct rtti_ready_result {
+		rtti_ready_state state { rtti_ready_state::waiting };
+		std::chrono::steady_clock::duration waited {};
+		rtti_factory_counts counts {};
+	};
+
+	// polls read_counts, a callable returning rtti_factory_counts, until the detector calls it ready or timed out
+	template<typename Read>
+	auto
+	wait_for_rtti(Read &&read_counts, const rtti_ready_options &options = {}) -> rtti_ready_result {
+		auto start = rtti_ready_detector::clock::now();
+		rtti_ready_detector detector(options, start);
+		while (true) {
+			auto now = rtti_ready_detector::clock::now();
+			auto state = detector.observe(read_counts(), now);
+			if (state != rtti_ready_state::waiting) {
+				return { state, now - start, detector.counts() };
+			}
+
+			std::this_thread::sleep_for(detector.next_poll());
+		}
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,369 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "rtti_snapshot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+namespace {
+	using namespace stormbird_hook;
+
+	constexpr size_t copy_alignment = 8;
+	constexpr uint32_t max_array_count = 1u << 20; // more than any table of the game holds, anything past is garbage
+	constexpr size_t max_string_length = 64 * 1024;
+	constexpr size_t string_chunk = 64;
+
+	// the dump's own process, where everything the factory points at can be read as it is
+	struct direct_reader {
+		auto
+		operator()(uint64_t address, void *out, size_t size) const -> bool {
+			std::memcpy(out, reinterpret_cast<const void *>(address), size);
+			return true;
+		}
+	};
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// copies a type the first time it is seen and fixes up its pointers later, so the walk is a loop over pending
+	// copies rather than a recursion through the graph. every read goes through read, a pointer that cannot be read
+	// is copied as null.
+	template<typename Reader>
+	class rtti_capture {
+	public:
+		rtti_capture(bump_arena &arena, Reader &read) : arena(arena), read(read) { }
+
+		auto
+		capture(const RTTIFactory &factory) -> RTTIFactory {
+			RTTIFactory result {};
+			result.rtti = copy_array(factory.rtti, [this](RTTIRecord &record) { record.rtti = type(record.rtti); });
+			result.rtti_refs = copy_array(factory.rtti_refs, [this](RTTIRefRecord &record) {
+				record.data = reference_data(record.data);
+				record.rtti = copy_array(record.rtti, [this](RTTIRefChain &chain) {
+					chain.type = type(chain.type);
+					chain.ref_type = type(chain.ref_type);
+				});
+			});
+			result.core_rtti = copy_array(factory.core_rtti, [this](CoreRTTIRecord &record) {
+				record.name = copy_string(record.name);
+				record.rtti = copy_of(record.rtti);
+				if (record.rtti != nullptr) {
+					record.rtti->rtti = type(record.rtti->rtti);
+				}
+			});
+
+			while (!pending.empty()) {
+				auto *copy = pending.back();
+				pending.pop_back();
+				fix(copy);
+			}
+
+			return result;
+		}
+
+		[[nodiscard]] auto
+		type_count() const -> size_t {
+			return types;
+		}
+
+		[[nodiscard]] auto
+		unreadable_count() const -> size_t {
+			return unreadable;
+		}
+
+	private:
+		static auto
+		address_of(const void *pointer) -> uint64_t {
+			return reinterpret_cast<uint64_t>(pointer);
+		}
+
+		template<typename T>
+		auto
+		copy_of(const T *original, size_t count = 1) -> T * {
+			if (original == nullptr) {
+				return nullptr;
+			}
+
+			auto *copy = static_cast<T *>(arena.allocate(sizeof(T) * count, copy_alignment));
+			if (!read(address_of(original), copy, sizeof(T) * count)) {
+				unreadable++;
+				return nullptr;
+			}
+
+			return copy;
+		}
+
+		template<typename T, typename Fn>
+		auto
+		copy_array(const Array<T> &original, Fn &&fix_element) -> Array<T> {
+			if (original.array == nullptr || original.count == 0) {
+				return { nullptr, 0, 0 };
+			}
+
+			auto *copy = original.count <= max_array_count ? copy_of(original.array, original.count) : nullptr;
+			if (copy == nullptr) {
+				unreadable += original.count > max_array_count ? 1 : 0;
+				return { nullptr, 0, 0 };
+			}
+
+			for (uint32_t index = 0; index < original.count; ++index) {
+				fix_element(copy[index]);
+			}
+
+			return { copy, original.count, original.count };
+		}
+
+		auto
+		copy_string(const char *original) -> const char * {
+			if constexpr (std::is_same_v<std::remove_const_t<Reader>, direct_reader>) {
+				return arena.copy_string(original);
+			} else {
+				return original == nullptr ? nullptr : read_string(address_of(original));
+			}
+		}
+
+		// strings are read in chunks that end on 64 byte boundaries, so no chunk runs into the next page. a chunk that
+		// cannot be read is retried a byte at a time, the string may end before the memory does.
+		auto
+		read_string(uint64_t address) -> const char * {
+			text.clear();
+			std::array<char, string_chunk> chunk {};
+			while (text.size() < max_string_length) {
+				auto size = string_chunk - address % string_chunk;
+				if (!read(address, chunk.data(), size)) {
+					size = 1;
+					if (!read(address, chunk.data(), size)) {
+						break;
+					}
+				}
+
+				auto *end = std::find(chunk.data(), chunk.data() + size, '\0');
+				text.append(chunk.data(), end);
+				if (end != chunk.data() + size) {
+					return arena.copy_string(text);
+				}
+
+				address += size;
+			}
+
+			unreadable++;
+			return nullptr;
+		}
+
+		// the copy of a type, made on first sight with the pointers still aimed at the game
+		auto
+		type(const RTTIBase *original) -> RTTIBase * {
+			if (original == nullptr) {
+				return nullptr;
+			}
+
+			auto [it, inserted] = copies.try_emplace(original, nullptr);
+			if (!inserted) {
+				return it->second;
+			}
+
+			RTTIBase base {};
+			if (!read(address_of(original), &base, sizeof(base)) || base.rtti_type > RTTIType::Struct) {
+				unreadable++;
+				return nullptr;
+			}
+
+			size_t size = sizeof(RTTIBase);
+			switch (base.rtti_type) {
+				case RTTIType::Primitive: size = sizeof(RTTIPrimitive); break;
+				case RTTIType::Reference:
+				case RTTIType::Container: size = sizeof(RTTIReference); break;
+				case RTTIType::Enum:
+				case RTTIType::Bitset: size = sizeof(RTTIEnum); break;
+				case RTTIType::Class: size = sizeof(RTTIClass); break;
+				case RTTIType::Struct: size = sizeof(RTTIStruct); break;
+			}
+
+			auto *header = static_cast<uint8_t *>(arena.allocate(sizeof(uint64_t) + size, copy_alignment));
+			auto address = address_of(original);
+			std::memcpy(header, &address, sizeof(address));
+			if (!read(address, header + sizeof(uint64_t), size)) {
+				unreadable++;
+				return nullptr;
+			}
+
+			auto *copy = reinterpret_cast<RTTIBase *>(header + sizeof(uint64_t));
+			it->second = copy;
+			pending.push_back(copy);
+			types++;
+			return copy;
+		}
+
+		auto
+		class_type(const RTTIClass *original) -> RTTIClass * {
+			return reinterpret_cast<RTTIClass *>(type(reinterpret_cast<const RTTIBase *>(original)));
+		}
+
+		auto
+		reference_data(const RTTIReferenceBaseData *original) -> RTTIReferenceBaseData * {
+			if (original == nullptr) {
+				return nullptr;
+			}
+
+			auto [it, inserted] = shared_data.try_emplace(original, nullptr);
+			if (inserted) {
+				it->second = copy_of(original);
+				if (it->second != nullptr) {
+					it->second->name = copy_string(it->second->name);
+				}
+			}
+
+			return it->second;
+		}
+
+		auto
+		empty_data() -> RTTIReferenceBaseData * {
+			if (empty == nullptr) {
+				empty = static_cast<RTTIReferenceBaseData *>(arena.allocate(sizeof(RTTIReferenceBaseData), copy_alignment));
+				*empty = {};
+			}
+
+			return empty;
+		}
+
+		// points everything the copy refers to at copies
+		void
+		fix(RTTIBase *copy) {
+			switch (copy->rtti_type) {
+				case RTTIType::Primitive:
+					{
+						auto *primitive = reinterpret_cast<RTTIPrimitive *>(copy);
+						primitive->name = copy_string(primitive->name);
+						primitive->parent = type(primitive->parent);
+						break;
+					}
+				case RTTIType::Reference:
+				case RTTIType::Container:
+					{
+						auto *reference = reinterpret_cast<RTTIReference *>(copy);
+						reference->type = type(reference->type);
+						reference->data = reference_data(reference->data);
+						if (reference->data == nullptr) {
+							reference->data = empty_data(); // the dump reads the data of every reference
+						}
+						break;
+					}
+				case RTTIType::Enum:
+				case RTTIType::Bitset:
+					{
+						auto *enum_rtti = reinterpret_cast<RTTIEnum *>(copy);
+						enum_rtti->name = copy_string(enum_rtti->name);
+						if (enum_rtti->values != nullptr && enum_rtti->member_count > 0) {
+							enum_rtti->values = copy_of(enum_rtti->values, enum_rtti->member_count);
+							for (auto i = 0; enum_rtti->values != nullptr && i < enum_rtti->member_count; i++) {
+								enum_rtti->values[i].name = copy_string(enum_rtti->values[i].name);
+							}
+						}
+						break;
+					}
+				case RTTIType::Class:
+					{
+						fix_class(reinterpret_cast<RTTIClass *>(copy));
+						break;
+					}
+				case RTTIType::Struct: break;
+			}
+		}
+
+		void
+		fix_class(RTTIClass *class_rtti) {
+			class_rtti->name = copy_string(class_rtti->name);
+			class_rtti->first_child = class_type(class_rtti->first_child);
+			class_rtti->next_sibling = class_type(class_rtti->next_sibling);
+
+			if (class_rtti->bases != nullptr && class_rtti->base_count > 0) {
+				class_rtti->bases = copy_of(class_rtti->bases, class_rtti->base_count);
+				for (auto i = 0; class_rtti->bases != nullptr && i < class_rtti->base_count; i++) {
+					class_rtti->bases[i].type = class_type(class_rtti->bases[i].type);
+				}
+			}
+
+			if (class_rtti->members != nullptr && class_rtti->member_count > 0) {
+				class_rtti->members = copy_of(class_rtti->members, class_rtti->member_count);
+				for (auto i = 0; class_rtti->members != nullptr && i < class_rtti->member_count; i++) {
+					auto &member = class_rtti->members[i];
+					member.type = type(member.type);
+					member.name = copy_string(member.name);
+				}
+			}
+
+			if (class_rtti->functions != nullptr && class_rtti->function_count > 0) {
+				class_rtti->functions = copy_of(class_rtti->functions, class_rtti->function_count);
+				for (auto i = 0; class_rtti->functions != nullptr && i < class_rtti->function_count; i++) {
+					auto &function = class_rtti->functions[i];
+					function.name = copy_string(function.name);
+					function.args = copy_string(function.args);
+				}
+			}
+
+			if (class_rtti->events != nullptr && class_rtti->event_count > 0) {
+				class_rtti->events = copy_of(class_rtti->events, class_rtti->event_count);
+				for (auto i = 0; class_rtti->events != nullptr && i < class_rtti->event_count; i++) {
+					class_rtti->events[i].type = type(class_rtti->events[i].type);
+				}
+			}
+
+			if (class_rtti->base_events != nullptr && class_rtti->base_event_count > 0) {
+				class_rtti->base_events = copy_of(class_rtti->base_events, class_rtti->base_event_count);
+				for (auto i = 0; class_rtti->base_events != nullptr && i < class_rtti->base_event_count; i++) {
+					auto &base_event = class_rtti->base_events[i];
+					base_event.type = type(base_event.type);
+					base_event.base_class = type(base_event.base_class);
+				}
+			}
+		}
+
+		bump_arena &arena;
+		Reader &read;
+		ankerl::unordered_dense::map<const RTTIBase *, RTTIBase *> copies; // null for types that could not be read
+		ankerl::unordered_dense::map<const RTTIReferenceBaseData *, RTTIReferenceBaseData *> shared_data; // many references share one
+		RTTIReferenceBaseData *empty { nullptr }; // stands in for data that could not be read
+		std::vector<RTTIBase *> pending; // copied, pointers not fixed yet
+		std::string text; // scratch for read_string()
+		size_t types { 0 };
+		size_t unreadable { 0 };
+	};
+
+#pragma clang diagnostic pop
+} // namespace
+
+namespace stormbird_hook {
+	auto
+	rtti_snapshot::capture(const RTTIFactory &factory) -> rtti_snapshot {
+		rtti_snapshot snapshot;
+		direct_reader read;
+		rtti_capture capture(snapshot.arena, read);
+		snapshot.copied_factory = capture.capture(factory);
+		snapshot.types = capture.type_count();
+		return snapshot;
+	}
+
+	auto
+	rtti_snapshot::capture(uint64_t factory_address, const memory_reader &read) -> std::optional<rtti_snapshot> {
+		RTTIFactory factory {};
+		if (!read(factory_address, &factory, sizeof(factory))) {
+			return std::nullopt;
+		}
+
+		rtti_snapshot snapshot;
+		rtti_capture capture(snapshot.arena, read);
+		snapshot.copied_factory = capture.capture(factory);
+		snapshot.types = capture.type_count();
+		snapshot.unreadable = capture.unreadable_count();
+		return snapshot;
+	}
+} // namespace stormbird_hook
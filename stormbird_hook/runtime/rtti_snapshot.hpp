@@ -0,0 +1,61 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "arena.hpp"
+#include "memory_snapshot.hpp"
+#include "rtti.hpp"
+
+// a copy of everything the dump reads from the game, taken in one pass that does nothing but copy, so the game's memory
+// is only touched for as long as that takes. the copies point at each other and at copies of their strings, all of it
+// in one arena, so the serializers walk a snapshot the same way they walk the game, whenever they get to it.
+// every copied type keeps the address of its original in the 8 bytes right in front of it, see rtti_address().
+
+namespace stormbird_hook {
+	class rtti_snapshot {
+	public:
+		[[nodiscard]] static auto
+		capture(const RTTIFactory &factory) -> rtti_snapshot;
+
+		// the same walk for a factory this process cannot read directly, such as one in a memory_snapshot_view. every
+		// read goes through read and a pointer that cannot be read is copied as null. nothing if the factory cannot.
+		[[nodiscard]] static auto
+		capture(uint64_t factory_address, const memory_reader &read) -> std::optional<rtti_snapshot>;
+
+		// the factory's tables, pointing at the copies. runtime_rtti is left empty, nothing reads it.
+		[[nodiscard]] auto
+		factory() const -> const RTTIFactory & {
+			return copied_factory;
+		}
+
+		[[nodiscard]] auto
+		type_count() const -> size_t {
+			return types;
+		}
+
+		// bytes copied
+		[[nodiscard]] auto
+		size() const -> size_t {
+			return arena.size();
+		}
+
+		// pointers that could not be read, always 0 for a capture of this process
+		[[nodiscard]] auto
+		unreadable_count() const -> size_t {
+			return unreadable;
+		}
+
+	private:
+		rtti_snapshot() = default;
+
+		bump_arena arena;
+		RTTIFactory copied_factory {};
+		size_t types { 0 };
+		size_t unreadable { 0 };
+	};
+} // namespace stormbird_hook
@@ -0,0 +1,334 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+#include "rtti.hpp"
+
+// the pieces every walk over the rtti graph shares. nothing here recurses, the graph can be as deep as the game
+// makes it without touching the stack of the dump thread.
+
+namespace stormbird_hook {
+	enum class rtti_dump_mode : uint8_t {
+		serial, // types are written in the order the walk finds them
+		parallel // walked and written on a pool of threads, sorted by address so every thread count writes the same file
+	};
+
+	struct rtti_dump_options {
+		rtti_dump_mode mode { rtti_dump_mode::serial };
+		uint32_t thread_count { 0 }; // parallel only, 0 uses every hardware thread
+	};
+
+	// where the types being walked live, a snapshot's types are copies that carry their game address with them
+	enum class rtti_source : uint8_t {
+		game,
+		snapshot
+	};
+
+	// the address a type has in the game, 0 for null
+	inline auto
+	rtti_address(const void *type, rtti_source source) -> uint64_t {
+		if (source == rtti_source::snapshot && type != nullptr) {
+			uint64_t address = 0;
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+			std::memcpy(&address, static_cast<const uint8_t *>(type) - sizeof(address), sizeof(address));
+
+#pragma clang diagnostic pop
+
+			return address;
+		}
+
+		return reinterpret_cast<uint64_t>(type);
+	}
+
+	// type addresses, flat and open addressing so a visit is one probe into one array
+	using rtti_address_set = ankerl::unordered_dense::set<uint64_t>;
+
+	// type addresses shared by several walks, split into shards with a lock each so walks rarely wait on each other
+	class rtti_concurrent_address_set {
+	public:
+		// true for the first caller with this address
+		auto
+		emplace(uint64_t address) -> bool {
+			auto &shard = shards[(address * 0x9E3779B97F4A7C15) >> (64 - shard_bits)];
+			std::lock_guard lock(shard.lock);
+			return shard.addresses.emplace(address).second;
+		}
+
+		[[nodiscard]] auto
+		size() -> size_t {
+			size_t count = 0;
+			for (auto &shard : shards) {
+				std::lock_guard lock(shard.lock);
+				count += shard.addresses.size();
+			}
+
+			return count;
+		}
+
+	private:
+		static constexpr uint32_t shard_bits = 6;
+
+		struct alignas(64) shard_type {
+			std::mutex lock;
+			rtti_address_set addresses;
+		};
+
+		std::array<shard_type, 1 << shard_bits> shards;
+	};
+
+	// the types the factory lists, in the order rtti.json starts from them
+	template<typename Fn>
+	void
+	for_each_rtti_root(const RTTIFactory &factory, Fn &&fn) {
+		for (const auto &rtti_record : factory.rtti) {
+			fn(rtti_record.rtti);
+		}
+
+		for (const auto &ref_rtti_record : factory.rtti_refs) {
+			for (const auto &rtti_record : ref_rtti_record.rtti) {
+				fn(rtti_record.type);
+				fn(rtti_record.ref_type);
+			}
+		}
+
+		for (const auto &rtti_record : factory.core_rtti) {
+			if (rtti_record.rtti != nullptr) {
+				fn(rtti_record.rtti->rtti);
+			}
+		}
+	}
+
+	// the sibling chain under a class, up to the first sibling seen twice since some chains loop back on themselves.
+	// seen is scratch space, passing the same set for every class keeps its table around instead of allocating one.
+	template<typename Fn>
+	void
+	for_each_rtti_descendant(const RTTIClass *class_rtti, rtti_address_set &seen, Fn &&fn) {
+		seen.clear();
+		for (const auto *descendant_rtti = class_rtti->first_child; descendant_rtti != nullptr; descendant_rtti = descendant_rtti->next_sibling) {
+			if (!seen.emplace(reinterpret_cast<uint64_t>(descendant_rtti)).second) {
+				break;
+			}
+
+			fn(descendant_rtti);
+		}
+	}
+
+	// every type rtti refers to, in the order the json dump lists them. null pointers are passed on as well.
+	// siblings is scratch space for for_each_rtti_descendant().
+	template<typename Fn>
+	void
+	for_each_rtti_edge(const RTTIBase *rtti, rtti_address_set &siblings, Fn &&fn) {
+		switch (rtti->rtti_type) {
+			case RTTIType::Primitive:
+				{
+					const auto *primitive = reinterpret_cast<const RTTIPrimitive *>(rtti);
+					if (primitive->parent != rtti) {
+						fn(primitive->parent);
+					}
+					break;
+				}
+			case RTTIType::Reference:
+			case RTTIType::Container:
+				{
+					fn(reinterpret_cast<const RTTIReference *>(rtti)->type);
+					break;
+				}
+			case RTTIType::Class:
+				{
+					const auto *class_rtti = reinterpret_cast<const RTTIClass *>(rtti);
+					for_each_rtti_descendant(class_rtti, siblings, [&fn](const RTTIClass *descendant_rtti) { fn(reinterpret_cast<const RTTIBase *>(descendant_rtti)); });
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+					for (auto i = 0; class_rtti->bases != nullptr && i < class_rtti->base_count; i++) {
+						fn(reinterpret_cast<const RTTIBase *>(class_rtti->bases[i].type));
+					}
+
+					for (auto i = 0; class_rtti->members != nullptr && i < class_rtti->member_count; i++) {
+						fn(class_rtti->members[i].type);
+					}
+
+					for (auto i = 0; class_rtti->events != nullptr && i < class_rtti->event_count; i++) {
+						fn(class_rtti->events[i].type);
+					}
+
+					for (auto i = 0; class_rtti->base_events != nullptr && i < class_rtti->base_event_count; i++) {
+						fn(class_rtti->base_events[i].type);
+						fn(class_rtti->base_events[i].base_class);
+					}
+
+#pragma clang diagnostic pop
+
+					break;
+				}
+			case RTTIType::Enum:
+			case RTTIType::Bitset:
+			case RTTIType::Struct: break;
+		}
+	}
+
+	// types waiting to be visited, each type is let in once
+	class rtti_work_queue {
+	public:
+		rtti_work_queue() = default;
+
+		// a type is let in once across every queue on shared, for one walk split over several threads
+		explicit rtti_work_queue(rtti_concurrent_address_set &shared) : shared(&shared) { }
+
+		// false if the type is null or was pushed before
+		auto
+		push(const RTTIBase *rtti) -> bool {
+			if (rtti == nullptr) {
+				return false;
+			}
+
+			auto address = reinterpret_cast<uint64_t>(rtti);
+			if (shared != nullptr ? !shared->emplace(address) : !visited.emplace(address).second) {
+				return false;
+			}
+
+			pending.push_back(rtti);
+			return true;
+		}
+
+		// the most recently pushed type, null once the queue is drained
+		auto
+		pop() -> const RTTIBase * {
+			if (pending.empty()) {
+				return nullptr;
+			}
+
+			const auto *rtti = pending.back();
+			pending.pop_back();
+			return rtti;
+		}
+
+		// types pushed through this queue, or through every queue on the shared set
+		[[nodiscard]] auto
+		visited_count() const -> size_t {
+			return shared != nullptr ? shared->size() : visited.size();
+		}
+
+	private:
+		rtti_address_set visited;
+		rtti_concurrent_address_set *shared { nullptr };
+		std::vector<const RTTIBase *> pending; // pushed but not popped yet
+	};
+
+	// depth-first from each root, handing a type to fn once every type it leads to is done: the types a type refers
+	// to come before it, except around a cycle. the order of the recursive walk, on a stack of its own since chains of
+	// bases and members run deeper than the thread's stack.
+	class rtti_post_order_walk {
+	public:
+		template<typename Fn>
+		void
+		walk(const RTTIBase *root, Fn &&fn) {
+			enter(root);
+			while (!frames.empty()) {
+				auto &frame = frames.back();
+				if (frame.next_edge < edges.size()) { // the edges of the top frame are the last ones on the edge stack
+					enter(edges[frame.next_edge++]);
+					continue;
+				}
+
+				const auto *rtti = frame.rtti;
+				edges.resize(frame.first_edge);
+				frames.pop_back();
+				fn(rtti);
+			}
+		}
+
+	private:
+		struct frame {
+			const RTTIBase *rtti;
+			size_t first_edge;
+			size_t next_edge;
+		};
+
+		// a type is marked when it is entered, so a cycle back to it is cut there
+		void
+		enter(const RTTIBase *rtti) {
+			if (rtti == nullptr || !visited.emplace(reinterpret_cast<uint64_t>(rtti)).second) {
+				return;
+			}
+
+			frames.push_back({ rtti, edges.size(), edges.size() });
+			for_each_rtti_edge(rtti, siblings, [this](const RTTIBase *edge) { edges.push_back(edge); });
+		}
+
+		rtti_address_set visited;
+		rtti_address_set siblings; // scratch for for_each_rtti_descendant()
+		std::vector<frame> frames;
+		std::vector<const RTTIBase *> edges; // the edges of every frame, in frame order
+	};
+
+	inline auto
+	rtti_thread_count(const rtti_dump_options &options) -> uint32_t {
+		return options.thread_count == 0 ? std::max(1u, std::thread::hardware_concurrency()) : options.thread_count;
+	}
+
+	// every type reachable from the factory, sorted by game address. the roots are handed out to a pool of threads that
+	// walk from them on one shared visited set, so each type is found by exactly one thread.
+	inline auto
+	collect_rtti_types(const RTTIFactory &factory, const rtti_dump_options &options, rtti_source source = rtti_source::game) -> std::vector<const RTTIBase *> {
+		std::vector<const RTTIBase *> roots;
+		for_each_rtti_root(factory, [&roots](const RTTIBase *rtti) {
+			if (rtti != nullptr) {
+				roots.push_back(rtti);
+			}
+		});
+
+		auto thread_count = static_cast<uint32_t>(std::clamp<size_t>(rtti_thread_count(options), 1, std::max<size_t>(roots.size(), 1)));
+		rtti_concurrent_address_set visited;
+		std::vector<std::vector<const RTTIBase *>> found(thread_count);
+		std::atomic<size_t> next_root { 0 };
+		auto worker = [&](uint32_t index) {
+			rtti_work_queue queue(visited);
+			rtti_address_set siblings;
+			auto &types = found[index];
+			for (auto root = next_root++; root < roots.size(); root = next_root++) {
+				queue.push(roots[root]);
+				while (const auto *rtti = queue.pop()) {
+					types.push_back(rtti);
+					for_each_rtti_edge(rtti, siblings, [&queue](const RTTIBase *next) { queue.push(next); });
+				}
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (uint32_t index = 1; index < thread_count; ++index) {
+			workers.emplace_back(worker, index);
+		}
+
+		worker(0);
+
+		for (auto &thread : workers) {
+			thread.join();
+		}
+
+		std::vector<const RTTIBase *> types;
+		for (const auto &part : found) {
+			types.insert(types.end(), part.begin(), part.end());
+		}
+
+		std::sort(types.begin(), types.end(), [source](const RTTIBase *left, const RTTIBase *right) { return rtti_address(left, source) < rtti_address(right, source); });
+		return types;
+	}
+} // namespace stormbird_hook
@@ -2,22 +2,32 @@
 // Copyright (c) 2023 <https://github.com/yretenai/stormbird>
 // SPDX-License-Identifier: MPL-2.0
 
+#include <algorithm>
 #include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <memory>
+#include <optional>
 #include <ostream>
-#include <unordered_set>
+#include <sstream>
 
+#include "memory_snapshot.hpp"
 #include "rtti.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_delta.hpp"
+#include "rtti_dump.hpp"
+#include "rtti_index.hpp"
+#include "rtti_locate.hpp"
+#include "rtti_ready.hpp"
+#include "rtti_snapshot.hpp"
 #include "runtime.hpp"
 #include "settings.hpp"
 #include "signature.hpp"
-#include "signature_engine.hpp"
+#include "signature_cache.hpp"
+#include "signature_module.hpp"
+#include "xref_index.hpp"
 
 #include <MinHook.h>
-#include <nlohmann/json.hpp>
-
-using namespace nlohmann;
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wmicrosoft-cast"
@@ -50,11 +60,6 @@ namespace stormbird_hook {
 		return module;
 	}
 
-	struct rtti_json {
-		json::array_t rtti;
-		std::unordered_set<uint64_t> visited {};
-	};
-
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
 	using rtti_factory_ctor_t = RTTIFactory *(*) (RTTIFactory *);
@@ -62,295 +67,166 @@ namespace stormbird_hook {
 
 	RTTIFactory *rtti_factory = nullptr;
 
-#pragma clang diagnostic push
-#pragma ide diagnostic ignored "NotInitializedField"
-
+	// finds the factory through the data sections of the game when the constructor could not be hooked.
+	// only works once the game has registered its types, the factory looks empty before that.
 	auto
-	get_rtti_name(RTTIBase *rtti) -> std::string { // NOLINT(*-no-recursion)
-		if (rtti == nullptr) {
-			return "<null>";
+	locate_rtti_factory() -> RTTIFactory * {
+		MODULEINFO module_info;
+		if (!GetModuleInformation(GetCurrentProcess(), g_game_module, &module_info, sizeof(module_info))) {
+			return nullptr;
 		}
 
-		switch (rtti->rtti_type) {
-			case RTTIType::Primitive:
-				{
-					auto ptr = reinterpret_cast<RTTIPrimitive *>(rtti);
-					return ptr->name;
-				}
-			case RTTIType::Reference:
-			case RTTIType::Container:
-				{
-					auto ptr = reinterpret_cast<RTTIReference *>(rtti);
-					std::string name = ptr->data->name;
-					auto type = get_rtti_name(ptr->type);
-					return name + "<" + type + ">";
-				}
-			case RTTIType::Enum:
-			case RTTIType::Bitset:
-				{
-					auto ptr = reinterpret_cast<RTTIEnum *>(rtti);
-					return ptr->name;
-				}
-			case RTTIType::Class:
-				{
-					auto ptr = reinterpret_cast<RTTIClass *>(rtti);
-					return ptr->name;
-				}
-			case RTTIType::Struct: break;
+		const auto *base = reinterpret_cast<const uint8_t *>(g_game_module);
+		auto image = parse_pe_image({ base, module_info.SizeOfImage });
+		if (!image) {
+			return nullptr;
 		}
 
-		return {};
-	}
+		std::vector<scan_region> readable;
+		for_each_module_region(g_game_module, [&readable](const uint8_t *begin, const uint8_t *end) { readable.emplace_back(begin, end); });
 
-	void
-	visit_rtti(rtti_json &result, RTTIBase *rtti);
+		auto index = build_loaded_xref_index(base, *image, readable);
+		auto factories = find_rtti_factories(index, *image, read_process_memory);
+		if (factories.size() != 1) {
+			// none is expected while the game is still starting, dump_rtti() keeps trying until it gives up
+			if (factories.size() > 1) {
+				g_output << "[rtti] found " << factories.size() << " rtti factory candidates, expected one\n";
+			}
 
-	void
-	visit_rtti_primitive(rtti_json &result, json &obj, RTTIPrimitive *primitive) {
-		obj["total_size"] = primitive->total_size;
-		obj["size"] = primitive->size;
-		obj["count"] = primitive->count;
-		obj["unknown2"] = primitive->unknown1;
-		obj["unknown2"] = primitive->unknown2;
-		obj["name"] = std::string(primitive->name);
-		if (primitive->parent != reinterpret_cast<RTTIBase *>(primitive)) {
-			obj["parent_addr"] = reinterpret_cast<uint64_t>(primitive->parent);
-			obj["parent"] = get_rtti_name(primitive->parent);
-
-						visit_rtti(result, primitive->parent);
+			return nullptr;
 		}
-	}
 
-	void
-	visit_rtti_reference(rtti_json &result, json &obj, RTTIReference *reference) {
-		obj["name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(reference));
-		obj["container_name"] = std::string(reference->data->name);
-		obj["type_name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(reference->type));
-		obj["type_addr"] = reinterpret_cast<uint64_t>(reference->type);
-		obj["unknown1"] = reference->data->unknown1;
-		obj["unknown2"] = reference->data->unknown2;
-		obj["unknown3"] = reference->data->unknown3;
-
-		visit_rtti(result, reference->type);
+		g_output << "[rtti] found rtti factory at " << std::hex << factories[0] << std::dec << "\n";
+		return reinterpret_cast<RTTIFactory *>(factories[0]);
 	}
 
+	// only what changed since rtti.manifest was written, or a full dump and its manifest to start from
 	void
-	visit_rtti_enum(json &obj, RTTIEnum *enum_rtti) {
-		obj["name"] = std::string(enum_rtti->name);
-		obj["size"] = enum_rtti->size;
-		obj["member_count"] = enum_rtti->member_count;
-		obj["unknown1"] = enum_rtti->unknown1;
-		obj["unknown2"] = enum_rtti->unknown2;
-		json::array_t values;
-
-		for (auto i = 0; i < enum_rtti->member_count; i++) {
-			auto enum_value = enum_rtti->values[i];
-			json value;
-			value["value"] = enum_value.value;
-			value["name"] = std::string(enum_value.name);
-			values.emplace_back(value);
+	dump_rtti_delta(const rtti_snapshot &snapshot, const rtti_dump_options &options) {
+		const std::filesystem::path manifest_path = "./rtti.manifest";
+		auto base = rtti_manifest::load(manifest_path);
+		if (!base) {
+			g_output << "[rtti] no rtti.manifest yet, writing a full dump to start from\n";
+			std::ofstream json_data("./rtti.json", std::ios::binary);
+			write_rtti_json(snapshot, json_data, options);
+			build_rtti_manifest(snapshot, options).save(manifest_path);
+			return;
+		}
+
+		auto delta = diff_rtti(snapshot, *base, options);
+		g_output << "[rtti] " << delta.added << " added, " << delta.changed << " changed, " << delta.removed.size() << " removed since the last dump\n";
+		if (delta.empty()) {
+			return;
 		}
 
-		obj["values"] = values;
+		std::ostringstream delta_name;
+		delta_name << "./rtti." << std::hex << delta.manifest.hash() << ".delta.json";
+		std::ofstream delta_data(delta_name.str(), std::ios::binary);
+		write_rtti_json(delta, delta_data);
+		delta.manifest.save(manifest_path);
 	}
 
 	void
-	visit_rtti_class(rtti_json &result, json &obj, RTTIClass *class_rtti) {
-		obj["name"] = std::string(class_rtti->name);
-		obj["base_count"] = class_rtti->base_count;
-		obj["member_count"] = class_rtti->member_count;
-		obj["function_count"] = class_rtti->function_count;
-		obj["event_count"] = class_rtti->event_count;
-		obj["base_event_count"] = class_rtti->base_event_count;
-		obj["unknown1"] = class_rtti->unknown1;
-		obj["unknown2"] = class_rtti->unknown2;
-		obj["unknown3"] = class_rtti->unknown3;
-		obj["unknown4"] = class_rtti->unknown4;
-		obj["hash"] = class_rtti->hash;
-		obj["unknown5"] = class_rtti->unknown5;
-		obj["size"] = class_rtti->size;
-		obj["alignment"] = class_rtti->alignment;
-		obj["flags"] = class_rtti->flags;
-
-		if (class_rtti->first_child != nullptr) {
-			std::unordered_set<uint64_t> visited {};
-			json::array_t descendants;
-			RTTIClass *descendant_rtti = class_rtti->first_child;
-			while (descendant_rtti != nullptr) {
-				if (!visited.emplace(reinterpret_cast<uint64_t>(descendant_rtti)).second) {
-					break;
-				}
-
-				json descendant_obj;
-				descendant_obj["name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(descendant_rtti));
-				descendant_obj["addr"] = reinterpret_cast<uint64_t>(descendant_rtti);
-				descendants.emplace_back(descendant_obj);
-				visit_rtti(result, reinterpret_cast<RTTIBase*>(descendant_rtti));
-				descendant_rtti = descendant_rtti->next_sibling;
-			}
-			obj["descendants"] = descendants;
-		}
-
-		if (class_rtti->bases != nullptr && class_rtti->base_count > 0) {
-			json::array_t bases;
-			for (auto i = 0; i < class_rtti->base_count; i++) {
-				json base_obj;
-				auto base = class_rtti->bases[i];
-				base_obj["name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(base.type));
-				base_obj["addr"] = reinterpret_cast<uint64_t>(base.type);
-				base_obj["offset"] = base.offset;
-				visit_rtti(result, reinterpret_cast<RTTIBase*>(base.type));
-				bases.emplace_back(base_obj);
-			}
-			obj["bases"] = bases;
-		}
+	dump_rtti() {
+		using namespace std::chrono_literals;
 
-		if (class_rtti->members != nullptr && class_rtti->member_count > 0) {
-			json::array_t members;
-			for (auto i = 0; i < class_rtti->member_count; i++) {
-				json member_obj;
-				auto member = class_rtti->members[i];
-				member_obj["type_name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(member.type));
-				member_obj["type_addr"] = reinterpret_cast<uint64_t>(member.type);
-				member_obj["name"] = std::string(member.name);
-				member_obj["offset"] = member.offset;
-				member_obj["flags"] = member.flags;
-				member_obj["unknown"] = member.unknown;
-				visit_rtti(result, reinterpret_cast<RTTIBase*>(member.type));
-				members.emplace_back(member_obj);
-			}
-			obj["members"] = members;
-		}
+		rtti_ready_options ready_options {
+			.quiet_period = std::chrono::milliseconds(std::max(g_settings.dump_rtti_quiet_ms, 0)),
+			.timeout = std::chrono::milliseconds(std::max(g_settings.dump_rtti_timeout_ms, 0)),
+		};
 
-		if (class_rtti->functions != nullptr && class_rtti->function_count > 0) {
-			json::array_t functions;
-			for (auto i = 0; i < class_rtti->function_count; i++) {
-				json function_obj;
-				auto function = class_rtti->functions[i];
-				function_obj["type"] = function.return_type;
-				function_obj["name"] = std::string(function.name);
-				function_obj["args"] = std::string(function.args);
-				functions.emplace_back(function_obj);
-			}
-			obj["functions"] = functions;
-		}
+		g_output << "[rtti] waiting for the game to register its types...\n";
+		g_output.flush();
 
-		if (class_rtti->events != nullptr && class_rtti->event_count > 0) {
-			json::array_t events;
-			for (auto i = 0; i < class_rtti->event_count; i++) {
-				json event_obj;
-				auto event = class_rtti->events[i];
-				event_obj["name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(event.type));
-				event_obj["addr"] = reinterpret_cast<uint64_t>(reinterpret_cast<RTTIBase *>(event.type));
-				visit_rtti(result, reinterpret_cast<RTTIBase*>(event.type));
-				events.emplace_back(event_obj);
-			}
-			obj["events"] = events;
-		}
+		// without the constructor hook the factory can only be found once it holds types, until then it reads as empty.
+		// looking it up indexes the whole image, so that is tried once a second rather than on every poll.
+		auto next_locate = std::chrono::steady_clock::now();
+		auto ready = wait_for_rtti(
+			[&next_locate]() -> rtti_factory_counts {
+				if (rtti_factory == nullptr && std::chrono::steady_clock::now() >= next_locate) {
+					rtti_factory = locate_rtti_factory();
+					next_locate = std::chrono::steady_clock::now() + 1s;
+				}
 
-		if (class_rtti->base_events != nullptr && class_rtti->base_event_count > 0) {
-			json::array_t base_events;
-			for (auto i = 0; i < class_rtti->base_event_count; i++) {
-				json base_event_obj;
-				auto base_event = class_rtti->base_events[i];
-				base_event_obj["unknown1"] = base_event.unknown1;
-				base_event_obj["name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(base_event.type));
-				base_event_obj["addr"] = reinterpret_cast<uint64_t>(base_event.type);
-				base_event_obj["type_name"] = get_rtti_name(reinterpret_cast<RTTIBase *>(base_event.base_class));
-				base_event_obj["type_addr"] = reinterpret_cast<uint64_t>(base_event.base_class);
-				visit_rtti(result, reinterpret_cast<RTTIBase*>(base_event.type));
-				visit_rtti(result, reinterpret_cast<RTTIBase*>(base_event.base_class));
-				base_events.emplace_back(base_event_obj);
-			}
-			obj["base_events"] = base_events;
-		}
-	}
+				return rtti_factory == nullptr ? rtti_factory_counts {} : read_rtti_factory_counts(*rtti_factory);
+			},
+			ready_options);
 
-	void
-	visit_rtti(rtti_json &result, RTTIBase *rtti) {
-		if (rtti == nullptr) {
+		auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(ready.waited).count();
+		if (rtti_factory == nullptr) {
+			g_output << "[rtti] could not locate the rtti factory after " << waited << " ms, not dumping\n";
+			g_output.flush();
 			return;
 		}
 
-		if (!result.visited.emplace(reinterpret_cast<uint64_t>(rtti)).second) {
-			return;
+		if (ready.state == rtti_ready_state::ready) {
+			g_output << "[rtti] factory settled after " << waited << " ms";
+		} else {
+			g_output << "[rtti] factory still changing after " << waited << " ms, dumping anyway";
 		}
 
-		json obj;
-		obj["type_id"] = rtti->type_id;
-		obj["category_type_id"] = rtti->category_type_id;
-		obj["type"] = static_cast<uint8_t>(rtti->rtti_type);
-		obj["addr"] = reinterpret_cast<uint64_t>(rtti);
-
-		switch (rtti->rtti_type) {
-			case RTTIType::Primitive:
-				{
-					visit_rtti_primitive(result, obj, reinterpret_cast<RTTIPrimitive *>(rtti));
-					break;
-				}
-			case RTTIType::Reference:
-			case RTTIType::Container:
-				{
-					visit_rtti_reference(result, obj, reinterpret_cast<RTTIReference *>(rtti));
-					break;
-				}
-			case RTTIType::Enum:
-			case RTTIType::Bitset:
-				{
-					visit_rtti_enum(obj, reinterpret_cast<RTTIEnum *>(rtti));
-					break;
-				}
-			case RTTIType::Class:
-				{
-					visit_rtti_class(result, obj, reinterpret_cast<RTTIClass *>(rtti));
-					break;
-				}
-			case RTTIType::Struct: break;
+		g_output << " (" << ready.counts.rtti << " types, " << ready.counts.rtti_refs << " references, " << ready.counts.core_rtti << " core types)\n";
+
+		rtti_dump_options options {
+			.mode = g_settings.dump_rtti_parallel ? rtti_dump_mode::parallel : rtti_dump_mode::serial,
+			.thread_count = static_cast<uint32_t>(std::max(g_settings.dump_rtti_threads, 0)),
+		};
+
+		// the game's memory is only read while copying, everything after works on the copy
+		auto capture_start = std::chrono::steady_clock::now();
+		auto snapshot = rtti_snapshot::capture(*rtti_factory);
+		std::chrono::duration<double, std::milli> capture_time = std::chrono::steady_clock::now() - capture_start;
+		g_output << "[rtti] copied " << snapshot.type_count() << " types (" << snapshot.size() / 1024 << " KiB) in " << capture_time.count() << " ms\n";
+
+		if (g_settings.dump_rtti_memory) {
+			// copied again through the reader, the dump uses this copy so it matches rtti.memory exactly
+			memory_recorder recorder(read_process_memory);
+			auto factory_address = reinterpret_cast<uint64_t>(rtti_factory);
+			if (auto recorded = rtti_snapshot::capture(factory_address, recorder.reader()); recorded) {
+				snapshot = std::move(*recorded);
+				std::ofstream memory_data("./rtti.memory", std::ios::binary);
+				recorder.write(memory_data, factory_address);
+				g_output << "[rtti] saved " << recorder.size() / 1024 << " KiB of memory to rtti.memory\n";
+			} else {
+				g_output << "[rtti] could not read the factory again, not saving rtti.memory\n";
+			}
 		}
 
-		result.rtti.emplace_back(obj);
-	}
-
-#pragma clang diagnostic pop
-
-	void
-	dump_rtti() {
-		using namespace std::chrono_literals;
-
-		g_output << "[rtti] sleeping by 5 seconds to give the game a chance to "
-					"set up...\n";
-		std::this_thread::sleep_for(5s);
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
 
 		g_output << "[rtti] dumping...\n";
 
 		g_output.flush();
 
-		rtti_json rtti;
+		if (g_settings.dump_rtti_binary && g_settings.dump_rtti_delta) {
+			g_output << "[rtti] dump_rtti_binary and dump_rtti_delta are both set, writing a full rtti.bin and no delta\n";
+		}
 
-		for (const auto &rtti_record : rtti_factory->rtti) {
-			visit_rtti(rtti, rtti_record.rtti);
+		// rtti.idx is built from the bytes of rtti.bin, they are serialized once for both files
+		std::optional<rtti_binary_buffer> binary;
+		if (g_settings.dump_rtti_index) {
+			binary = build_rtti_binary(snapshot, options);
 		}
 
-		for (const auto &ref_rtti_record : rtti_factory->rtti_refs) {
-			for (const auto &rtti_record : ref_rtti_record.rtti) {
-				visit_rtti(rtti, rtti_record.type);
-				visit_rtti(rtti, rtti_record.ref_type);
+		if (g_settings.dump_rtti_binary) {
+			std::ofstream binary_data("./rtti.bin", std::ios::binary);
+			if (binary) {
+				binary_data.write(reinterpret_cast<const char *>(binary->bytes().data()), static_cast<std::streamsize>(binary->size));
+			} else {
+				write_rtti_binary(snapshot, binary_data, options);
 			}
+		} else if (g_settings.dump_rtti_delta) {
+			dump_rtti_delta(snapshot, options);
+		} else {
+			std::ofstream json_data("./rtti.json", std::ios::binary);
+			write_rtti_json(snapshot, json_data, options);
 		}
 
-		for (const auto &rtti_record : rtti_factory->core_rtti) {
-			visit_rtti(rtti, rtti_record.rtti->rtti);
+		if (auto file = binary ? rtti_file_view::open(binary->bytes()) : std::nullopt; file) {
+			std::ofstream index_data("./rtti.idx", std::ios::binary);
+			write_rtti_index(*file, index_data);
 		}
 
-		std::ofstream json_data;
-
-		json_data.open("./rtti.json");
-		json j = rtti.rtti;
-		auto json_text = j.dump();
-		json_data.write(json_text.c_str(), static_cast<std::streamsize>(json_text.size()));
-		json_data.flush();
-		json_data.close();
-
 		g_output.flush();
 	}
 
@@ -390,17 +266,22 @@ namespace stormbird_hook {
 		g_minhook_initialized = true;
 	}
 
+	struct hook_request {
+		std::string_view name;
+		signature_target target; // hooks the address the target resolves to
+		LPVOID detour;
+		LPVOID *original;
+	};
+
 	void
-	create_hook(const std::string_view &name, std::ostream &output, HMODULE game, const hex_signature &signature, LPVOID detour, LPVOID *original) {
-		output << "[stormbird] searching for " << name << " pointer\n";
-		auto pointers = scan(game, signature);
+	create_hook(const std::string_view &name, std::ostream &output, const std::vector<uint8_t *> &pointers, LPVOID detour, LPVOID *original) {
 		if (pointers.empty()) {
 			output << "[stormbird] could not find " << name << " pointer, aborting\n";
 			return;
 		}
 
 		if (pointers.size() > 1) {
-			output << "[stormbird] found " << pointers.size() << " " << name << " pointers, too many. aborting\n";
+			output << "[stormbird] found more than one " << name << " pointer, aborting\n";
 			return;
 		}
 
@@ -421,6 +302,106 @@ namespace stormbird_hook {
 		output << "[stormbird] created " << name << " hook\n";
 	}
 
+	auto
+	get_module_path(HMODULE module) -> std::filesystem::path {
+		std::array<wchar_t, MAX_PATH + 1> path {};
+		auto length = GetModuleFileNameW(module, path.data(), static_cast<DWORD>(path.size()));
+		if (length == 0 || length >= path.size()) {
+			return {};
+		}
+
+		return { std::wstring_view(path.data(), length) };
+	}
+
+	// a signature usually breaks because a patch changed a register or an offset, so list what almost matched.
+	// these are never hooked, they are only there to make fixing the signature quicker.
+	void
+	log_near_matches(std::ostream &output, HMODULE game, const hook_request &hook) {
+		constexpr uint32_t max_mismatches = 2;
+		constexpr size_t max_listed = 4;
+
+		auto *base = reinterpret_cast<uint8_t *>(game);
+		auto near = scan_approximate(game, hook.target.signature, max_mismatches, { .scope = scan_scope::executable });
+		for (size_t index = 0; index < near.size() && index < max_listed; ++index) {
+			output << "[stormbird] " << hook.name << " nearly matches at " << std::hex << reinterpret_cast<uint64_t>(near[index].address) << " (rva " << near[index].address - base << ")" << std::dec << ", " << near[index].distance << " bytes differ\n";
+		}
+	}
+
+	// resolves hooks from the signature cache where the cached address still holds the signature,
+	// scans the code sections once for the rest, then hooks whatever was found exactly once.
+	// the cache keeps the match, not the resolved address, so it can still be verified next time.
+	void
+	create_hooks(std::ostream &output, HMODULE game, const std::vector<hook_request> &hooks) {
+		if (hooks.empty()) {
+			return;
+		}
+
+		auto *base = reinterpret_cast<uint8_t *>(game);
+		std::vector<std::vector<uint8_t *>> pointers(hooks.size());
+		std::vector<size_t> pending;
+
+		signature_cache cache(signature_cache_name);
+		std::optional<module_identity> identity;
+		if (g_settings.use_signature_cache) {
+			identity = identify_module(get_module_path(game));
+			if (identity) {
+				cache.load(*identity);
+			} else {
+				output << "[stormbird] could not identify game module, not using the signature cache\n";
+			}
+		}
+
+		for (size_t index = 0; index < hooks.size(); ++index) {
+			const auto &hook = hooks[index];
+			if (identity) {
+				auto rva = cache.find(hook.name);
+				if (rva && verify_signature(base, identity->size_of_image, *rva, hook.target.signature)) {
+					output << "[stormbird] using cached " << hook.name << " pointer\n";
+					pointers[index].push_back(base + *rva);
+					continue;
+				}
+			}
+
+			pending.push_back(index);
+		}
+
+		if (!pending.empty()) {
+			signature_batch batch;
+			for (auto index : pending) {
+				output << "[stormbird] searching for " << hooks[index].name << " pointer\n";
+				batch.add(hooks[index].target.signature);
+			}
+
+			// create_hook() only cares about zero, one or more, so each signature stops at its second match
+			auto found = scan(game, batch, { .scope = scan_scope::executable, .max_matches = 2 });
+			for (size_t id = 0; id < pending.size(); ++id) {
+				const auto &hook = hooks[pending[id]];
+				pointers[pending[id]] = std::move(found[id]);
+
+				if (pointers[pending[id]].empty()) {
+					log_near_matches(output, game, hook);
+				}
+
+				if (identity) {
+					if (pointers[pending[id]].size() == 1) {
+						cache.store(hook.name, static_cast<uint32_t>(pointers[pending[id]][0] - base));
+					} else {
+						cache.erase(hook.name);
+					}
+				}
+			}
+		}
+
+		if (identity) {
+			cache.save();
+		}
+
+		for (size_t index = 0; index < hooks.size(); ++index) {
+			const auto &hook = hooks[index];
+			create_hook(hook.name, output, resolve_matches(hook.target, pointers[index]), hook.detour, hook.original);
+		}
+	}
+
 #pragma clang diagnostic pop
 
 	namespace runtime {
@@ -460,11 +441,20 @@ namespace stormbird_hook {
 				}
 			}
 
+			std::vector<hook_request> hooks;
 			if (g_settings.dump_rtti) {
-				create_hook("rtti", g_output, g_game_module, RTTI_FACTORY_CTOR_SIGNATURE, &rtti_factory_ctor, reinterpret_cast<LPVOID *>(&fwd_rtti_factory_ctor));
+				hooks.push_back({ "rtti", RTTI_FACTORY_CTOR_SIGNATURE.view(), &rtti_factory_ctor, reinterpret_cast<LPVOID *>(&fwd_rtti_factory_ctor) });
 				rtti_factory = nullptr;
 			}
 
+			create_hooks(g_output, g_game_module, hooks);
+
+			// without the constructor hook the factory is looked up through the data sections once the game is up
+			if (g_settings.dump_rtti && fwd_rtti_factory_ctor == nullptr) {
+				g_output << "[stormbird] rtti hook not created, locating the rtti factory after startup instead\n";
+				g_rtti_dump_thread = std::thread(dump_rtti);
+			}
+
 			g_output << "[stormbird] init complete\n";
 
 			g_output.flush();
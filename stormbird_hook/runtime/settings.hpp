@@ -5,14 +5,17 @@
 #pragma once
 
 #define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
 #include <windows.h>
 
 #include <array>
+#include <string>
 #include <string_view>
 
 namespace stormbird_hook {
 	constexpr static const char *settings_name = R"(.\stormbird.ini)";
 	constexpr static const char *settings_namespace = "stormbird";
+	constexpr static const char *signature_cache_name = R"(.\stormbird.cache)";
 
 #define LOAD_SETTING_BOOL(name) (settings.name = GetPrivateProfileIntA(settings_namespace, #name, static_cast<int>(settings.name), settings_name) != 0)
 #define LOAD_SETTING_INT(name) (settings.name = GetPrivateProfileIntA(settings_namespace, #name, settings.name, settings_name))
@@ -28,6 +31,15 @@ namespace stormbird_hook {
 	struct settings {
 		bool load_renderdoc = false; // disable by default because it kills ReShade and performance in general.
 		bool dump_rtti = false; // disable by default for clutter reasons
+		bool dump_rtti_binary = false; // write rtti.bin instead of rtti.json, stormbird_rtti_json converts it back
+		bool dump_rtti_delta = false; // write only what changed since rtti.manifest, stormbird_rtti_merge rebuilds rtti.json. dump_rtti_binary wins if both are set
+		bool dump_rtti_index = false; // also write rtti.idx, the lookup tables stormbird_rtti_query reads
+		bool dump_rtti_memory = false; // also save the memory the dump read to rtti.memory, stormbird_rtti_offline dumps it again
+		bool dump_rtti_parallel = false; // dump on several threads, types are sorted by address instead of walk order
+		int dump_rtti_threads = 0; // threads for the parallel dump, 0 uses every hardware thread
+		int dump_rtti_quiet_ms = 1000; // the dump starts once the game has not registered a type for this long
+		int dump_rtti_timeout_ms = 30000; // or after this long, whether the game is done or not
+		bool use_signature_cache = true; // reuse signature addresses from the last launch if the game has not changed
 
 		std::array<char, MAX_PATH + 1> exe_name {}; // name of the exe we are patching, used to find the exe in the same directory.
 		std::array<char, MAX_PATH + 1> renderdoc_path {}; // path to renderdoc/dll
@@ -39,6 +51,15 @@ namespace stormbird_hook {
 
 			LOAD_SETTING_BOOL(load_renderdoc);
 			LOAD_SETTING_BOOL(dump_rtti);
+			LOAD_SETTING_BOOL(dump_rtti_binary);
+			LOAD_SETTING_BOOL(dump_rtti_delta);
+			LOAD_SETTING_BOOL(dump_rtti_index);
+			LOAD_SETTING_BOOL(dump_rtti_memory);
+			LOAD_SETTING_BOOL(dump_rtti_parallel);
+			LOAD_SETTING_INT(dump_rtti_threads);
+			LOAD_SETTING_INT(dump_rtti_quiet_ms);
+			LOAD_SETTING_INT(dump_rtti_timeout_ms);
+			LOAD_SETTING_BOOL(use_signature_cache);
 			LOAD_SETTING(exe_name)
 			LOAD_SETTING(renderdoc_path)
 
@@ -55,6 +76,15 @@ namespace stormbird_hook {
 			renderdoc_path[MAX_PATH] = '\0';
 			SAVE_SETTING_BOOL(load_renderdoc);
 			SAVE_SETTING_BOOL(dump_rtti);
+			SAVE_SETTING_BOOL(dump_rtti_binary);
+			SAVE_SETTING_BOOL(dump_rtti_delta);
+			SAVE_SETTING_BOOL(dump_rtti_index);
+			SAVE_SETTING_BOOL(dump_rtti_memory);
+			SAVE_SETTING_BOOL(dump_rtti_parallel);
+			SAVE_SETTING_INT(dump_rtti_threads);
+			SAVE_SETTING_INT(dump_rtti_quiet_ms);
+			SAVE_SETTING_INT(dump_rtti_timeout_ms);
+			SAVE_SETTING_BOOL(use_signature_cache);
 			SAVE_SETTING(exe_name);
 			SAVE_SETTING(renderdoc_path);
 		}
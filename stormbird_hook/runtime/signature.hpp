@@ -4,8 +4,20 @@
 
 #pragma once
 
-#include "signature_engine.hpp"
+#include <array>
+
+#include "signature_pattern.hpp"
+#include "signature_resolve.hpp"
 
 namespace stormbird_hook {
 	MAKE_SIGNATURE(RTTI_FACTORY_CTOR, "48 89 41 08 48 89 41 10 48 89 41 18 48 89 41 20 48 89 41 28 48 89 41 30 48 89 41 38 48 89 41 40 48 8b c1 48 89 ?? ?? ?? ?? ?? c3")
+
+	// the ctor ends by storing the new factory in its global, mov [rip + disp32], rax
+	inline constexpr signature_target RTTI_FACTORY_INSTANCE_TARGET { RTTI_FACTORY_CTOR_SIGNATURE, follow_rip(38) };
+
+	// every signature above, used by tools that check them against game builds
+	inline constexpr std::array signatures = {
+		NAMED_SIGNATURE(RTTI_FACTORY_CTOR),
+		NAMED_TARGET(RTTI_FACTORY_INSTANCE),
+	};
 } // namespace stormbird_hook
@@ -0,0 +1,39 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "signature_engine.hpp"
+#include "signature_simd.hpp"
+
+// fuzzy matching for signatures broken by a patch, usually one or two changed registers or struct offsets.
+// this is a diagnostic: it is only worth running once the exact scan has come up empty.
+
+namespace stormbird_hook {
+	// appends every position in [begin, end) within max_mismatches literal bytes of the signature, in ascending order.
+	inline void
+	find_signature_approximate(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results, signature_isa isa) {
+		switch (isa) {
+			case signature_isa::scalar: find_approximate_scalar(begin, end, signature, max_mismatches, results); break;
+			case signature_isa::sse2: find_approximate_sse2(begin, end, signature, max_mismatches, results); break;
+			default: find_approximate_avx2(begin, end, signature, max_mismatches, results); break;
+		}
+	}
+
+	inline void
+	find_signature_approximate(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results) {
+		find_signature_approximate(begin, end, signature, max_mismatches, results, detect_signature_isa());
+	}
+
+	// closest candidates first, ties in address order
+	template<typename Match>
+	void
+	rank_approximate_matches(std::vector<Match> &matches) {
+		std::stable_sort(matches.begin(), matches.end(), [](const Match &lhs, const Match &rhs) { return lhs.distance < rhs.distance; });
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,400 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "signature_engine.hpp"
+#include "signature_pattern.hpp"
+
+// extended patterns, for code that comes in more than one encoding:
+//   48 8B ??        a literal byte and a wildcard byte
+//   4? 8B           a wildcard nibble, e.g. any rex prefix
+//   [48 4C]         a byte set, one of the listed bytes. sets take nibble patterns and ranges: [4? 90-9F]
+//   (8B 05 | 8B 0D ?? ??)  alternatives, which may differ in length and nest. a | outside of () splits the whole pattern
+// every variant is compiled into one shift-and automaton, so all of them are matched in a single pass.
+
+namespace stormbird_hook {
+	// the byte values one pattern position accepts
+	struct byte_class {
+		std::array<uint64_t, 4> bits {};
+
+		void
+		add(uint8_t value) {
+			bits[value >> 6] |= 1ull << (value & 63);
+		}
+
+		// every byte where the bits under mask equal value
+		void
+		add_masked(uint8_t value, uint8_t mask) {
+			for (uint32_t byte = 0; byte < 256; ++byte) {
+				if ((byte & mask) == value) {
+					add(static_cast<uint8_t>(byte));
+				}
+			}
+		}
+
+		void
+		add_range(uint8_t first, uint8_t last) {
+			for (uint32_t byte = first; byte <= last; ++byte) {
+				add(static_cast<uint8_t>(byte));
+			}
+		}
+
+		[[nodiscard]] auto
+		contains(uint8_t value) const -> bool {
+			return (bits[value >> 6] & (1ull << (value & 63))) != 0;
+		}
+	};
+
+	class signature_automaton {
+	public:
+		static constexpr size_t max_variants = 256;
+		static constexpr size_t max_positions = 4096;
+
+		// nothing if the pattern is malformed, a variant is empty, or it expands past max_variants or max_positions
+		[[nodiscard]] static auto
+		parse(std::string_view pattern) -> std::optional<signature_automaton> {
+			pattern_parser parser { pattern };
+			std::vector<sequence> variants;
+			if (!parser.parse_alternatives(variants) || parser.index != pattern.size()) {
+				return std::nullopt;
+			}
+
+			size_t positions = 0;
+			for (const auto &variant : variants) {
+				if (variant.empty()) {
+					return std::nullopt;
+				}
+
+				positions += variant.size();
+			}
+
+			if (positions > max_positions) {
+				return std::nullopt;
+			}
+
+			signature_automaton automaton;
+			automaton.compile(variants);
+			return automaton;
+		}
+
+		[[nodiscard]] auto
+		variant_count() const -> size_t {
+			return lengths.size();
+		}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+		// appends the non-overlapping matches in [begin, end) in ascending order, the same rules as find_signature().
+		// when variants start at the same address the one written first wins.
+		// alignment and max_matches of the scan policy apply, the rva window is up to the caller.
+		void
+		find(const uint8_t *begin, const uint8_t *end, std::vector<const uint8_t *> &results, const scan_options &options = {}) const {
+			struct hit {
+				const uint8_t *start;
+				uint32_t variant;
+			};
+
+			// hits come out ordered by where they end, the leftmost-first walk needs them by where they start. a hit is
+			// seen at most longest - 1 bytes after its start, so once the scan is that far past a start every hit
+			// starting there or before is known and the walk can take them. only those few bytes of hits are kept.
+			std::vector<hit> hits;
+			auto settle_at = std::numeric_limits<uintptr_t>::max(); // where the earliest kept hit can be taken
+			auto limit = remaining_matches(options, 0);
+			const auto *next = begin;
+
+			// takes the hits starting at or before settled, true once max_matches is reached
+			auto settle = [&](const uint8_t *settled) {
+				std::sort(hits.begin(), hits.end(), [](const hit &lhs, const hit &rhs) { return lhs.start != rhs.start ? lhs.start < rhs.start : lhs.variant < rhs.variant; });
+
+				size_t taken = 0;
+				for (; taken < hits.size() && hits[taken].start <= settled; ++taken) {
+					const auto &[start, variant] = hits[taken];
+					if (start < next) {
+						continue;
+					}
+
+					results.push_back(start);
+					next = start + lengths[variant];
+					if (--limit == 0) {
+						return true;
+					}
+				}
+
+				hits.erase(hits.begin(), hits.begin() + static_cast<ptrdiff_t>(taken));
+				settle_at = hits.empty() ? std::numeric_limits<uintptr_t>::max() : reinterpret_cast<uintptr_t>(hits.front().start) + longest - 1;
+				return false;
+			};
+
+			auto alignment_mask = static_cast<uintptr_t>(std::max(options.alignment, 1u) - 1);
+			auto record = [&](const uint8_t *cur, size_t word, uint64_t accepted) {
+				while (accepted != 0) {
+					auto variant = position_variant[(word * 64) + std::countr_zero(accepted)];
+					accepted &= accepted - 1;
+
+					const auto *start = cur + 1 - lengths[variant];
+					if ((reinterpret_cast<uintptr_t>(start) & alignment_mask) == 0) {
+						hits.push_back({ start, variant });
+						settle_at = std::min(settle_at, reinterpret_cast<uintptr_t>(start) + longest - 1);
+					}
+				}
+			};
+
+			if (limit == 0) {
+				return;
+			}
+
+			if (words == 1) {
+				uint64_t state = 0;
+				for (const auto *cur = begin; cur < end; ++cur) {
+					state = ((state << 1) | starts[0]) & table[*cur];
+					if ((state & accepts[0]) != 0) {
+						record(cur, 0, state & accepts[0]);
+					}
+
+					if (reinterpret_cast<uintptr_t>(cur) >= settle_at && settle(cur + 1 - longest)) {
+						return;
+					}
+				}
+			} else {
+				std::vector<uint64_t> state(words);
+				for (const auto *cur = begin; cur < end; ++cur) {
+					const auto *row = table.data() + (static_cast<size_t>(*cur) * words);
+					for (auto word = words; word-- > 0;) {
+						auto carry = word > 0 ? state[word - 1] >> 63 : 0;
+						state[word] = ((state[word] << 1) | carry | starts[word]) & row[word];
+					}
+
+					for (size_t word = 0; word < words; ++word) {
+						if ((state[word] & accepts[word]) != 0) {
+							record(cur, word, state[word] & accepts[word]);
+						}
+					}
+
+					if (reinterpret_cast<uintptr_t>(cur) >= settle_at && settle(cur + 1 - longest)) {
+						return;
+					}
+				}
+			}
+
+			settle(end);
+		}
+
+#pragma clang diagnostic pop
+
+	private:
+		using sequence = std::vector<byte_class>;
+
+		struct pattern_parser {
+			std::string_view pattern;
+			size_t index { 0 };
+
+			void
+			skip_spaces() {
+				while (index < pattern.size() && pattern[index] == ' ') {
+					index++;
+				}
+			}
+
+			auto
+			parse_byte(uint8_t &value, uint8_t &mask) -> bool {
+				if (index + 1 >= pattern.size() || !is_pattern_nibble(pattern[index]) || !is_pattern_nibble(pattern[index + 1])) {
+					return false;
+				}
+
+				std::tie(value, mask) = parse_pattern_byte(pattern[index], pattern[index + 1]);
+				index += 2;
+				return true;
+			}
+
+			// [...] with the opening bracket already consumed
+			auto
+			parse_set(byte_class &set) -> bool {
+				auto empty = true;
+				while (true) {
+					skip_spaces();
+					if (index >= pattern.size()) {
+						return false;
+					}
+
+					if (pattern[index] == ']') {
+						index++;
+						return !empty;
+					}
+
+					uint8_t value = 0;
+					uint8_t mask = 0;
+					if (!parse_byte(value, mask)) {
+						return false;
+					}
+
+					if (index < pattern.size() && pattern[index] == '-') { // a range, both ends literal
+						index++;
+						uint8_t last = 0;
+						uint8_t last_mask = 0;
+						if (mask != 0xFF || !parse_byte(last, last_mask) || last_mask != 0xFF || last < value) {
+							return false;
+						}
+
+						set.add_range(value, last);
+					} else {
+						set.add_masked(value, mask);
+					}
+
+					empty = false;
+				}
+			}
+
+			// appends every element to every variant built so far
+			static auto
+			append(std::vector<sequence> &variants, const std::vector<sequence> &tails) -> bool {
+				if (variants.size() * tails.size() > max_variants) {
+					return false;
+				}
+
+				std::vector<sequence> product;
+				size_t positions = 0;
+				for (const auto &head : variants) {
+					for (const auto &tail : tails) {
+						auto &variant = product.emplace_back(head);
+						variant.insert(variant.end(), tail.begin(), tail.end());
+						positions += variant.size();
+					}
+				}
+
+				if (positions > max_positions) {
+					return false;
+				}
+
+				variants = std::move(product);
+				return true;
+			}
+
+			// a sequence of bytes, sets and groups up to a | or ), every way it can be read
+			auto
+			parse_sequence(std::vector<sequence> &variants) -> bool {
+				variants = { sequence {} };
+				while (true) {
+					skip_spaces();
+					if (index >= pattern.size() || pattern[index] == ')' || pattern[index] == '|') {
+						return true;
+					}
+
+					if (pattern[index] == '[') {
+						index++;
+						byte_class set;
+						if (!parse_set(set) || !append(variants, { sequence { set } })) {
+							return false;
+						}
+
+						continue;
+					}
+
+					if (pattern[index] == '(') {
+						index++;
+						std::vector<sequence> alternatives;
+						if (!parse_alternatives(alternatives) || index >= pattern.size() || pattern[index] != ')' || !append(variants, alternatives)) {
+							return false;
+						}
+
+						index++;
+						continue;
+					}
+
+					uint8_t value = 0;
+					uint8_t mask = 0;
+					if (!parse_byte(value, mask)) {
+						return false;
+					}
+
+					byte_class element;
+					element.add_masked(value, mask);
+					if (!append(variants, { sequence { element } })) {
+						return false;
+					}
+				}
+			}
+
+			// sequences separated by |, up to a ) or the end of the pattern
+			auto
+			parse_alternatives(std::vector<sequence> &alternatives) -> bool {
+				while (true) {
+					std::vector<sequence> alternative;
+					if (!parse_sequence(alternative)) {
+						return false;
+					}
+
+					alternatives.insert(alternatives.end(), alternative.begin(), alternative.end());
+					if (alternatives.size() > max_variants) {
+						return false;
+					}
+
+					if (index < pattern.size() && pattern[index] == '|') {
+						index++;
+						continue;
+					}
+
+					return true;
+				}
+			}
+		};
+
+		// lays the variants out back to back in one bit vector. a variant's first bit is always set in starts,
+		// so the carry out of the previous variant's last bit does no harm.
+		void
+		compile(const std::vector<sequence> &variants) {
+			size_t positions = 0;
+			for (const auto &variant : variants) {
+				positions += variant.size();
+			}
+
+			words = (positions + 63) / 64;
+			table.assign(256 * words, 0);
+			starts.assign(words, 0);
+			accepts.assign(words, 0);
+			position_variant.assign(words * 64, 0);
+
+			size_t position = 0;
+			for (uint32_t id = 0; id < variants.size(); ++id) {
+				const auto &variant = variants[id];
+				lengths.push_back(static_cast<uint32_t>(variant.size()));
+				longest = std::max(longest, static_cast<uint32_t>(variant.size()));
+				starts[position / 64] |= 1ull << (position % 64);
+
+				for (const auto &element : variant) {
+					for (uint32_t byte = 0; byte < 256; ++byte) {
+						if (element.contains(static_cast<uint8_t>(byte))) {
+							table[(byte * words) + (position / 64)] |= 1ull << (position % 64);
+						}
+					}
+
+					position++;
+				}
+
+				accepts[(position - 1) / 64] |= 1ull << ((position - 1) % 64);
+				position_variant[position - 1] = id;
+			}
+		}
+
+		size_t words { 0 };
+		std::vector<uint64_t> table; // for each byte value, the positions accepting it
+		std::vector<uint64_t> starts; // first position of every variant
+		std::vector<uint64_t> accepts; // last position of every variant
+		std::vector<uint32_t> position_variant; // variant ending at each accepting position
+		std::vector<uint32_t> lengths; // length of each variant
+		uint32_t longest { 0 }; // length of the longest variant
+	};
+} // namespace stormbird_hook
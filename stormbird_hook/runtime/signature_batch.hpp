@@ -0,0 +1,165 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "signature_engine.hpp"
+
+namespace stormbird_hook {
+	// matches many signatures in a single pass over memory.
+	// every signature is bucketed by its rarest literal byte. with avx2 a nibble lookup skips 32 bytes at a time to the
+	// next byte that may anchor some signature, otherwise each scanned byte costs one table lookup. only bytes that
+	// anchor some signature go on to a full check.
+	// a batch of a few signatures is cheaper to scan one vectorized find_signature() pass per signature.
+	class signature_batch {
+	public:
+		// up to this many signatures are scanned one pass each, where the bench has the passes at least as fast
+		static constexpr size_t separate_pass_limit = 8;
+
+		// bytes the nibble lookup runs ahead of the full checks
+		static constexpr size_t anchor_slice_size = 64 * 1024;
+
+		// returns the index used for this signature in the results.
+		// the signature's storage has to outlive the batch.
+		auto
+		add(const hex_signature &signature) -> size_t {
+			signatures.push_back(signature);
+			dirty = true;
+			return signatures.size() - 1;
+		}
+
+		[[nodiscard]] auto
+		size() const -> size_t {
+			return signatures.size();
+		}
+
+		// builds the anchor buckets, add() invalidates them.
+		void
+		build() {
+			bucket_offsets.fill(0);
+			bucket_ids.clear();
+			anchors = {};
+
+			for (const auto &signature : signatures) {
+				if (signature.has_literal) {
+					bucket_offsets[signature.values[signature.anchor] + 1]++;
+					anchors.add(signature.values[signature.anchor]);
+				}
+			}
+
+			for (size_t index = 1; index < bucket_offsets.size(); ++index) {
+				bucket_offsets[index] += bucket_offsets[index - 1];
+			}
+
+			bucket_ids.resize(bucket_offsets.back());
+			auto fill = bucket_offsets;
+			for (uint32_t id = 0; id < signatures.size(); ++id) {
+				const auto &signature = signatures[id];
+				if (signature.has_literal) {
+					bucket_ids[fill[signature.values[signature.anchor]]++] = id;
+				}
+			}
+
+			dirty = false;
+		}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+		// appends the non-overlapping matches of every signature in [begin, end) to results[id],
+		// exactly as find_signature() would for each signature on its own.
+		// max_matches caps results[id] as a whole, so it carries over when results are kept across regions,
+		// and the walk ends as soon as every signature has hit it. the rva window does not apply to a raw range.
+		void
+		find(const uint8_t *begin, const uint8_t *end, std::vector<std::vector<const uint8_t *>> &results, const scan_options &options = {}) {
+			if (dirty) {
+				build();
+			}
+
+			results.resize(signatures.size());
+
+			auto isa = detect_signature_isa();
+			auto alignment = std::max(options.alignment, 1u);
+			auto alignment_mask = static_cast<uintptr_t>(alignment - 1);
+
+			// a signature without literal bytes has nothing to bucket on
+			auto separate = signatures.size() <= separate_pass_limit;
+			size_t pending = 0;
+			std::vector<size_t> limits(signatures.size());
+			for (size_t id = 0; id < signatures.size(); ++id) {
+				limits[id] = remaining_matches(options, results[id].size());
+				if (separate || !signatures[id].has_literal) {
+					find_signature(begin, end, signatures[id], results[id], isa, alignment, limits[id]);
+				} else if (limits[id] > 0) {
+					pending++;
+				}
+			}
+
+			if (bucket_ids.empty() || pending == 0) {
+				return;
+			}
+
+			std::vector<const uint8_t *> next(signatures.size(), begin);
+			auto length = static_cast<size_t>(end - begin);
+
+			// the full check of every signature anchored on the byte at cur
+			auto check = [&](const uint8_t *cur) {
+				auto offset = static_cast<size_t>(cur - begin);
+				for (auto bucket = bucket_offsets[*cur]; bucket < bucket_offsets[*cur + 1]; ++bucket) {
+					auto id = bucket_ids[bucket];
+					const auto &signature = signatures[id];
+					if (limits[id] == 0 || offset < signature.anchor || offset - signature.anchor + signature.size > length) {
+						continue;
+					}
+
+					const auto *candidate = cur - signature.anchor;
+					if (candidate < next[id] || (reinterpret_cast<uintptr_t>(candidate) & alignment_mask) != 0 || candidate[signature.second_anchor] != signature.values[signature.second_anchor] || !signature.matches(candidate)) {
+						continue;
+					}
+
+					results[id].push_back(candidate);
+					next[id] = candidate + signature.size;
+					if (--limits[id] == 0) {
+						pending--;
+					}
+				}
+			};
+
+			if (isa != signature_isa::avx2 && isa != signature_isa::avx512) {
+				for (const auto *cur = begin; cur < end && pending > 0; ++cur) {
+					check(cur);
+				}
+
+				return;
+			}
+
+			// the nibble lookup collects the candidates of one slice at a time, so a batch that is done stops early
+			std::vector<uint32_t> offsets;
+			for (const auto *slice = begin; slice < end && pending > 0;) {
+				const auto *slice_end = slice + std::min<size_t>(anchor_slice_size, end - slice);
+				offsets.clear();
+				find_anchor_bytes_avx2(slice, slice_end, anchors, offsets);
+				for (size_t index = 0; index < offsets.size() && pending > 0; ++index) {
+					check(slice + offsets[index]);
+				}
+
+				slice = slice_end;
+			}
+		}
+
+#pragma clang diagnostic pop
+
+	private:
+		std::vector<hex_signature> signatures;
+		std::array<uint32_t, 257> bucket_offsets {}; // bucket_ids range for each anchor byte value
+		std::vector<uint32_t> bucket_ids;
+		anchor_byte_set anchors; // every byte some bucket is keyed on
+		bool dirty { true };
+	};
+} // namespace stormbird_hook
@@ -0,0 +1,152 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "signature_cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "hash.hpp"
+#include "mapped_file.hpp"
+
+namespace stormbird_hook {
+	auto
+	identify_module(std::span<const uint8_t> file, const pe_image &image) -> module_identity {
+		module_identity identity { image.timestamp, image.size_of_image, 0 };
+
+		for (const auto *section : select_sections(image, { .scope = scan_scope::executable })) {
+			if (section->raw_offset >= file.size()) {
+				continue;
+			}
+
+			auto size = std::min<size_t>({ section->raw_size, section->mapped_size(), file.size() - section->raw_offset });
+			identity.code_hash = hash_bytes(file.subspan(section->raw_offset, size), identity.code_hash);
+		}
+
+		return identity;
+	}
+
+	auto
+	identify_module(const std::filesystem::path &path) -> std::optional<module_identity> {
+		mapped_file file(path);
+		if (!file.is_open()) {
+			return std::nullopt;
+		}
+
+		auto image = parse_pe_image(file.data());
+		if (!image) {
+			return std::nullopt;
+		}
+
+		return identify_module(file.data(), *image);
+	}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	auto
+	verify_signature(const uint8_t *base, size_t size, uint32_t rva, const hex_signature &signature) -> bool {
+		if (signature.size == 0 || rva > size || size - rva < signature.size) {
+			return false;
+		}
+
+		return signature.matches(base + rva);
+	}
+
+#pragma clang diagnostic pop
+
+	// format:
+	//   module <timestamp> <size_of_image> <code_hash>
+	//   <name> <rva>
+	// numbers are hex.
+	void
+	signature_cache::load(const module_identity &module) {
+		identity = module;
+		entries.clear();
+		dirty = false;
+
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			return;
+		}
+
+		std::string line;
+		auto matches = false;
+		while (std::getline(file, line)) {
+			std::istringstream stream(line);
+			std::string name;
+			stream >> name;
+			if (name.empty() || name[0] == '#') {
+				continue;
+			}
+
+			if (name == "module") {
+				module_identity cached;
+				stream >> std::hex >> cached.timestamp >> cached.size_of_image >> cached.code_hash;
+				matches = !stream.fail() && cached == identity;
+				continue;
+			}
+
+			uint32_t rva = 0;
+			stream >> std::hex >> rva;
+			if (matches && !stream.fail()) {
+				entries[name] = rva;
+			}
+		}
+
+		// a cache for another build is stale, rewrite it
+		dirty = !matches;
+	}
+
+	void
+	signature_cache::save() {
+		if (!dirty) {
+			return;
+		}
+
+		std::ofstream file(path, std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+
+		file << "# stormbird signature cache, safe to delete\n";
+		file << std::hex << "module " << identity.timestamp << " " << identity.size_of_image << " " << identity.code_hash << "\n";
+		for (const auto &[name, rva] : entries) {
+			file << name << " " << rva << "\n";
+		}
+
+		dirty = false;
+	}
+
+	auto
+	signature_cache::find(std::string_view name) const -> std::optional<uint32_t> {
+		auto entry = entries.find(name);
+		if (entry == entries.end()) {
+			return std::nullopt;
+		}
+
+		return entry->second;
+	}
+
+	void
+	signature_cache::store(std::string_view name, uint32_t rva) {
+		auto entry = entries.find(name);
+		if (entry != entries.end() && entry->second == rva) {
+			return;
+		}
+
+		entries.insert_or_assign(std::string(name), rva);
+		dirty = true;
+	}
+
+	void
+	signature_cache::erase(std::string_view name) {
+		auto entry = entries.find(name);
+		if (entry != entries.end()) {
+			entries.erase(entry);
+			dirty = true;
+		}
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,71 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "pe_image.hpp"
+#include "signature_engine.hpp"
+
+namespace stormbird_hook {
+	// identifies one exact build of a module
+	struct module_identity {
+		uint32_t timestamp { 0 };
+		uint32_t size_of_image { 0 };
+		uint64_t code_hash { 0 }; // hash_bytes() of every executable section as stored in the file
+
+		auto
+		operator==(const module_identity &) const -> bool = default;
+	};
+
+	// hashes the code sections of the pe file on disk. the file is used instead of the loaded image,
+	// since relocations and our own hooks change the loaded bytes.
+	auto
+	identify_module(std::span<const uint8_t> file, const pe_image &image) -> module_identity;
+
+	auto
+	identify_module(const std::filesystem::path &path) -> std::optional<module_identity>;
+
+	// checks that a cached rva still holds the signature, without scanning anything
+	auto
+	verify_signature(const uint8_t *base, size_t size, uint32_t rva, const hex_signature &signature) -> bool;
+
+	// resolved signature rvas from previous launches, kept in a small text file.
+	// entries are only used when the module identity matches the one they were resolved against.
+	class signature_cache {
+	public:
+		explicit signature_cache(std::filesystem::path path) : path(std::move(path)) { }
+
+		// reads the cache file, drops everything if it belongs to another build
+		void
+		load(const module_identity &module);
+
+		// writes the cache file if anything changed
+		void
+		save();
+
+		[[nodiscard]] auto
+		find(std::string_view name) const -> std::optional<uint32_t>;
+
+		void
+		store(std::string_view name, uint32_t rva);
+
+		void
+		erase(std::string_view name);
+
+	private:
+		std::filesystem::path path;
+		module_identity identity;
+		std::map<std::string, uint32_t, std::less<>> entries;
+		bool dirty { false };
+	};
+} // namespace stormbird_hook
@@ -4,108 +4,197 @@
 
 #pragma once
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
-
-#include <Psapi.h>
 #include <algorithm>
-#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <limits>
+#include <span>
 #include <string_view>
+#include <utility>
 #include <vector>
 
+#include "pe_image.hpp"
+#include "signature_pattern.hpp"
+#include "signature_simd.hpp"
+
 namespace stormbird_hook {
-	struct signature_byte {
-		bool any { false }; // if true, any value is accepted
-		uint8_t value { 0 }; // value to match
+	enum class scan_mode : uint8_t {
+		serial,
+		parallel
+	};
 
-		auto
-		operator==(uint8_t byte) const -> bool {
-			return any || value == byte; // if any is true, any value is accepted
-		}
+	// which parts of the image are scanned
+	enum class scan_scope : uint8_t {
+		module, // every committed page of the image, headers and data included
+		executable, // only sections holding code
+		named // only the section named in scan_options::section
 	};
 
-	struct hex_signature {
-		std::array<signature_byte, 128> signature; // signature to match
-		uint32_t size { 0 }; // size of the signature
+	constexpr size_t unlimited_matches = std::numeric_limits<size_t>::max();
+
+	// how a scan is run, and the policy for which matches it looks for.
+	// a scan stops as soon as max_matches are found, so a uniqueness check only has to look for a second match.
+	struct scan_options {
+		scan_mode mode { scan_mode::serial };
+		uint32_t thread_count { 0 }; // 0 uses every hardware thread
+		size_t chunk_size { 1024 * 1024 }; // bytes of starting positions per work item
+		scan_scope scope { scan_scope::module };
+		std::string_view section {}; // section name for scan_scope::named, e.g. ".text"
+		size_t max_matches { 0 }; // stop after this many matches, 0 finds every match
+		uint32_t alignment { 1 }; // matches only start at addresses that are a multiple of this power of two, e.g. 16 for function entries
+		uint32_t rva_begin { 0 }; // only bytes in [rva_begin, rva_end) of the image are scanned
+		uint32_t rva_end { std::numeric_limits<uint32_t>::max() };
 	};
 
+	// how many more matches the policy allows once found have been collected
 	constexpr auto
-	parse_octet(const char &value) -> uint8_t {
-		if (value >= '0' && value <= '9') { // if the value is a number
-			return value - '0';
-		}
-		if (value >= 'A' && value <= 'F') { // if the value is an uppercase letter
-			return 10 + value - 'A';
-		}
-		if (value >= 'a' && value <= 'f') { // if the value is a lowercase letter
-			return 10 + value - 'a';
+	remaining_matches(const scan_options &options, size_t found) -> size_t {
+		if (options.max_matches == 0) {
+			return unlimited_matches;
 		}
 
-		return 0;
+		return found >= options.max_matches ? 0 : options.max_matches - found;
 	}
 
+	// the part of [rva, rva + size) inside the policy's rva window, as an offset from rva and a size
 	constexpr auto
-	parse_signature(const std::string_view &hex_string) -> hex_signature {
-		hex_signature signature;
-		for (size_t index = 0; index < hex_string.size(); index += 2) {
-			if (hex_string[index] == ' ') { // if the value is a space
-				index -= 1;
-				continue;
-			}
-
-			if (hex_string[index] == '?' && hex_string[index + 1] == '?') { // if the value is a wildcard
-				signature.signature[signature.size++].any = true;
-			} else { // if the value is a hex value
-				signature.signature[signature.size++].value = (parse_octet(hex_string[index]) << 4) | parse_octet(hex_string[index + 1]);
-			}
+	clip_to_window(uint32_t rva, size_t size, const scan_options &options) -> std::pair<size_t, size_t> {
+		auto begin = std::max<uint64_t>(rva, options.rva_begin);
+		auto end = std::min<uint64_t>(static_cast<uint64_t>(rva) + size, options.rva_end);
+		if (begin >= end) {
+			return { 0, 0 };
 		}
 
-		return signature;
+		return { static_cast<size_t>(begin - rva), static_cast<size_t>(end - begin) };
 	}
 
+	using scan_region = std::pair<const uint8_t *, const uint8_t *>;
+
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
 
-	auto
-	scan(HMODULE module, const hex_signature &signature) -> std::vector<uint8_t *> {
-		std::vector<uint8_t *> results;
+	// portable matcher: horspool over the precomputed shift table, used where there are no vector units
+	// and as a reference for the vectorized paths.
+	inline void
+	find_signature_scalar(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		if (signature.size == 0) {
+			return;
+		}
+
+		const auto &shift = *signature.shift;
+		const auto last = signature.size - 1;
+		for (const auto *cur = begin; end - cur >= static_cast<ptrdiff_t>(signature.size);) {
+			if (signature.matches(cur)) {
+				results.push_back(cur);
+				cur += signature.size;
+				continue;
+			}
+
+			cur += shift[cur[last]];
+		}
+	}
 
-		MODULEINFO module_info;
-		if (!GetModuleInformation(GetCurrentProcess(), module, &module_info, sizeof(module_info))) {
-			return results;
+	// finds every non-overlapping match in [begin, end) using the given instruction set.
+	inline void
+	find_signature(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results, signature_isa isa) {
+		if (isa == signature_isa::scalar) {
+			find_signature_scalar(begin, end, signature, results);
+			return;
 		}
 
-		auto *start = reinterpret_cast<uint8_t *>(module);
-		auto *module_end = start + module_info.SizeOfImage;
-		auto *cur = start;
+		switch (isa) {
+			case signature_isa::avx512: find_signature_avx512(begin, end, signature, results); break;
+			case signature_isa::avx2: find_signature_avx2(begin, end, signature, results); break;
+			default: find_signature_sse2(begin, end, signature, results); break;
+		}
+	}
 
-		while (cur < module_end) {
-			// get the memory information
-			MEMORY_BASIC_INFORMATION mem;
-			if ((VirtualQuery(cur, &mem, sizeof(mem)) == 0u) || mem.State != MEM_COMMIT || ((mem.Protect & PAGE_GUARD) != 0u)) {
-				break;
+	inline void
+	find_signature(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		find_signature(begin, end, signature, results, detect_signature_isa());
+	}
+
+	// only every alignment-th address can start a match, so those are checked directly instead of searched for.
+	// appends at most limit matches.
+	inline void
+	find_signature_aligned(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results, uint32_t alignment, size_t limit) {
+		if (signature.size == 0 || end - begin < static_cast<ptrdiff_t>(signature.size)) {
+			return;
+		}
+
+		auto length = static_cast<size_t>(end - begin);
+		auto align_up = [&](size_t offset) {
+			auto misalignment = (reinterpret_cast<uintptr_t>(begin) + offset) & (alignment - 1);
+			return misalignment == 0 ? offset : offset + alignment - misalignment;
+		};
+
+		size_t count = 0;
+		for (auto offset = align_up(0); count < limit && offset <= length - signature.size;) {
+			const auto *cur = begin + offset;
+			if ((!signature.has_literal || cur[signature.anchor] == signature.values[signature.anchor]) && signature.matches(cur)) {
+				results.push_back(cur);
+				count++;
+				offset = align_up(offset + signature.size);
+				continue;
 			}
 
-			auto *begin = reinterpret_cast<uint8_t *>(mem.BaseAddress);
-			auto *end = begin + mem.RegionSize;
+			offset += alignment;
+		}
+	}
 
-			// search for the signature
-			uint8_t *found = std::search(begin, end, signature.signature.begin(), signature.signature.begin() + signature.size);
-			while (found < end && found >= begin) {
-				results.push_back(found);
-				found = std::search(found + signature.size, end, signature.signature.begin(), signature.signature.begin() + signature.size);
+	// serial scan under a scan policy, appends at most limit matches.
+	// with a limit the range is searched slice by slice, restarting each slice where the last match ended,
+	// which finds the same matches as one pass but can stop after the slice holding the last one.
+	inline void
+	find_signature(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results, signature_isa isa, uint32_t alignment, size_t limit, size_t slice_size = 1024 * 1024) {
+		if (alignment > 1) {
+			find_signature_aligned(begin, end, signature, results, alignment, limit);
+			return;
+		}
+
+		if (limit == unlimited_matches) {
+			find_signature(begin, end, signature, results, isa);
+			return;
+		}
+
+		slice_size = std::max<size_t>(slice_size, signature.size);
+		const auto *next = begin;
+		while (limit > 0 && signature.size > 0 && end - next >= static_cast<ptrdiff_t>(signature.size)) {
+			const auto *slice_end = next + std::min<size_t>(slice_size, end - next);
+			const auto *overlap_end = slice_end + std::min<size_t>(signature.size - 1, end - slice_end);
+
+			auto before = results.size();
+			find_signature(next, overlap_end, signature, results, isa);
+			if (results.size() - before > limit) {
+				results.resize(before + limit);
 			}
 
-			cur = end;
-			mem = {};
+			limit -= results.size() - before;
+			next = results.size() > before ? std::max(slice_end, results.back() + signature.size) : slice_end;
 		}
+	}
 
+	inline auto
+	find_signature(std::span<const uint8_t> data, const hex_signature &signature) -> std::vector<const uint8_t *> {
+		std::vector<const uint8_t *> results;
+		find_signature(data.data(), data.data() + data.size(), signature, results);
 		return results;
 	}
 
-#pragma clang diagnostic pop
+	// sections of the image picked by the scan scope, in address order.
+	inline auto
+	select_sections(const pe_image &image, const scan_options &options) -> std::vector<const pe_section *> {
+		std::vector<const pe_section *> sections;
+		for (const auto &section : image.sections) {
+			if (options.scope == scan_scope::module || (options.scope == scan_scope::executable && section.executable()) || (options.scope == scan_scope::named && section.name() == options.section)) {
+				sections.push_back(&section);
+			}
+		}
+
+		std::sort(sections.begin(), sections.end(), [](const pe_section *lhs, const pe_section *rhs) { return lhs->virtual_address < rhs->virtual_address; });
+		return sections;
+	}
 
-#define MAKE_SIGNATURE(codename, signature) const hex_signature constexpr codename##_SIGNATURE = parse_signature(signature);
+#pragma clang diagnostic pop
 
 } // namespace stormbird_hook
@@ -0,0 +1,207 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "pe_image.hpp"
+#include "signature_approximate.hpp"
+#include "signature_automaton.hpp"
+#include "signature_batch.hpp"
+#include "signature_engine.hpp"
+#include "signature_parallel.hpp"
+#include "signature_resolve.hpp"
+
+// the offline side of the signature engine, scans pe files on disk without loading them.
+
+namespace stormbird_hook {
+	struct approximate_rva {
+		uint32_t rva { 0 };
+		uint32_t distance { 0 };
+	};
+
+	// a section's bytes inside the file, along with the rva they are loaded at
+	struct file_region {
+		std::span<const uint8_t> bytes;
+		uint32_t rva { 0 };
+	};
+
+	// views into the raw section data picked by the scan scope and the rva window, nothing is copied.
+	// the zero fill between raw_size and virtual_size is not part of the file and is not scanned.
+	inline auto
+	file_regions(std::span<const uint8_t> file, const pe_image &image, const scan_options &options) -> std::vector<file_region> {
+		std::vector<file_region> regions;
+		if (options.scope == scan_scope::module) {
+			// headers first, then every section, same as the loaded image
+			auto [offset, size] = clip_to_window(0, std::min<size_t>(image.size_of_headers, file.size()), options);
+			if (size > 0) {
+				regions.push_back({ file.subspan(offset, size), static_cast<uint32_t>(offset) });
+			}
+		}
+
+		for (const auto *section : select_sections(image, options)) {
+			if (section->raw_offset >= file.size() || section->raw_size == 0) {
+				continue;
+			}
+
+			auto raw_size = std::min<size_t>({ section->raw_size, section->mapped_size(), file.size() - section->raw_offset });
+			auto [offset, size] = clip_to_window(section->virtual_address, raw_size, options);
+			if (size > 0) {
+				regions.push_back({ file.subspan(section->raw_offset + offset, size), static_cast<uint32_t>(section->virtual_address + offset) });
+			}
+		}
+
+		return regions;
+	}
+
+	// reads the file as if it were loaded at its preferred image base, so absolute pointers stored in it resolve as-is.
+	// only bytes backed by the file are readable, the zero fill of a section is not.
+	struct file_reader {
+		std::span<const uint8_t> file;
+		const pe_image *image { nullptr };
+
+		auto
+		operator()(uint64_t address, void *out, size_t size) const -> bool {
+			if (address < image->image_base || address - image->image_base >= image->size_of_image) {
+				return false;
+			}
+
+			auto rva = static_cast<uint32_t>(address - image->image_base);
+			uint64_t offset = rva;
+			uint64_t available = rva < image->size_of_headers ? image->size_of_headers - rva : 0;
+			if (available == 0) {
+				const auto *section = image->section_for_rva(rva);
+				if (section == nullptr || rva - section->virtual_address >= section->raw_size) {
+					return false;
+				}
+
+				offset = static_cast<uint64_t>(section->raw_offset) + (rva - section->virtual_address);
+				available = section->raw_size - (rva - section->virtual_address);
+			}
+
+			if (available < size || offset > file.size() || file.size() - offset < size) {
+				return false;
+			}
+
+			std::memcpy(out, file.data() + offset, size);
+			return true;
+		}
+	};
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// follows the target's steps from each match rva, dropping matches that do not resolve inside the image
+	inline auto
+	resolve_file_matches(std::span<const uint8_t> file, const pe_image &image, const signature_target &target, const std::vector<uint32_t> &matches) -> std::vector<uint32_t> {
+		std::vector<uint32_t> results;
+		file_reader reader { file, &image };
+		for (auto rva : matches) {
+			auto address = resolve_target(image.image_base + rva, target, reader);
+			if (address && *address >= image.image_base && *address - image.image_base < image.size_of_image) {
+				results.push_back(static_cast<uint32_t>(*address - image.image_base));
+			}
+		}
+
+		return results;
+	}
+
+	// rvas of every match of the signature in the file, under the scan policy.
+	// alignment is checked on the mapped address, which lines up with the rva for alignments up to the file alignment.
+	inline auto
+	scan_file(std::span<const uint8_t> file, const pe_image &image, const hex_signature &signature, const scan_options &options = {}) -> std::vector<uint32_t> {
+		std::vector<uint32_t> results;
+		std::vector<const uint8_t *> found;
+		for (const auto &region : file_regions(file, image, options)) {
+			auto limit = remaining_matches(options, results.size());
+			if (limit == 0) {
+				break;
+			}
+
+			auto region_options = options;
+			region_options.max_matches = limit == unlimited_matches ? 0 : limit;
+
+			found.clear();
+			find_signature(region.bytes.data(), region.bytes.data() + region.bytes.size(), signature, found, region_options);
+			for (const auto *match : found) {
+				results.push_back(region.rva + static_cast<uint32_t>(match - region.bytes.data()));
+			}
+		}
+
+		return results;
+	}
+
+	// rvas of every match of an extended pattern in the file
+	inline auto
+	scan_file(std::span<const uint8_t> file, const pe_image &image, const signature_automaton &automaton, const scan_options &options = {}) -> std::vector<uint32_t> {
+		std::vector<uint32_t> results;
+		std::vector<const uint8_t *> found;
+		for (const auto &region : file_regions(file, image, options)) {
+			auto limit = remaining_matches(options, results.size());
+			if (limit == 0) {
+				break;
+			}
+
+			auto region_options = options;
+			region_options.max_matches = limit == unlimited_matches ? 0 : limit;
+
+			found.clear();
+			automaton.find(region.bytes.data(), region.bytes.data() + region.bytes.size(), found, region_options);
+			for (const auto *match : found) {
+				results.push_back(region.rva + static_cast<uint32_t>(match - region.bytes.data()));
+			}
+		}
+
+		return results;
+	}
+
+	// rvas within max_mismatches literal bytes of the signature, closest first
+	inline auto
+	scan_file_approximate(std::span<const uint8_t> file, const pe_image &image, const hex_signature &signature, uint32_t max_mismatches, const scan_options &options = {}) -> std::vector<approximate_rva> {
+		std::vector<approximate_rva> results;
+		std::vector<approximate_match> found;
+		auto isa = detect_signature_isa();
+		for (const auto &region : file_regions(file, image, options)) {
+			found.clear();
+			find_signature_approximate(region.bytes.data(), region.bytes.data() + region.bytes.size(), signature, max_mismatches, found, isa);
+			for (const auto &match : found) {
+				results.push_back({ region.rva + static_cast<uint32_t>(match.address - region.bytes.data()), match.distance });
+			}
+		}
+
+		rank_approximate_matches(results);
+		return results;
+	}
+
+	// rvas the target resolves to, one for every match of its signature
+	inline auto
+	scan_file(std::span<const uint8_t> file, const pe_image &image, const signature_target &target, const scan_options &options = {}) -> std::vector<uint32_t> {
+		return resolve_file_matches(file, image, target, scan_file(file, image, target.signature, options));
+	}
+
+	// rvas of every match of every signature in the batch, indexed like add()
+	inline auto
+	scan_file(std::span<const uint8_t> file, const pe_image &image, signature_batch &batch, const scan_options &options = {}) -> std::vector<std::vector<uint32_t>> {
+		std::vector<std::vector<uint32_t>> results(batch.size());
+		std::vector<std::vector<const uint8_t *>> found;
+		for (const auto &region : file_regions(file, image, options)) {
+			// found keeps growing across regions so the batch can apply max_matches, only the new matches are converted
+			batch.find(region.bytes.data(), region.bytes.data() + region.bytes.size(), found, options);
+			for (size_t id = 0; id < found.size(); ++id) {
+				for (auto index = results[id].size(); index < found[id].size(); ++index) {
+					results[id].push_back(region.rva + static_cast<uint32_t>(found[id][index] - region.bytes.data()));
+				}
+			}
+		}
+
+		return results;
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
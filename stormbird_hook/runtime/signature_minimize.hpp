@@ -0,0 +1,162 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pe_image.hpp"
+#include "signature_file.hpp"
+#include "x64_decoder.hpp"
+
+// the parts of stormbird_sigmin that build the shortest signature matching one address of a pe file on disk.
+// relocated pointers, branch targets and rip-relative displacements change between builds, so they are wildcarded.
+
+namespace stormbird_hook {
+	struct signature_candidate {
+		std::vector<uint8_t> values;
+		std::vector<uint8_t> masks;
+		std::vector<size_t> boundaries; // end of each decoded instruction
+	};
+
+	// decodes forward from the start of code, the bytes at rva, and masks every byte that is not stable across builds.
+	// offsets also masks memory displacements, e.g. struct field offsets.
+	inline auto
+	collect_signature_candidate(std::span<const uint8_t> code, uint32_t rva, const std::vector<pe_relocation> &relocations, bool offsets) -> signature_candidate {
+		signature_candidate bytes;
+		size_t pos = 0;
+		while (pos < code.size()) {
+			auto instruction = decode_x64(code.subspan(pos));
+			if (!instruction) {
+				break;
+			}
+
+			auto start = bytes.values.size();
+			bytes.values.insert(bytes.values.end(), code.begin() + static_cast<ptrdiff_t>(pos), code.begin() + static_cast<ptrdiff_t>(pos + instruction->length));
+			bytes.masks.resize(bytes.values.size(), 0xFF);
+
+			auto wildcard = [&](size_t offset, size_t size) {
+				std::fill_n(bytes.masks.begin() + static_cast<ptrdiff_t>(start + offset), size, 0);
+			};
+
+			if (instruction->displacement_size > 0 && (instruction->rip_relative || offsets)) {
+				wildcard(instruction->displacement_offset, instruction->displacement_size);
+			}
+
+			if (instruction->relative_branch) {
+				wildcard(instruction->immediate_offset, instruction->immediate_size);
+			}
+
+			pos += instruction->length;
+			bytes.boundaries.push_back(pos);
+		}
+
+		// the loader rewrites these, e.g. absolute addresses in mov imm64
+		auto first = std::lower_bound(relocations.begin(), relocations.end(), rva > 8 ? rva - 8 : 0, [](const pe_relocation &relocation, uint32_t value) { return relocation.rva < value; });
+		for (auto it = first; it != relocations.end() && it->rva < rva + bytes.values.size(); ++it) {
+			for (uint32_t index = 0; index < it->size; ++index) {
+				if (it->rva + index >= rva && it->rva + index < rva + bytes.values.size()) {
+					bytes.masks[it->rva + index - rva] = 0;
+				}
+			}
+		}
+
+		for (size_t index = 0; index < bytes.values.size(); ++index) {
+			bytes.values[index] &= bytes.masks[index];
+		}
+
+		return bytes;
+	}
+
+	// the first size bytes as a pattern, trailing wildcards dropped since they do not narrow the match
+	inline auto
+	format_signature_candidate(const signature_candidate &bytes, size_t size) -> std::string {
+		while (size > 0 && bytes.masks[size - 1] == 0) {
+			size--;
+		}
+
+		constexpr std::string_view digits = "0123456789abcdef";
+		std::string pattern;
+		for (size_t index = 0; index < size; ++index) {
+			if (!pattern.empty()) {
+				pattern += ' ';
+			}
+
+			if (bytes.masks[index] == 0) {
+				pattern += "??";
+			} else {
+				pattern += digits[bytes.values[index] >> 4];
+				pattern += digits[bytes.values[index] & 0xF];
+			}
+		}
+
+		return pattern;
+	}
+
+	// true if the signature matches at rva and nowhere else in the scanned regions
+	inline auto
+	is_unique_in_file(std::span<const uint8_t> file, const pe_image &image, const hex_signature &signature, uint32_t rva, scan_options options) -> bool {
+		options.max_matches = 2;
+		auto matches = scan_file(file, image, signature, options);
+		return matches.size() == 1 && matches.front() == rva;
+	}
+
+	// index of the first boundary whose prefix matches only at rva, boundaries.size() if none does
+	inline auto
+	shortest_unique_boundary(std::span<const uint8_t> file, const pe_image &image, const signature_candidate &bytes, uint32_t rva, const scan_options &options) -> size_t {
+		auto unique_at = [&](size_t boundary) {
+			auto signature = dynamic_signature::parse(format_signature_candidate(bytes, bytes.boundaries[boundary]));
+			return signature && is_unique_in_file(file, image, signature->view(), rva, options);
+		};
+
+		// a longer prefix only ever matches a subset of the places a shorter one does, so uniqueness is monotonic
+		size_t low = 0;
+		size_t high = bytes.boundaries.size();
+		while (low < high) {
+			auto mid = low + ((high - low) / 2);
+			if (unique_at(mid)) {
+				high = mid;
+			} else {
+				low = mid + 1;
+			}
+		}
+
+		return low;
+	}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// positions where both anchors line up, i.e. how often the scan leaves the simd filter for a full compare
+	inline auto
+	anchor_candidates(std::span<const uint8_t> file, const pe_image &image, const hex_signature &signature, const scan_options &options) -> size_t {
+		if (!signature.has_literal) {
+			return SIZE_MAX;
+		}
+
+		size_t candidates = 0;
+		auto first = signature.values[signature.anchor];
+		auto second = signature.values[signature.second_anchor];
+		for (const auto &region : file_regions(file, image, options)) {
+			if (region.bytes.size() < signature.size) {
+				continue;
+			}
+
+			const auto *data = region.bytes.data();
+			auto last = region.bytes.size() - signature.size;
+			for (size_t index = 0; index <= last; ++index) {
+				candidates += static_cast<size_t>(data[index + signature.anchor] == first && data[index + signature.second_anchor] == second);
+			}
+		}
+
+		return candidates;
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
@@ -0,0 +1,243 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+#include <Psapi.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "signature_approximate.hpp"
+#include "signature_automaton.hpp"
+#include "signature_batch.hpp"
+#include "signature_engine.hpp"
+#include "signature_parallel.hpp"
+#include "signature_resolve.hpp"
+
+// the in-process side of the signature engine, everything here walks the pages of a loaded module.
+
+namespace stormbird_hook {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// calls fn(begin, end) for every committed and readable range in [start, stop), skipping over holes.
+	template<typename Fn>
+	void
+	for_each_committed_region(uint8_t *start, uint8_t *stop, Fn &&fn) {
+		auto *cur = start;
+
+		while (cur < stop) {
+			// get the memory information
+			MEMORY_BASIC_INFORMATION mem;
+			if (VirtualQuery(cur, &mem, sizeof(mem)) == 0u) {
+				break;
+			}
+
+			auto *begin = reinterpret_cast<uint8_t *>(mem.BaseAddress);
+			auto *end = begin + mem.RegionSize;
+
+			if (mem.State == MEM_COMMIT && (mem.Protect & (PAGE_GUARD | PAGE_NOACCESS)) == 0u) {
+				fn(std::max(begin, cur), std::min(end, stop));
+			}
+
+			cur = end;
+			mem = {};
+		}
+	}
+
+	// calls fn(begin, end) for every committed region of the module.
+	template<typename Fn>
+	void
+	for_each_module_region(HMODULE module, Fn &&fn) {
+		MODULEINFO module_info;
+		if (!GetModuleInformation(GetCurrentProcess(), module, &module_info, sizeof(module_info))) {
+			return;
+		}
+
+		auto *start = reinterpret_cast<uint8_t *>(module);
+		for_each_committed_region(start, start + module_info.SizeOfImage, fn);
+	}
+
+	// the committed ranges of the module covered by the scan scope and the rva window
+	inline auto
+	module_regions(HMODULE module, const scan_options &options) -> std::vector<scan_region> {
+		std::vector<scan_region> regions;
+		auto collect = [&](const uint8_t *begin, const uint8_t *end) { regions.emplace_back(begin, end); };
+
+		MODULEINFO module_info;
+		if (!GetModuleInformation(GetCurrentProcess(), module, &module_info, sizeof(module_info))) {
+			return regions;
+		}
+
+		auto *start = reinterpret_cast<uint8_t *>(module);
+		if (options.scope == scan_scope::module) {
+			auto [offset, size] = clip_to_window(0, module_info.SizeOfImage, options);
+			for_each_committed_region(start + offset, start + offset + size, collect);
+			return regions;
+		}
+
+		auto image = parse_pe_image({ start, module_info.SizeOfImage });
+		if (!image) {
+			return regions;
+		}
+
+		for (const auto *section : select_sections(*image, options)) {
+			auto mapped = std::min<size_t>(section->mapped_size(), module_info.SizeOfImage - std::min(section->virtual_address, module_info.SizeOfImage));
+			auto [offset, size] = clip_to_window(section->virtual_address, mapped, options);
+			auto *section_start = start + section->virtual_address + offset;
+			for_each_committed_region(section_start, section_start + size, collect);
+		}
+
+		return regions;
+	}
+
+	inline auto
+	scan(HMODULE module, const hex_signature &signature) -> std::vector<uint8_t *> {
+		std::vector<uint8_t *> results;
+		auto isa = detect_signature_isa();
+		std::vector<const uint8_t *> found;
+
+		for_each_module_region(module, [&](const uint8_t *begin, const uint8_t *end) {
+			// search for the signature
+			found.clear();
+			find_signature(begin, end, signature, found, isa);
+			for (const auto *match : found) {
+				results.push_back(const_cast<uint8_t *>(match));
+			}
+		});
+
+		return results;
+	}
+
+	// scans the module under the scan policy, e.g. { .scope = scan_scope::executable, .max_matches = 2 } to check a signature is unique
+	inline auto
+	scan(HMODULE module, const hex_signature &signature, const scan_options &options) -> std::vector<uint8_t *> {
+		auto regions = module_regions(module, options);
+		std::vector<const uint8_t *> found;
+		if (options.mode == scan_mode::parallel) {
+			find_signature_parallel(regions, signature, found, options);
+		} else {
+			auto isa = detect_signature_isa();
+			for (const auto &[begin, end] : regions) {
+				auto limit = remaining_matches(options, found.size());
+				if (limit == 0) {
+					break;
+				}
+
+				find_signature(begin, end, signature, found, isa, std::max(options.alignment, 1u), limit, options.chunk_size);
+			}
+		}
+
+		std::vector<uint8_t *> results;
+		results.reserve(found.size());
+		for (const auto *match : found) {
+			results.push_back(const_cast<uint8_t *>(match));
+		}
+
+		return results;
+	}
+
+	// matches of an extended pattern, every variant in one walk of the module
+	inline auto
+	scan(HMODULE module, const signature_automaton &automaton, const scan_options &options = {}) -> std::vector<uint8_t *> {
+		std::vector<const uint8_t *> found;
+		for (const auto &[begin, end] : module_regions(module, options)) {
+			auto limit = remaining_matches(options, found.size());
+			if (limit == 0) {
+				break;
+			}
+
+			auto region_options = options;
+			region_options.max_matches = limit == unlimited_matches ? 0 : limit;
+			automaton.find(begin, end, found, region_options);
+		}
+
+		std::vector<uint8_t *> results;
+		results.reserve(found.size());
+		for (const auto *match : found) {
+			results.push_back(const_cast<uint8_t *>(match));
+		}
+
+		return results;
+	}
+
+	// every position in the scanned regions within max_mismatches literal bytes of the signature, closest first
+	inline auto
+	scan_approximate(HMODULE module, const hex_signature &signature, uint32_t max_mismatches, const scan_options &options = {}) -> std::vector<approximate_match> {
+		std::vector<approximate_match> results;
+		auto isa = detect_signature_isa();
+		for (const auto &[begin, end] : module_regions(module, options)) {
+			find_signature_approximate(begin, end, signature, max_mismatches, results, isa);
+		}
+
+		rank_approximate_matches(results);
+		return results;
+	}
+
+	// copies memory of this process, refusing anything that is not committed and readable
+	inline auto
+	read_process_memory(uint64_t address, void *out, size_t size) -> bool {
+		auto *begin = reinterpret_cast<uint8_t *>(address);
+		size_t readable = 0;
+		for_each_committed_region(begin, begin + size, [&](const uint8_t *from, const uint8_t *to) {
+			if (from == begin + readable) { // stop counting at the first hole
+				readable += to - from;
+			}
+		});
+
+		if (readable < size) {
+			return false;
+		}
+
+		std::memcpy(out, begin, size);
+		return true;
+	}
+
+	// follows the target's steps from each match, dropping the ones that do not resolve
+	inline auto
+	resolve_matches(const signature_target &target, const std::vector<uint8_t *> &matches) -> std::vector<uint8_t *> {
+		std::vector<uint8_t *> results;
+		results.reserve(matches.size());
+		for (auto *match : matches) {
+			auto address = resolve_target(reinterpret_cast<uint64_t>(match), target, read_process_memory);
+			if (address) {
+				results.push_back(reinterpret_cast<uint8_t *>(*address));
+			}
+		}
+
+		return results;
+	}
+
+	// final addresses the target resolves to, one for every match of its signature
+	inline auto
+	scan(HMODULE module, const signature_target &target, const scan_options &options = {}) -> std::vector<uint8_t *> {
+		return resolve_matches(target, scan(module, target.signature, options));
+	}
+
+	// one walk of the module for every signature in the batch, results are indexed like add().
+	inline auto
+	scan(HMODULE module, signature_batch &batch, const scan_options &options = {}) -> std::vector<std::vector<uint8_t *>> {
+		std::vector<std::vector<const uint8_t *>> found;
+		for (const auto &[begin, end] : module_regions(module, options)) {
+			batch.find(begin, end, found, options);
+		}
+
+		std::vector<std::vector<uint8_t *>> results(batch.size());
+		for (size_t id = 0; id < found.size(); ++id) {
+			for (const auto *match : found[id]) {
+				results[id].push_back(const_cast<uint8_t *>(match));
+			}
+		}
+
+		return results;
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
@@ -0,0 +1,123 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "signature_engine.hpp"
+
+namespace stormbird_hook {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// splits every region into chunks, scans them on a pool of threads and merges the matches back in ascending order.
+	// each chunk reads signature.size - 1 bytes past its end so matches straddling a chunk edge are still found,
+	// matches never cross regions, same as the serial walk.
+	// with max_matches set the workers stop taking chunks once enough matches are in, the merge scans any
+	// skipped chunk it still needs so the result is the same as the serial walk.
+	inline void
+	find_signature_parallel(std::span<const scan_region> regions, const hex_signature &signature, std::vector<const uint8_t *> &results, const scan_options &options = {}) {
+		auto limit = remaining_matches(options, 0);
+		if (signature.size == 0 || limit == 0) {
+			return;
+		}
+
+		struct scan_chunk {
+			const uint8_t *begin;
+			const uint8_t *end; // end of the starting positions
+			const uint8_t *region_end;
+			std::vector<const uint8_t *> results;
+			bool scanned { false };
+		};
+
+		auto chunk_size = std::max<size_t>(options.chunk_size, signature.size);
+		std::vector<scan_chunk> chunks;
+		for (const auto &[begin, end] : regions) {
+			for (const auto *cur = begin; cur < end; cur += std::min<size_t>(chunk_size, end - cur)) {
+				chunks.push_back({ cur, cur + std::min<size_t>(chunk_size, end - cur), end, {} });
+			}
+		}
+
+		auto isa = detect_signature_isa();
+		auto alignment = std::max(options.alignment, 1u);
+		auto scan_chunk_range = [&](scan_chunk &chunk, const uint8_t *from) {
+			auto *overlap_end = chunk.end + std::min<size_t>(signature.size - 1, chunk.region_end - chunk.end);
+			chunk.results.clear();
+			find_signature(from, overlap_end, signature, chunk.results, isa, alignment, unlimited_matches);
+			chunk.scanned = true;
+		};
+
+		auto thread_count = options.thread_count == 0 ? std::max(1u, std::thread::hardware_concurrency()) : options.thread_count;
+		thread_count = static_cast<uint32_t>(std::min<size_t>(thread_count, chunks.size()));
+
+		std::atomic<size_t> next_chunk { 0 };
+		std::atomic<size_t> found { 0 };
+		auto worker = [&]() {
+			for (auto index = next_chunk++; index < chunks.size() && found.load(std::memory_order_relaxed) < limit; index = next_chunk++) {
+				scan_chunk_range(chunks[index], chunks[index].begin);
+				found.fetch_add(chunks[index].results.size(), std::memory_order_relaxed);
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (uint32_t index = 1; index < thread_count; ++index) {
+			workers.emplace_back(worker);
+		}
+
+		worker();
+
+		for (auto &thread : workers) {
+			thread.join();
+		}
+
+		// matches are non-overlapping. a match hanging off the end of one chunk means the next chunk's
+		// greedy walk started too early, so that chunk is rescanned from where the match ends.
+		const uint8_t *next = nullptr;
+		const uint8_t *region_end = nullptr;
+		size_t merged = 0;
+		for (auto &chunk : chunks) {
+			if (merged >= limit) {
+				break;
+			}
+
+			if (chunk.region_end != region_end) {
+				region_end = chunk.region_end;
+				next = chunk.begin;
+			}
+
+			if (!chunk.scanned || (!chunk.results.empty() && chunk.results.front() < next)) {
+				scan_chunk_range(chunk, std::max(next, chunk.begin));
+			}
+
+			for (const auto *match : chunk.results) {
+				if (merged++ >= limit) {
+					break;
+				}
+
+				results.push_back(match);
+				next = match + signature.size;
+			}
+		}
+	}
+
+	// scans [begin, end) under the scan policy, an address range scan
+	inline void
+	find_signature(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results, const scan_options &options) {
+		if (options.mode == scan_mode::serial) {
+			find_signature(begin, end, signature, results, detect_signature_isa(), std::max(options.alignment, 1u), remaining_matches(options, 0), options.chunk_size);
+			return;
+		}
+
+		scan_region region { begin, end };
+		find_signature_parallel({ &region, 1 }, signature, results, options);
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
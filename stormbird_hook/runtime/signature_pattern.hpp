@@ -0,0 +1,286 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// signatures are written as hex bytes separated by optional spaces, with ?? for a wildcard byte
+// and a single ? for a wildcard nibble:
+//   "4? 89 41 08 48 8b c1 ?? ?? c3"
+// MAKE_SIGNATURE compiles them to value/mask form, anchors and a shift table at compile time.
+// byte sets and alternations need signature_automaton instead.
+
+namespace stormbird_hook {
+	using signature_shift_table = std::array<uint8_t, 256>;
+
+	// non-owning view of a compiled signature, this is what the matchers work with.
+	struct hex_signature {
+		const uint8_t *values { nullptr }; // value to match, zero where masked
+		const uint8_t *masks { nullptr }; // 0xFF for literal bytes, 0x00 for wildcards, 0xF0 or 0x0F for wildcard nibbles
+		const signature_shift_table *shift { nullptr }; // horspool shift for each byte at the end of the window
+		uint32_t size { 0 }; // size of the signature
+		uint32_t anchor { 0 }; // offset of the rarest literal byte
+		uint32_t second_anchor { 0 }; // offset of the second rarest literal byte, same as anchor if there is only one
+		bool has_literal { false }; // false if no byte is fully literal, anchors are only picked from literal bytes
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+		[[nodiscard]] auto
+		matches(const uint8_t *data) const -> bool {
+			for (uint32_t index = 0; index < size; ++index) {
+				if ((data[index] & masks[index]) != values[index]) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+#pragma clang diagnostic pop
+	};
+
+	constexpr auto
+	is_hex_digit(char value) -> bool {
+		return (value >= '0' && value <= '9') || (value >= 'A' && value <= 'F') || (value >= 'a' && value <= 'f');
+	}
+
+	constexpr auto
+	parse_octet(const char &value) -> uint8_t {
+		if (value >= '0' && value <= '9') { // if the value is a number
+			return value - '0';
+		}
+		if (value >= 'A' && value <= 'F') { // if the value is an uppercase letter
+			return 10 + value - 'A';
+		}
+		if (value >= 'a' && value <= 'f') { // if the value is a lowercase letter
+			return 10 + value - 'a';
+		}
+
+		return 0;
+	}
+
+	constexpr auto
+	is_pattern_nibble(char value) -> bool {
+		return value == '?' || is_hex_digit(value);
+	}
+
+	// value and mask of one pattern byte made of two nibbles, each a hex digit or ?
+	constexpr auto
+	parse_pattern_byte(char high, char low) -> std::pair<uint8_t, uint8_t> {
+		uint8_t value = 0;
+		uint8_t mask = 0;
+		if (high != '?') {
+			value |= parse_octet(high) << 4;
+			mask |= 0xF0;
+		}
+		if (low != '?') {
+			value |= parse_octet(low);
+			mask |= 0x0F;
+		}
+
+		return { value, mask };
+	}
+
+	// number of bytes in the pattern, or nothing if the pattern is malformed:
+	// odd nibble counts, unknown characters or no bytes at all.
+	constexpr auto
+	count_signature_bytes(std::string_view pattern) -> std::optional<size_t> {
+		size_t count = 0;
+		for (size_t index = 0; index < pattern.size(); index += 2) {
+			if (pattern[index] == ' ') { // if the value is a space
+				index -= 1;
+				continue;
+			}
+
+			if (index + 1 >= pattern.size()) { // half a byte at the end
+				return std::nullopt;
+			}
+
+			auto high = pattern[index];
+			auto low = pattern[index + 1];
+			if (!is_pattern_nibble(high) || !is_pattern_nibble(low)) {
+				return std::nullopt;
+			}
+
+			count++;
+		}
+
+		if (count == 0) {
+			return std::nullopt;
+		}
+
+		return count;
+	}
+
+	constexpr auto
+	is_valid_signature(std::string_view pattern) -> bool {
+		return count_signature_bytes(pattern).has_value();
+	}
+
+	// rough rank of how often a byte shows up in x64 code, higher is more common.
+	// bytes not listed are treated as equally rare.
+	constexpr auto
+	byte_commonness(uint8_t value) -> uint32_t {
+		constexpr std::array<uint8_t, 48> common_bytes = {
+			0x00, 0xFF, 0x48, 0x8B, 0xCC, 0x89, 0x24, 0x4C, 0x0F, 0x44, 0x8D, 0xE8, 0x83, 0x85, 0x01, 0x41,
+			0x49, 0x45, 0xC0, 0x10, 0x08, 0x20, 0x4D, 0x74, 0xC3, 0x75, 0x40, 0x18, 0x33, 0x28, 0x30, 0x38,
+			0xC7, 0xEB, 0x5C, 0x54, 0xD2, 0xC1, 0x90, 0x04, 0x02, 0x84, 0x3B, 0xF8, 0xC8, 0x50, 0x03, 0xE9,
+		};
+
+		for (size_t index = 0; index < common_bytes.size(); ++index) {
+			if (common_bytes[index] == value) {
+				return static_cast<uint32_t>(common_bytes.size() - index);
+			}
+		}
+
+		return 0;
+	}
+
+	// everything derived from the pattern bytes, shared by the compile-time and the runtime signatures
+	struct signature_layout {
+		uint32_t anchor { 0 };
+		uint32_t second_anchor { 0 };
+		bool has_literal { false };
+	};
+
+	// fills values and masks from a pattern that passed count_signature_bytes()
+	constexpr void
+	fill_signature(std::string_view pattern, std::span<uint8_t> values, std::span<uint8_t> masks) {
+		size_t count = 0;
+		for (size_t index = 0; index < pattern.size(); index += 2) {
+			if (pattern[index] == ' ') { // if the value is a space
+				index -= 1;
+				continue;
+			}
+
+			auto [value, mask] = parse_pattern_byte(pattern[index], pattern[index + 1]);
+			values[count] = value;
+			masks[count] = mask;
+
+			count++;
+		}
+	}
+
+	// picks the two rarest literal bytes, the second one filters out most of the candidates the first one lets through
+	constexpr auto
+	layout_signature(std::span<const uint8_t> values, std::span<const uint8_t> masks) -> signature_layout {
+		signature_layout layout;
+		for (uint32_t index = 0; index < values.size(); ++index) {
+			if (masks[index] != 0xFF) {
+				continue;
+			}
+
+			if (!layout.has_literal || byte_commonness(values[index]) < byte_commonness(values[layout.anchor])) {
+				layout.anchor = index;
+			}
+
+			layout.has_literal = true;
+		}
+
+		layout.second_anchor = layout.anchor;
+		for (uint32_t index = 0; index < values.size(); ++index) {
+			if (masks[index] != 0xFF || index == layout.anchor) {
+				continue;
+			}
+
+			if (layout.second_anchor == layout.anchor || byte_commonness(values[index]) < byte_commonness(values[layout.second_anchor])) {
+				layout.second_anchor = index;
+			}
+		}
+
+		return layout;
+	}
+
+	// wildcard-aware horspool table: how far the window may move when a byte ends it without a match.
+	// a wildcard matches any byte, so no shift may skip past the last wildcard before the final byte.
+	// wildcard nibbles count as wildcards here.
+	constexpr void
+	fill_shift_table(std::span<const uint8_t> values, std::span<const uint8_t> masks, signature_shift_table &shift) {
+		auto size = values.size();
+		auto limit = size;
+		for (size_t index = 0; index + 1 < size; ++index) {
+			if (masks[index] != 0xFF) {
+				limit = size - 1 - index;
+			}
+		}
+
+		shift.fill(static_cast<uint8_t>(std::min<size_t>(limit, 255)));
+		for (size_t index = 0; index + 1 < size; ++index) {
+			if (masks[index] == 0xFF) {
+				auto distance = std::min<size_t>(size - 1 - index, limit);
+				shift[values[index]] = static_cast<uint8_t>(std::min<size_t>(distance, 255));
+			}
+		}
+	}
+
+	// exact-size signature built at compile time by MAKE_SIGNATURE
+	template<size_t N>
+	struct compiled_signature {
+		std::array<uint8_t, N> values {};
+		std::array<uint8_t, N> masks {};
+		signature_shift_table shift {};
+		signature_layout layout {};
+
+		constexpr explicit compiled_signature(std::string_view pattern) {
+			fill_signature(pattern, values, masks);
+			layout = layout_signature(values, masks);
+			fill_shift_table(values, masks, shift);
+		}
+
+		[[nodiscard]] constexpr auto
+		view() const -> hex_signature {
+			return { values.data(), masks.data(), &shift, static_cast<uint32_t>(N), layout.anchor, layout.second_anchor, layout.has_literal };
+		}
+
+		// NOLINTNEXTLINE(google-explicit-constructor)
+		constexpr operator hex_signature() const {
+			return view();
+		}
+	};
+
+	// signature parsed at runtime, for tools that take patterns from the command line.
+	class dynamic_signature {
+	public:
+		[[nodiscard]] static auto
+		parse(std::string_view pattern) -> std::optional<dynamic_signature> {
+			auto count = count_signature_bytes(pattern);
+			if (!count) {
+				return std::nullopt;
+			}
+
+			dynamic_signature signature;
+			signature.values.resize(*count);
+			signature.masks.resize(*count);
+			fill_signature(pattern, signature.values, signature.masks);
+			signature.layout = layout_signature(signature.values, signature.masks);
+			fill_shift_table(signature.values, signature.masks, signature.shift);
+			return signature;
+		}
+
+		// only valid while this object is alive and not moved
+		[[nodiscard]] auto
+		view() const -> hex_signature {
+			return { values.data(), masks.data(), &shift, static_cast<uint32_t>(values.size()), layout.anchor, layout.second_anchor, layout.has_literal };
+		}
+
+	private:
+		std::vector<uint8_t> values;
+		std::vector<uint8_t> masks;
+		signature_shift_table shift {};
+		signature_layout layout {};
+	};
+
+#define MAKE_SIGNATURE(codename, signature) \
+	static_assert(::stormbird_hook::is_valid_signature(signature), "malformed signature " #codename); \
+	inline constexpr ::stormbird_hook::compiled_signature<::stormbird_hook::count_signature_bytes(signature).value_or(1)> codename##_SIGNATURE { signature };
+} // namespace stormbird_hook
@@ -0,0 +1,135 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "signature_pattern.hpp"
+
+// most functions and globals are only reachable through an operand inside some unique piece of code.
+// a signature target pairs a signature with the steps that turn its match into the address we actually want.
+
+namespace stormbird_hook {
+	enum class resolve_mode : uint8_t {
+		rel32, // call/jmp rel32, the target is relative to the end of the operand
+		rip_relative, // [rip + disp32], the target is relative to the end of the instruction
+		absolute, // an 8 byte pointer stored at the operand
+		offset // moves the address by the operand, no memory is read
+	};
+
+	struct resolve_step {
+		resolve_mode mode { resolve_mode::offset };
+		int32_t operand { 0 }; // offset of the operand from the current address
+		uint8_t trailing { 0 }; // rip_relative only: immediate bytes between the displacement and the end of the instruction
+	};
+
+	constexpr auto
+	follow_rel32(int32_t operand) -> resolve_step {
+		return { resolve_mode::rel32, operand, 0 };
+	}
+
+	constexpr auto
+	follow_rip(int32_t operand, uint8_t trailing = 0) -> resolve_step {
+		return { resolve_mode::rip_relative, operand, trailing };
+	}
+
+	constexpr auto
+	follow_pointer(int32_t operand) -> resolve_step {
+		return { resolve_mode::absolute, operand, 0 };
+	}
+
+	constexpr auto
+	move_by(int32_t distance) -> resolve_step {
+		return { resolve_mode::offset, distance, 0 };
+	}
+
+	struct signature_target {
+		static constexpr size_t max_steps = 4;
+
+		hex_signature signature;
+		std::array<resolve_step, max_steps> steps {};
+		uint8_t step_count { 0 };
+
+		// a plain signature resolves to its match
+		// NOLINTNEXTLINE(google-explicit-constructor)
+		constexpr signature_target(hex_signature signature) : signature(signature) { }
+
+		// steps are applied in order, each one starting from the address the previous one resolved to
+		template<typename... Steps>
+		constexpr signature_target(hex_signature signature, Steps... hops) : signature(signature), steps { hops... }, step_count(sizeof...(Steps)) {
+			static_assert(sizeof...(Steps) <= max_steps, "too many resolve steps");
+		}
+	};
+
+	struct named_signature {
+		std::string_view name;
+		signature_target target;
+	};
+
+	// follows the steps of a target from a match address. read(address, out, size) copies memory at a
+	// virtual address and returns false if the address is not readable.
+	template<typename Reader>
+	auto
+	resolve_target(uint64_t address, const signature_target &target, Reader &&read) -> std::optional<uint64_t> {
+		for (uint8_t index = 0; index < target.step_count; ++index) {
+			const auto &step = target.steps[index];
+			auto operand = address + static_cast<int64_t>(step.operand);
+
+			switch (step.mode) {
+				case resolve_mode::rel32:
+				case resolve_mode::rip_relative:
+					{
+						int32_t displacement = 0;
+						if (!read(operand, &displacement, sizeof(displacement))) {
+							return std::nullopt;
+						}
+
+						auto next_instruction = operand + sizeof(displacement) + (step.mode == resolve_mode::rip_relative ? step.trailing : 0);
+						address = next_instruction + static_cast<int64_t>(displacement);
+						break;
+					}
+				case resolve_mode::absolute:
+					{
+						uint64_t pointer = 0;
+						if (!read(operand, &pointer, sizeof(pointer)) || pointer == 0) {
+							return std::nullopt;
+						}
+
+						address = pointer;
+						break;
+					}
+				case resolve_mode::offset: address = operand; break;
+			}
+		}
+
+		return address;
+	}
+
+	// reads from one contiguous image, such as a loaded module mapped at base_address
+	struct image_reader {
+		std::span<const uint8_t> image;
+		uint64_t base_address { 0 };
+
+		auto
+		operator()(uint64_t address, void *out, size_t size) const -> bool {
+			if (address < base_address || address - base_address > image.size() || image.size() - (address - base_address) < size) {
+				return false;
+			}
+
+			std::memcpy(out, image.data() + (address - base_address), size);
+			return true;
+		}
+	};
+
+#define NAMED_SIGNATURE(codename) \
+	named_signature { #codename, codename##_SIGNATURE.view() }
+#define NAMED_TARGET(codename) \
+	named_signature { #codename, codename##_TARGET }
+} // namespace stormbird_hook
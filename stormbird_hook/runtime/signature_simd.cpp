@@ -0,0 +1,500 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "signature_simd.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define STORMBIRD_X86 1
+	#include <immintrin.h>
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define STORMBIRD_TARGET(isa) __attribute__((target(isa)))
+#else
+	#define STORMBIRD_TARGET(isa)
+#endif
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+namespace {
+	using stormbird_hook::signature_isa;
+	using stormbird_hook::hex_signature;
+
+#ifdef STORMBIRD_X86
+	void
+	cpuid(uint32_t leaf, uint32_t subleaf, std::array<uint32_t, 4> &regs) {
+	#ifdef _MSC_VER
+		std::array<int, 4> info {};
+		__cpuidex(info.data(), static_cast<int>(leaf), static_cast<int>(subleaf));
+		for (size_t index = 0; index < 4; ++index) {
+			regs[index] = static_cast<uint32_t>(info[index]);
+		}
+	#else
+		__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+	#endif
+	}
+
+	auto
+	xgetbv() -> uint64_t {
+	#ifdef _MSC_VER
+		return _xgetbv(0);
+	#else
+		uint32_t eax = 0;
+		uint32_t edx = 0;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<uint64_t>(edx) << 32) | eax;
+	#endif
+	}
+
+	auto
+	query_isa() -> signature_isa {
+		std::array<uint32_t, 4> regs {};
+		cpuid(0, 0, regs);
+		auto max_leaf = regs[0];
+
+		cpuid(1, 0, regs);
+		if ((regs[3] & (1u << 26)) == 0) { // sse2
+			return signature_isa::scalar;
+		}
+
+		// the os has to save the upper register state, otherwise avx is unusable even if the cpu has it.
+		if ((regs[2] & (1u << 27)) == 0 || max_leaf < 7) { // osxsave
+			return signature_isa::sse2;
+		}
+
+		auto xcr0 = xgetbv();
+		if ((xcr0 & 0x6) != 0x6) { // xmm and ymm state
+			return signature_isa::sse2;
+		}
+
+		cpuid(7, 0, regs);
+		auto has_avx2 = (regs[1] & (1u << 5)) != 0;
+		auto has_avx512 = (regs[1] & (1u << 16)) != 0 && (regs[1] & (1u << 30)) != 0; // avx512f and avx512bw
+
+		if (has_avx512 && (xcr0 & 0xE0) == 0xE0) { // opmask and zmm state
+			return signature_isa::avx512;
+		}
+
+		if (has_avx2) {
+			return signature_isa::avx2;
+		}
+
+		return signature_isa::sse2;
+	}
+#endif
+
+	// walks the candidate bits of one block, verifying each against the full masked pattern
+	void
+	check_candidates(const uint8_t *block, uint64_t candidates, const uint8_t *&next, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		while (candidates != 0) {
+			const auto *candidate = block + std::countr_zero(candidates);
+			candidates &= candidates - 1;
+
+			if (candidate < next) { // overlaps the previous match
+				continue;
+			}
+
+			if (signature.matches(candidate)) {
+				results.push_back(candidate);
+				next = candidate + signature.size;
+			}
+		}
+	}
+
+	// finishes the bytes that do not fill a whole vector
+	void
+	find_tail(const uint8_t *cur, const uint8_t *last, const uint8_t *next, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		for (cur = cur < next ? next : cur; cur <= last; ++cur) {
+			if (cur[signature.anchor] == signature.values[signature.anchor] && signature.matches(cur)) {
+				results.push_back(cur);
+				cur += signature.size - 1;
+			}
+		}
+	}
+
+	// a pattern without a literal byte has nothing to anchor on, only wildcards and wildcard nibbles
+	auto
+	find_wildcards(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) -> bool {
+		if (signature.size == 0 || end - begin < static_cast<ptrdiff_t>(signature.size)) {
+			return true;
+		}
+
+		if (signature.has_literal) {
+			return false;
+		}
+
+		for (const auto *cur = begin; end - cur >= static_cast<ptrdiff_t>(signature.size);) {
+			if (signature.matches(cur)) {
+				results.push_back(cur);
+				cur += signature.size;
+				continue;
+			}
+
+			++cur;
+		}
+
+		return true;
+	}
+
+	// with k mismatches allowed, splitting the literal bytes into k + 1 disjoint groups guarantees at least one
+	// group still matches exactly. only positions where some group matches are counted, the groups are pairs of
+	// the rarest literals so they filter almost as well as the exact scan's anchors.
+	constexpr uint32_t max_filter_groups = 8;
+
+	struct mismatch_filter {
+		uint32_t count { 0 }; // 0 when there are too few literals to filter on, every position is then a candidate
+		std::array<std::array<uint32_t, 2>, max_filter_groups> offsets {};
+	};
+
+	auto
+	make_mismatch_filter(const hex_signature &signature, uint32_t max_mismatches) -> mismatch_filter {
+		mismatch_filter filter;
+		if (max_mismatches >= max_filter_groups) {
+			return filter;
+		}
+
+		std::vector<uint32_t> literals;
+		for (uint32_t index = 0; index < signature.size; ++index) {
+			if (signature.masks[index] == 0xFF) {
+				literals.push_back(index);
+			}
+		}
+
+		std::stable_sort(literals.begin(), literals.end(), [&](uint32_t lhs, uint32_t rhs) { return stormbird_hook::byte_commonness(signature.values[lhs]) < stormbird_hook::byte_commonness(signature.values[rhs]); });
+
+		auto groups = max_mismatches + 1;
+		if (literals.size() >= groups * 2) {
+			for (uint32_t group = 0; group < groups; ++group) {
+				filter.offsets[group] = { literals[group * 2], literals[(group * 2) + 1] };
+			}
+		} else if (literals.size() >= groups) {
+			for (uint32_t group = 0; group < groups; ++group) {
+				filter.offsets[group] = { literals[group], literals[group] };
+			}
+		} else {
+			return filter;
+		}
+
+		filter.count = groups;
+		return filter;
+	}
+
+	auto
+	passes_filter(const uint8_t *data, const hex_signature &signature, const mismatch_filter &filter) -> bool {
+		if (filter.count == 0) {
+			return true;
+		}
+
+		for (uint32_t group = 0; group < filter.count; ++group) {
+			auto [first, second] = filter.offsets[group];
+			if (data[first] == signature.values[first] && data[second] == signature.values[second]) {
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// mismatched literal bytes at data, stops counting once past limit
+	auto
+	count_mismatches(const uint8_t *data, const hex_signature &signature, uint32_t index, uint32_t count, uint32_t limit) -> uint32_t {
+		for (; index < signature.size && count <= limit; ++index) {
+			count += (data[index] & signature.masks[index]) != signature.values[index] ? 1 : 0;
+		}
+
+		return count;
+	}
+
+	// scalar filter and count for positions the vector loop did not cover
+	template<typename Count>
+	void
+	find_approximate_tail(const uint8_t *cur, const uint8_t *last, const hex_signature &signature, const mismatch_filter &filter, uint32_t max_mismatches, Count &&count, std::vector<stormbird_hook::approximate_match> &results) {
+		for (; cur <= last; ++cur) {
+			if (!passes_filter(cur, signature, filter)) {
+				continue;
+			}
+
+			auto distance = count(cur);
+			if (distance <= max_mismatches) {
+				results.push_back({ cur, distance });
+			}
+		}
+	}
+} // namespace
+
+namespace stormbird_hook {
+	auto
+	detect_signature_isa() -> signature_isa {
+#ifdef STORMBIRD_X86
+		static const signature_isa isa = query_isa();
+		return isa;
+#else
+		return signature_isa::scalar;
+#endif
+	}
+
+#ifdef STORMBIRD_X86
+	STORMBIRD_TARGET("sse2")
+	void
+	find_signature_sse2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		if (find_wildcards(begin, end, signature, results)) {
+			return;
+		}
+
+		const auto *last = end - signature.size; // last valid starting position
+		const auto *next = begin;
+		const auto *cur = begin;
+		auto anchor = _mm_set1_epi8(static_cast<char>(signature.values[signature.anchor]));
+		auto second_anchor = _mm_set1_epi8(static_cast<char>(signature.values[signature.second_anchor]));
+
+		for (; last - cur >= 15; cur += 16) {
+			auto first = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + signature.anchor)), anchor);
+			auto second = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + signature.second_anchor)), second_anchor);
+			auto candidates = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(first, second)));
+			check_candidates(cur, candidates, next, signature, results);
+		}
+
+		find_tail(cur, last, next, signature, results);
+	}
+
+	STORMBIRD_TARGET("avx2")
+	void
+	find_signature_avx2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		if (find_wildcards(begin, end, signature, results)) {
+			return;
+		}
+
+		const auto *last = end - signature.size;
+		const auto *next = begin;
+		const auto *cur = begin;
+		auto anchor = _mm256_set1_epi8(static_cast<char>(signature.values[signature.anchor]));
+		auto second_anchor = _mm256_set1_epi8(static_cast<char>(signature.values[signature.second_anchor]));
+
+		for (; last - cur >= 31; cur += 32) {
+			auto first = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur + signature.anchor)), anchor);
+			auto second = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur + signature.second_anchor)), second_anchor);
+			auto candidates = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(first, second)));
+			check_candidates(cur, candidates, next, signature, results);
+		}
+
+		find_tail(cur, last, next, signature, results);
+	}
+
+	STORMBIRD_TARGET("avx512f,avx512bw")
+	void
+	find_signature_avx512(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		if (find_wildcards(begin, end, signature, results)) {
+			return;
+		}
+
+		const auto *last = end - signature.size;
+		const auto *next = begin;
+		const auto *cur = begin;
+		auto anchor = _mm512_set1_epi8(static_cast<char>(signature.values[signature.anchor]));
+		auto second_anchor = _mm512_set1_epi8(static_cast<char>(signature.values[signature.second_anchor]));
+
+		for (; last - cur >= 63; cur += 64) {
+			auto first = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(cur + signature.anchor), anchor);
+			auto second = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512(cur + signature.second_anchor), second_anchor);
+			check_candidates(cur, static_cast<uint64_t>(first & second), next, signature, results);
+		}
+
+		find_tail(cur, last, next, signature, results);
+	}
+
+	STORMBIRD_TARGET("avx2")
+	void
+	find_anchor_bytes_avx2(const uint8_t *begin, const uint8_t *end, const anchor_byte_set &set, std::vector<uint32_t> &offsets) {
+		auto low = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low.data())));
+		auto high = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set.high.data())));
+		auto nibble = _mm256_set1_epi8(0x0F);
+		auto zero = _mm256_setzero_si256();
+
+		const auto *cur = begin;
+		for (; end - cur >= 32; cur += 32) {
+			auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+			auto low_bits = _mm256_shuffle_epi8(low, _mm256_and_si256(bytes, nibble));
+			auto high_bits = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+			auto hits = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(low_bits, high_bits), zero)));
+			while (hits != 0) {
+				offsets.push_back(static_cast<uint32_t>(cur - begin) + std::countr_zero(hits));
+				hits &= hits - 1;
+			}
+		}
+
+		for (; cur < end; ++cur) {
+			if (set.may_contain(*cur)) {
+				offsets.push_back(static_cast<uint32_t>(cur - begin));
+			}
+		}
+	}
+#else
+	// no vector units to speak of, the anchor check alone still beats std::search.
+	void
+	find_signature_sse2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		if (find_wildcards(begin, end, signature, results)) {
+			return;
+		}
+
+		find_tail(begin, end - signature.size, begin, signature, results);
+	}
+
+	void
+	find_signature_avx2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		find_signature_sse2(begin, end, signature, results);
+	}
+
+	void
+	find_signature_avx512(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results) {
+		find_signature_sse2(begin, end, signature, results);
+	}
+
+	void
+	find_anchor_bytes_avx2(const uint8_t *begin, const uint8_t *end, const anchor_byte_set &set, std::vector<uint32_t> &offsets) {
+		for (const auto *cur = begin; cur < end; ++cur) {
+			if (set.may_contain(*cur)) {
+				offsets.push_back(static_cast<uint32_t>(cur - begin));
+			}
+		}
+	}
+#endif
+
+	void
+	find_approximate_scalar(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results) {
+		if (signature.size == 0 || end - begin < static_cast<ptrdiff_t>(signature.size)) {
+			return;
+		}
+
+		auto filter = make_mismatch_filter(signature, max_mismatches);
+		auto count = [&](const uint8_t *data) { return count_mismatches(data, signature, 0, 0, max_mismatches); };
+		find_approximate_tail(begin, end - signature.size, signature, filter, max_mismatches, count, results);
+	}
+
+#ifdef STORMBIRD_X86
+	STORMBIRD_TARGET("sse2")
+	void
+	find_approximate_sse2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results) {
+		if (signature.size == 0 || end - begin < static_cast<ptrdiff_t>(signature.size)) {
+			return;
+		}
+
+		auto filter = make_mismatch_filter(signature, max_mismatches);
+		auto count = [&](const uint8_t *data) STORMBIRD_TARGET("sse2") {
+			uint32_t mismatches = 0;
+			uint32_t index = 0;
+			for (; index + 16 <= signature.size && mismatches <= max_mismatches; index += 16) {
+				auto masked = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index)), _mm_loadu_si128(reinterpret_cast<const __m128i *>(signature.masks + index)));
+				auto equal = _mm_cmpeq_epi8(masked, _mm_loadu_si128(reinterpret_cast<const __m128i *>(signature.values + index)));
+				mismatches += std::popcount(~static_cast<uint32_t>(_mm_movemask_epi8(equal)) & 0xFFFFu);
+			}
+
+			return count_mismatches(data, signature, index, mismatches, max_mismatches);
+		};
+
+		const auto *last = end - signature.size;
+		const auto *cur = begin;
+		if (filter.count > 0) {
+			__m128i anchors[max_filter_groups * 2]; // NOLINT(*-avoid-c-arrays), std::array drops the vector attributes
+			for (uint32_t group = 0; group < filter.count; ++group) {
+				anchors[group * 2] = _mm_set1_epi8(static_cast<char>(signature.values[filter.offsets[group][0]]));
+				anchors[(group * 2) + 1] = _mm_set1_epi8(static_cast<char>(signature.values[filter.offsets[group][1]]));
+			}
+
+			for (; last - cur >= 15; cur += 16) {
+				uint32_t candidates = 0;
+				for (uint32_t group = 0; group < filter.count; ++group) {
+					auto first = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + filter.offsets[group][0])), anchors[group * 2]);
+					auto second = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cur + filter.offsets[group][1])), anchors[(group * 2) + 1]);
+					candidates |= static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(first, second)));
+				}
+
+				while (candidates != 0) {
+					const auto *candidate = cur + std::countr_zero(candidates);
+					candidates &= candidates - 1;
+
+					auto distance = count(candidate);
+					if (distance <= max_mismatches) {
+						results.push_back({ candidate, distance });
+					}
+				}
+			}
+		}
+
+		find_approximate_tail(cur, last, signature, filter, max_mismatches, count, results);
+	}
+
+	STORMBIRD_TARGET("avx2")
+	void
+	find_approximate_avx2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results) {
+		if (signature.size == 0 || end - begin < static_cast<ptrdiff_t>(signature.size)) {
+			return;
+		}
+
+		auto filter = make_mismatch_filter(signature, max_mismatches);
+		auto count = [&](const uint8_t *data) STORMBIRD_TARGET("avx2") {
+			uint32_t mismatches = 0;
+			uint32_t index = 0;
+			for (; index + 32 <= signature.size && mismatches <= max_mismatches; index += 32) {
+				auto masked = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + index)), _mm256_loadu_si256(reinterpret_cast<const __m256i *>(signature.masks + index)));
+				auto equal = _mm256_cmpeq_epi8(masked, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(signature.values + index)));
+				mismatches += std::popcount(~static_cast<uint32_t>(_mm256_movemask_epi8(equal)));
+			}
+
+			return count_mismatches(data, signature, index, mismatches, max_mismatches);
+		};
+
+		const auto *last = end - signature.size;
+		const auto *cur = begin;
+		if (filter.count > 0) {
+			__m256i anchors[max_filter_groups * 2]; // NOLINT(*-avoid-c-arrays)
+			for (uint32_t group = 0; group < filter.count; ++group) {
+				anchors[group * 2] = _mm256_set1_epi8(static_cast<char>(signature.values[filter.offsets[group][0]]));
+				anchors[(group * 2) + 1] = _mm256_set1_epi8(static_cast<char>(signature.values[filter.offsets[group][1]]));
+			}
+
+			for (; last - cur >= 31; cur += 32) {
+				uint32_t candidates = 0;
+				for (uint32_t group = 0; group < filter.count; ++group) {
+					auto first = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur + filter.offsets[group][0])), anchors[group * 2]);
+					auto second = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur + filter.offsets[group][1])), anchors[(group * 2) + 1]);
+					candidates |= static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(first, second)));
+				}
+
+				while (candidates != 0) {
+					const auto *candidate = cur + std::countr_zero(candidates);
+					candidates &= candidates - 1;
+
+					auto distance = count(candidate);
+					if (distance <= max_mismatches) {
+						results.push_back({ candidate, distance });
+					}
+				}
+			}
+		}
+
+		find_approximate_tail(cur, last, signature, filter, max_mismatches, count, results);
+	}
+#else
+	void
+	find_approximate_sse2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results) {
+		find_approximate_scalar(begin, end, signature, max_mismatches, results);
+	}
+
+	void
+	find_approximate_avx2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results) {
+		find_approximate_scalar(begin, end, signature, max_mismatches, results);
+	}
+#endif
+} // namespace stormbird_hook
+
+#pragma clang diagnostic pop
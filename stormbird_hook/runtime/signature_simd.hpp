@@ -0,0 +1,81 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "signature_pattern.hpp"
+
+namespace stormbird_hook {
+	enum class signature_isa : uint8_t {
+		scalar,
+		sse2,
+		avx2,
+		avx512
+	};
+
+	// a position within some number of mismatched literal bytes of a signature
+	struct approximate_match {
+		const uint8_t *address { nullptr };
+		uint32_t distance { 0 }; // mismatched literal bytes, 0 for an exact match
+	};
+
+	// a set of byte values as two nibble tables, so a byte shuffle tests a whole vector of bytes at once.
+	// a byte is in the set when low[byte & 15] & high[byte >> 4] is not zero. the first 8 high nibbles added get a
+	// bit of their own, later ones share, so bytes outside the set may pass but no byte in it is missed.
+	struct anchor_byte_set {
+		std::array<uint8_t, 16> low {};
+		std::array<uint8_t, 16> high {};
+		uint32_t high_count { 0 };
+
+		void
+		add(uint8_t value) {
+			auto high_nibble = value >> 4;
+			if (high[high_nibble] == 0) {
+				high[high_nibble] = static_cast<uint8_t>(1 << (high_count++ % 8));
+			}
+
+			low[value & 15] |= high[high_nibble];
+		}
+
+		[[nodiscard]] auto
+		may_contain(uint8_t value) const -> bool {
+			return (low[value & 15] & high[value >> 4]) != 0;
+		}
+	};
+
+	// highest instruction set supported by both the cpu and the os, checked once
+	auto
+	detect_signature_isa() -> signature_isa;
+
+	// vectorized matchers, these append non-overlapping matches in [begin, end) in ascending order.
+	// callers must check detect_signature_isa() before using anything above sse2.
+	void
+	find_signature_sse2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results);
+
+	void
+	find_signature_avx2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results);
+
+	void
+	find_signature_avx512(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, std::vector<const uint8_t *> &results);
+
+	// appends the offset from begin of every position in [begin, end) whose byte may be in the set, in ascending order.
+	// callers must check detect_signature_isa() for avx2.
+	void
+	find_anchor_bytes_avx2(const uint8_t *begin, const uint8_t *end, const anchor_byte_set &set, std::vector<uint32_t> &offsets);
+
+	// approximate matchers, these append every position in [begin, end) within max_mismatches literal bytes of the
+	// signature in ascending order. positions may overlap, nothing is skipped after a hit.
+	void
+	find_approximate_scalar(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results);
+
+	void
+	find_approximate_sse2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results);
+
+	void
+	find_approximate_avx2(const uint8_t *begin, const uint8_t *end, const hex_signature &signature, uint32_t max_mismatches, std::vector<approximate_match> &results);
+} // namespace stormbird_hook
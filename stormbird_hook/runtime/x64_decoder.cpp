@@ -0,0 +1,391 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "x64_decoder.hpp"
+
+namespace {
+	constexpr size_t max_instruction_length = 15;
+
+	struct opcode_info {
+		bool valid { true };
+		bool modrm { false };
+		uint8_t immediate { 0 };
+		bool relative { false };
+		bool operand_sized { false }; // a 4 byte immediate shrinks to 2 bytes with a 66 prefix
+	};
+
+	constexpr opcode_info invalid_opcode { .valid = false };
+	constexpr opcode_info no_operands {};
+	constexpr opcode_info with_modrm { .modrm = true };
+
+	constexpr auto
+	immediate(uint8_t size, bool modrm = false) -> opcode_info {
+		return { .modrm = modrm, .immediate = size, .operand_sized = size == 4 };
+	}
+
+	constexpr auto
+	branch(uint8_t size) -> opcode_info {
+		return { .immediate = size, .relative = true };
+	}
+
+	auto
+	one_byte_info(uint8_t opcode, bool rex_w) -> opcode_info {
+		if (opcode < 0x40) { // the alu block, the prefixes and 0f are handled before this
+			switch (opcode & 7) {
+				case 0:
+				case 1:
+				case 2:
+				case 3: return with_modrm;
+				case 4: return immediate(1);
+				case 5: return immediate(4);
+				default: return invalid_opcode;
+			}
+		}
+
+		if (opcode >= 0x50 && opcode <= 0x5F) {
+			return no_operands;
+		}
+
+		if (opcode >= 0x70 && opcode <= 0x7F) {
+			return branch(1);
+		}
+
+		if (opcode >= 0x84 && opcode <= 0x8F) {
+			return with_modrm;
+		}
+
+		if ((opcode >= 0x90 && opcode <= 0x99) || (opcode >= 0x9B && opcode <= 0x9F)) {
+			return no_operands;
+		}
+
+		if (opcode >= 0xA0 && opcode <= 0xA3) { // mov with a full 64-bit address
+			return { .immediate = 8 };
+		}
+
+		if (opcode >= 0xB0 && opcode <= 0xB7) {
+			return immediate(1);
+		}
+
+		if (opcode >= 0xB8 && opcode <= 0xBF) { // the only 8 byte immediate
+			return rex_w ? opcode_info { .immediate = 8 } : immediate(4);
+		}
+
+		if (opcode >= 0xD8 && opcode <= 0xDF) { // x87
+			return with_modrm;
+		}
+
+		switch (opcode) {
+			case 0x63: return with_modrm;
+			case 0x68: return immediate(4);
+			case 0x69: return immediate(4, true);
+			case 0x6A: return immediate(1);
+			case 0x6B: return immediate(1, true);
+			case 0x6C:
+			case 0x6D:
+			case 0x6E:
+			case 0x6F: return no_operands;
+			case 0x80: return immediate(1, true);
+			case 0x81: return immediate(4, true);
+			case 0x83: return immediate(1, true);
+			case 0xA4:
+			case 0xA5:
+			case 0xA6:
+			case 0xA7: return no_operands;
+			case 0xA8: return immediate(1);
+			case 0xA9: return immediate(4);
+			case 0xAA:
+			case 0xAB:
+			case 0xAC:
+			case 0xAD:
+			case 0xAE:
+			case 0xAF: return no_operands;
+			case 0xC0:
+			case 0xC1: return immediate(1, true);
+			case 0xC2: return { .immediate = 2 };
+			case 0xC3: return no_operands;
+			case 0xC6: return immediate(1, true);
+			case 0xC7: return immediate(4, true);
+			case 0xC8: return { .immediate = 3 }; // enter imm16, imm8
+			case 0xC9: return no_operands;
+			case 0xCA: return { .immediate = 2 };
+			case 0xCB:
+			case 0xCC: return no_operands;
+			case 0xCD: return immediate(1);
+			case 0xCF: return no_operands;
+			case 0xD0:
+			case 0xD1:
+			case 0xD2:
+			case 0xD3: return with_modrm;
+			case 0xD7: return no_operands;
+			case 0xE0:
+			case 0xE1:
+			case 0xE2:
+			case 0xE3: return branch(1);
+			case 0xE4:
+			case 0xE5:
+			case 0xE6:
+			case 0xE7: return immediate(1);
+			case 0xE8:
+			case 0xE9: return branch(4);
+			case 0xEB: return branch(1);
+			case 0xEC:
+			case 0xED:
+			case 0xEE:
+			case 0xEF:
+			case 0xF1:
+			case 0xF4:
+			case 0xF5: return no_operands;
+			case 0xF6:
+			case 0xF7: return with_modrm; // the test immediate depends on modrm.reg
+			case 0xF8:
+			case 0xF9:
+			case 0xFA:
+			case 0xFB:
+			case 0xFC:
+			case 0xFD: return no_operands;
+			case 0xFE:
+			case 0xFF: return with_modrm;
+			default: return invalid_opcode;
+		}
+	}
+
+	auto
+	two_byte_info(uint8_t opcode) -> opcode_info {
+		if (opcode >= 0x80 && opcode <= 0x8F) { // jcc rel32
+			return branch(4);
+		}
+
+		if (opcode >= 0xC8 && opcode <= 0xCF) { // bswap
+			return no_operands;
+		}
+
+		switch (opcode) {
+			case 0x04:
+			case 0x0A:
+			case 0x0C:
+			case 0x36:
+			case 0x39:
+			case 0x3B:
+			case 0x3C:
+			case 0x3D:
+			case 0x3E:
+			case 0x3F: return invalid_opcode;
+			case 0x05:
+			case 0x06:
+			case 0x07:
+			case 0x08:
+			case 0x09:
+			case 0x0B:
+			case 0x0E:
+			case 0x30:
+			case 0x31:
+			case 0x32:
+			case 0x33:
+			case 0x34:
+			case 0x35:
+			case 0x37:
+			case 0x77:
+			case 0xA0:
+			case 0xA1:
+			case 0xA2:
+			case 0xA8:
+			case 0xA9:
+			case 0xAA: return no_operands;
+			case 0x0F: // 3dnow, the opcode is the trailing byte
+			case 0x70:
+			case 0x71:
+			case 0x72:
+			case 0x73:
+			case 0xA4:
+			case 0xAC:
+			case 0xBA:
+			case 0xC2:
+			case 0xC4:
+			case 0xC5:
+			case 0xC6: return { .modrm = true, .immediate = 1 };
+			default: return with_modrm;
+		}
+	}
+
+	// immediate byte of the vex and evex encoded instructions in the 0f map
+	auto
+	vex_map1_immediate(uint8_t opcode) -> uint8_t {
+		switch (opcode) {
+			case 0x70:
+			case 0x71:
+			case 0x72:
+			case 0x73:
+			case 0xC2:
+			case 0xC4:
+			case 0xC5:
+			case 0xC6: return 1;
+			default: return 0;
+		}
+	}
+
+	auto
+	is_legacy_prefix(uint8_t value) -> bool {
+		switch (value) {
+			case 0x26:
+			case 0x2E:
+			case 0x36:
+			case 0x3E:
+			case 0x64:
+			case 0x65:
+			case 0x66:
+			case 0x67:
+			case 0xF0:
+			case 0xF2:
+			case 0xF3: return true;
+			default: return false;
+		}
+	}
+} // namespace
+
+namespace stormbird_hook {
+	auto
+	decode_x64(std::span<const uint8_t> code) -> std::optional<x64_instruction> {
+		if (code.size() > max_instruction_length) {
+			code = code.first(max_instruction_length);
+		}
+
+		size_t pos = 0;
+		auto operand_size_prefix = false;
+		auto address_size_prefix = false;
+		while (pos < code.size() && is_legacy_prefix(code[pos])) {
+			operand_size_prefix |= code[pos] == 0x66;
+			address_size_prefix |= code[pos] == 0x67;
+			pos++;
+		}
+
+		auto rex_w = false;
+		if (pos < code.size() && (code[pos] & 0xF0) == 0x40) {
+			rex_w = (code[pos] & 0x08) != 0;
+			pos++;
+		}
+
+		if (pos >= code.size()) {
+			return std::nullopt;
+		}
+
+		opcode_info info;
+		auto opcode = code[pos++];
+		auto test_immediate = false;
+
+		if (opcode == 0xC4 || opcode == 0xC5 || opcode == 0x62) { // vex and evex, always followed by an opcode and modrm
+			size_t payload = opcode == 0xC5 ? 1 : (opcode == 0xC4 ? 2 : 3);
+			if (pos + payload >= code.size()) {
+				return std::nullopt;
+			}
+
+			uint8_t map = opcode == 0xC5 ? 1 : (code[pos] & (opcode == 0xC4 ? 0x1F : 0x07));
+			pos += payload;
+			auto vex_opcode = code[pos++];
+
+			info = with_modrm;
+			if (map == 3) {
+				info.immediate = 1;
+			} else if (map == 1) {
+				info.immediate = vex_map1_immediate(vex_opcode);
+				if (vex_opcode == 0x77 && opcode != 0x62) { // vzeroupper and vzeroall
+					info = no_operands;
+				}
+			} else if (map != 2 && !(opcode == 0x62 && (map == 5 || map == 6))) { // evex maps 5 and 6 are fp16
+				return std::nullopt;
+			}
+		} else if (opcode == 0x0F) {
+			if (pos >= code.size()) {
+				return std::nullopt;
+			}
+
+			auto second = code[pos++];
+			if (second == 0x38) {
+				if (pos >= code.size()) {
+					return std::nullopt;
+				}
+
+				pos++;
+				info = with_modrm;
+			} else if (second == 0x3A) {
+				if (pos >= code.size()) {
+					return std::nullopt;
+				}
+
+				pos++;
+				info = { .modrm = true, .immediate = 1 };
+			} else {
+				info = two_byte_info(second);
+			}
+		} else {
+			info = one_byte_info(opcode, rex_w);
+			test_immediate = opcode == 0xF6 || opcode == 0xF7;
+			if (opcode >= 0xA0 && opcode <= 0xA3 && address_size_prefix) {
+				info.immediate = 4;
+			}
+		}
+
+		if (!info.valid) {
+			return std::nullopt;
+		}
+
+		x64_instruction instruction;
+		if (info.modrm) {
+			if (pos >= code.size()) {
+				return std::nullopt;
+			}
+
+			auto modrm = code[pos++];
+			auto mod = modrm >> 6;
+			auto reg = (modrm >> 3) & 7;
+			auto rm = modrm & 7;
+
+			if (mod != 3) {
+				if (rm == 4) { // sib
+					if (pos >= code.size()) {
+						return std::nullopt;
+					}
+
+					auto sib = code[pos++];
+					if (mod == 0 && (sib & 7) == 5) {
+						instruction.displacement_size = 4;
+					}
+				} else if (mod == 0 && rm == 5) {
+					instruction.displacement_size = 4;
+					instruction.rip_relative = true;
+				}
+
+				if (mod == 1) {
+					instruction.displacement_size = 1;
+				} else if (mod == 2) {
+					instruction.displacement_size = 4;
+				}
+			}
+
+			if (test_immediate && reg <= 1) {
+				info.immediate = opcode == 0xF6 ? 1 : 4;
+				info.operand_sized = opcode == 0xF7;
+			}
+		}
+
+		instruction.displacement_offset = static_cast<uint8_t>(pos);
+		pos += instruction.displacement_size;
+
+		auto immediate_size = info.immediate;
+		if (info.operand_sized && operand_size_prefix) {
+			immediate_size = 2;
+		}
+
+		instruction.immediate_offset = static_cast<uint8_t>(pos);
+		instruction.immediate_size = immediate_size;
+		instruction.relative_branch = info.relative;
+		pos += immediate_size;
+
+		if (pos > code.size()) {
+			return std::nullopt;
+		}
+
+		instruction.length = static_cast<uint8_t>(pos);
+		return instruction;
+	}
+} // namespace stormbird_hook
@@ -0,0 +1,28 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+// just enough of an x64 decoder to find instruction boundaries and the operand bytes that move between builds:
+// branch displacements, rip-relative displacements and memory displacements.
+
+namespace stormbird_hook {
+	struct x64_instruction {
+		uint8_t length { 0 };
+		uint8_t displacement_offset { 0 }; // modrm displacement, offset from the start of the instruction
+		uint8_t displacement_size { 0 }; // 0, 1 or 4
+		uint8_t immediate_offset { 0 };
+		uint8_t immediate_size { 0 }; // 0, 1, 2, 3 (enter), 4 or 8
+		bool rip_relative { false }; // the displacement is relative to the next instruction
+		bool relative_branch { false }; // the immediate is a branch displacement, rel8 or rel32
+	};
+
+	// decodes the instruction at the start of code, nothing if it is invalid in 64-bit mode or runs past the end
+	auto
+	decode_x64(std::span<const uint8_t> code) -> std::optional<x64_instruction>;
+} // namespace stormbird_hook
@@ -0,0 +1,167 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include "xref_index.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "hash.hpp"
+
+namespace {
+	constexpr uint32_t pointer_alignment = 8;
+
+	auto
+	is_string_byte(uint8_t value) -> bool {
+		return (value >= 0x20 && value < 0x7F) || value == '\t' || value == '\n' || value == '\r';
+	}
+
+	auto
+	is_data_section(const stormbird_hook::pe_section &section) -> bool {
+		return !section.executable() && (section.characteristics & stormbird_hook::pe_section_initialized_data) != 0;
+	}
+} // namespace
+
+namespace stormbird_hook {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	auto
+	xref_index::build(std::vector<xref_region> regions, uint64_t image_base, uint32_t size_of_image) -> xref_index {
+		xref_index index;
+		index.base = image_base;
+		index.size = size_of_image;
+		index.regions = std::move(regions);
+		std::sort(index.regions.begin(), index.regions.end(), [](const xref_region &lhs, const xref_region &rhs) { return lhs.rva < rhs.rva; });
+
+		for (const auto &region : index.regions) {
+			const auto *data = region.bytes.data();
+			auto count = region.bytes.size();
+
+			// pointers, aligned on the rva since the sections are at least page aligned once loaded
+			for (size_t offset = (pointer_alignment - (region.rva % pointer_alignment)) % pointer_alignment; offset + sizeof(uint64_t) <= count; offset += pointer_alignment) {
+				uint64_t value = 0;
+				std::memcpy(&value, data + offset, sizeof(value));
+				if (index.contains(value)) {
+					index.pointers.push_back({ value, static_cast<uint32_t>(region.rva + offset) });
+				}
+			}
+
+			// strings, each run of printable bytes that ends in a nul
+			size_t start = 0;
+			for (size_t offset = 0; offset < count; ++offset) {
+				if (is_string_byte(data[offset])) {
+					continue;
+				}
+
+				if (data[offset] == 0 && offset - start >= min_string_size) {
+					auto size = static_cast<uint32_t>(offset - start);
+					index.strings.push_back({ hash_bytes({ data + start, size }), static_cast<uint32_t>(region.rva + start), size });
+				}
+
+				start = offset + 1;
+			}
+		}
+
+		std::sort(index.pointers.begin(), index.pointers.end(), [](const xref_pointer &lhs, const xref_pointer &rhs) { return lhs.target != rhs.target ? lhs.target < rhs.target : lhs.rva < rhs.rva; });
+		std::sort(index.strings.begin(), index.strings.end(), [](const xref_string &lhs, const xref_string &rhs) { return lhs.hash != rhs.hash ? lhs.hash < rhs.hash : lhs.rva < rhs.rva; });
+		return index;
+	}
+
+	auto
+	xref_index::pointers_to(uint64_t address) const -> std::span<const xref_pointer> {
+		auto first = std::lower_bound(pointers.begin(), pointers.end(), address, [](const xref_pointer &pointer, uint64_t value) { return pointer.target < value; });
+		auto last = std::upper_bound(first, pointers.end(), address, [](uint64_t value, const xref_pointer &pointer) { return value < pointer.target; });
+		return { first, last };
+	}
+
+	auto
+	xref_index::find_string(std::string_view text) const -> std::vector<uint32_t> {
+		std::vector<uint32_t> results;
+		auto hash = hash_bytes({ reinterpret_cast<const uint8_t *>(text.data()), text.size() });
+		auto first = std::lower_bound(strings.begin(), strings.end(), hash, [](const xref_string &string, uint64_t value) { return string.hash < value; });
+		for (auto it = first; it != strings.end() && it->hash == hash; ++it) {
+			if (it->size == text.size() && string_at(it->rva) == text) {
+				results.push_back(it->rva);
+			}
+		}
+
+		return results;
+	}
+
+	auto
+	xref_index::pointers_to_string(std::string_view text) const -> std::vector<uint32_t> {
+		std::vector<uint32_t> results;
+		for (auto rva : find_string(text)) {
+			for (const auto &pointer : pointers_to(base + rva)) {
+				results.push_back(pointer.rva);
+			}
+		}
+
+		std::sort(results.begin(), results.end());
+		return results;
+	}
+
+	auto
+	xref_index::string_at(uint32_t rva) const -> std::optional<std::string_view> {
+		auto next = std::upper_bound(regions.begin(), regions.end(), rva, [](uint32_t value, const xref_region &region) { return value < region.rva; });
+		if (next == regions.begin()) {
+			return std::nullopt;
+		}
+
+		const auto &region = *(next - 1);
+		if (rva - region.rva >= region.bytes.size()) {
+			return std::nullopt;
+		}
+
+		const auto *text = reinterpret_cast<const char *>(region.bytes.data() + (rva - region.rva));
+		auto available = region.bytes.size() - (rva - region.rva);
+		const auto *terminator = static_cast<const char *>(std::memchr(text, 0, available));
+		if (terminator == nullptr) {
+			return std::nullopt;
+		}
+
+		return std::string_view(text, terminator - text);
+	}
+
+	auto
+	build_xref_index(std::span<const uint8_t> file, const pe_image &image) -> xref_index {
+		std::vector<xref_region> regions;
+		for (const auto &section : image.sections) {
+			if (!is_data_section(section) || section.raw_offset >= file.size()) {
+				continue;
+			}
+
+			auto size = std::min<size_t>({ section.raw_size, section.mapped_size(), file.size() - section.raw_offset });
+			regions.push_back({ file.subspan(section.raw_offset, size), section.virtual_address });
+		}
+
+		return xref_index::build(std::move(regions), image.image_base, image.size_of_image);
+	}
+
+	auto
+	build_loaded_xref_index(const uint8_t *base, const pe_image &image, std::span<const std::pair<const uint8_t *, const uint8_t *>> readable) -> xref_index {
+		std::vector<xref_region> regions;
+		for (const auto &section : image.sections) {
+			if (!is_data_section(section) || section.virtual_address >= image.size_of_image) {
+				continue;
+			}
+
+			// a section may have pages the game decommitted or protected, only the readable parts of it are indexed
+			const auto *section_begin = base + section.virtual_address;
+			const auto *section_end = section_begin + std::min(section.mapped_size(), image.size_of_image - section.virtual_address);
+			for (const auto &[begin, end] : readable) {
+				const auto *from = std::max(begin, section_begin);
+				const auto *to = std::min(end, section_end);
+				if (from < to) {
+					regions.push_back({ { from, static_cast<size_t>(to - from) }, static_cast<uint32_t>(from - base) });
+				}
+			}
+		}
+
+		return xref_index::build(std::move(regions), reinterpret_cast<uint64_t>(base), image.size_of_image);
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_hook
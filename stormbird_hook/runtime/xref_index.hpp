@@ -0,0 +1,104 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "pe_image.hpp"
+
+// cross references of an image's data sections, built in one pass: every aligned pointer into the image and every
+// string literal. answers "who points at this address" and "who points at this string" with a binary search,
+// which is enough to find rtti records by their names without hooking anything.
+
+namespace stormbird_hook {
+	// bytes of one section, as laid out on disk or by the loader
+	struct xref_region {
+		std::span<const uint8_t> bytes;
+		uint32_t rva { 0 };
+	};
+
+	// an 8 byte aligned value holding an address inside the image
+	struct xref_pointer {
+		uint64_t target { 0 }; // address pointed at
+		uint32_t rva { 0 }; // where the pointer is stored
+	};
+
+	// a nul terminated run of printable ascii
+	struct xref_string {
+		uint64_t hash { 0 }; // hash_bytes() of the text
+		uint32_t rva { 0 };
+		uint32_t size { 0 }; // without the nul
+	};
+
+	class xref_index {
+	public:
+		static constexpr uint32_t min_string_size = 4;
+
+		// image_base is wherever the pointers in the regions are relative to: the preferred base on disk, the real base in memory.
+		// the regions are not copied, they have to outlive the index.
+		static auto
+		build(std::vector<xref_region> regions, uint64_t image_base, uint32_t size_of_image) -> xref_index;
+
+		// every pointer to address, ordered by where it is stored
+		[[nodiscard]] auto
+		pointers_to(uint64_t address) const -> std::span<const xref_pointer>;
+
+		// rvas of every string equal to text
+		[[nodiscard]] auto
+		find_string(std::string_view text) const -> std::vector<uint32_t>;
+
+		// rvas of every pointer to a string equal to text
+		[[nodiscard]] auto
+		pointers_to_string(std::string_view text) const -> std::vector<uint32_t>;
+
+		// the nul terminated string stored at rva, nothing if rva is not in an indexed region or the string is cut off
+		[[nodiscard]] auto
+		string_at(uint32_t rva) const -> std::optional<std::string_view>;
+
+		// true if address is inside the image
+		[[nodiscard]] auto
+		contains(uint64_t address) const -> bool {
+			return address >= base && address - base < size;
+		}
+
+		[[nodiscard]] auto
+		image_base() const -> uint64_t {
+			return base;
+		}
+
+		// every pointer in the index, sorted by target
+		[[nodiscard]] auto
+		all_pointers() const -> std::span<const xref_pointer> {
+			return pointers;
+		}
+
+		[[nodiscard]] auto
+		string_count() const -> size_t {
+			return strings.size();
+		}
+
+	private:
+		uint64_t base { 0 };
+		uint32_t size { 0 };
+		std::vector<xref_region> regions; // sorted by rva
+		std::vector<xref_pointer> pointers; // sorted by target, then rva
+		std::vector<xref_string> strings; // sorted by hash, then rva
+	};
+
+	// indexes the data sections of a pe file on disk, everything that is neither code nor zero fill
+	auto
+	build_xref_index(std::span<const uint8_t> file, const pe_image &image) -> xref_index;
+
+	// indexes the data sections of an image the loader mapped at base, pointers are relative to base.
+	// readable are the [begin, end) ranges of the image that are committed and readable, e.g. from for_each_module_region(),
+	// nothing outside of them is read.
+	auto
+	build_loaded_xref_index(const uint8_t *base, const pe_image &image, std::span<const std::pair<const uint8_t *, const uint8_t *>> readable) -> xref_index;
+} // namespace stormbird_hook
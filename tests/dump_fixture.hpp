@@ -0,0 +1,42 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// reads back what a dump wrote. the file views want 8 byte alignment, which a string does not promise.
+
+namespace stormbird_test {
+	inline auto
+	aligned_copy(const std::string &bytes) -> std::vector<uint64_t> {
+		std::vector<uint64_t> copy((bytes.size() + 7) / 8);
+		std::memcpy(copy.data(), bytes.data(), bytes.size());
+		return copy;
+	}
+
+	inline auto
+	as_bytes(const std::vector<uint64_t> &copy, size_t size) -> std::span<const uint8_t> {
+		return { reinterpret_cast<const uint8_t *>(copy.data()), size };
+	}
+
+	// the objects of an rtti.json, in no particular order
+	inline auto
+	sorted_objects(const std::string &json) -> std::vector<std::string> {
+		std::vector<std::string> objects;
+		for (const auto &object : nlohmann::ordered_json::parse(json)) {
+			objects.push_back(object.dump());
+		}
+
+		std::sort(objects.begin(), objects.end());
+		return objects;
+	}
+} // namespace stormbird_test
@@ -0,0 +1,139 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// json_writer has to write exactly what nlohmann::json::dump() wrote before it
+
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <snitch/snitch.hpp>
+
+#include "json_writer.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	// every control character, the characters json escapes and some utf-8 that is passed through
+	auto
+	awkward_strings() -> std::vector<std::string> {
+		std::vector<std::string> strings = { "", "plain", "quote \" and backslash \\", "slash / stays", "\xC3\xA9t\xC3\xA9", "\xE2\x82\xAC \xF0\x9F\x98\x80", "\x7F" };
+		std::string controls;
+		for (char value = 0; value < 0x20; ++value) {
+			controls += value;
+			strings.emplace_back(1, value);
+		}
+
+		strings.push_back(controls);
+		strings.push_back("a\nb\tc\rd\be\ff\x01g");
+		return strings;
+	}
+
+	template<typename Write>
+	auto
+	written(Write &&write) -> std::string {
+		std::ostringstream output;
+		{
+			json_writer writer(output);
+			write(writer);
+		}
+
+		return output.str();
+	}
+} // namespace
+
+TEST_CASE("escapes strings like nlohmann", "[json_writer]") {
+	for (const auto &text : awkward_strings()) {
+		CHECK(written([&](json_writer &writer) { writer.value(text); }) == nlohmann::json(text).dump());
+	}
+
+	CHECK(written([](json_writer &writer) { writer.value(static_cast<const char *>(nullptr)); }) == "\"\"");
+}
+
+TEST_CASE("writes integers like nlohmann", "[json_writer]") {
+	for (uint64_t number : { uint64_t { 0 }, uint64_t { 1 }, uint64_t { 9 }, uint64_t { 10 }, uint64_t { 0x7FFFFFFF }, uint64_t { 0xFFFFFFFF }, std::numeric_limits<uint64_t>::max() }) {
+		CHECK(written([&](json_writer &writer) { writer.value(number); }) == nlohmann::json(number).dump());
+	}
+
+	auto fields = written([](json_writer &writer) {
+		writer.begin_object();
+		writer.field("u8", std::numeric_limits<uint8_t>::max());
+		writer.field("u16", std::numeric_limits<uint16_t>::max());
+		writer.field("u32", std::numeric_limits<uint32_t>::max());
+		writer.field("u64", std::numeric_limits<uint64_t>::max());
+		writer.field("text", "value");
+		writer.end_object();
+	});
+
+	nlohmann::ordered_json expected;
+	expected["u8"] = std::numeric_limits<uint8_t>::max();
+	expected["u16"] = std::numeric_limits<uint16_t>::max();
+	expected["u32"] = std::numeric_limits<uint32_t>::max();
+	expected["u64"] = std::numeric_limits<uint64_t>::max();
+	expected["text"] = "value";
+	CHECK(fields == expected.dump());
+}
+
+TEST_CASE("nests arrays and objects like nlohmann", "[json_writer]") {
+	auto json = written([](json_writer &writer) {
+		writer.begin_array();
+		writer.begin_object();
+		writer.end_object();
+		writer.begin_array();
+		writer.end_array();
+		for (const auto &text : awkward_strings()) {
+			writer.begin_object();
+			writer.field(text, text);
+			writer.key("list");
+			writer.begin_array();
+			writer.value(uint64_t { 1 });
+			writer.value(text);
+			writer.begin_object();
+			writer.end_object();
+			writer.end_array();
+			writer.end_object();
+		}
+		writer.end_array();
+	});
+
+	nlohmann::ordered_json expected = nlohmann::ordered_json::array();
+	expected.push_back(nlohmann::ordered_json::object());
+	expected.push_back(nlohmann::ordered_json::array());
+	for (const auto &text : awkward_strings()) {
+		nlohmann::ordered_json element;
+		element[text] = text;
+		element["list"] = nlohmann::ordered_json::array({ 1, text, nlohmann::ordered_json::object() });
+		expected.push_back(element);
+	}
+
+	CHECK(json == expected.dump());
+	CHECK(nlohmann::ordered_json::parse(json) == expected);
+}
+
+TEST_CASE("writes values larger than its buffer", "[json_writer]") {
+	std::string text(json_writer::buffer_size * 2 + 17, 'x');
+	for (size_t index = 0; index < text.size(); index += 997) {
+		text[index] = '\n';
+	}
+
+	auto json = written([&](json_writer &writer) {
+		writer.begin_array();
+		for (int round = 0; round < 3; ++round) {
+			writer.value(text);
+			writer.value(std::numeric_limits<uint64_t>::max());
+		}
+		writer.end_array();
+	});
+
+	nlohmann::json expected = nlohmann::json::array();
+	for (int round = 0; round < 3; ++round) {
+		expected.push_back(text);
+		expected.push_back(std::numeric_limits<uint64_t>::max());
+	}
+
+	CHECK(json == expected.dump());
+}
@@ -0,0 +1,152 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+#include "pe_image.hpp"
+
+// builds small pe32 and pe32+ files for the tests, with just the header fields parse_pe_image() reads
+
+namespace stormbird_test {
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	using stormbird_hook::pe_data_directory;
+
+	struct pe_fixture_section {
+		std::string_view name;
+		uint32_t virtual_address { 0 };
+		uint32_t virtual_size { 0 };
+		std::vector<uint8_t> data; // raw data, zero fill past it up to the virtual size
+		uint32_t characteristics { 0 };
+	};
+
+	struct pe_fixture {
+		static constexpr uint32_t nt_offset = 0x80;
+		static constexpr uint32_t file_alignment = 0x200;
+		static constexpr uint32_t size_of_headers = 0x400;
+
+		bool is_64 { true };
+		uint16_t machine { 0x8664 };
+		uint32_t timestamp { 0x5F000000 };
+		uint64_t image_base { 0x140000000 };
+		uint32_t entry_point { 0x1000 };
+		uint32_t size_of_image { 0x10000 };
+		uint32_t directory_count { 16 };
+		std::array<pe_data_directory, 16> directories {};
+		std::vector<pe_fixture_section> sections;
+
+		[[nodiscard]] auto
+		optional_header_size() const -> uint16_t {
+			return static_cast<uint16_t>((is_64 ? 112 : 96) + directory_count * sizeof(pe_data_directory));
+		}
+
+		// where the section table starts in the file
+		[[nodiscard]] auto
+		section_table() const -> uint32_t {
+			return nt_offset + 24 + optional_header_size();
+		}
+
+		// file offset of a section's raw data
+		[[nodiscard]] auto
+		raw_offset(size_t index) const -> uint32_t {
+			auto offset = size_of_headers;
+			for (size_t prior = 0; prior < index; ++prior) {
+				offset += align(static_cast<uint32_t>(sections[prior].data.size()));
+			}
+
+			return offset;
+		}
+
+		// the file as it is on disk
+		[[nodiscard]] auto
+		file() const -> std::vector<uint8_t> {
+			std::vector<uint8_t> bytes(raw_offset(sections.size()));
+			auto put = [&bytes](size_t offset, auto value) { std::memcpy(bytes.data() + offset, &value, sizeof(value)); };
+
+			put(0, uint16_t { 0x5A4D });
+			put(0x3C, nt_offset);
+			put(nt_offset, uint32_t { 0x00004550 });
+
+			auto file_header = nt_offset + 4;
+			put(file_header, machine);
+			put(file_header + 2, static_cast<uint16_t>(sections.size()));
+			put(file_header + 4, timestamp);
+			put(file_header + 16, optional_header_size());
+
+			auto optional_header = file_header + 20;
+			put(optional_header, uint16_t { static_cast<uint16_t>(is_64 ? 0x20B : 0x10B) });
+			put(optional_header + 16, entry_point);
+			if (is_64) {
+				put(optional_header + 24, image_base);
+			} else {
+				put(optional_header + 28, static_cast<uint32_t>(image_base));
+			}
+
+			put(optional_header + 36, file_alignment);
+			put(optional_header + 56, size_of_image);
+			put(optional_header + 60, size_of_headers);
+
+			auto directory_table = optional_header + (is_64 ? 108 : 92);
+			put(directory_table, directory_count);
+			for (uint32_t index = 0; index < directory_count; ++index) {
+				put(directory_table + 4 + index * sizeof(pe_data_directory), directories[index]);
+			}
+
+			for (size_t index = 0; index < sections.size(); ++index) {
+				const auto &section = sections[index];
+				auto header = section_table() + index * 40;
+				std::copy_n(section.name.begin(), std::min<size_t>(section.name.size(), 8), bytes.begin() + static_cast<ptrdiff_t>(header));
+				put(header + 8, section.virtual_size);
+				put(header + 12, section.virtual_address);
+				put(header + 16, static_cast<uint32_t>(section.data.size()));
+				put(header + 20, section.data.empty() ? 0u : raw_offset(index));
+				put(header + 36, section.characteristics);
+				std::copy(section.data.begin(), section.data.end(), bytes.begin() + raw_offset(index));
+			}
+
+			return bytes;
+		}
+
+		// the image the way the loader maps it, every section at its rva
+		[[nodiscard]] auto
+		loaded() const -> std::vector<uint8_t> {
+			auto bytes = file();
+			std::vector<uint8_t> image(size_of_image);
+			std::copy_n(bytes.begin(), std::min<size_t>(size_of_headers, bytes.size()), image.begin());
+			for (const auto &section : sections) {
+				std::copy(section.data.begin(), section.data.end(), image.begin() + section.virtual_address);
+			}
+
+			return image;
+		}
+
+	private:
+		static auto
+		align(uint32_t size) -> uint32_t {
+			return (size + file_alignment - 1) / file_alignment * file_alignment;
+		}
+	};
+
+	// a base relocation block for one page, entries are type << 12 | page offset
+	inline auto
+	relocation_block(uint32_t page, std::initializer_list<uint16_t> entries) -> std::vector<uint8_t> {
+		std::vector<uint8_t> block(8 + entries.size() * 2);
+		auto size = static_cast<uint32_t>(block.size());
+		std::memcpy(block.data(), &page, sizeof(page));
+		std::memcpy(block.data() + 4, &size, sizeof(size));
+		std::memcpy(block.data() + 8, std::data(entries), entries.size() * 2);
+		return block;
+	}
+
+#pragma clang diagnostic pop
+} // namespace stormbird_test
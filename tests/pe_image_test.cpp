@@ -0,0 +1,280 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <snitch/snitch.hpp>
+
+#include "pe_fixture.hpp"
+#include "pe_image.hpp"
+
+using namespace stormbird_hook;
+using stormbird_test::pe_fixture;
+using stormbird_test::relocation_block;
+
+namespace {
+	constexpr uint32_t code_characteristics = pe_section_code | pe_section_execute | pe_section_read;
+	constexpr uint32_t rdata_characteristics = pe_section_initialized_data | pe_section_read;
+	constexpr uint32_t data_characteristics = pe_section_initialized_data | pe_section_read | pe_section_write;
+
+	constexpr uint16_t dir64 = 10 << 12;
+	constexpr uint16_t highlow = 3 << 12;
+
+	// .text, .rdata, .data with zero fill and .reloc, like a small linker output
+	auto
+	make_fixture(bool is_64) -> pe_fixture {
+		pe_fixture fixture;
+		fixture.is_64 = is_64;
+		fixture.machine = is_64 ? 0x8664 : 0x14C;
+		fixture.image_base = is_64 ? 0x140000000 : 0x400000;
+
+		std::vector<uint8_t> relocations = relocation_block(0x2000, { static_cast<uint16_t>((is_64 ? dir64 : highlow) | 0x10), 0, static_cast<uint16_t>((is_64 ? dir64 : highlow) | 0x08) });
+		auto second = relocation_block(0x3000, { static_cast<uint16_t>(highlow | 0x20) });
+		relocations.insert(relocations.end(), second.begin(), second.end());
+
+		fixture.sections = {
+			{ ".text", 0x1000, 0x180, std::vector<uint8_t>(0x200, 0xCC), code_characteristics },
+			{ ".rdata", 0x2000, 0x100, std::vector<uint8_t>(0x100, 0x11), rdata_characteristics },
+			{ ".data", 0x3000, 0x2000, std::vector<uint8_t>(0x200, 0x22), data_characteristics },
+			{ ".reloc", 0x5000, static_cast<uint32_t>(relocations.size()), relocations, rdata_characteristics },
+		};
+
+		fixture.directories[pe_directory_base_relocation] = { 0x5000, static_cast<uint32_t>(relocations.size()) };
+		fixture.directories[pe_directory_exception] = { 0x2080, 0x18 };
+		fixture.size_of_image = 0x6000;
+		return fixture;
+	}
+
+	void
+	put_u32(std::vector<uint8_t> &bytes, size_t offset, uint32_t value) {
+		std::memcpy(&bytes[offset], &value, sizeof(value));
+	}
+} // namespace
+
+TEST_CASE("parses the headers of a pe32+ image", "[pe_image]") {
+	auto fixture = make_fixture(true);
+	auto image = parse_pe_image(fixture.file());
+	REQUIRE(image.has_value());
+
+	CHECK(image->is_64);
+	CHECK(image->machine == 0x8664);
+	CHECK(image->timestamp == fixture.timestamp);
+	CHECK(image->image_base == 0x140000000);
+	CHECK(image->entry_point == 0x1000);
+	CHECK(image->size_of_image == 0x6000);
+	CHECK(image->size_of_headers == pe_fixture::size_of_headers);
+
+	REQUIRE(image->sections.size() == 4);
+	CHECK(image->sections[0].name() == ".text");
+	CHECK(image->sections[0].executable());
+	CHECK(image->sections[0].virtual_address == 0x1000);
+	CHECK(image->sections[0].raw_offset == fixture.raw_offset(0));
+	CHECK(image->sections[2].name() == ".data");
+	CHECK_FALSE(image->sections[2].executable());
+	CHECK(image->sections[2].mapped_size() == 0x2000);
+	CHECK(image->sections[2].raw_size == 0x200);
+	CHECK(image->find_section(".reloc") == &image->sections[3]);
+	CHECK(image->find_section(".tls") == nullptr);
+}
+
+TEST_CASE("parses the headers of a pe32 image", "[pe_image]") {
+	auto fixture = make_fixture(false);
+	auto image = parse_pe_image(fixture.file());
+	REQUIRE(image.has_value());
+
+	CHECK_FALSE(image->is_64);
+	CHECK(image->machine == 0x14C);
+	CHECK(image->image_base == 0x400000);
+	CHECK(image->size_of_image == 0x6000);
+	REQUIRE(image->sections.size() == 4);
+	CHECK(image->sections[1].name() == ".rdata");
+	CHECK(image->directories[pe_directory_base_relocation].virtual_address == 0x5000);
+}
+
+TEST_CASE("reads as many data directories as the optional header holds", "[pe_image]") {
+	for (auto is_64 : { true, false }) {
+		auto fixture = make_fixture(is_64);
+		auto image = parse_pe_image(fixture.file());
+		REQUIRE(image.has_value());
+		CHECK(image->directories[pe_directory_exception].virtual_address == 0x2080);
+		CHECK(image->directories[pe_directory_exception].size == 0x18);
+		CHECK(image->directories[pe_directory_export].size == 0);
+
+		// a short table leaves the directories past it empty
+		fixture.directory_count = 4;
+		image = parse_pe_image(fixture.file());
+		REQUIRE(image.has_value());
+		CHECK(image->directories[pe_directory_exception].size == 0x18);
+		CHECK(image->directories[pe_directory_base_relocation].size == 0);
+		CHECK(image->sections.size() == 4);
+
+		// a count larger than the optional header stops at the end of the header
+		auto bytes = fixture.file();
+		put_u32(bytes, pe_fixture::nt_offset + 24 + (is_64 ? 108 : 92), 0xFFFFFFFF);
+		image = parse_pe_image(bytes);
+		REQUIRE(image.has_value());
+		CHECK(image->directories[pe_directory_exception].size == 0x18);
+		CHECK(image->directories[pe_directory_base_relocation].size == 0);
+	}
+}
+
+TEST_CASE("maps rvas to file offsets", "[pe_image]") {
+	auto fixture = make_fixture(true);
+	auto image = parse_pe_image(fixture.file());
+	REQUIRE(image.has_value());
+
+	CHECK(image->rva_to_offset(0) == 0u);
+	CHECK(image->rva_to_offset(pe_fixture::size_of_headers - 1) == pe_fixture::size_of_headers - 1);
+	CHECK(image->rva_to_offset(0x1000) == fixture.raw_offset(0));
+	CHECK(image->rva_to_offset(0x117F) == fixture.raw_offset(0) + 0x17F);
+	CHECK(image->rva_to_offset(0x2010) == fixture.raw_offset(1) + 0x10);
+	CHECK(image->rva_to_offset(0x31FF) == fixture.raw_offset(2) + 0x1FF);
+
+	// zero fill past the raw data, the gap between sections and past the image have no file offset
+	CHECK_FALSE(image->rva_to_offset(0x3200).has_value());
+	CHECK_FALSE(image->rva_to_offset(0x4FFF).has_value());
+	CHECK_FALSE(image->rva_to_offset(0x1180).has_value());
+	CHECK_FALSE(image->rva_to_offset(0x8000).has_value());
+	CHECK_FALSE(image->rva_to_offset(0xFFFFFFFF).has_value());
+
+	CHECK(image->section_for_rva(0x3FFF) == &image->sections[2]);
+	CHECK(image->section_for_rva(0x1180) == nullptr);
+}
+
+TEST_CASE("reads base relocations sorted by rva", "[pe_image]") {
+	for (auto is_64 : { true, false }) {
+		auto fixture = make_fixture(is_64);
+		auto file = fixture.file();
+		auto image = parse_pe_image(file);
+		REQUIRE(image.has_value());
+
+		// absolute entries are padding and are left out
+		auto relocations = parse_relocations(file, *image);
+		REQUIRE(relocations.size() == 3);
+		CHECK(relocations[0].rva == 0x2008);
+		CHECK(relocations[0].size == (is_64 ? 8 : 4));
+		CHECK(relocations[1].rva == 0x2010);
+		CHECK(relocations[2].rva == 0x3020);
+		CHECK(relocations[2].size == 4);
+	}
+}
+
+TEST_CASE("stops at relocation blocks that do not fit", "[pe_image]") {
+	auto fixture = make_fixture(true);
+	auto file = fixture.file();
+	auto image = parse_pe_image(file);
+	REQUIRE(image.has_value());
+	auto block = fixture.raw_offset(3);
+
+	// a block smaller than its own header ends the walk
+	auto bytes = file;
+	put_u32(bytes, block + 4, 4);
+	CHECK(parse_relocations(bytes, *image).empty());
+
+	// a directory outside the image or past the end of the file has nothing to read
+	auto moved = *image;
+	moved.directories[pe_directory_base_relocation].virtual_address = 0x8000;
+	CHECK(parse_relocations(file, moved).empty());
+
+	std::vector<uint8_t> truncated(file.begin(), file.begin() + block + 12);
+	auto relocations = parse_relocations(truncated, *image);
+	REQUIRE(relocations.size() == 1);
+	CHECK(relocations[0].rva == 0x2010);
+
+	moved = *image;
+	moved.directories[pe_directory_base_relocation] = {};
+	CHECK(parse_relocations(file, moved).empty());
+}
+
+TEST_CASE("stops at relocation blocks larger than the directory", "[pe_image]") {
+	for (uint32_t block_size : { 0xFFFFFFF0u, 0xFFFFFFFFu, 0x80000000u, 0x100u, 24u }) {
+		auto fixture = make_fixture(true);
+		auto relocations = relocation_block(0x2000, { dir64 | 0x10, dir64 | 0x18, dir64 | 0x20, dir64 | 0x28 });
+		auto corrupt = relocation_block(0x3000, { dir64 | 0x30, dir64 | 0x38, 0, 0 });
+		std::memcpy(corrupt.data() + 4, &block_size, sizeof(block_size));
+		relocations.insert(relocations.end(), corrupt.begin(), corrupt.end());
+
+		// the second block starts at offset 16, a cursor stepping over 0xFFFFFFF0 bytes would wrap back to 0
+		fixture.sections[3].data = relocations;
+		fixture.sections[3].virtual_size = static_cast<uint32_t>(relocations.size());
+		fixture.directories[pe_directory_base_relocation] = { 0x5000, static_cast<uint32_t>(relocations.size()) };
+
+		auto file = fixture.file();
+		auto image = parse_pe_image(file);
+		REQUIRE(image.has_value());
+
+		auto parsed = parse_relocations(file, *image);
+		REQUIRE(parsed.size() == 4);
+		CHECK(parsed.front().rva == 0x2010);
+		CHECK(parsed.back().rva == 0x2028);
+	}
+}
+
+TEST_CASE("rejects truncated headers", "[pe_image]") {
+	for (auto is_64 : { true, false }) {
+		auto fixture = make_fixture(is_64);
+		auto file = fixture.file();
+
+		// every cut before the end of the section table loses a header field the parser needs
+		auto section_table_end = fixture.section_table() + fixture.sections.size() * 40;
+		for (size_t size = 0; size < section_table_end; ++size) {
+			std::vector<uint8_t> prefix(file.begin(), file.begin() + static_cast<ptrdiff_t>(size));
+			CHECK_FALSE(parse_pe_image(prefix).has_value());
+		}
+
+		// once the section table is whole the headers parse, cut off section data only limits what can be read
+		for (auto size = section_table_end; size <= file.size(); size += 0x40) {
+			std::vector<uint8_t> prefix(file.begin(), file.begin() + static_cast<ptrdiff_t>(size));
+			auto image = parse_pe_image(prefix);
+			REQUIRE(image.has_value());
+			CHECK(parse_relocations(prefix, *image).size() <= 3);
+		}
+	}
+}
+
+TEST_CASE("rejects malformed headers", "[pe_image]") {
+	auto file = make_fixture(true).file();
+	auto nt_offset = pe_fixture::nt_offset;
+
+	{ // not mz
+		auto bytes = file;
+		bytes[1] = 'X';
+		CHECK_FALSE(parse_pe_image(bytes).has_value());
+	}
+
+	{ // nt headers outside the file
+		for (uint32_t offset : { 0xFFFFFFFFu, 0xFFFFFFFCu, static_cast<uint32_t>(file.size()), static_cast<uint32_t>(file.size() - 2) }) {
+			auto bytes = file;
+			put_u32(bytes, 0x3C, offset);
+			CHECK_FALSE(parse_pe_image(bytes).has_value());
+		}
+	}
+
+	{ // not pe
+		auto bytes = file;
+		bytes[nt_offset + 2] = 1;
+		CHECK_FALSE(parse_pe_image(bytes).has_value());
+	}
+
+	{ // unknown optional header
+		auto bytes = file;
+		bytes[nt_offset + 24] = 0x07;
+		bytes[nt_offset + 25] = 0x01; // rom image
+		CHECK_FALSE(parse_pe_image(bytes).has_value());
+	}
+
+	{ // section table past the end
+		auto bytes = file;
+		bytes[nt_offset + 6] = 0xFF;
+		bytes[nt_offset + 7] = 0xFF;
+		CHECK_FALSE(parse_pe_image(bytes).has_value());
+
+		bytes = file;
+		bytes[nt_offset + 20] = 0xFF;
+		bytes[nt_offset + 21] = 0xFF; // optional header size
+		CHECK_FALSE(parse_pe_image(bytes).has_value());
+	}
+}
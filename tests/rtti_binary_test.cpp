@@ -0,0 +1,200 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include <snitch/snitch.hpp>
+
+#include "dump_fixture.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_dump.hpp"
+
+using namespace stormbird_hook;
+using stormbird_test::aligned_copy;
+using stormbird_test::as_bytes;
+using stormbird_test::sorted_objects;
+
+namespace {
+	// a small factory with every kind of type and every field the dump writes. the types refer to each other through
+	// their own members, so it must not move.
+	struct small_factory {
+		RTTIPrimitive int32 {};
+		RTTIPrimitive entity_id {}; // has a parent
+		std::array<RTTIEnumValue, 3> color_values {};
+		RTTIEnum color {};
+		std::array<RTTIEnumValue, 2> flag_values {};
+		RTTIBitset flags {};
+		RTTIReferenceBaseData ref_data { "Ref", 3, 4, 5, 0 };
+		RTTIReferenceBaseData array_data { "Array", 6, 7, 8, 0 };
+		RTTIReference entity_ref {};
+		RTTIContainer entity_refs {};
+		std::array<RTTIClassMember, 2> entity_members {};
+		RTTIClass entity {};
+		std::array<RTTIBaseClass, 1> player_bases {};
+		std::array<RTTIClassMember, 3> player_members {};
+		std::array<RTTIClassFunction, 1> player_functions {};
+		std::array<RTTIClassEvent, 1> player_events {};
+		std::array<RTTIBaseClassEvent, 1> player_base_events {};
+		RTTIClass player {};
+		RTTIClass npc {};
+		RTTIClass damage_event {};
+		std::array<RTTIRecord, 2> records {};
+		std::array<RTTIRefChain, 1> ref_chains {};
+		std::array<RTTIRefRecord, 1> ref_records {};
+		CoreRTTIInfo core_info {};
+		std::array<CoreRTTIRecord, 1> core_records {};
+		RTTIFactory factory {};
+
+		small_factory() {
+			int32 = { { 1, 2, RTTIType::Primitive }, 0, 4, 4, 1, 0, 0x11, "int32", nullptr };
+			int32.parent = &int32.base;
+			entity_id = { { 3, 2, RTTIType::Primitive }, 0, 4, 4, 1, 0, 0x22, "EntityId", &int32.base };
+
+			color_values[0] = { 0, "Red", {} };
+			color_values[1] = { 1, "Quote \"Green\"", {} };
+			color_values[2] = { ~0ULL, "Invalid", {} };
+			color = { { 4, 5, RTTIType::Enum }, 1, 3, 6, 7, "Color", color_values.data(), nullptr };
+			flag_values[0] = { 1, "Hidden", {} };
+			flag_values[1] = { 0x8000'0000, "Dead", {} };
+			flags = { { 8, 5, RTTIType::Bitset }, 4, 2, 0, 0, "Flags", flag_values.data(), nullptr };
+
+			entity_ref = { { 9, 10, RTTIType::Reference }, {}, &entity.base, &ref_data };
+			entity_refs = { { 11, 10, RTTIType::Container }, {}, &entity_ref.base, &array_data };
+
+			entity_members[0] = { &entity_id.base, 0, 1, 2, "id", nullptr, nullptr, nullptr, nullptr };
+			entity_members[1] = { &flags.base, 4, 0, 0, "flags", nullptr, nullptr, nullptr, nullptr };
+			entity.base = { 12, 13, RTTIType::Class };
+			entity.member_count = 2;
+			entity.size = 8;
+			entity.alignment = 4;
+			entity.name = "Entity";
+			entity.hash = 0xDEADBEEF;
+			entity.first_child = &player;
+			entity.members = entity_members.data();
+
+			player_bases[0] = { &entity, 0, 0 };
+			player_members[0] = { &color.base, 8, 0, 0, "color", nullptr, nullptr, nullptr, nullptr };
+			player_members[1] = { &entity_refs.base, 16, 0, 0, "followers", nullptr, nullptr, nullptr, nullptr };
+			player_members[2] = { &entity_ref.base, 32, 0, 0, "target", nullptr, nullptr, nullptr, nullptr }; // back to the base, a cycle
+			player_functions[0] = { 0x1234, "Respawn", "(int32 delay)", nullptr };
+			player_events[0] = { &damage_event.base, nullptr };
+			player_base_events[0] = { 99, &damage_event.base, &entity.base };
+			player.base = { 14, 13, RTTIType::Class };
+			player.base_count = 1;
+			player.member_count = 3;
+			player.function_count = 1;
+			player.event_count = 1;
+			player.base_event_count = 1;
+			player.unknown1 = 1;
+			player.unknown2 = 2;
+			player.unknown3 = 3;
+			player.unknown4 = 4;
+			player.size = 40;
+			player.alignment = 8;
+			player.flags = 0x10;
+			player.name = "Player";
+			player.hash = 0xCAFE;
+			player.unknown5 = 5;
+			player.next_sibling = &npc;
+			player.bases = player_bases.data();
+			player.members = player_members.data();
+			player.functions = player_functions.data();
+			player.events = player_events.data();
+			player.base_events = player_base_events.data();
+
+			npc.base = { 15, 13, RTTIType::Class };
+			npc.name = "NPC";
+			npc.size = 8;
+			damage_event.base = { 16, 17, RTTIType::Class };
+			damage_event.name = "DamageEvent";
+
+			records[0] = { 1, &player.base };
+			records[1] = { 2, &color.base };
+			ref_chains[0] = { 3, &int32.base, &entity_refs.base };
+			ref_records[0] = { 4, &array_data, { ref_chains.data(), 1, 1 } };
+			core_info = { &npc.base, nullptr, nullptr };
+			core_records[0] = { 5, "NPC", &core_info };
+
+			factory.rtti = { records.data(), 2, 2 };
+			factory.rtti_refs = { ref_records.data(), 1, 1 };
+			factory.core_rtti = { core_records.data(), 1, 1 };
+		}
+
+		small_factory(const small_factory &) = delete;
+		auto operator=(const small_factory &) -> small_factory & = delete;
+	};
+} // namespace
+
+TEST_CASE("rtti.bin turns back into the rtti.json of the live factory", "[rtti_binary]") {
+	small_factory types;
+	std::ostringstream live_json;
+	std::ostringstream binary;
+	write_rtti_json(types.factory, live_json);
+	write_rtti_binary(types.factory, binary);
+
+	auto binary_file = aligned_copy(binary.str());
+	auto file = rtti_file_view::open(as_bytes(binary_file, binary.str().size()));
+	REQUIRE(file.has_value());
+	CHECK(file->types().size() == 10);
+
+	std::ostringstream converted_json;
+	write_rtti_json(*file, converted_json);
+
+	auto live = sorted_objects(live_json.str());
+	CHECK(live.size() == 10);
+	CHECK(sorted_objects(converted_json.str()) == live);
+
+	CHECK(file->name_of(rtti_file_null) == "<null>");
+	CHECK(file->address_of(rtti_file_null) == 0);
+	CHECK(std::any_of(file->types().begin(), file->types().end(), [&](const rtti_file_type &type) {
+		return file->string(type.name) == "Array<Ref<Entity>>" && type.address == reinterpret_cast<uint64_t>(&types.entity_refs);
+	}));
+}
+
+TEST_CASE("an rtti.bin built in memory is the file write_rtti_binary writes", "[rtti_binary]") {
+	small_factory types;
+	for (auto mode : { rtti_dump_mode::serial, rtti_dump_mode::parallel }) {
+		std::ostringstream binary;
+		write_rtti_binary(types.factory, binary, { .mode = mode });
+		auto buffer = build_rtti_binary(types.factory, { .mode = mode });
+		CHECK(std::string(reinterpret_cast<const char *>(buffer.bytes().data()), buffer.size) == binary.str());
+		CHECK(rtti_file_view::open(buffer.bytes()).has_value());
+	}
+}
+
+TEST_CASE("rejects a malformed rtti.bin", "[rtti_binary]") {
+	small_factory types;
+	std::ostringstream binary;
+	write_rtti_binary(types.factory, binary);
+	auto size = binary.str().size();
+	auto binary_file = aligned_copy(binary.str());
+	REQUIRE(rtti_file_view::open(as_bytes(binary_file, size)).has_value());
+
+	{ // truncated
+		CHECK_FALSE(rtti_file_view::open(as_bytes(binary_file, sizeof(rtti_file_header) - 1)).has_value());
+		CHECK_FALSE(rtti_file_view::open(as_bytes(binary_file, size - 8)).has_value());
+	}
+
+	{ // another version
+		auto bad = binary_file;
+		reinterpret_cast<rtti_file_header *>(bad.data())->version = rtti_file_version + 1;
+		CHECK_FALSE(rtti_file_view::open(as_bytes(bad, size)).has_value());
+	}
+
+	{ // not an rtti.bin
+		auto bad = binary_file;
+		reinterpret_cast<rtti_file_header *>(bad.data())->magic[0] = 'X';
+		CHECK_FALSE(rtti_file_view::open(as_bytes(bad, size)).has_value());
+	}
+
+	{ // a table running past the end of the file
+		auto bad = binary_file;
+		reinterpret_cast<rtti_file_header *>(bad.data())->tables[static_cast<size_t>(rtti_file_table::types)].size = ~0ULL;
+		CHECK_FALSE(rtti_file_view::open(as_bytes(bad, size)).has_value());
+	}
+}
@@ -0,0 +1,75 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <sstream>
+#include <string>
+
+#include <nlohmann/json.hpp>
+#include <snitch/snitch.hpp>
+
+#include "dump_fixture.hpp"
+#include "rtti_delta.hpp"
+#include "rtti_dump.hpp"
+#include "rtti_graph.hpp"
+#include "rtti_merge.hpp"
+
+using namespace stormbird_hook;
+using stormbird_bench::rtti_graph;
+using stormbird_cli::rtti_merger;
+using stormbird_cli::strip_rtti_locations;
+using stormbird_test::sorted_objects;
+
+namespace {
+	auto
+	full_json(const RTTIFactory &factory) -> nlohmann::json {
+		std::ostringstream output;
+		write_rtti_json(factory, output);
+		return nlohmann::json::parse(output.str());
+	}
+
+	auto
+	delta_json(const rtti_delta &delta) -> nlohmann::json {
+		std::ostringstream output;
+		write_rtti_json(delta, output);
+		return nlohmann::json::parse(output.str());
+	}
+} // namespace
+
+TEST_CASE("a full dump merged with its deltas is the full dump of the patched game", "[rtti_delta]") {
+	// the same graph three times, each at addresses of its own like a game rebuilt between patches
+	rtti_graph first(400, 11);
+	rtti_graph second(400, 11);
+	rtti_graph third(400, 11);
+	second.patch(7);
+	third.patch(7);
+	third.patch(5);
+
+	auto first_delta = diff_rtti(second.factory, build_rtti_manifest(first.factory));
+	auto second_delta = diff_rtti(third.factory, first_delta.manifest);
+	REQUIRE(first_delta.changed > 0);
+	REQUIRE(second_delta.changed > 0);
+
+	auto delta = delta_json(first_delta);
+	for (const auto &type : delta["types"]) {
+		CHECK_FALSE(type.contains("addr"));
+		CHECK_FALSE(type.contains("type_id"));
+	}
+
+	rtti_merger merger(full_json(first.factory));
+	CHECK(merger.apply(delta));
+	CHECK(merger.apply(delta_json(second_delta)));
+	auto merged = merger.result();
+
+	auto expected = full_json(third.factory);
+	for (auto &type : expected) {
+		strip_rtti_locations(type);
+	}
+
+	CHECK(sorted_objects(merged.dump()) == sorted_objects(expected.dump()));
+
+	// a delta out of order is turned away
+	rtti_merger out_of_order(full_json(first.factory));
+	CHECK(out_of_order.apply(delta_json(second_delta)));
+	CHECK_FALSE(out_of_order.apply(delta_json(first_delta)));
+}
@@ -0,0 +1,91 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <snitch/snitch.hpp>
+
+#include "dump_fixture.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_dump.hpp"
+#include "rtti_graph.hpp"
+
+using namespace stormbird_hook;
+using stormbird_bench::rtti_graph;
+using stormbird_test::aligned_copy;
+using stormbird_test::as_bytes;
+using stormbird_test::sorted_objects;
+
+namespace {
+	auto
+	json_of(const RTTIFactory &factory, const rtti_dump_options &options) -> std::string {
+		std::ostringstream output;
+		write_rtti_json(factory, output, options);
+		return output.str();
+	}
+
+	auto
+	binary_of(const RTTIFactory &factory, const rtti_dump_options &options) -> std::string {
+		std::ostringstream output;
+		write_rtti_binary(factory, output, options);
+		return output.str();
+	}
+
+	// the walk the serial dump started out as, on the call stack
+	void
+	visit_recursive(const RTTIBase *rtti, rtti_address_set &visited, std::vector<uint64_t> &order) {
+		if (rtti == nullptr || !visited.emplace(reinterpret_cast<uint64_t>(rtti)).second) {
+			return;
+		}
+
+		rtti_address_set siblings;
+		for_each_rtti_edge(rtti, siblings, [&](const RTTIBase *edge) { visit_recursive(edge, visited, order); });
+		order.push_back(reinterpret_cast<uint64_t>(rtti));
+	}
+} // namespace
+
+TEST_CASE("a serial dump lists a type after the types it refers to", "[rtti_dump]") {
+	rtti_graph graph(300, 3);
+	rtti_address_set visited;
+	std::vector<uint64_t> expected;
+	for_each_rtti_root(graph.factory, [&](const RTTIBase *rtti) { visit_recursive(rtti, visited, expected); });
+
+	std::vector<uint64_t> order;
+	for (const auto &object : nlohmann::json::parse(json_of(graph.factory, {}))) {
+		order.push_back(object["addr"].get<uint64_t>());
+	}
+
+	CHECK(order == expected);
+}
+
+TEST_CASE("a parallel dump writes the same file on any number of threads", "[rtti_dump]") {
+	for (uint64_t seed = 1; seed <= 2; ++seed) {
+		rtti_graph graph(2000, seed);
+		auto serial_json = json_of(graph.factory, {});
+		auto serial_objects = sorted_objects(serial_json);
+		REQUIRE(serial_objects.size() > 2000);
+
+		auto parallel_json = json_of(graph.factory, { .mode = rtti_dump_mode::parallel, .thread_count = 1 });
+		auto parallel_binary = binary_of(graph.factory, { .mode = rtti_dump_mode::parallel, .thread_count = 1 });
+		CHECK(sorted_objects(parallel_json) == serial_objects);
+
+		for (uint32_t thread_count = 2; thread_count <= 8; ++thread_count) {
+			rtti_dump_options options { .mode = rtti_dump_mode::parallel, .thread_count = thread_count };
+			CHECK(json_of(graph.factory, options) == parallel_json);
+			CHECK(binary_of(graph.factory, options) == parallel_binary);
+		}
+
+		// the parallel rtti.bin holds the same types as the serial one, only in another order
+		auto binary_file = aligned_copy(parallel_binary);
+		auto file = rtti_file_view::open(as_bytes(binary_file, parallel_binary.size()));
+		REQUIRE(file.has_value());
+		std::ostringstream converted;
+		write_rtti_json(*file, converted);
+		CHECK(sorted_objects(converted.str()) == serial_objects);
+	}
+}
@@ -0,0 +1,29 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// writes the rtti.bin of the synthetic graph, the input of the rtti_layout_compiles test
+
+#include <fstream>
+#include <iostream>
+
+#include "rtti_binary.hpp"
+#include "rtti_graph.hpp"
+
+auto
+main(int argc, char **argv) -> int {
+	if (argc != 2) {
+		std::cerr << "usage: rtti_graph_dump <rtti.bin>\n";
+		return 1;
+	}
+
+	stormbird_bench::rtti_graph graph(2000, 1);
+	std::ofstream output(argv[1], std::ios::binary);
+	if (!output) {
+		std::cerr << "[rtti_graph_dump] could not open " << argv[1] << "\n";
+		return 1;
+	}
+
+	stormbird_hook::write_rtti_binary(graph.factory, output);
+	return output ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <snitch/snitch.hpp>
+
+#include "dump_fixture.hpp"
+#include "rtti_graph.hpp"
+#include "rtti_index.hpp"
+#include "rtti_snapshot.hpp"
+
+using namespace stormbird_hook;
+using stormbird_bench::rtti_graph;
+using stormbird_test::aligned_copy;
+using stormbird_test::as_bytes;
+
+namespace {
+	struct expected_field {
+		uint32_t offset { 0 };
+		std::string owner;
+	};
+
+	// the nearest declaration of name, breadth-first through the bases of the live classes
+	auto
+	brute_force_resolve(const RTTIClass *start, std::string_view name) -> std::optional<expected_field> {
+		std::deque<std::pair<const RTTIClass *, uint32_t>> queue { { start, 0 } };
+		std::set<const RTTIClass *> seen { start };
+		while (!queue.empty()) {
+			auto [class_rtti, offset] = queue.front();
+			queue.pop_front();
+			for (uint8_t index = 0; index < class_rtti->member_count; ++index) {
+				if (name == class_rtti->members[index].name) {
+					return expected_field { offset + class_rtti->members[index].offset, class_rtti->name };
+				}
+			}
+
+			for (uint8_t index = 0; index < class_rtti->base_count; ++index) {
+				const auto &base = class_rtti->bases[index];
+				if (seen.insert(base.type).second) {
+					queue.emplace_back(base.type, offset + base.offset);
+				}
+			}
+		}
+
+		return std::nullopt;
+	}
+} // namespace
+
+TEST_CASE("the index answers what a walk of the live classes does", "[rtti_index]") {
+	for (uint64_t seed = 1; seed <= 3; ++seed) {
+		rtti_graph graph(1500, seed);
+		auto snapshot = rtti_snapshot::capture(graph.factory);
+
+		std::ostringstream binary;
+		std::ostringstream index_from_snapshot;
+		std::ostringstream index_from_file;
+		write_rtti_binary(snapshot, binary);
+		write_rtti_index(snapshot, index_from_snapshot);
+
+		auto binary_file = aligned_copy(binary.str());
+		auto file = rtti_file_view::open(as_bytes(binary_file, binary.str().size()));
+		REQUIRE(file.has_value());
+		write_rtti_index(*file, index_from_file);
+		CHECK(index_from_file.str() == index_from_snapshot.str());
+
+		auto index_file = aligned_copy(index_from_snapshot.str());
+		auto index = rtti_index_view::open(as_bytes(index_file, index_from_snapshot.str().size()));
+		REQUIRE(index.has_value());
+		CHECK(index->types().size() == file->types().size());
+		CHECK(index->find("NoSuchType").empty());
+		CHECK(index->find_class("NoSuchType") == nullptr);
+
+		// the graph names every class uniquely, so the live class behind every name is known
+		std::vector<const RTTIClass *> classes;
+		for (const auto &type : file->types()) {
+			if (type.kind == RTTIType::Class) {
+				classes.push_back(reinterpret_cast<const RTTIClass *>(type.address));
+			}
+		}
+
+		REQUIRE_FALSE(classes.empty());
+		for (const auto *class_rtti : classes) {
+			const auto *class_index = index->find_class(class_rtti->name);
+			REQUIRE(class_index != nullptr);
+			CHECK(index->name_of(class_index->type) == class_rtti->name);
+			CHECK(index->class_of(class_index->type) == class_index);
+			CHECK(class_index->size == class_rtti->size);
+			CHECK(class_index->hash == class_rtti->hash);
+			CHECK(class_index->members.count == class_rtti->member_count);
+
+			for (uint8_t position = 0; position < class_rtti->member_count; ++position) {
+				const auto &member = class_rtti->members[position];
+				const auto *member_index = index->find_member(*class_index, member.name);
+				REQUIRE(member_index != nullptr);
+				CHECK(member_index->offset == member.offset);
+				CHECK(member_index->position == position);
+			}
+
+			CHECK(index->find_member(*class_index, "no_such_member") == nullptr);
+
+			for (std::string_view name : { "member0", "member5", "member11", "no_such_member" }) {
+				auto expected = brute_force_resolve(class_rtti, name);
+				auto resolved = index->resolve_member(*class_index, name);
+				REQUIRE(resolved.has_value() == expected.has_value());
+				if (resolved) {
+					CHECK(resolved->offset == expected->offset);
+					CHECK(index->name_of(resolved->owner) == expected->owner);
+				}
+			}
+
+			// derived classes are the ones listing this class as a base, and its children
+			std::set<std::string_view> expected_derived;
+			for (const auto *other : classes) {
+				for (uint8_t index = 0; index < other->base_count; ++index) {
+					if (other->bases[index].type == class_rtti) {
+						expected_derived.insert(other->name);
+					}
+				}
+			}
+
+			for (const auto *child = class_rtti->first_child; child != nullptr; child = child->next_sibling) {
+				expected_derived.insert(child->name);
+			}
+
+			std::set<std::string_view> derived;
+			for (const auto &edge : index->derived(*class_index)) {
+				derived.insert(index->name_of(edge.type));
+			}
+
+			CHECK(derived == expected_derived);
+
+			// every subclass once, the direct ones among them
+			std::set<const rtti_index_class *> subclasses;
+			size_t visits = 0;
+			index->for_each_subclass(*class_index, [&](const rtti_index_class &subclass) {
+				subclasses.insert(&subclass);
+				visits++;
+			});
+
+			CHECK(visits == subclasses.size());
+			CHECK(subclasses.size() >= derived.size());
+		}
+	}
+}
+
+TEST_CASE("rejects a truncated index", "[rtti_index]") {
+	rtti_graph graph(200, 4);
+	std::ostringstream output;
+	write_rtti_index(rtti_snapshot::capture(graph.factory), output);
+	auto index_file = aligned_copy(output.str());
+
+	CHECK(rtti_index_view::open(as_bytes(index_file, output.str().size())).has_value());
+	CHECK_FALSE(rtti_index_view::open(as_bytes(index_file, 100)).has_value());
+	CHECK_FALSE(rtti_index_view::open(as_bytes(index_file, output.str().size() - 8)).has_value());
+
+	auto bad = index_file;
+	reinterpret_cast<rtti_index_header *>(bad.data())->version = rtti_index_version + 1;
+	CHECK_FALSE(rtti_index_view::open(as_bytes(bad, output.str().size())).has_value());
+}
@@ -0,0 +1,7 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// only compiled by the rtti_layout_compiles test, the header is what stormbird_rtti_layout wrote for the synthetic graph
+
+#include "rtti_graph_layout.hpp"
@@ -0,0 +1,151 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <snitch/snitch.hpp>
+
+#include "rtti_ready.hpp"
+
+using namespace stormbird_hook;
+using namespace std::chrono_literals;
+
+namespace {
+	using clock = rtti_ready_detector::clock;
+
+	// what the game has registered so far, as a function of the time since the hook started
+	using simulated_factory = std::function<rtti_factory_counts(clock::duration)>;
+
+	struct simulated_wait {
+		rtti_ready_state state { rtti_ready_state::waiting };
+		clock::duration waited {};
+		rtti_factory_counts counts {};
+		std::vector<clock::duration> polls; // every wait the detector asked for
+	};
+
+	// wait_for_rtti() with the sleep replaced by moving the time forward
+	auto
+	simulate(const simulated_factory &factory, const rtti_ready_options &options) -> simulated_wait {
+		simulated_wait result;
+		clock::time_point start {};
+		rtti_ready_detector detector(options, start);
+		auto now = start;
+		while (true) {
+			result.state = detector.observe(factory(now - start), now);
+			if (result.state != rtti_ready_state::waiting) {
+				result.waited = now - start;
+				result.counts = detector.counts();
+				return result;
+			}
+
+			result.polls.push_back(detector.next_poll());
+			now += detector.next_poll();
+		}
+	}
+
+	// types registered in a few bursts over the first half second, then nothing
+	auto
+	settling_factory(clock::duration elapsed) -> rtti_factory_counts {
+		if (elapsed < 50ms) {
+			return {};
+		}
+
+		if (elapsed < 120ms) {
+			return { 100, 10, 5 };
+		}
+
+		if (elapsed < 500ms) {
+			return { 2000, 150, 40 };
+		}
+
+		return { 4000, 300, 80 };
+	}
+
+	constexpr rtti_factory_counts settled_counts { 4000, 300, 80 };
+} // namespace
+
+TEST_CASE("is ready a quiet period after the counts stop changing", "[rtti_ready]") {
+	rtti_ready_options options;
+	auto result = simulate(settling_factory, options);
+	CHECK(result.state == rtti_ready_state::ready);
+	CHECK(result.counts == settled_counts);
+
+	// the last change is only seen at the first poll after it, at most max_poll late
+	CHECK(result.waited >= 500ms + options.quiet_period);
+	CHECK(result.waited <= 500ms + options.max_poll + options.quiet_period + options.max_poll);
+}
+
+TEST_CASE("is not ready while the counts keep changing", "[rtti_ready]") {
+	rtti_ready_options options;
+	auto growing = [](clock::duration elapsed) {
+		auto step = static_cast<uint32_t>(elapsed / 100ms);
+		return rtti_factory_counts { 100 + step, 10, 5 };
+	};
+
+	auto result = simulate(growing, options);
+	CHECK(result.state == rtti_ready_state::timed_out);
+	CHECK(result.waited >= options.timeout);
+	CHECK(result.waited < options.timeout + options.max_poll);
+
+	// a change just before the quiet period ends starts it again
+	auto late_change = [](clock::duration elapsed) {
+		return elapsed < 900ms ? rtti_factory_counts { 100, 10, 5 } : rtti_factory_counts { 101, 10, 5 };
+	};
+
+	result = simulate(late_change, options);
+	CHECK(result.state == rtti_ready_state::ready);
+	CHECK(result.waited >= 900ms + options.quiet_period);
+}
+
+TEST_CASE("times out when the tables stay empty", "[rtti_ready]") {
+	rtti_ready_options options;
+	auto result = simulate([](clock::duration) { return rtti_factory_counts {}; }, options);
+	CHECK(result.state == rtti_ready_state::timed_out);
+	CHECK(result.counts.empty());
+	CHECK(result.waited >= options.timeout);
+	CHECK(result.waited < options.timeout + options.max_poll);
+}
+
+TEST_CASE("backs off between first_poll and max_poll", "[rtti_ready]") {
+	rtti_ready_options options;
+	auto result = simulate(settling_factory, options);
+	REQUIRE_FALSE(result.polls.empty());
+	for (auto poll : result.polls) {
+		CHECK(poll >= 10ms);
+		CHECK(poll <= 250ms);
+	}
+
+	// doubles while nothing changes, starts over after a change
+	rtti_ready_detector detector(options, clock::time_point {});
+	auto now = clock::time_point {};
+	rtti_factory_counts counts { 1, 0, 0 };
+	detector.observe(counts, now);
+	CHECK(detector.next_poll() == 10ms);
+	for (auto expected : { 20ms, 40ms, 80ms, 160ms, 250ms, 250ms }) {
+		now += detector.next_poll();
+		detector.observe(counts, now);
+		CHECK(detector.next_poll() == expected);
+	}
+
+	counts.rtti_refs = 1;
+	detector.observe(counts, now + 1ms);
+	CHECK(detector.next_poll() == 10ms);
+}
+
+TEST_CASE("reads the counts of a factory and waits on the real clock", "[rtti_ready]") {
+	RTTIFactory factory {};
+	factory.rtti.count = 12;
+	factory.rtti_refs.count = 3;
+	factory.core_rtti.count = 4;
+	CHECK(read_rtti_factory_counts(factory) == rtti_factory_counts { 12, 3, 4 });
+
+	rtti_ready_options options { .quiet_period = 20ms, .timeout = 2000ms, .first_poll = 1ms, .max_poll = 5ms };
+	auto result = wait_for_rtti([&factory] { return read_rtti_factory_counts(factory); }, options);
+	CHECK(result.state == rtti_ready_state::ready);
+	CHECK(result.counts == rtti_factory_counts { 12, 3, 4 });
+	CHECK(result.waited >= options.quiet_period);
+}
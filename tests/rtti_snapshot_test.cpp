@@ -0,0 +1,156 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <vector>
+
+#include <snitch/snitch.hpp>
+
+#include "dump_fixture.hpp"
+#include "memory_snapshot.hpp"
+#include "rtti_binary.hpp"
+#include "rtti_dump.hpp"
+#include "rtti_graph.hpp"
+#include "rtti_snapshot.hpp"
+
+using namespace stormbird_hook;
+using stormbird_bench::rtti_graph;
+using stormbird_test::aligned_copy;
+using stormbird_test::as_bytes;
+
+namespace {
+	auto
+	read_this_process(uint64_t address, void *out, size_t size) -> bool {
+		std::memcpy(out, reinterpret_cast<const void *>(address), size);
+		return true;
+	}
+} // namespace
+
+TEST_CASE("an offline dump of recorded memory writes the live rtti.json", "[rtti_snapshot]") {
+	for (uint64_t seed = 0; seed < 4; ++seed) {
+		auto graph = std::make_unique<rtti_graph>(200 + seed * 300, seed);
+		auto entry = reinterpret_cast<uint64_t>(&graph->factory);
+
+		std::ostringstream live_json;
+		std::ostringstream live_binary;
+		write_rtti_json(graph->factory, live_json);
+		write_rtti_binary(graph->factory, live_binary);
+
+		memory_recorder recorder(read_this_process);
+		auto recorded = rtti_snapshot::capture(entry, recorder.reader());
+		REQUIRE(recorded.has_value());
+		CHECK(recorded->type_count() == rtti_snapshot::capture(graph->factory).type_count());
+
+		std::ostringstream memory;
+		recorder.write(memory, entry);
+
+		// the offline dump only has the file to go on
+		graph.reset();
+		auto memory_file = aligned_copy(memory.str());
+		auto view = memory_snapshot_view::open(as_bytes(memory_file, memory.str().size()));
+		REQUIRE(view.has_value());
+		CHECK(view->entry() == entry);
+
+		auto offline = rtti_snapshot::capture(view->entry(), view->reader());
+		REQUIRE(offline.has_value());
+		CHECK(offline->unreadable_count() == 0);
+
+		std::ostringstream offline_json;
+		std::ostringstream offline_binary;
+		write_rtti_json(*offline, offline_json);
+		write_rtti_binary(*offline, offline_binary);
+		CHECK(offline_json.str() == live_json.str());
+		CHECK(offline_binary.str() == live_binary.str());
+	}
+}
+
+TEST_CASE("an offline dump of a snapshot with missing regions nulls what it cannot read", "[rtti_snapshot]") {
+	rtti_graph graph(500, 7);
+	auto entry = reinterpret_cast<uint64_t>(&graph.factory);
+	memory_recorder recorder(read_this_process);
+	REQUIRE(rtti_snapshot::capture(entry, recorder.reader()).has_value());
+
+	std::ostringstream memory;
+	recorder.write(memory, entry);
+	auto memory_file = aligned_copy(memory.str());
+	auto bytes = as_bytes(memory_file, memory.str().size());
+	auto view = memory_snapshot_view::open(bytes);
+	REQUIRE(view.has_value());
+	REQUIRE(view->regions().size() > 3);
+
+	// every third region dropped, but never the factory itself
+	std::vector<memory_region> kept;
+	for (size_t index = 0; index < view->regions().size(); ++index) {
+		const auto &region = view->regions()[index];
+		if (index % 3 != 1 || (entry >= region.address && entry < region.address + region.size)) {
+			kept.push_back({ region.address, bytes.subspan(region.offset, region.size) });
+		}
+	}
+
+	std::ostringstream damaged;
+	write_memory_snapshot(damaged, entry, kept);
+	auto damaged_file = aligned_copy(damaged.str());
+	auto damaged_view = memory_snapshot_view::open(as_bytes(damaged_file, damaged.str().size()));
+	REQUIRE(damaged_view.has_value());
+
+	auto offline = rtti_snapshot::capture(damaged_view->entry(), damaged_view->reader());
+	REQUIRE(offline.has_value());
+	CHECK(offline->unreadable_count() > 0);
+	CHECK(offline->type_count() < rtti_snapshot::capture(graph.factory).type_count());
+
+	std::ostringstream json;
+	write_rtti_json(*offline, json);
+	CHECK_FALSE(json.str().empty());
+}
+
+TEST_CASE("rejects malformed memory snapshots", "[memory_snapshot]") {
+	std::vector<uint8_t> first(16, 1);
+	std::vector<uint8_t> second(16, 2);
+	std::vector<memory_region> regions = { { 0x1010, second }, { 0x1000, first } };
+	std::ostringstream memory;
+	write_memory_snapshot(memory, 0x1000, regions);
+	auto size = memory.str().size();
+	auto memory_file = aligned_copy(memory.str());
+
+	{ // reads run across regions that touch, never past the ends
+		auto view = memory_snapshot_view::open(as_bytes(memory_file, size));
+		REQUIRE(view.has_value());
+		REQUIRE(view->regions().size() == 2);
+		CHECK(view->regions()[0].address == 0x1000);
+
+		std::vector<uint8_t> out(8);
+		REQUIRE(view->read(0x100C, out.data(), out.size()));
+		CHECK(out == std::vector<uint8_t> { 1, 1, 1, 1, 2, 2, 2, 2 });
+		CHECK_FALSE(view->read(0x101C, out.data(), out.size()));
+		CHECK_FALSE(view->read(0x0FFF, out.data(), 2));
+	}
+
+	{ // truncated
+		CHECK_FALSE(memory_snapshot_view::open(as_bytes(memory_file, sizeof(memory_file_header) - 1)).has_value());
+		CHECK_FALSE(memory_snapshot_view::open(as_bytes(memory_file, size - 1)).has_value());
+	}
+
+	{ // a region running past the end of the file
+		auto bad = memory_file;
+		auto *table = reinterpret_cast<memory_file_region *>(reinterpret_cast<uint8_t *>(bad.data()) + sizeof(memory_file_header));
+		table[0].size = ~0ULL;
+		CHECK_FALSE(memory_snapshot_view::open(as_bytes(bad, size)).has_value());
+	}
+
+	{ // overlapping regions
+		auto bad = memory_file;
+		auto *table = reinterpret_cast<memory_file_region *>(reinterpret_cast<uint8_t *>(bad.data()) + sizeof(memory_file_header));
+		table[1].address = 0x1008;
+		CHECK_FALSE(memory_snapshot_view::open(as_bytes(bad, size)).has_value());
+	}
+
+	{ // another version
+		auto bad = memory_file;
+		reinterpret_cast<memory_file_header *>(bad.data())->version = memory_file_version + 1;
+		CHECK_FALSE(memory_snapshot_view::open(as_bytes(bad, size)).has_value());
+	}
+}
@@ -0,0 +1,143 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// the batch against one find_signature() per signature, on either side of the separate pass limit
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <snitch/snitch.hpp>
+
+#include "signature_batch.hpp"
+#include "signature_engine.hpp"
+#include "signature_simd.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	auto
+	random_bytes(size_t size, uint32_t alphabet, std::mt19937 &random) -> std::vector<uint8_t> {
+		std::vector<uint8_t> bytes(size);
+		for (auto &byte : bytes) {
+			byte = static_cast<uint8_t>(random() % alphabet);
+		}
+
+		return bytes;
+	}
+
+	// a pattern copied from the bytes at offset, with a few wildcards
+	auto
+	pattern_at(const std::vector<uint8_t> &bytes, size_t offset, size_t size, std::mt19937 &random) -> std::string {
+		std::string pattern;
+		std::array<char, 4> text {};
+		for (size_t index = 0; index < size; ++index) {
+			std::snprintf(text.data(), text.size(), "%02X", bytes[offset + index]);
+			if (random() % 6 == 0) {
+				text[0] = text[1] = '?';
+			}
+
+			pattern += text.data();
+			pattern += ' ';
+		}
+
+		return pattern;
+	}
+} // namespace
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+TEST_CASE("a batch finds what find_signature finds for each signature", "[signature_batch]") {
+	std::mt19937 random(42);
+	auto buffer = random_bytes(signature_batch::anchor_slice_size * 2 + 1234, 24, random);
+	const auto *begin = buffer.data();
+	const auto *end = begin + buffer.size();
+
+	for (size_t count : { size_t { 1 }, signature_batch::separate_pass_limit, signature_batch::separate_pass_limit + 1, size_t { 40 } }) {
+		std::deque<dynamic_signature> patterns; // a hex_signature points into its pattern, which must not move
+		signature_batch batch;
+		for (size_t index = 0; index < count; ++index) {
+			auto size = 3 + random() % 6;
+			auto signature = dynamic_signature::parse(index == 0 ? std::string("?? ??") : pattern_at(buffer, random() % (buffer.size() - size), size, random));
+			REQUIRE(signature.has_value());
+			patterns.push_back(*signature);
+			CHECK(batch.add(patterns.back().view()) == index);
+		}
+
+		for (const auto &options : { scan_options {}, scan_options { .max_matches = 3 }, scan_options { .alignment = 4 } }) {
+			// found in two halves, so max_matches carries over from the first
+			std::vector<std::vector<const uint8_t *>> found;
+			const auto *middle = begin + buffer.size() / 2;
+			batch.find(begin, middle, found, options);
+			batch.find(middle, end, found, options);
+			REQUIRE(found.size() == count);
+
+			for (size_t id = 0; id < count; ++id) {
+				std::vector<const uint8_t *> expected;
+				auto signature = patterns[id].view();
+				for (const auto &[from, to] : { std::pair { begin, middle }, std::pair { middle, end } }) {
+					find_signature(from, to, signature, expected, detect_signature_isa(), options.alignment, remaining_matches(options, expected.size()));
+				}
+
+				CHECK(found[id] == expected);
+			}
+		}
+	}
+}
+
+TEST_CASE("the anchor lookup never misses a byte of the set", "[signature_batch]") {
+	std::mt19937 random(5);
+	for (size_t round = 0; round < 200; ++round) {
+		anchor_byte_set set;
+		std::vector<uint8_t> members;
+		for (size_t index = 0, count = 1 + random() % 40; index < count; ++index) {
+			members.push_back(static_cast<uint8_t>(random()));
+			set.add(members.back());
+		}
+
+		for (auto member : members) {
+			CHECK(set.may_contain(member));
+		}
+
+		// exact while every high nibble has a bit of its own
+		std::array<bool, 16> high_nibbles {};
+		for (auto member : members) {
+			high_nibbles[member >> 4] = true;
+		}
+
+		if (std::count(high_nibbles.begin(), high_nibbles.end(), true) <= 8) {
+			for (uint32_t value = 0; value < 256; ++value) {
+				auto member = std::find(members.begin(), members.end(), static_cast<uint8_t>(value)) != members.end();
+				CHECK(set.may_contain(static_cast<uint8_t>(value)) == member);
+			}
+		}
+
+		if (detect_signature_isa() < signature_isa::avx2) {
+			continue;
+		}
+
+		// every size around the 32 byte blocks
+		auto buffer = random_bytes(random() % 200, 256, random);
+		std::vector<uint32_t> expected;
+		for (uint32_t offset = 0; offset < buffer.size(); ++offset) {
+			if (set.may_contain(buffer[offset])) {
+				expected.push_back(offset);
+			}
+		}
+
+		std::vector<uint32_t> found;
+		find_anchor_bytes_avx2(buffer.data(), buffer.data() + buffer.size(), set, found);
+		CHECK(found == expected);
+	}
+}
+
+#pragma clang diagnostic pop
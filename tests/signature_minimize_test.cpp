@@ -0,0 +1,159 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <snitch/snitch.hpp>
+
+#include "pe_fixture.hpp"
+#include "signature_minimize.hpp"
+
+using namespace stormbird_hook;
+using stormbird_test::pe_fixture;
+using stormbird_test::relocation_block;
+
+namespace {
+	// mov [rsp+8], rbx; sub rsp, 20h; call rel32; mov rax, imm64; mov rax, [rip+disp32]; ret
+	const std::vector<uint8_t> function_a = {
+		0x48, 0x89, 0x5C, 0x24, 0x08,
+		0x48, 0x83, 0xEC, 0x20,
+		0xE8, 0x10, 0x20, 0x30, 0x40,
+		0x48, 0xB8, 0x00, 0x30, 0x00, 0x40, 0x01, 0x00, 0x00, 0x00,
+		0x48, 0x8B, 0x05, 0x55, 0x66, 0x77, 0x08,
+		0xC3
+	};
+
+	// the same prologue and call, then xor eax, eax; ret
+	const std::vector<uint8_t> function_b = {
+		0x48, 0x89, 0x5C, 0x24, 0x08,
+		0x48, 0x83, 0xEC, 0x20,
+		0xE8, 0x99, 0x88, 0x77, 0x66,
+		0x31, 0xC0,
+		0xC3
+	};
+
+	constexpr uint32_t text_rva = 0x1000;
+	constexpr uint32_t function_b_rva = 0x1040;
+	constexpr uint32_t copy_of_a_rva = 0x1080;
+
+	// .text with a at its start and b after it, padded with int3. copy_a puts a second copy of a after b.
+	auto
+	make_fixture(bool copy_a) -> pe_fixture {
+		std::vector<uint8_t> text(0x100, 0xCC);
+		std::copy(function_a.begin(), function_a.end(), text.begin());
+		std::copy(function_b.begin(), function_b.end(), text.begin() + (function_b_rva - text_rva));
+		if (copy_a) {
+			std::copy(function_a.begin(), function_a.end(), text.begin() + (copy_of_a_rva - text_rva));
+		}
+
+		// the imm64 of mov rax is an absolute address the loader relocates
+		auto relocations = copy_a ? relocation_block(text_rva, { 0xA000 | 16, 0xA000 | (copy_of_a_rva - text_rva + 16) }) : relocation_block(text_rva, { 0xA000 | 16 });
+
+		pe_fixture fixture;
+		fixture.sections = {
+			{ ".text", text_rva, 0x100, text, pe_section_code | pe_section_execute | pe_section_read },
+			{ ".reloc", 0x2000, static_cast<uint32_t>(relocations.size()), relocations, pe_section_initialized_data | pe_section_read },
+		};
+
+		fixture.directories[pe_directory_base_relocation] = { 0x2000, static_cast<uint32_t>(relocations.size()) };
+		fixture.size_of_image = 0x3000;
+		return fixture;
+	}
+
+	auto
+	code_at(const std::vector<uint8_t> &file, const pe_image &image, uint32_t rva, size_t size) -> std::span<const uint8_t> {
+		auto offset = image.rva_to_offset(rva);
+		if (!offset) {
+			return {};
+		}
+
+		return std::span<const uint8_t>(file).subspan(*offset, size);
+	}
+} // namespace
+
+TEST_CASE("wildcards branches, rip-relative displacements and relocated fields", "[signature_minimize]") {
+	auto file = make_fixture(false).file();
+	auto image = parse_pe_image(file);
+	REQUIRE(image.has_value());
+
+	auto bytes = collect_signature_candidate(code_at(file, *image, text_rva, function_a.size()), text_rva, parse_relocations(file, *image), false);
+	CHECK(bytes.boundaries == std::vector<size_t> { 5, 9, 14, 24, 31, 32 });
+	CHECK(format_signature_candidate(bytes, bytes.values.size()) == "48 89 5c 24 08 48 83 ec 20 e8 ?? ?? ?? ?? 48 b8 ?? ?? ?? ?? ?? ?? ?? ?? 48 8b 05 ?? ?? ?? ?? c3");
+
+	// trailing wildcards do not narrow the match and are dropped
+	CHECK(format_signature_candidate(bytes, 14) == "48 89 5c 24 08 48 83 ec 20 e8");
+	CHECK(format_signature_candidate(bytes, 24) == "48 89 5c 24 08 48 83 ec 20 e8 ?? ?? ?? ?? 48 b8");
+
+	// without the relocation the imm64 is taken as it is, with offsets the stack displacement goes too
+	bytes = collect_signature_candidate(code_at(file, *image, text_rva, function_a.size()), text_rva, {}, true);
+	CHECK(format_signature_candidate(bytes, 24) == "48 89 5c 24 ?? 48 83 ec 20 e8 ?? ?? ?? ?? 48 b8 00 30 00 40 01 00 00 00");
+}
+
+TEST_CASE("stops at the first byte that does not decode", "[signature_minimize]") {
+	std::vector<uint8_t> code = { 0x48, 0x83, 0xEC, 0x20, 0x06, 0xC3 };
+	auto bytes = collect_signature_candidate(code, text_rva, {}, false);
+	CHECK(bytes.boundaries == std::vector<size_t> { 4 });
+	CHECK(bytes.values.size() == 4);
+}
+
+TEST_CASE("finds the shortest prefix that only matches the target", "[signature_minimize]") {
+	auto file = make_fixture(false).file();
+	auto image = parse_pe_image(file);
+	REQUIRE(image.has_value());
+	scan_options options { .scope = scan_scope::executable };
+
+	// a and b share everything up to the call target, the first instruction after it tells them apart
+	auto bytes = collect_signature_candidate(code_at(file, *image, text_rva, 96), text_rva, parse_relocations(file, *image), false);
+	auto boundary = shortest_unique_boundary(file, *image, bytes, text_rva, options);
+	REQUIRE(boundary == 3);
+
+	auto pattern = format_signature_candidate(bytes, bytes.boundaries[boundary]);
+	auto signature = dynamic_signature::parse(pattern);
+	REQUIRE(signature.has_value());
+	CHECK(scan_file(file, *image, signature->view(), options) == std::vector<uint32_t> { text_rva });
+
+	// one instruction shorter matches b as well
+	auto shorter = dynamic_signature::parse(format_signature_candidate(bytes, bytes.boundaries[boundary - 1]));
+	REQUIRE(shorter.has_value());
+	CHECK(scan_file(file, *image, shorter->view(), options) == std::vector<uint32_t> { text_rva, function_b_rva });
+
+	bytes = collect_signature_candidate(code_at(file, *image, function_b_rva, 96), function_b_rva, parse_relocations(file, *image), false);
+	CHECK(shortest_unique_boundary(file, *image, bytes, function_b_rva, options) == 3);
+}
+
+TEST_CASE("reports no boundary when every prefix matches elsewhere", "[signature_minimize]") {
+	auto file = make_fixture(true).file();
+	auto image = parse_pe_image(file);
+	REQUIRE(image.has_value());
+	scan_options options { .scope = scan_scope::executable };
+
+	auto bytes = collect_signature_candidate(code_at(file, *image, text_rva, function_a.size()), text_rva, parse_relocations(file, *image), false);
+	CHECK(shortest_unique_boundary(file, *image, bytes, text_rva, options) == bytes.boundaries.size());
+
+	// what follows the copy is different, so with more bytes the target is unique again
+	bytes = collect_signature_candidate(code_at(file, *image, text_rva, 96), text_rva, parse_relocations(file, *image), false);
+	CHECK(shortest_unique_boundary(file, *image, bytes, text_rva, options) < bytes.boundaries.size());
+}
+
+TEST_CASE("counts the positions where both anchors line up", "[signature_minimize]") {
+	auto fixture = make_fixture(false);
+	auto file = fixture.file();
+	auto image = parse_pe_image(file);
+	REQUIRE(image.has_value());
+	scan_options options { .scope = scan_scope::executable };
+
+	// a single literal byte is both anchors
+	auto call = dynamic_signature::parse("e8 ?? ?? ?? ??");
+	REQUIRE(call.has_value());
+	const auto &text = fixture.sections[0].data;
+	auto calls = static_cast<size_t>(std::count(text.begin(), text.end() - 4, 0xE8));
+	CHECK(anchor_candidates(file, *image, call->view(), options) == calls);
+
+	auto wildcards = dynamic_signature::parse("?? ??");
+	REQUIRE(wildcards.has_value());
+	CHECK(anchor_candidates(file, *image, wildcards->view(), options) == SIZE_MAX);
+}
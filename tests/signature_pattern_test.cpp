@@ -0,0 +1,444 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// the pattern grammar: plain patterns, wildcard nibbles, byte sets and alternations, and the automaton against a
+// brute force matcher working from variants built alongside each random pattern
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#define STORMBIRD_TEST_MMAN 1
+#endif
+
+#include <snitch/snitch.hpp>
+
+#include "signature_automaton.hpp"
+#include "signature_engine.hpp"
+#include "signature_pattern.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	using byte_set = std::bitset<256>;
+	using variant = std::vector<byte_set>;
+
+	// a pattern and every byte sequence it stands for, in the order they are written
+	struct random_pattern {
+		std::string text;
+		std::vector<variant> variants;
+	};
+
+	auto
+	hex(uint32_t value) -> std::string {
+		std::array<char, 4> text {};
+		std::snprintf(text.data(), text.size(), "%02X", value);
+		return text.data();
+	}
+
+	auto
+	masked_set(uint8_t value, uint8_t mask) -> byte_set {
+		byte_set set;
+		for (uint32_t byte = 0; byte < 256; ++byte) {
+			set[byte] = (byte & mask) == value;
+		}
+
+		return set;
+	}
+
+	// every head followed by every tail, heads first
+	auto
+	concatenate(const std::vector<variant> &heads, const std::vector<variant> &tails) -> std::vector<variant> {
+		std::vector<variant> product;
+		for (const auto &head : heads) {
+			for (const auto &tail : tails) {
+				auto &joined = product.emplace_back(head);
+				joined.insert(joined.end(), tail.begin(), tail.end());
+			}
+		}
+
+		return product;
+	}
+
+	auto
+	random_alternatives(std::mt19937 &random, uint32_t depth) -> random_pattern;
+
+	// one to four bytes, nibbles, sets or groups. bytes come from a small alphabet so matches are common.
+	auto
+	random_sequence(std::mt19937 &random, uint32_t depth) -> random_pattern {
+		random_pattern sequence { "", { variant {} } };
+		auto count = 1 + random() % 4;
+		for (uint32_t element = 0; element < count; ++element) {
+			auto value = static_cast<uint8_t>(0x40 + random() % 4);
+			random_pattern part;
+			switch (random() % (depth < 2 ? 7 : 6)) {
+				case 0:
+				case 1:
+					part = { hex(value), { { masked_set(value, 0xFF) } } };
+					break;
+				case 2:
+					part = { "??", { { masked_set(0, 0) } } };
+					break;
+				case 3:
+					part = { "4?", { { masked_set(0x40, 0xF0) } } };
+					break;
+				case 4:
+					part = { "?" + hex(value).substr(1), { { masked_set(value & 0x0F, 0x0F) } } };
+					break;
+				case 5: {
+					// a literal and a range, or a nibble pattern and a literal
+					auto last = static_cast<uint8_t>(value + random() % 3);
+					auto set = masked_set(0x43, 0xFF);
+					if (random() % 2 == 0) {
+						for (uint32_t byte = value; byte <= last; ++byte) {
+							set[byte] = true;
+						}
+
+						part = { "[43 " + hex(value) + "-" + hex(last) + "]", { { set } } };
+					} else {
+						part = { "[?" + hex(value).substr(1) + " 43]", { { set | masked_set(value & 0x0F, 0x0F) } } };
+					}
+
+					break;
+				}
+				default:
+					part = random_alternatives(random, depth + 1);
+					part.text = "(" + part.text + ")";
+					break;
+			}
+
+			sequence.text += part.text + " ";
+			sequence.variants = concatenate(sequence.variants, part.variants);
+		}
+
+		return sequence;
+	}
+
+	// one to three sequences separated by |
+	auto
+	random_alternatives(std::mt19937 &random, uint32_t depth) -> random_pattern {
+		random_pattern alternatives;
+		auto count = 1 + random() % 3;
+		for (uint32_t alternative = 0; alternative < count; ++alternative) {
+			auto sequence = random_sequence(random, depth);
+			alternatives.text += (alternative == 0 ? "" : "| ") + sequence.text;
+			alternatives.variants.insert(alternatives.variants.end(), sequence.variants.begin(), sequence.variants.end());
+		}
+
+		return alternatives;
+	}
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+	// leftmost-first, the first variant that matches at an address wins, matches do not overlap
+	auto
+	brute_force(const uint8_t *begin, const uint8_t *end, const std::vector<variant> &variants, const scan_options &options = {}) -> std::vector<const uint8_t *> {
+		std::vector<const uint8_t *> results;
+		for (const auto *cur = begin; cur < end;) {
+			const variant *found = nullptr;
+			if (reinterpret_cast<uintptr_t>(cur) % std::max(options.alignment, 1u) == 0) {
+				for (const auto &candidate : variants) {
+					auto matches = static_cast<size_t>(end - cur) >= candidate.size();
+					for (size_t index = 0; matches && index < candidate.size(); ++index) {
+						matches = candidate[index][cur[index]];
+					}
+
+					if (matches) {
+						found = &candidate;
+						break;
+					}
+				}
+			}
+
+			if (found == nullptr) {
+				++cur;
+				continue;
+			}
+
+			results.push_back(cur);
+			if (results.size() == options.max_matches) {
+				break;
+			}
+
+			cur += found->size();
+		}
+
+		return results;
+	}
+
+	auto
+	automaton_matches(const signature_automaton &automaton, const std::vector<uint8_t> &buffer, const scan_options &options = {}) -> std::vector<const uint8_t *> {
+		std::vector<const uint8_t *> results;
+		automaton.find(buffer.data(), buffer.data() + buffer.size(), results, options);
+		return results;
+	}
+
+	// offsets of the matches from the start of the buffer
+	auto
+	offsets(const std::vector<uint8_t> &buffer, const std::vector<const uint8_t *> &matches) -> std::vector<size_t> {
+		std::vector<size_t> result;
+		for (const auto *match : matches) {
+			result.push_back(static_cast<size_t>(match - buffer.data()));
+		}
+
+		return result;
+	}
+
+#pragma clang diagnostic pop
+} // namespace
+
+TEST_CASE("counts the bytes of plain patterns", "[signature_pattern]") {
+	CHECK(count_signature_bytes("48 8B 05 ?? ?? ?? ??") == 7u);
+	CHECK(count_signature_bytes("488B05") == 3u);
+	CHECK(count_signature_bytes("  48   8b  ") == 2u);
+	CHECK(count_signature_bytes("4? ?F ??") == 3u);
+
+	for (std::string_view pattern : { "", "   ", "4", "48 8", "4 8", "48 G0", "48-8B", "0x48", "[48]", "(48)", "48 | 8B", "48 ?" }) {
+		CHECK_FALSE(count_signature_bytes(pattern).has_value());
+		CHECK_FALSE(is_valid_signature(pattern));
+		CHECK_FALSE(dynamic_signature::parse(pattern).has_value());
+	}
+}
+
+TEST_CASE("wildcard nibbles mask half a byte", "[signature_pattern]") {
+	auto signature = dynamic_signature::parse("4? ?F ?? 8b");
+	REQUIRE(signature.has_value());
+	auto view = signature->view();
+	REQUIRE(view.size == 4);
+
+	constexpr std::array<uint8_t, 4> values = { 0x40, 0x0F, 0x00, 0x8B };
+	constexpr std::array<uint8_t, 4> masks = { 0xF0, 0x0F, 0x00, 0xFF };
+	for (size_t index = 0; index < values.size(); ++index) {
+		CHECK(view.values[index] == values[index]);
+		CHECK(view.masks[index] == masks[index]);
+	}
+
+	// anchors are only picked from fully literal bytes
+	CHECK(view.has_literal);
+	CHECK(view.anchor == 3u);
+
+	constexpr std::array<uint8_t, 4> match = { 0x4C, 0x1F, 0x99, 0x8B };
+	constexpr std::array<uint8_t, 4> miss = { 0x5C, 0x1F, 0x99, 0x8B };
+	CHECK(view.matches(match.data()));
+	CHECK_FALSE(view.matches(miss.data()));
+}
+
+TEST_CASE("parses extended patterns", "[signature_automaton]") {
+	struct expected_pattern {
+		std::string_view pattern;
+		size_t variants;
+	};
+
+	constexpr std::array<expected_pattern, 11> patterns = { {
+		{ "48 8B ??", 1 },
+		{ "4? 8B", 1 },
+		{ "[48 4C] 8B", 1 },
+		{ "[4? 90-9F]", 1 },
+		{ "(8B 05 | 8B 0D ?? ?? )", 2 },
+		{ "48 | 4C 8B", 2 },
+		{ "((48 | 49) 8B | 4C) 05", 3 },
+		{ "(48 | 49) (8B | 89)", 4 },
+		{ "  48   ( 8B|89 )  ", 2 },
+		{ "((((48))))", 1 },
+		{ "e8 ?? ?? ?? ?? [4c-4f]", 1 },
+	} };
+
+	for (const auto &[pattern, variants] : patterns) {
+		auto automaton = signature_automaton::parse(pattern);
+		REQUIRE(automaton.has_value());
+		CHECK(automaton->variant_count() == variants);
+	}
+}
+
+TEST_CASE("rejects malformed extended patterns", "[signature_automaton]") {
+	constexpr std::array<std::string_view, 27> patterns = {
+		"",
+		"   ",
+		"4",
+		"48 8",
+		"4 8",
+		"48 G0",
+		"[48",
+		"[]",
+		"[ ]",
+		"[48-]",
+		"[4?-50]",
+		"[40-5?]",
+		"[40 - 4F]", // ranges are written without spaces
+		"[50-40]",
+		"[48 [4C]]",
+		"(48",
+		"48)",
+		"()",
+		"(48 | )",
+		"( | 48)",
+		"48 |",
+		"| 48",
+		"48 || 4C",
+		"((48)",
+		"48 ) (",
+		"0x48",
+		"48 {2}",
+	};
+
+	for (auto pattern : patterns) {
+		CHECK_FALSE(signature_automaton::parse(pattern).has_value());
+	}
+}
+
+TEST_CASE("limits the variants and positions of extended patterns", "[signature_automaton]") {
+	std::string pattern;
+	for (size_t group = 0; group < 8; ++group) {
+		pattern += "(00 | 01) ";
+	}
+
+	auto automaton = signature_automaton::parse(pattern);
+	REQUIRE(automaton.has_value());
+	CHECK(automaton->variant_count() == signature_automaton::max_variants);
+	CHECK_FALSE(signature_automaton::parse(pattern + "(00 | 01)").has_value());
+
+	std::string positions;
+	for (size_t index = 0; index < signature_automaton::max_positions; ++index) {
+		positions += "?? ";
+	}
+
+	CHECK(signature_automaton::parse(positions).has_value());
+	CHECK_FALSE(signature_automaton::parse(positions + "??").has_value());
+}
+
+TEST_CASE("sets accept the listed bytes, nibble patterns and ranges", "[signature_automaton]") {
+	auto automaton = signature_automaton::parse("[4? 90-9F CC]");
+	REQUIRE(automaton.has_value());
+
+	std::vector<uint8_t> buffer(256);
+	for (size_t byte = 0; byte < buffer.size(); ++byte) {
+		buffer[byte] = static_cast<uint8_t>(byte);
+	}
+
+	std::vector<size_t> expected;
+	for (size_t byte = 0; byte < buffer.size(); ++byte) {
+		if ((byte >= 0x40 && byte <= 0x4F) || (byte >= 0x90 && byte <= 0x9F) || byte == 0xCC) {
+			expected.push_back(byte);
+		}
+	}
+
+	CHECK(offsets(buffer, automaton_matches(*automaton, buffer)) == expected);
+}
+
+TEST_CASE("the variant written first wins at the same address", "[signature_automaton]") {
+	std::vector<uint8_t> buffer = { 0x48, 0x8B, 0x90 };
+
+	// the long variant written first takes the 8B, written second it never gets the chance
+	auto long_first = signature_automaton::parse("(48 8B | 48 | 8B)");
+	REQUIRE(long_first.has_value());
+	CHECK(offsets(buffer, automaton_matches(*long_first, buffer)) == std::vector<size_t> { 0 });
+
+	auto short_first = signature_automaton::parse("48 | 48 8B | 8B");
+	REQUIRE(short_first.has_value());
+	CHECK(offsets(buffer, automaton_matches(*short_first, buffer)) == std::vector<size_t> { 0, 1 });
+
+	// a later variant still matches where the first does not
+	auto fallback = signature_automaton::parse("48 8B 48 | 8B 90");
+	REQUIRE(fallback.has_value());
+	CHECK(offsets(buffer, automaton_matches(*fallback, buffer)) == std::vector<size_t> { 1 });
+}
+
+TEST_CASE("plain patterns match the same through the automaton", "[signature_automaton]") {
+	std::mt19937 random(42);
+	for (size_t round = 0; round < 500; ++round) {
+		std::vector<uint8_t> buffer(random() % 400);
+		for (auto &byte : buffer) {
+			byte = static_cast<uint8_t>(0x40 + random() % 3);
+		}
+
+		std::string pattern;
+		auto size = 1 + random() % 6;
+		for (size_t index = 0; index < size; ++index) {
+			constexpr std::array<std::string_view, 6> bytes = { "40", "41", "42", "??", "4?", "?1" };
+			pattern += std::string(bytes[random() % bytes.size()]) + " ";
+		}
+
+		auto signature = dynamic_signature::parse(pattern);
+		auto automaton = signature_automaton::parse(pattern);
+		REQUIRE(signature.has_value());
+		REQUIRE(automaton.has_value());
+
+		std::vector<const uint8_t *> expected;
+		find_signature_scalar(buffer.data(), buffer.data() + buffer.size(), signature->view(), expected);
+		CHECK(automaton_matches(*automaton, buffer) == expected);
+	}
+}
+
+TEST_CASE("the automaton agrees with a brute force matcher", "[signature_automaton]") {
+	std::mt19937 random(5);
+	constexpr std::array<uint32_t, 4> alignments = { 1, 1, 2, 4 };
+	for (size_t round = 0; round < 2000; ++round) {
+		auto pattern = random_alternatives(random, 0);
+		auto automaton = signature_automaton::parse(pattern.text);
+		size_t positions = 0;
+		for (const auto &expanded : pattern.variants) {
+			positions += expanded.size();
+		}
+
+		if (pattern.variants.size() > signature_automaton::max_variants || positions > signature_automaton::max_positions) {
+			CHECK_FALSE(automaton.has_value());
+			continue;
+		}
+
+		REQUIRE(automaton.has_value());
+		REQUIRE(automaton->variant_count() == pattern.variants.size());
+
+		std::vector<uint8_t> buffer(random() % 300);
+		for (auto &byte : buffer) {
+			byte = static_cast<uint8_t>(0x40 + random() % 4);
+		}
+
+		scan_options options;
+		options.alignment = alignments[round % alignments.size()];
+		options.max_matches = round % 5 == 0 ? 1 + random() % 4 : 0;
+
+		auto expected = brute_force(buffer.data(), buffer.data() + buffer.size(), pattern.variants, options);
+		CHECK(automaton_matches(*automaton, buffer, options) == expected);
+	}
+}
+
+#ifdef STORMBIRD_TEST_MMAN
+TEST_CASE("the automaton stops once max_matches can no longer change", "[signature_automaton]") {
+	auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	auto *mapping = static_cast<uint8_t *>(mmap(nullptr, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	REQUIRE(mapping != MAP_FAILED);
+
+	// the range runs on into a guard page, reading that far faults
+	std::fill(mapping, mapping + page, uint8_t { 0x90 });
+	REQUIRE(mprotect(mapping + page, page, PROT_NONE) == 0);
+
+	// the 05 ?? ?? at 18 is seen before the load at 16 ends, it must still lose to it
+	constexpr std::array<uint8_t, 7> load = { 0x48, 0x8B, 0x05, 0x11, 0x22, 0x33, 0x44 };
+	std::copy(load.begin(), load.end(), mapping + 16);
+	std::copy(load.begin(), load.end(), mapping + 64);
+	mapping[200] = 0x48;
+	mapping[201] = 0x8B;
+
+	auto automaton = signature_automaton::parse("48 8B 05 ?? ?? ?? ?? | 05 ?? ?? | 48 8B");
+	REQUIRE(automaton.has_value());
+
+	scan_options options;
+	options.max_matches = 3;
+	std::vector<const uint8_t *> results;
+	automaton->find(mapping, mapping + (page * 2), results, options);
+	CHECK(results == std::vector<const uint8_t *> { mapping + 16, mapping + 64, mapping + 200 });
+
+	munmap(mapping, page * 2);
+}
+#endif
@@ -0,0 +1,203 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// the vector matchers against the scalar one, they have to return the same matches on every buffer
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+	#include <sys/mman.h>
+	#include <unistd.h>
+	#define STORMBIRD_TEST_MMAN 1
+#endif
+
+#include <snitch/snitch.hpp>
+
+#include "signature_engine.hpp"
+#include "signature_simd.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	using signature_finder = void (*)(const uint8_t *, const uint8_t *, const hex_signature &, std::vector<const uint8_t *> &);
+
+	struct simd_finder {
+		signature_isa isa;
+		signature_finder find;
+	};
+
+	// the vector matchers this cpu runs
+	auto
+	supported_finders() -> std::vector<simd_finder> {
+		constexpr std::array<simd_finder, 3> finders = { {
+			{ signature_isa::sse2, find_signature_sse2 },
+			{ signature_isa::avx2, find_signature_avx2 },
+			{ signature_isa::avx512, find_signature_avx512 },
+		} };
+
+		std::vector<simd_finder> supported;
+		for (const auto &finder : finders) {
+			if (finder.isa <= detect_signature_isa()) {
+				supported.push_back(finder);
+			}
+		}
+
+		return supported;
+	}
+
+	// true if every supported vector matcher finds what the scalar matcher finds
+	auto
+	same_matches(const uint8_t *begin, const uint8_t *end, const hex_signature &signature) -> bool {
+		std::vector<const uint8_t *> expected;
+		find_signature_scalar(begin, end, signature, expected);
+
+		std::vector<const uint8_t *> found;
+		for (const auto &finder : supported_finders()) {
+			found.clear();
+			finder.find(begin, end, signature, found);
+			if (found != expected) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// a pattern copied from the bytes, with some of them turned into wildcards and wildcard nibbles
+	auto
+	pattern_from(const uint8_t *bytes, size_t size, std::mt19937 &random) -> std::string {
+		std::string pattern;
+		std::array<char, 4> text {};
+		for (size_t index = 0; index < size; ++index) {
+			std::snprintf(text.data(), text.size(), "%02X", bytes[index]);
+			switch (random() % 20) {
+				case 0:
+				case 1:
+				case 2: text[0] = text[1] = '?'; break;
+				case 3: text[0] = '?'; break;
+				case 4: text[1] = '?'; break;
+				default: break;
+			}
+
+			pattern += text.data();
+			pattern += ' ';
+		}
+
+		return pattern;
+	}
+
+	auto
+	random_bytes(size_t size, uint32_t alphabet, std::mt19937 &random) -> std::vector<uint8_t> {
+		std::vector<uint8_t> bytes(size);
+		for (auto &byte : bytes) {
+			byte = static_cast<uint8_t>(0x40 + random() % alphabet); // 0x40 onwards so small alphabets are not all wildcards
+		}
+
+		return bytes;
+	}
+} // namespace
+
+#pragma clang diagnostic push
+#pragma ide diagnostic ignored "cppcoreguidelines-pro-bounds-pointer-arithmetic"
+
+TEST_CASE("simd matchers agree with the scalar matcher on random buffers", "[signature_simd]") {
+	std::mt19937 random(1234);
+	constexpr std::array<uint32_t, 4> alphabets = { 2, 4, 16, 192 };
+
+	for (size_t round = 0; round < 4000; ++round) {
+		auto alphabet = alphabets[round % alphabets.size()];
+		auto buffer = random_bytes(random() % 700, alphabet, random);
+		auto size = 1 + random() % 40;
+
+		// mostly patterns that occur in the buffer, sometimes ones that likely do not
+		std::vector<uint8_t> source = random_bytes(size, alphabet, random);
+		if (buffer.size() >= size && round % 4 != 0) {
+			auto offset = random() % (buffer.size() - size + 1);
+			source.assign(buffer.begin() + offset, buffer.begin() + offset + size);
+		}
+
+		auto signature = dynamic_signature::parse(pattern_from(source.data(), source.size(), random));
+		REQUIRE(signature.has_value());
+		CHECK(same_matches(buffer.data(), buffer.data() + buffer.size(), signature->view()));
+	}
+}
+
+TEST_CASE("simd matchers agree on patterns without literal bytes", "[signature_simd]") {
+	std::mt19937 random(99);
+	auto buffer = random_bytes(300, 4, random);
+	for (const auto *pattern : { "??", "?? ??", "4? ?1", "?? ?? ?? ?? ?? ??", "?4 ?? 4?" }) {
+		auto signature = dynamic_signature::parse(pattern);
+		REQUIRE(signature.has_value());
+		for (size_t size = 0; size <= buffer.size(); size += 7) {
+			CHECK(same_matches(buffer.data(), buffer.data() + size, signature->view()));
+		}
+	}
+}
+
+TEST_CASE("simd matchers find matches at the tail of every chunk", "[signature_simd]") {
+	auto signature = dynamic_signature::parse("E8 ?? ?? ?? ?? 4C 8B 3?");
+	REQUIRE(signature.has_value());
+	constexpr std::array<uint8_t, 8> match = { 0xE8, 0x11, 0x22, 0x33, 0x44, 0x4C, 0x8B, 0x35 };
+
+	// every buffer size around the 16, 32 and 64 byte blocks, with a match at each position near a block edge and at the very end
+	for (size_t size = match.size(); size < 200; ++size) {
+		for (size_t position = 0; position + match.size() <= size; ++position) {
+			if (position % 16 > 1 && position % 16 < 8 && position + match.size() != size) {
+				continue;
+			}
+
+			std::vector<uint8_t> buffer(size, 0x90);
+			std::copy(match.begin(), match.end(), buffer.begin() + static_cast<ptrdiff_t>(position));
+
+			std::vector<const uint8_t *> expected;
+			find_signature_scalar(buffer.data(), buffer.data() + size, signature->view(), expected);
+			REQUIRE(expected.size() == 1);
+			CHECK(expected.front() == buffer.data() + position);
+			CHECK(same_matches(buffer.data(), buffer.data() + size, signature->view()));
+		}
+	}
+}
+
+#ifdef STORMBIRD_TEST_MMAN
+TEST_CASE("simd matchers do not read past a page edge", "[signature_simd]") {
+	auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	auto *mapping = static_cast<uint8_t *>(mmap(nullptr, page * 3, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	REQUIRE(mapping != MAP_FAILED);
+
+	// readable page between two guard pages, touching either guard page faults
+	auto *data = mapping + page;
+	REQUIRE(mprotect(mapping, page, PROT_NONE) == 0);
+	REQUIRE(mprotect(data + page, page, PROT_NONE) == 0);
+
+	std::mt19937 random(7);
+	for (size_t round = 0; round < 400; ++round) {
+		auto size = 1 + random() % 48;
+		auto length = size + random() % 300;
+		for (size_t index = 0; index < page; ++index) {
+			data[index] = static_cast<uint8_t>(0x40 + random() % 4);
+		}
+
+		// a buffer ending at the page edge with a match in its last bytes, and one starting at the page with a match in its first
+		auto *tail = data + page - length;
+		auto tail_signature = dynamic_signature::parse(pattern_from(data + page - size, size, random));
+		REQUIRE(tail_signature.has_value());
+		CHECK(same_matches(tail, data + page, tail_signature->view()));
+
+		auto head_signature = dynamic_signature::parse(pattern_from(data, size, random));
+		REQUIRE(head_signature.has_value());
+		CHECK(same_matches(data, data + length, head_signature->view()));
+	}
+
+	munmap(mapping, page * 3);
+}
+#endif
+
+#pragma clang diagnostic pop
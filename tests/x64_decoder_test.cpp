@@ -0,0 +1,142 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+// instruction lengths and operand fields checked against objdump
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <snitch/snitch.hpp>
+
+#include "x64_decoder.hpp"
+
+using namespace stormbird_hook;
+
+namespace {
+	struct expected_instruction {
+		std::vector<uint8_t> bytes;
+		x64_instruction decoded;
+	};
+
+	auto
+	instruction(uint8_t length, uint8_t displacement_offset, uint8_t displacement_size, uint8_t immediate_offset, uint8_t immediate_size, bool rip_relative = false, bool relative_branch = false) -> x64_instruction {
+		return { length, displacement_offset, displacement_size, immediate_offset, immediate_size, rip_relative, relative_branch };
+	}
+
+	auto
+	expected_instructions() -> std::vector<expected_instruction> {
+		return {
+			{ { 0x48, 0x89, 0x5C, 0x24, 0x08 }, instruction(5, 4, 1, 5, 0) }, // mov [rsp+8], rbx
+			{ { 0x48, 0x8B, 0x05, 0x11, 0x22, 0x33, 0x44 }, instruction(7, 3, 4, 7, 0, true) }, // mov rax, [rip+disp32]
+			{ { 0xE8, 0x01, 0x02, 0x03, 0x04 }, instruction(5, 1, 0, 1, 4, false, true) }, // call rel32
+			{ { 0x74, 0x10 }, instruction(2, 1, 0, 1, 1, false, true) }, // je rel8
+			{ { 0x0F, 0x84, 0x01, 0x02, 0x03, 0x04 }, instruction(6, 2, 0, 2, 4, false, true) }, // je rel32
+			{ { 0x48, 0xB8, 1, 2, 3, 4, 5, 6, 7, 8 }, instruction(10, 2, 0, 2, 8) }, // mov rax, imm64
+			{ { 0xB8, 0x01, 0x02, 0x03, 0x04 }, instruction(5, 1, 0, 1, 4) }, // mov eax, imm32
+			{ { 0x66, 0xB8, 0x34, 0x12 }, instruction(4, 2, 0, 2, 2) }, // mov ax, imm16
+			{ { 0x48, 0x81, 0xEC, 0x28, 0x01, 0x00, 0x00 }, instruction(7, 3, 0, 3, 4) }, // sub rsp, imm32
+			{ { 0x48, 0x83, 0xEC, 0x28 }, instruction(4, 3, 0, 3, 1) }, // sub rsp, imm8
+			{ { 0xF6, 0xC1, 0x01 }, instruction(3, 2, 0, 2, 1) }, // test cl, imm8
+			{ { 0xF7, 0xC1, 0x01, 0x02, 0x03, 0x04 }, instruction(6, 2, 0, 2, 4) }, // test ecx, imm32
+			{ { 0xF7, 0xD8 }, instruction(2, 2, 0, 2, 0) }, // neg eax, no immediate for the other f7 forms
+			{ { 0x66, 0xF7, 0xC1, 0x34, 0x12 }, instruction(5, 3, 0, 3, 2) }, // test cx, imm16
+			{ { 0xC3 }, instruction(1, 1, 0, 1, 0) }, // ret
+			{ { 0xC2, 0x08, 0x00 }, instruction(3, 1, 0, 1, 2) }, // ret imm16
+			{ { 0xC8, 0x20, 0x00, 0x01 }, instruction(4, 1, 0, 1, 3) }, // enter imm16, imm8
+			{ { 0x8B, 0x04, 0x25, 0x44, 0x33, 0x22, 0x11 }, instruction(7, 3, 4, 7, 0) }, // mov eax, [disp32], sib without a base
+			{ { 0x8B, 0x84, 0x24, 0x00, 0x01, 0x00, 0x00 }, instruction(7, 3, 4, 7, 0) }, // mov eax, [rsp+disp32]
+			{ { 0xC5, 0xF8, 0x77 }, instruction(3, 3, 0, 3, 0) }, // vzeroupper
+			{ { 0xC5, 0xF9, 0x6F, 0x05, 0x01, 0x02, 0x03, 0x04 }, instruction(8, 4, 4, 8, 0, true) }, // vmovdqa xmm0, [rip+disp32]
+			{ { 0xC4, 0xE3, 0x79, 0x0F, 0xC1, 0x08 }, instruction(6, 5, 0, 5, 1) }, // vpalignr, map 3 has an immediate
+			{ { 0x62, 0xF1, 0x7C, 0x48, 0x10, 0x00 }, instruction(6, 6, 0, 6, 0) }, // vmovups zmm0, [rax]
+			{ { 0x0F, 0x1F, 0x44, 0x00, 0x00 }, instruction(5, 4, 1, 5, 0) }, // nop [rax+rax+0]
+			{ { 0x66, 0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00 }, instruction(9, 5, 4, 9, 0) }, // nop [rax+rax+disp32]
+			{ { 0x48, 0xA1, 1, 2, 3, 4, 5, 6, 7, 8 }, instruction(10, 2, 0, 2, 8) }, // mov rax, [moffs64]
+			{ { 0x67, 0xA1, 0x01, 0x02, 0x03, 0x04 }, instruction(6, 2, 0, 2, 4) }, // mov eax, [moffs32]
+			{ { 0x0F, 0x38, 0x00, 0xC1 }, instruction(4, 4, 0, 4, 0) }, // pshufb
+			{ { 0x66, 0x0F, 0x3A, 0x0F, 0xC1, 0x08 }, instruction(6, 5, 0, 5, 1) }, // palignr
+			{ { 0xF3, 0x48, 0xAB }, instruction(3, 3, 0, 3, 0) }, // rep stosq
+			{ { 0x41, 0xFF, 0xD0 }, instruction(3, 3, 0, 3, 0) }, // call r8
+			{ { 0xFF, 0x15, 0x01, 0x02, 0x03, 0x04 }, instruction(6, 2, 4, 6, 0, true) }, // call [rip+disp32]
+			{ { 0x48, 0x8D, 0x0D, 0x01, 0x02, 0x03, 0x04 }, instruction(7, 3, 4, 7, 0, true) }, // lea rcx, [rip+disp32]
+		};
+	}
+} // namespace
+
+TEST_CASE("decodes instruction lengths and operand fields", "[x64_decoder]") {
+	for (const auto &[bytes, expected] : expected_instructions()) {
+		auto decoded = decode_x64(bytes);
+		REQUIRE(decoded.has_value());
+		CHECK(decoded->length == expected.length);
+		CHECK(decoded->displacement_size == expected.displacement_size);
+		if (expected.displacement_size > 0) {
+			CHECK(decoded->displacement_offset == expected.displacement_offset);
+		}
+
+		CHECK(decoded->immediate_size == expected.immediate_size);
+		if (expected.immediate_size > 0) {
+			CHECK(decoded->immediate_offset == expected.immediate_offset);
+		}
+
+		CHECK(decoded->rip_relative == expected.rip_relative);
+		CHECK(decoded->relative_branch == expected.relative_branch);
+	}
+}
+
+TEST_CASE("walks instruction boundaries in a stream", "[x64_decoder]") {
+	std::vector<uint8_t> code;
+	std::vector<size_t> boundaries;
+	for (const auto &[bytes, expected] : expected_instructions()) {
+		code.insert(code.end(), bytes.begin(), bytes.end());
+		boundaries.push_back(code.size());
+	}
+
+	std::vector<size_t> decoded;
+	size_t pos = 0;
+	while (pos < code.size()) {
+		auto next = decode_x64(std::span<const uint8_t>(code).subspan(pos));
+		REQUIRE(next.has_value());
+		pos += next->length;
+		decoded.push_back(pos);
+	}
+
+	CHECK(decoded == boundaries);
+}
+
+TEST_CASE("rejects instructions cut off before their end", "[x64_decoder]") {
+	for (const auto &[bytes, expected] : expected_instructions()) {
+		for (size_t size = 0; size < bytes.size(); ++size) {
+			CHECK_FALSE(decode_x64(std::span<const uint8_t>(bytes).first(size)).has_value());
+		}
+	}
+}
+
+TEST_CASE("rejects opcodes that are invalid in 64-bit mode", "[x64_decoder]") {
+	constexpr std::array<std::array<uint8_t, 4>, 8> invalid = { {
+		{ 0x06, 0x90, 0x90, 0x90 }, // push es
+		{ 0x27, 0x90, 0x90, 0x90 }, // daa
+		{ 0x37, 0x90, 0x90, 0x90 }, // aaa
+		{ 0xD6, 0x90, 0x90, 0x90 }, // salc
+		{ 0x9A, 0x90, 0x90, 0x90 }, // call far
+		{ 0x0F, 0x04, 0x90, 0x90 },
+		{ 0x0F, 0x0A, 0x90, 0x90 },
+		{ 0xC4, 0xE4, 0x79, 0x90 }, // vex map 4
+	} };
+
+	for (const auto &bytes : invalid) {
+		CHECK_FALSE(decode_x64(bytes).has_value());
+	}
+}
+
+TEST_CASE("limits instructions to 15 bytes", "[x64_decoder]") {
+	std::vector<uint8_t> code(14, 0x66);
+	code.push_back(0x90);
+	auto decoded = decode_x64(code);
+	REQUIRE(decoded.has_value());
+	CHECK(decoded->length == 15);
+
+	code.insert(code.begin(), 0x66);
+	CHECK_FALSE(decode_x64(code).has_value());
+}
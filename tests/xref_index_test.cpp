@@ -0,0 +1,174 @@
+// stormbird project
+// Copyright (c) 2023 <https://github.com/yretenai/stormbird>
+// SPDX-License-Identifier: MPL-2.0
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+	#include <sys/mman.h>
+	#define STORMBIRD_TEST_MMAN 1
+#endif
+
+#include <snitch/snitch.hpp>
+
+#include "pe_fixture.hpp"
+#include "xref_index.hpp"
+
+using namespace stormbird_hook;
+using stormbird_test::pe_fixture;
+using stormbird_test::relocation_block;
+
+namespace {
+	constexpr uint64_t image_base = 0x140000000;
+	constexpr uint32_t page_size = 0x1000;
+
+	void
+	put_string(std::vector<uint8_t> &section, uint32_t offset, std::string_view text) {
+		std::memcpy(section.data() + offset, text.data(), text.size());
+	}
+
+	void
+	put_pointer(std::vector<uint8_t> &section, uint32_t offset, uint64_t value) {
+		std::memcpy(section.data() + offset, &value, sizeof(value));
+	}
+
+	// strings and pointers in .rdata, pointers to them in both pages of .data, and code that is never indexed
+	auto
+	make_fixture() -> pe_fixture {
+		std::vector<uint8_t> rdata(0x200);
+		put_string(rdata, 0x00, "RTTIFactory");
+		put_string(rdata, 0x10, "abc"); // shorter than min_string_size
+		put_string(rdata, 0x20, "Player");
+		put_string(rdata, 0x30, "Player");
+		put_pointer(rdata, 0x100, image_base + 0x2020);
+		put_pointer(rdata, 0x108, image_base + 0x3000);
+		put_pointer(rdata, 0x111, image_base + 0x2030); // unaligned
+		put_pointer(rdata, 0x118, 0x1); // not into the image
+
+		std::vector<uint8_t> data(0x1100);
+		put_pointer(data, 0x008, image_base + 0x2000);
+		put_pointer(data, 0x1010, image_base + 0x2000);
+
+		constexpr uint16_t dir64 = 10 << 12;
+		auto relocations = relocation_block(0x2000, { dir64 | 0x100, dir64 | 0x108, dir64 | 0x111 });
+		auto data_relocations = relocation_block(0x3000, { dir64 | 0x008 });
+		auto second_page = relocation_block(0x4000, { dir64 | 0x010 });
+		relocations.insert(relocations.end(), data_relocations.begin(), data_relocations.end());
+		relocations.insert(relocations.end(), second_page.begin(), second_page.end());
+
+		pe_fixture fixture;
+		fixture.image_base = image_base;
+		fixture.sections = {
+			{ ".text", 0x1000, 0x100, std::vector<uint8_t>(0x100, 0xCC), pe_section_code | pe_section_execute | pe_section_read },
+			{ ".rdata", 0x2000, 0x200, rdata, pe_section_initialized_data | pe_section_read },
+			{ ".data", 0x3000, 0x2000, data, pe_section_initialized_data | pe_section_read | pe_section_write },
+			{ ".reloc", 0x5000, static_cast<uint32_t>(relocations.size()), relocations, pe_section_initialized_data | pe_section_read },
+		};
+
+		fixture.directories[pe_directory_base_relocation] = { 0x5000, static_cast<uint32_t>(relocations.size()) };
+		fixture.size_of_image = 0x6000;
+		return fixture;
+	}
+
+	// the fixture the way the loader leaves it at base, relocated and with the .reloc section dropped from the image
+	void
+	load(const pe_fixture &fixture, uint8_t *base) {
+		auto file = fixture.file();
+		auto image = parse_pe_image(file);
+		auto loaded = fixture.loaded();
+		std::memcpy(base, loaded.data(), loaded.size());
+		for (const auto &relocation : parse_relocations(file, *image)) {
+			uint64_t value = 0;
+			std::memcpy(&value, base + relocation.rva, sizeof(value));
+			value += reinterpret_cast<uint64_t>(base) - image->image_base;
+			std::memcpy(base + relocation.rva, &value, sizeof(value));
+		}
+	}
+
+	// checks the index of the whole fixture, however it was built
+	void
+	check_full_index(const xref_index &index, uint64_t base) {
+		CHECK(index.image_base() == base);
+		CHECK(index.contains(base));
+		CHECK(index.contains(base + 0x5FFF));
+		CHECK_FALSE(index.contains(base + 0x6000));
+
+		CHECK(index.find_string("RTTIFactory") == std::vector<uint32_t> { 0x2000 });
+		CHECK(index.find_string("Player") == std::vector<uint32_t> { 0x2020, 0x2030 });
+		CHECK(index.find_string("abc").empty());
+		CHECK(index.find_string("Play").empty());
+
+		CHECK(index.string_at(0x2020) == "Player");
+		CHECK(index.string_at(0x2022) == "ayer");
+		CHECK_FALSE(index.string_at(0x1000).has_value());
+		CHECK_FALSE(index.string_at(0x7000).has_value());
+
+		auto to_player = index.pointers_to(base + 0x2020);
+		REQUIRE(to_player.size() == 1);
+		CHECK(to_player[0].rva == 0x2100);
+		CHECK(index.pointers_to(base + 0x3000).size() == 1);
+		CHECK(index.pointers_to(base + 0x2030).empty()); // only aligned pointers are indexed
+		CHECK(index.pointers_to(1).empty());
+
+		CHECK(index.pointers_to_string("RTTIFactory") == std::vector<uint32_t> { 0x3008, 0x4010 });
+		CHECK(index.pointers_to_string("Player") == std::vector<uint32_t> { 0x2100 });
+	}
+} // namespace
+
+TEST_CASE("indexes the strings and aligned pointers of a file", "[xref_index]") {
+	auto fixture = make_fixture();
+	auto file = fixture.file();
+	auto image = parse_pe_image(file);
+	REQUIRE(image.has_value());
+
+	check_full_index(build_xref_index(file, *image), image_base);
+}
+
+TEST_CASE("indexes a loaded image through its readable ranges", "[xref_index]") {
+	auto fixture = make_fixture();
+	std::vector<uint8_t> memory(fixture.size_of_image + page_size);
+	auto *base = memory.data() + (page_size - reinterpret_cast<uintptr_t>(memory.data()) % page_size);
+	load(fixture, base);
+
+	auto image = parse_pe_image({ base, fixture.size_of_image });
+	REQUIRE(image.has_value());
+
+	std::vector<std::pair<const uint8_t *, const uint8_t *>> readable = { { base, base + fixture.size_of_image } };
+	check_full_index(build_loaded_xref_index(base, *image, readable), reinterpret_cast<uint64_t>(base));
+
+	// the second page of .data is gone, nothing in it is indexed
+	readable = { { base, base + 0x4000 }, { base + 0x5000, base + fixture.size_of_image } };
+	auto index = build_loaded_xref_index(base, *image, readable);
+	CHECK(index.pointers_to_string("RTTIFactory") == std::vector<uint32_t> { 0x3008 });
+	CHECK(index.find_string("Player") == std::vector<uint32_t> { 0x2020, 0x2030 });
+
+	// no readable ranges, nothing indexed
+	index = build_loaded_xref_index(base, *image, {});
+	CHECK(index.all_pointers().empty());
+	CHECK(index.string_count() == 0);
+}
+
+#ifdef STORMBIRD_TEST_MMAN
+TEST_CASE("does not read pages outside the readable ranges", "[xref_index]") {
+	auto fixture = make_fixture();
+	auto *base = static_cast<uint8_t *>(mmap(nullptr, fixture.size_of_image, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	REQUIRE(base != MAP_FAILED);
+	load(fixture, base);
+
+	auto image = parse_pe_image({ base, fixture.size_of_image });
+	REQUIRE(image.has_value());
+
+	// the first page of .data faults if touched, like a decommitted page in the game
+	REQUIRE(mprotect(base + 0x3000, page_size, PROT_NONE) == 0);
+	std::vector<std::pair<const uint8_t *, const uint8_t *>> readable = { { base, base + 0x3000 }, { base + 0x4000, base + fixture.size_of_image } };
+	auto index = build_loaded_xref_index(base, *image, readable);
+	CHECK(index.pointers_to_string("RTTIFactory") == std::vector<uint32_t> { 0x4010 });
+	CHECK(index.pointers_to_string("Player") == std::vector<uint32_t> { 0x2100 });
+
+	munmap(base, fixture.size_of_image);
+}
+#endif